@@ -19,4 +19,7 @@
 /* Library installation directory */
 #cmakedefine KURENTO_MODULES_SO_DIR "@KURENTO_MODULES_SO_DIR@"
 
+/* io_uring is available for file writes */
+#cmakedefine HAVE_LIBURING
+
 #endif /* __KMS_ELEMENTS_CONFIG_H__ */
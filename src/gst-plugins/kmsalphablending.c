@@ -19,6 +19,7 @@
 #endif
 
 #include "kmsalphablending.h"
+#include "kmsoverlayblender.h"
 #include <commons/kmsagnosticcaps.h>
 #include <commons/kms-core-marshal.h>
 #include <commons/kmshubport.h>
@@ -94,6 +95,7 @@ enum
 enum
 {
   SIGNAL_SET_PORT_PROPERTIES,
+  SIGNAL_SET_PORTS_PROPERTIES,
   LAST_SIGNAL
 };
 
@@ -112,6 +114,7 @@ struct _KmsAlphaBlendingPrivate
   GRecMutex mutex;
   gint n_elems;
   gint output_width, output_height;
+  gint videotestsrc_width, videotestsrc_height;
   int master_port;
   int z_master;
 };
@@ -139,8 +142,11 @@ typedef struct _KmsAlphaBlendingData
   GstElement *videoscale;
   GstElement *queue;
   GstElement *videorate;
-  GstElement *videobox;
   GstPad *video_mixer_pad;
+  /* Last caps set on capsfilter */
+  gboolean caps_master;
+  gint caps_width;
+  gint caps_height;
   GstPad *videoconvert_sink_pad;
   gfloat relative_x;
   gfloat relative_y;
@@ -172,136 +178,131 @@ kms_create_alpha_blending_data ()
   return data;
 }
 
-static gint
-compare_port_data (KmsAlphaBlendingData * a, KmsAlphaBlendingData * b)
-{
-  return a->id - b->id;
-}
-
+/* Caps changes renegotiate the whole port, so the capsfilter is only */
+/* touched when the size or the role of the port change */
 static void
-configure_port (KmsAlphaBlendingData * port_data)
+kms_alpha_blending_port_set_caps (KmsAlphaBlendingData * port_data,
+    gboolean master, gint width, gint height)
 {
-  KmsAlphaBlending *mixer = port_data->mixer;
   GstCaps *filtercaps;
 
-  if (port_data->configured) {
-    gint _relative_x, _relative_y, _relative_width, _relative_height;
-
-    _relative_x = port_data->relative_x * mixer->priv->output_width;
-    _relative_y = port_data->relative_y * mixer->priv->output_height;
-    _relative_width = port_data->relative_width * mixer->priv->output_width;
-    _relative_height = port_data->relative_height * mixer->priv->output_height;
+  if (port_data->capsfilter == NULL || (port_data->caps_master == master &&
+          port_data->caps_width == width && port_data->caps_height == height)) {
+    return;
+  }
 
+  if (master) {
+    /* Master frames are the base of the output, blended in place */
+    filtercaps =
+        gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "I420",
+        "width", G_TYPE_INT, width, "height", G_TYPE_INT, height, NULL);
+  } else {
     filtercaps =
         gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "AYUV",
-        "width", G_TYPE_INT, _relative_width, "height",
-        G_TYPE_INT, _relative_height, "framerate", GST_TYPE_FRACTION, 15, 1,
-        NULL);
-
-    if (port_data->videobox != NULL) {
-      int left = 0;
-      int right = 0;
-      int top = 0;
-      int bottom = 0;
-
-      if (_relative_x <= 0) {
-        left = -1 * _relative_x;
-        if ((_relative_width - left) > mixer->priv->output_width) {
-          right = (_relative_width - left) - mixer->priv->output_width;
-        }
-      }
-
-      if (_relative_y <= 0) {
-        top = -1 * _relative_y;
-        if ((_relative_height - top) > mixer->priv->output_height) {
-          bottom = (_relative_height - top) - mixer->priv->output_height;
-        }
-      }
-      g_object_set (port_data->videobox, "right", right, "left", left, "top",
-          top, "bottom", bottom, NULL);
-    }
+        "width", G_TYPE_INT, width, "height", G_TYPE_INT, height,
+        "framerate", GST_TYPE_FRACTION, 15, 1, NULL);
+  }
 
-    if (port_data->video_mixer_pad != NULL) {
-      int aux_x = _relative_x;
-      int aux_y = _relative_y;
+  g_object_set (G_OBJECT (port_data->capsfilter), "caps", filtercaps, NULL);
+  gst_caps_unref (filtercaps);
 
-      if (aux_x < 0) {
-        aux_x = 0;
-      }
+  port_data->caps_master = master;
+  port_data->caps_width = width;
+  port_data->caps_height = height;
+}
 
-      if (aux_y < 0) {
-        aux_y = 0;
-      }
+static void
+configure_port_pad (KmsAlphaBlendingData * port_data)
+{
+  KmsAlphaBlending *mixer = port_data->mixer;
 
-      g_object_set (port_data->video_mixer_pad, "xpos", aux_x, "ypos", aux_y,
-          "zorder", port_data->z_order, "alpha", 1.0, NULL);
-    }
+  if (port_data->video_mixer_pad == NULL) {
+    return;
+  }
 
+  if (port_data->id == mixer->priv->master_port) {
+    g_object_set (port_data->video_mixer_pad, "xpos", 0, "ypos", 0, "alpha",
+        1.0, "zorder", mixer->priv->z_master, "master", TRUE, NULL);
+  } else if (port_data->configured) {
+    /* The blender clips the parts that fall out of the frame */
+    g_object_set (port_data->video_mixer_pad, "xpos",
+        (gint) (port_data->relative_x * mixer->priv->output_width), "ypos",
+        (gint) (port_data->relative_y * mixer->priv->output_height),
+        "zorder", port_data->z_order, "alpha", 1.0, "master", FALSE, NULL);
   } else {
-    filtercaps =
-        gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "AYUV",
-        "width", G_TYPE_INT, mixer->priv->output_width, "height",
-        G_TYPE_INT, mixer->priv->output_height,
-        "framerate", GST_TYPE_FRACTION, 15, 1, NULL);
-    if (port_data->video_mixer_pad != NULL) {
-      g_object_set (port_data->video_mixer_pad, "xpos", 0, "ypos", 0, "alpha",
-          1.0, "zorder", 1, NULL);
-    }
+    g_object_set (port_data->video_mixer_pad, "xpos", 0, "ypos", 0, "alpha",
+        1.0, "zorder", 1, "master", FALSE, NULL);
   }
+}
 
-  if (port_data->capsfilter != NULL) {
-    g_object_set (G_OBJECT (port_data->capsfilter), "caps", filtercaps, NULL);
+static void
+configure_port_caps (KmsAlphaBlendingData * port_data)
+{
+  KmsAlphaBlending *mixer = port_data->mixer;
+
+  if (port_data->id == mixer->priv->master_port) {
+    kms_alpha_blending_port_set_caps (port_data, TRUE,
+        mixer->priv->output_width, mixer->priv->output_height);
+  } else if (port_data->configured) {
+    kms_alpha_blending_port_set_caps (port_data, FALSE,
+        port_data->relative_width * mixer->priv->output_width,
+        port_data->relative_height * mixer->priv->output_height);
+  } else {
+    kms_alpha_blending_port_set_caps (port_data, FALSE,
+        mixer->priv->output_width, mixer->priv->output_height);
   }
+}
 
-  gst_caps_unref (filtercaps);
+static void
+configure_port (KmsAlphaBlendingData * port_data)
+{
+  configure_port_pad (port_data);
+  configure_port_caps (port_data);
 }
 
 static void
-kms_alpha_blending_reconfigure_ports (KmsAlphaBlending * self)
+kms_alpha_blending_set_videotestsrc_caps (KmsAlphaBlending * self)
 {
   GstCaps *filtercaps;
-  GList *l;
-  GList *values = g_hash_table_get_values (self->priv->ports);
 
-  values = g_list_sort (values, (GCompareFunc) compare_port_data);
+  if (self->priv->videotestsrc_capsfilter == NULL ||
+      (self->priv->videotestsrc_width == self->priv->output_width &&
+          self->priv->videotestsrc_height == self->priv->output_height)) {
+    return;
+  }
+
+  /* Base of the output until the master port sends video */
+  filtercaps =
+      gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "I420",
+      "width", G_TYPE_INT, self->priv->output_width, "height",
+      G_TYPE_INT, self->priv->output_height, "framerate", GST_TYPE_FRACTION, 15,
+      1, NULL);
+  g_object_set (G_OBJECT (self->priv->videotestsrc_capsfilter), "caps",
+      filtercaps, NULL);
+  gst_caps_unref (filtercaps);
 
-  for (l = values; l != NULL; l = l->next) {
-    KmsAlphaBlendingData *port_data = l->data;
+  self->priv->videotestsrc_width = self->priv->output_width;
+  self->priv->videotestsrc_height = self->priv->output_height;
+}
 
-    if (port_data->input == FALSE) {
-      continue;
-    }
+static void
+kms_alpha_blending_reconfigure_ports (KmsAlphaBlending * self)
+{
+  GHashTableIter iter;
+  gpointer value;
 
-    if (port_data->id == self->priv->master_port) {
-      filtercaps =
-          gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "AYUV",
-          "width", G_TYPE_INT, self->priv->output_width, "height",
-          G_TYPE_INT, self->priv->output_height, NULL);
+  g_hash_table_iter_init (&iter, self->priv->ports);
 
-      if (port_data->capsfilter != NULL) {
-        g_object_set (G_OBJECT (port_data->capsfilter), "caps", filtercaps,
-            NULL);
-      }
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    KmsAlphaBlendingData *port_data = value;
 
-      if (port_data->video_mixer_pad != NULL) {
-        g_object_set (port_data->video_mixer_pad, "xpos", 0, "ypos", 0, "alpha",
-            1.0, "zorder", self->priv->z_master, NULL);
-      }
-    } else {
+    if (port_data->input) {
       configure_port (port_data);
     }
   }
 
-  g_list_free (values);
   //reconfigure videotestsrc input
-  filtercaps =
-      gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "AYUV",
-      "width", G_TYPE_INT, self->priv->output_width, "height",
-      G_TYPE_INT, self->priv->output_height, "framerate", GST_TYPE_FRACTION, 15,
-      1, NULL);
-  g_object_set (G_OBJECT (self->priv->videotestsrc_capsfilter), "caps",
-      filtercaps, NULL);
-  gst_caps_unref (filtercaps);
+  kms_alpha_blending_set_videotestsrc_caps (self);
 }
 
 static void
@@ -402,13 +403,11 @@ static gboolean
 remove_elements_from_pipeline (KmsAlphaBlendingData * port_data)
 {
   KmsAlphaBlending *self = port_data->mixer;
-  GstElement *videoconvert, *videoscale, *videorate, *capsfilter, *queue,
-      *videobox;
+  GstElement *videoconvert, *videoscale, *videorate, *capsfilter, *queue;
 
   KMS_ALPHA_BLENDING_LOCK (self);
 
-  videobox = port_data->videobox;
-  gst_element_unlink (videobox, self->priv->videomixer);
+  gst_element_unlink (port_data->capsfilter, self->priv->videomixer);
 
   if (port_data->video_mixer_pad != NULL) {
     gst_element_release_request_pad (self->priv->videomixer,
@@ -422,7 +421,6 @@ remove_elements_from_pipeline (KmsAlphaBlendingData * port_data)
   queue = g_object_ref (port_data->queue);
   videoscale = g_object_ref (port_data->videoscale);
   capsfilter = g_object_ref (port_data->capsfilter);
-  g_object_ref (videobox);
 
   g_object_unref (port_data->videoconvert_sink_pad);
 
@@ -432,10 +430,11 @@ remove_elements_from_pipeline (KmsAlphaBlendingData * port_data)
   port_data->queue = NULL;
   port_data->videoscale = NULL;
   port_data->capsfilter = NULL;
-  port_data->videobox = NULL;
+  port_data->caps_width = 0;
+  port_data->caps_height = 0;
 
   gst_bin_remove_many (GST_BIN (self), videoconvert, videoscale, capsfilter,
-      videorate, queue, videobox, NULL);
+      videorate, queue, NULL);
 
   kms_base_hub_unlink_video_src (KMS_BASE_HUB (self), port_data->id);
 
@@ -446,14 +445,12 @@ remove_elements_from_pipeline (KmsAlphaBlendingData * port_data)
   gst_element_set_state (videorate, GST_STATE_NULL);
   gst_element_set_state (capsfilter, GST_STATE_NULL);
   gst_element_set_state (queue, GST_STATE_NULL);
-  gst_element_set_state (videobox, GST_STATE_NULL);
 
   g_object_unref (videoconvert);
   g_object_unref (videoscale);
   g_object_unref (videorate);
   g_object_unref (capsfilter);
   g_object_unref (queue);
-  g_object_unref (videobox);
 
   return G_SOURCE_REMOVE;
 }
@@ -650,7 +647,6 @@ link_to_videomixer (GstPad * pad, GstPadProbeInfo * info,
   }
 
   if (mixer->priv->videotestsrc == NULL) {
-    GstCaps *filtercaps;
     GstPad *pad;
 
     mixer->priv->videotestsrc = gst_element_factory_make ("videotestsrc", NULL);
@@ -660,14 +656,7 @@ link_to_videomixer (GstPad * pad, GstPadProbeInfo * info,
     g_object_set (mixer->priv->videotestsrc, "is-live", TRUE, "pattern",
         /*black */ 2, NULL);
 
-    filtercaps =
-        gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "AYUV",
-        "width", G_TYPE_INT, mixer->priv->output_width,
-        "height", G_TYPE_INT, mixer->priv->output_height,
-        "framerate", GST_TYPE_FRACTION, 15, 1, NULL);
-    g_object_set (G_OBJECT (mixer->priv->videotestsrc_capsfilter), "caps",
-        filtercaps, NULL);
-    gst_caps_unref (filtercaps);
+    kms_alpha_blending_set_videotestsrc_caps (mixer);
 
     gst_bin_add_many (GST_BIN (mixer), mixer->priv->videotestsrc,
         mixer->priv->videotestsrc_capsfilter, NULL);
@@ -680,7 +669,7 @@ link_to_videomixer (GstPad * pad, GstPadProbeInfo * info,
         sink_pad_template, NULL, NULL);
     gst_element_link_pads (mixer->priv->videotestsrc_capsfilter, NULL,
         mixer->priv->videomixer, GST_OBJECT_NAME (pad));
-    g_object_set (pad, "xpos", 0, "ypos", 0, "alpha", 0.0, "zorder", 0, NULL);
+    g_object_set (pad, "xpos", 0, "ypos", 0, "alpha", 1.0, "zorder", 0, NULL);
     g_object_unref (pad);
 
     gst_element_sync_state_with_parent (mixer->priv->videotestsrc_capsfilter);
@@ -691,24 +680,23 @@ link_to_videomixer (GstPad * pad, GstPadProbeInfo * info,
   data->capsfilter = gst_element_factory_make ("capsfilter", NULL);
   data->videorate = gst_element_factory_make ("videorate", NULL);
   data->queue = gst_element_factory_make ("queue", NULL);
-  data->videobox = gst_element_factory_make ("videobox", NULL);
   data->input = TRUE;
 
   gst_bin_add_many (GST_BIN (mixer), data->queue, data->videorate,
-      data->videoscale, data->capsfilter, data->videobox, NULL);
+      data->videoscale, data->capsfilter, NULL);
 
   g_object_set (data->videorate, "average-period", 200 * GST_MSECOND, NULL);
   g_object_set (data->queue, "flush-on-eos", TRUE, NULL);
 
   gst_element_link_many (data->videorate, data->queue, data->videoscale,
-      data->capsfilter, data->videobox, NULL);
+      data->capsfilter, NULL);
 
   /*link capsfilter -> videomixer */
   data->video_mixer_pad =
       gst_element_request_pad (mixer->priv->videomixer,
       sink_pad_template, NULL, NULL);
 
-  gst_element_link_pads (data->videobox, NULL,
+  gst_element_link_pads (data->capsfilter, NULL,
       mixer->priv->videomixer, GST_OBJECT_NAME (data->video_mixer_pad));
 
   gst_element_link (data->videoconvert, data->videorate);
@@ -722,7 +710,6 @@ link_to_videomixer (GstPad * pad, GstPadProbeInfo * info,
   gst_element_sync_state_with_parent (data->capsfilter);
   gst_element_sync_state_with_parent (data->videorate);
   gst_element_sync_state_with_parent (data->queue);
-  gst_element_sync_state_with_parent (data->videobox);
 
   /* configure videomixer pad */
   mixer->priv->n_elems++;
@@ -857,8 +844,7 @@ kms_alpha_blending_handle_port (KmsBaseHub * mixer,
     GstElement *videorate_mixer;
 
     videorate_mixer = gst_element_factory_make ("videorate", NULL);
-    self->priv->videomixer = gst_element_factory_make ("compositor", NULL);
-    g_object_set (G_OBJECT (self->priv->videomixer), "background", 1, NULL);
+    self->priv->videomixer = gst_element_factory_make ("overlayblender", NULL);
     self->priv->mixer_video_agnostic =
         gst_element_factory_make ("agnosticbin", NULL);
 
@@ -897,58 +883,148 @@ kms_alpha_blending_handle_port (KmsBaseHub * mixer,
   return port_id;
 }
 
-static void
-kms_alpha_blending_set_port_properties (KmsAlphaBlending * self,
-    GstStructure * properties)
+typedef struct _KmsAlphaBlendingPortProperties
 {
-  gint port, z_order;
-  gfloat relative_x, relative_y, relative_width, relative_height;
-  KmsAlphaBlendingData *port_data;
-  gboolean fields_ok = TRUE;
+  gint port;
+  gint z_order;
+  gfloat relative_x;
+  gfloat relative_y;
+  gfloat relative_width;
+  gfloat relative_height;
+} KmsAlphaBlendingPortProperties;
 
-  GST_DEBUG ("setting port properties");
+static gboolean
+kms_alpha_blending_parse_port_properties (KmsAlphaBlending * self,
+    const GstStructure * properties, KmsAlphaBlendingPortProperties * props)
+{
+  gboolean fields_ok = TRUE;
 
   fields_ok = fields_ok
-      && gst_structure_get (properties, "relative_x", G_TYPE_FLOAT, &relative_x,
-      NULL);
+      && gst_structure_get (properties, "relative_x", G_TYPE_FLOAT,
+      &props->relative_x, NULL);
   fields_ok = fields_ok
-      && gst_structure_get (properties, "relative_y", G_TYPE_FLOAT, &relative_y,
-      NULL);
+      && gst_structure_get (properties, "relative_y", G_TYPE_FLOAT,
+      &props->relative_y, NULL);
   fields_ok = fields_ok
       && gst_structure_get (properties, "relative_width", G_TYPE_FLOAT,
-      &relative_width, NULL);
+      &props->relative_width, NULL);
   fields_ok = fields_ok
       && gst_structure_get (properties, "relative_height", G_TYPE_FLOAT,
-      &relative_height, NULL);
+      &props->relative_height, NULL);
   fields_ok = fields_ok
-      && gst_structure_get (properties, "port", G_TYPE_INT, &port, NULL);
+      && gst_structure_get (properties, "port", G_TYPE_INT, &props->port, NULL);
   fields_ok = fields_ok
-      && gst_structure_get (properties, "z_order", G_TYPE_INT, &z_order, NULL);
+      && gst_structure_get (properties, "z_order", G_TYPE_INT, &props->z_order,
+      NULL);
 
   if (!fields_ok) {
     GST_WARNING_OBJECT (self, "Invalid properties structure received");
+  }
+
+  return fields_ok;
+}
+
+/* Places the port, its caps have to be updated afterwards */
+static void
+kms_alpha_blending_apply_port_properties (KmsAlphaBlendingData * port_data,
+    KmsAlphaBlendingPortProperties * props)
+{
+  port_data->relative_x = props->relative_x;
+  port_data->relative_y = props->relative_y;
+  port_data->relative_width = props->relative_width;
+  port_data->relative_height = props->relative_height;
+  port_data->z_order = props->z_order;
+  port_data->configured = TRUE;
+
+  configure_port_pad (port_data);
+}
+
+static void
+kms_alpha_blending_set_port_properties (KmsAlphaBlending * self,
+    GstStructure * properties)
+{
+  KmsAlphaBlendingPortProperties props;
+  KmsAlphaBlendingData *port_data;
+
+  GST_DEBUG ("setting port properties");
+
+  if (!kms_alpha_blending_parse_port_properties (self, properties, &props)) {
     return;
   }
 
   KMS_ALPHA_BLENDING_LOCK (self);
 
-  port_data = g_hash_table_lookup (self->priv->ports, GINT_TO_POINTER (port));
+  port_data = g_hash_table_lookup (self->priv->ports,
+      GINT_TO_POINTER (props.port));
 
-  if (port_data == NULL) {
-    KMS_ALPHA_BLENDING_UNLOCK (self);
-    return;
+  if (port_data != NULL) {
+    kms_alpha_blending_apply_port_properties (port_data, &props);
+    configure_port_caps (port_data);
   }
 
-  port_data->relative_x = relative_x;
-  port_data->relative_y = relative_y;
-  port_data->relative_width = relative_width;
-  port_data->relative_height = relative_height;
-  port_data->z_order = z_order;
-  port_data->configured = TRUE;
+  KMS_ALPHA_BLENDING_UNLOCK (self);
+}
+
+static void
+kms_alpha_blending_set_ports_properties (KmsAlphaBlending * self,
+    GPtrArray * properties)
+{
+  KmsAlphaBlendingPortProperties *props;
+  KmsAlphaBlendingData **ports;
+  guint i;
+
+  GST_DEBUG ("setting properties of %u ports", properties->len);
+
+  props = g_new (KmsAlphaBlendingPortProperties, properties->len);
+  ports = g_new (KmsAlphaBlendingData *, properties->len);
+
+  for (i = 0; i < properties->len; i++) {
+    if (!kms_alpha_blending_parse_port_properties (self,
+            g_ptr_array_index (properties, i), &props[i])) {
+      goto end;
+    }
+  }
+
+  KMS_ALPHA_BLENDING_LOCK (self);
+
+  /* Nothing is applied unless every entry is valid */
+  for (i = 0; i < properties->len; i++) {
+    ports[i] = g_hash_table_lookup (self->priv->ports,
+        GINT_TO_POINTER (props[i].port));
 
-  configure_port (port_data);
+    if (ports[i] == NULL) {
+      GST_WARNING_OBJECT (self, "Unknown port %d, no properties applied",
+          props[i].port);
+      KMS_ALPHA_BLENDING_UNLOCK (self);
+      goto end;
+    }
+  }
+
+  /* No frame is composed with only part of the changes */
+  if (self->priv->videomixer != NULL) {
+    kms_overlay_blender_lock_layout (KMS_OVERLAY_BLENDER (self->priv->
+            videomixer));
+  }
+
+  for (i = 0; i < properties->len; i++) {
+    kms_alpha_blending_apply_port_properties (ports[i], &props[i]);
+  }
+
+  if (self->priv->videomixer != NULL) {
+    kms_overlay_blender_unlock_layout (KMS_OVERLAY_BLENDER (self->priv->
+            videomixer));
+  }
+
+  /* Resized ports renegotiate afterwards */
+  for (i = 0; i < properties->len; i++) {
+    configure_port_caps (ports[i]);
+  }
 
   KMS_ALPHA_BLENDING_UNLOCK (self);
+
+end:
+  g_free (props);
+  g_free (ports);
 }
 
 static void
@@ -992,6 +1068,8 @@ kms_alpha_blending_class_init (KmsAlphaBlendingClass * klass)
 
   klass->set_port_properties = GST_DEBUG_FUNCPTR
       (kms_alpha_blending_set_port_properties);
+  klass->set_ports_properties = GST_DEBUG_FUNCPTR
+      (kms_alpha_blending_set_ports_properties);
 
   gobject_class->set_property = kms_alpha_blending_set_property;
   gobject_class->get_property = kms_alpha_blending_get_property;
@@ -1025,6 +1103,13 @@ kms_alpha_blending_class_init (KmsAlphaBlendingClass * klass)
       G_STRUCT_OFFSET (KmsAlphaBlendingClass, set_port_properties), NULL, NULL,
       __kms_core_marshal_VOID__BOXED, G_TYPE_NONE, 1, GST_TYPE_STRUCTURE);
 
+  kms_alpha_blending_signals[SIGNAL_SET_PORTS_PROPERTIES] =
+      g_signal_new ("set-ports-properties",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_ACTION | G_SIGNAL_RUN_LAST,
+      G_STRUCT_OFFSET (KmsAlphaBlendingClass, set_ports_properties), NULL,
+      NULL, __kms_core_marshal_VOID__BOXED, G_TYPE_NONE, 1, G_TYPE_PTR_ARRAY);
+
   /* Registers a private structure for the instantiatable type */
   g_type_class_add_private (klass, sizeof (KmsAlphaBlendingPrivate));
 }
@@ -71,6 +71,8 @@ struct _KmsAlphaBlendingClass
 
     /* Actions */
   void (*set_port_properties) (KmsAlphaBlending * self, GstStructure * properties);
+  /* GPtrArray of set-port-properties structures, applied at once */
+  void (*set_ports_properties) (KmsAlphaBlending * self, GPtrArray * properties);
 };
 
 GType kms_alpha_blending_get_type (void);
@@ -19,13 +19,31 @@
 #endif
 
 #include "kmscompositemixer.h"
+#include "kmscompositemediamode.h"
+#include "kmscompositelayout.h"
+#include "kms-elements-enumtypes.h"
+#include <kms-elements-marshal.h>
 #include <commons/kmsagnosticcaps.h>
 #include <commons/kmshubport.h>
 #include <commons/kmsloop.h>
 #include <commons/kmsrefstruct.h>
 #include <math.h>
 
-#define LATENCY 600             //ms
+#define DEFAULT_WIDTH 800
+#define DEFAULT_HEIGHT 600
+#define DEFAULT_FRAMERATE 15    //fps
+#define DEFAULT_FORMAT NULL     /* Negotiated */
+#define DEFAULT_LATENCY 600     //ms
+#define DEFAULT_MEDIA_MODE KMS_COMPOSITE_MEDIA_MODE_AUDIO_VIDEO
+#define DEFAULT_MIX_MINUS FALSE
+#define DEFAULT_LAYOUT KMS_COMPOSITE_LAYOUT_GRID
+#define DEFAULT_SPEAKERS 1
+#define DEFAULT_MAX_THUMBNAILS 8
+#define DEFAULT_SPEAKER_HOLD_TIME 2000  //ms
+#define DEFAULT_SPEAKER_SWITCH_MARGIN 6 //dB
+
+#define SPEAKER_UPDATE_INTERVAL 250     //ms
+#define THUMBNAIL_STRIP_RATIO 5 /* Thumbnails take 1/5 of the height */
 
 #define PLUGIN_NAME "compositemixer"
 
@@ -35,6 +53,12 @@
 #define KMS_COMPOSITE_MIXER_UNLOCK(mixer) \
   (g_rec_mutex_unlock (&( (KmsCompositeMixer *) (mixer))->priv->mutex))
 
+#define KMS_COMPOSITE_MIXER_HAS_AUDIO(mixer) \
+  ((mixer)->priv->media_mode != KMS_COMPOSITE_MEDIA_MODE_VIDEO)
+
+#define KMS_COMPOSITE_MIXER_HAS_VIDEO(mixer) \
+  ((mixer)->priv->media_mode != KMS_COMPOSITE_MEDIA_MODE_AUDIO)
+
 GST_DEBUG_CATEGORY_STATIC (kms_composite_mixer_debug_category);
 #define GST_CAT_DEFAULT kms_composite_mixer_debug_category
 
@@ -83,6 +107,46 @@ GST_STATIC_PAD_TEMPLATE (VIDEO_SRC_PAD_NAME_COMP,
     GST_STATIC_CAPS (KMS_AGNOSTIC_RAW_VIDEO_CAPS)
     );
 
+enum
+{
+  PROP_0,
+  PROP_WIDTH,
+  PROP_HEIGHT,
+  PROP_FRAMERATE,
+  PROP_FORMAT,
+  PROP_LATENCY,
+  PROP_MEDIA_MODE,
+  PROP_LAYOUT,
+  PROP_SPEAKERS,
+  PROP_MAX_THUMBNAILS,
+  PROP_SPEAKER_HOLD_TIME,
+  PROP_SPEAKER_SWITCH_MARGIN,
+  PROP_MIX_MINUS,
+  N_PROPERTIES
+};
+
+enum
+{
+  SIGNAL_GET_INPUT_STATS,
+  LAST_SIGNAL
+};
+
+static guint obj_signals[LAST_SIGNAL] = { 0 };
+
+/* Working formats accepted by the "format" property */
+static const gchar *supported_formats[] = { "I420", "NV12", "AYUV", NULL };
+
+typedef struct _KmsCompositeMixerCell
+{
+  gint x, y;
+  gint width, height;
+  gboolean visible;
+} KmsCompositeMixerCell;
+
+/* Inputs dropped from the layout keep their own size, so nothing scales */
+/* them, and their buffers are dropped before reaching the videomixer */
+static const KmsCompositeMixerCell hidden_cell = { 0, 0, 0, 0, FALSE };
+
 struct _KmsCompositeMixerPrivate
 {
   GstElement *videomixer;
@@ -90,13 +154,33 @@ struct _KmsCompositeMixerPrivate
   GstElement *datamixer_sink;
   GstElement *datamixer_src;
   GstElement *videotestsrc;
+  GstElement *background_capsfilter;
+  GstElement *output_capsfilter;
   GHashTable *ports;
+  GList *inputs;                /* Ports linked to the videomixer, sorted by id */
+  GPtrArray *layouts;           /* Grid cells (GArray) indexed by number of inputs */
   GstElement *mixer_audio_agnostic;
   GstElement *mixer_video_agnostic;
   KmsLoop *loop;
   GRecMutex mutex;
   gint n_elems;
   gint output_width, output_height;
+  gint framerate;
+  gchar *format;
+  guint latency;
+  KmsCompositeMediaMode media_mode;
+  gboolean mix_minus;
+  /* Serializes starting and stopping the videomixer. Always taken before */
+  /* the mixer lock, as state changes wait for the streaming threads. */
+  GMutex video_state_mutex;
+  gboolean video_active;
+  KmsCompositeLayout layout;
+  guint n_speakers;
+  guint max_thumbnails;
+  guint speaker_hold_time;
+  guint speaker_switch_margin;
+  GPtrArray *speakers;          /* Inputs shown as speakers, by tile */
+  guint speakers_source_id;
 };
 
 /* class initialization */
@@ -120,8 +204,19 @@ typedef struct _KmsCompositeMixerData
   gulong probe_id;
   gulong link_probe_id;
   gulong latency_probe_id;
+  gulong caps_probe_id;
+  gulong hidden_probe_id;
   GstPad *video_mixer_pad;
   GstPad *tee_sink_pad;
+  KmsCompositeMixerCell cell;   /* Geometry currently applied */
+  gint in_width, in_height;     /* Caps received by the videomixer */
+  const gchar *in_format;       /* Interned string */
+  gboolean fast_path;
+  GstPad *audio_sink_pad;
+  gulong audio_probe_id;
+  gboolean audio_s16;
+  gint audio_level;             /* Smoothed mean square of the samples */
+  gint64 speaker_since;
 } KmsCompositeMixerData;
 
 #define KMS_COMPOSITE_MIXER_REF(data) \
@@ -147,6 +242,47 @@ kms_create_composite_mixer_data ()
   return data;
 }
 
+static gboolean
+kms_composite_mixer_caps_has_size (GstCaps * caps,
+    const KmsCompositeMixerCell * cell)
+{
+  GstStructure *st = gst_caps_get_structure (caps, 0);
+  gint width, height;
+
+  return gst_structure_get_int (st, "width", &width)
+      && gst_structure_get_int (st, "height", &height)
+      && width == cell->width && height == cell->height;
+}
+
+/* Must be called with the mixer lock held. A width of 0 leaves the size */
+/* to the input. */
+static GstCaps *
+kms_composite_mixer_create_caps (KmsCompositeMixer * self, gint width,
+    gint height, gboolean with_framerate)
+{
+  GstCaps *caps;
+
+  caps = gst_caps_new_empty_simple ("video/x-raw");
+
+  if (width > 0) {
+    gst_caps_set_simple (caps, "width", G_TYPE_INT, width, "height",
+        G_TYPE_INT, height, "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1,
+        NULL);
+  }
+
+  if (self->priv->format != NULL) {
+    gst_caps_set_simple (caps, "format", G_TYPE_STRING, self->priv->format,
+        NULL);
+  }
+
+  if (with_framerate) {
+    gst_caps_set_simple (caps, "framerate", GST_TYPE_FRACTION,
+        self->priv->framerate, 1, NULL);
+  }
+
+  return caps;
+}
+
 static gint
 compare_port_data (gconstpointer a, gconstpointer b)
 {
@@ -156,57 +292,606 @@ compare_port_data (gconstpointer a, gconstpointer b)
   return port_data_a->id - port_data_b->id;
 }
 
+/* Grid of n_elems cells filling the given area */
+static GArray *
+kms_composite_mixer_create_grid (KmsCompositeMixer * self, gint n_elems,
+    gint area_width, gint area_height)
+{
+  GArray *layout;
+  gint width, height, n_columns, n_rows, i;
+
+  layout = g_array_sized_new (FALSE, FALSE, sizeof (KmsCompositeMixerCell),
+      n_elems);
+
+  n_columns = (gint) ceil (sqrt (n_elems));
+  n_rows = (gint) ceil ((float) n_elems / (float) n_columns);
+
+  GST_DEBUG_OBJECT (self, "columns %d rows %d", n_columns, n_rows);
+
+  width = area_width / n_columns;
+  height = area_height / n_rows;
+
+  for (i = 0; i < n_elems; i++) {
+    KmsCompositeMixerCell cell;
+
+    cell.x = (i % n_columns) * width;
+    cell.y = (i / n_columns) * height;
+    cell.width = width;
+    cell.height = height;
+    cell.visible = TRUE;
+
+    g_array_append_val (layout, cell);
+  }
+
+  return layout;
+}
+
+static GArray *
+kms_composite_mixer_create_layout (KmsCompositeMixer * self, gint n_elems)
+{
+  return kms_composite_mixer_create_grid (self, n_elems,
+      self->priv->output_width, self->priv->output_height);
+}
+
+/* Slots of layouts not computed yet are NULL, and GLib frees those too */
+static void
+kms_composite_mixer_layout_free (GArray * layout)
+{
+  if (layout != NULL) {
+    g_array_unref (layout);
+  }
+}
+
+/* Layouts only depend on the number of inputs, so they are computed once */
+static const KmsCompositeMixerCell *
+kms_composite_mixer_get_layout (KmsCompositeMixer * self, gint n_elems)
+{
+  GArray *layout;
+
+  if (self->priv->layouts->len <= (guint) n_elems) {
+    g_ptr_array_set_size (self->priv->layouts, n_elems + 1);
+  }
+
+  layout = g_ptr_array_index (self->priv->layouts, n_elems);
+
+  if (layout == NULL) {
+    layout = kms_composite_mixer_create_layout (self, n_elems);
+    g_ptr_array_index (self->priv->layouts, n_elems) = layout;
+  }
+
+  return (const KmsCompositeMixerCell *) layout->data;
+}
+
+/* Must be called with the mixer lock held */
+static const gchar *
+kms_composite_mixer_get_working_format (KmsCompositeMixer * self)
+{
+  const gchar *format = NULL;
+  GstCaps *caps;
+  GstPad *pad;
+
+  if (self->priv->format != NULL) {
+    return g_intern_string (self->priv->format);
+  }
+
+  if (self->priv->output_capsfilter == NULL) {
+    return NULL;
+  }
+
+  /* Not forced, so it is the one negotiated by the videomixer */
+  pad = gst_element_get_static_pad (self->priv->output_capsfilter, "src");
+  caps = gst_pad_get_current_caps (pad);
+  g_object_unref (pad);
+
+  if (caps != NULL) {
+    format = g_intern_string (gst_structure_get_string
+        (gst_caps_get_structure (caps, 0), "format"));
+    gst_caps_unref (caps);
+  }
+
+  return format;
+}
+
+/* Must be called with the mixer lock held. An input is in the fast path */
+/* when it reaches the videomixer with the size of its cell and the working */
+/* format: the scaler and converter upstream run in passthrough and the */
+/* videomixer blends it without converting it. */
+static void
+kms_composite_mixer_update_fast_path (KmsCompositeMixer * self,
+    KmsCompositeMixerData * port_data, const gchar * working_format)
+{
+  gboolean fast_path;
+
+  fast_path = port_data->in_format != NULL
+      && port_data->in_format == working_format
+      && port_data->in_width == port_data->cell.width
+      && port_data->in_height == port_data->cell.height;
+
+  if (fast_path == port_data->fast_path) {
+    return;
+  }
+
+  port_data->fast_path = fast_path;
+
+  GST_DEBUG_OBJECT (self, "Fast path %s for port %d (%dx%d %s)",
+      fast_path ? "enabled" : "disabled", port_data->id, port_data->in_width,
+      port_data->in_height, port_data->in_format);
+}
+
+static GstPadProbeReturn
+cb_drop_hidden (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  return GST_PAD_PROBE_DROP;
+}
+
+/* Must be called with the mixer lock held */
+static void
+kms_composite_mixer_set_visible (KmsCompositeMixerData * port_data,
+    gboolean visible)
+{
+  g_object_set (port_data->video_mixer_pad, "alpha", visible ? 1.0 : 0.0,
+      NULL);
+
+  if (!visible && port_data->hidden_probe_id == 0) {
+    port_data->hidden_probe_id = gst_pad_add_probe (port_data->tee_sink_pad,
+        GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+        cb_drop_hidden, NULL, NULL);
+  } else if (visible && port_data->hidden_probe_id > 0) {
+    gst_pad_remove_probe (port_data->tee_sink_pad, port_data->hidden_probe_id);
+    port_data->hidden_probe_id = 0;
+  }
+}
+
+/* Must be called with the mixer lock held. Only touches what changed; an */
+/* unchanged size must not renegotiate caps, as that makes the scaler */
+/* reallocate. */
+static void
+kms_composite_mixer_apply_cell (KmsCompositeMixer * self,
+    KmsCompositeMixerData * port_data, const KmsCompositeMixerCell * cell,
+    GstCaps ** filtercaps, const gchar * working_format)
+{
+  if (cell->width != port_data->cell.width
+      || cell->height != port_data->cell.height) {
+    if (*filtercaps == NULL
+        || !kms_composite_mixer_caps_has_size (*filtercaps, cell)) {
+      if (*filtercaps != NULL) {
+        gst_caps_unref (*filtercaps);
+      }
+
+      *filtercaps = kms_composite_mixer_create_caps (self, cell->width,
+          cell->height, FALSE);
+    }
+
+    g_object_set (port_data->capsfilter, "caps", *filtercaps, NULL);
+  }
+
+  if (cell->x != port_data->cell.x || cell->y != port_data->cell.y) {
+    g_object_set (port_data->video_mixer_pad, "xpos", cell->x, "ypos",
+        cell->y, NULL);
+  }
+
+  if (cell->visible != port_data->cell.visible) {
+    kms_composite_mixer_set_visible (port_data, cell->visible);
+  }
+
+  port_data->cell = *cell;
+  kms_composite_mixer_update_fast_path (self, port_data, working_format);
+
+  GST_DEBUG_OBJECT (self, "id_port %d top %d left %d width %d height %d%s",
+      port_data->id, cell->y, cell->x, cell->width, cell->height,
+      cell->visible ? "" : " (hidden)");
+}
+
+/* Speakers share a grid on top and the rest of the inputs get a strip of */
+/* thumbnails at the bottom, in port order. Inputs that do not fit in the */
+/* strip are hidden. */
+static void
+kms_composite_mixer_apply_speaker_layout (KmsCompositeMixer * self,
+    GstCaps ** filtercaps, const gchar * working_format)
+{
+  guint n_speakers = self->priv->speakers->len;
+  gint n_thumbnails, thumbnail_width, strip_height = 0, thumbnail = 0;
+  GArray *grid = NULL;
+  GList *l;
+  guint i;
+
+  n_thumbnails = MIN ((guint) self->priv->n_elems - n_speakers,
+      self->priv->max_thumbnails);
+
+  if (n_thumbnails > 0) {
+    strip_height = self->priv->output_height / THUMBNAIL_STRIP_RATIO;
+  }
+
+  if (n_speakers > 0) {
+    grid = kms_composite_mixer_create_grid (self, n_speakers,
+        self->priv->output_width, self->priv->output_height - strip_height);
+
+    for (i = 0; i < n_speakers; i++) {
+      kms_composite_mixer_apply_cell (self,
+          g_ptr_array_index (self->priv->speakers, i),
+          &g_array_index (grid, KmsCompositeMixerCell, i), filtercaps,
+          working_format);
+    }
+
+    g_array_unref (grid);
+  }
+
+  thumbnail_width = n_thumbnails > 0 ?
+      self->priv->output_width / n_thumbnails : 0;
+
+  for (l = self->priv->inputs; l != NULL; l = l->next) {
+    KmsCompositeMixerData *port_data = l->data;
+    KmsCompositeMixerCell cell;
+
+    if (port_data->speaker_since > 0) {
+      continue;
+    }
+
+    if (thumbnail < n_thumbnails) {
+      cell.x = thumbnail * thumbnail_width;
+      cell.y = self->priv->output_height - strip_height;
+      cell.width = thumbnail_width;
+      cell.height = strip_height;
+      cell.visible = TRUE;
+      thumbnail++;
+    } else {
+      cell = hidden_cell;
+    }
+
+    kms_composite_mixer_apply_cell (self, port_data, &cell, filtercaps,
+        working_format);
+  }
+}
+
 static void
 kms_composite_mixer_recalculate_sizes (gpointer data)
 {
   KmsCompositeMixer *self = KMS_COMPOSITE_MIXER (data);
-  GstCaps *filtercaps;
-  gint width, height, top, left, counter, n_columns, n_rows;
+  const KmsCompositeMixerCell *layout;
+  const gchar *working_format;
+  GstCaps *filtercaps = NULL;
+  gint counter;
   GList *l;
-  GList *values = g_hash_table_get_values (self->priv->ports);
 
   if (self->priv->n_elems <= 0) {
     return;
   }
 
-  counter = 0;
-  values = g_list_sort (values, compare_port_data);
+  working_format = kms_composite_mixer_get_working_format (self);
 
-  n_columns = (gint) ceil (sqrt (self->priv->n_elems));
-  n_rows = (gint) ceil ((float) self->priv->n_elems / (float) n_columns);
+  if (self->priv->layout == KMS_COMPOSITE_LAYOUT_ACTIVE_SPEAKER) {
+    kms_composite_mixer_apply_speaker_layout (self, &filtercaps,
+        working_format);
+  } else {
+    layout = kms_composite_mixer_get_layout (self, self->priv->n_elems);
 
-  GST_DEBUG_OBJECT (self, "columns %d rows %d", n_columns, n_rows);
+    for (l = self->priv->inputs, counter = 0; l != NULL;
+        l = l->next, counter++) {
+      kms_composite_mixer_apply_cell (self, l->data, &layout[counter],
+          &filtercaps, working_format);
+    }
+  }
 
-  width = self->priv->output_width / n_columns;
-  height = self->priv->output_height / n_rows;
+  if (filtercaps != NULL) {
+    gst_caps_unref (filtercaps);
+  }
+}
+
+/* Must be called with the mixer lock held */
+static void
+kms_composite_mixer_update_output_caps (KmsCompositeMixer * self)
+{
+  GstCaps *caps;
+
+  caps = kms_composite_mixer_create_caps (self, self->priv->output_width,
+      self->priv->output_height, TRUE);
+
+  GST_DEBUG_OBJECT (self, "Output caps: %" GST_PTR_FORMAT, caps);
+
+  if (self->priv->background_capsfilter != NULL) {
+    g_object_set (self->priv->background_capsfilter, "caps", caps, NULL);
+  }
+
+  if (self->priv->output_capsfilter != NULL) {
+    g_object_set (self->priv->output_capsfilter, "caps", caps, NULL);
+  }
+
+  gst_caps_unref (caps);
+}
+
+/* Must be called with the mixer lock held. Used when the canvas size or the */
+/* working format change, so every input has to be renegotiated. */
+static void
+kms_composite_mixer_reset_layout (KmsCompositeMixer * self)
+{
+  GHashTableIter iter;
+  gpointer value;
+  GstCaps *caps;
+
+  g_ptr_array_set_size (self->priv->layouts, 0);
+
+  kms_composite_mixer_update_output_caps (self);
+
+  caps = kms_composite_mixer_create_caps (self, self->priv->output_width,
+      self->priv->output_height, FALSE);
+
+  g_hash_table_iter_init (&iter, self->priv->ports);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    KmsCompositeMixerData *port_data = value;
+
+    if (port_data->input) {
+      port_data->cell.width = port_data->cell.height = -1;
+    } else if (port_data->capsfilter != NULL) {
+      /* Not linked to the videomixer yet; it will take the full canvas */
+      g_object_set (port_data->capsfilter, "caps", caps, NULL);
+    }
+  }
+
+  gst_caps_unref (caps);
+
+  kms_composite_mixer_recalculate_sizes (self);
+}
+
+static gdouble
+kms_composite_mixer_level_to_db (gint level)
+{
+  return 10.0 * log10 (MAX (level, 1));
+}
+
+static gint
+compare_audio_level (gconstpointer a, gconstpointer b)
+{
+  gint level_a = g_atomic_int_get (&((KmsCompositeMixerData *) a)->audio_level);
+  gint level_b = g_atomic_int_get (&((KmsCompositeMixerData *) b)->audio_level);
+
+  return (level_b > level_a) - (level_b < level_a);
+}
 
-  for (l = values; l != NULL; l = l->next) {
+/* Must be called with the mixer lock held */
+static void
+kms_composite_mixer_set_speaker (KmsCompositeMixer * self,
+    KmsCompositeMixerData * port_data, guint tile, gint64 now)
+{
+  if (tile < self->priv->speakers->len) {
+    KmsCompositeMixerData *old = g_ptr_array_index (self->priv->speakers, tile);
+
+    GST_DEBUG_OBJECT (self, "Port %d replaces port %d as speaker",
+        port_data->id, old->id);
+    old->speaker_since = 0;
+    g_ptr_array_index (self->priv->speakers, tile) = port_data;
+  } else {
+    GST_DEBUG_OBJECT (self, "Port %d is now a speaker", port_data->id);
+    g_ptr_array_add (self->priv->speakers, port_data);
+  }
+
+  port_data->speaker_since = now;
+}
+
+/* Must be called with the mixer lock held. Returns TRUE if the set of */
+/* speakers changed. A speaker keeps its tile for at least the hold time, */
+/* and is only replaced by someone louder by more than the switch margin. */
+static gboolean
+kms_composite_mixer_select_speakers (KmsCompositeMixer * self)
+{
+  gint64 hold_time = self->priv->speaker_hold_time * G_TIME_SPAN_MILLISECOND;
+  gint64 now = g_get_monotonic_time ();
+  GList *candidates = NULL, *l;
+  gboolean changed = FALSE;
+  guint i;
+
+  while (self->priv->speakers->len > self->priv->n_speakers) {
+    KmsCompositeMixerData *port_data =
+        g_ptr_array_index (self->priv->speakers,
+        self->priv->speakers->len - 1);
+
+    port_data->speaker_since = 0;
+    g_ptr_array_remove_index (self->priv->speakers,
+        self->priv->speakers->len - 1);
+    changed = TRUE;
+  }
+
+  for (l = self->priv->inputs; l != NULL; l = l->next) {
     KmsCompositeMixerData *port_data = l->data;
 
-    if (port_data->input == FALSE) {
+    if (port_data->speaker_since == 0) {
+      candidates = g_list_prepend (candidates, port_data);
+    }
+  }
+
+  candidates = g_list_sort (candidates, compare_audio_level);
+
+  for (l = candidates; l != NULL; l = l->next) {
+    KmsCompositeMixerData *candidate = l->data, *weakest = NULL;
+    guint tile = 0;
+
+    if (self->priv->speakers->len < self->priv->n_speakers) {
+      kms_composite_mixer_set_speaker (self, candidate,
+          self->priv->speakers->len, now);
+      changed = TRUE;
       continue;
     }
 
-    filtercaps =
-        gst_caps_new_simple ("video/x-raw",
-        "width", G_TYPE_INT, width, "height", G_TYPE_INT, height,
-        "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1, NULL);
-    g_object_set (port_data->capsfilter, "caps", filtercaps, NULL);
-    gst_caps_unref (filtercaps);
+    for (i = 0; i < self->priv->speakers->len; i++) {
+      KmsCompositeMixerData *speaker =
+          g_ptr_array_index (self->priv->speakers, i);
+
+      if (now - speaker->speaker_since < hold_time) {
+        continue;
+      }
+
+      if (weakest == NULL || compare_audio_level (speaker, weakest) > 0) {
+        weakest = speaker;
+        tile = i;
+      }
+    }
+
+    /* Candidates are sorted, so nobody else can take a tile */
+    if (weakest == NULL ||
+        kms_composite_mixer_level_to_db (candidate->audio_level) <
+        kms_composite_mixer_level_to_db (weakest->audio_level) +
+        self->priv->speaker_switch_margin) {
+      break;
+    }
 
-    top = ((counter / n_columns) * height);
-    left = ((counter % n_columns) * width);
+    kms_composite_mixer_set_speaker (self, candidate, tile, now);
+    changed = TRUE;
+  }
+
+  g_list_free (candidates);
+
+  return changed;
+}
+
+static gboolean
+kms_composite_mixer_update_speakers (gpointer data)
+{
+  KmsCompositeMixer *self = KMS_COMPOSITE_MIXER (data);
 
-    g_object_set (port_data->video_mixer_pad, "xpos", left, "ypos", top,
-        "alpha", 1.0, NULL);
-    counter++;
+  KMS_COMPOSITE_MIXER_LOCK (self);
+
+  if (self->priv->layout != KMS_COMPOSITE_LAYOUT_ACTIVE_SPEAKER) {
+    self->priv->speakers_source_id = 0;
+    KMS_COMPOSITE_MIXER_UNLOCK (self);
+    return G_SOURCE_REMOVE;
+  }
+
+  if (kms_composite_mixer_select_speakers (self)) {
+    kms_composite_mixer_recalculate_sizes (self);
+  }
+
+  KMS_COMPOSITE_MIXER_UNLOCK (self);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Must be called with the mixer lock held */
+static void
+kms_composite_mixer_set_layout (KmsCompositeMixer * self,
+    KmsCompositeLayout layout)
+{
+  guint i;
+
+  if (self->priv->layout == layout) {
+    return;
+  }
+
+  g_atomic_int_set ((gint *) & self->priv->layout, layout);
+
+  if (layout == KMS_COMPOSITE_LAYOUT_ACTIVE_SPEAKER) {
+    kms_composite_mixer_select_speakers (self);
+
+    if (self->priv->speakers_source_id == 0) {
+      self->priv->speakers_source_id =
+          kms_loop_timeout_add_full (self->priv->loop, G_PRIORITY_DEFAULT,
+          SPEAKER_UPDATE_INTERVAL, kms_composite_mixer_update_speakers, self,
+          NULL);
+    }
+  } else {
+    for (i = 0; i < self->priv->speakers->len; i++) {
+      KmsCompositeMixerData *port_data =
+          g_ptr_array_index (self->priv->speakers, i);
+
+      port_data->speaker_since = 0;
+    }
+
+    g_ptr_array_set_size (self->priv->speakers, 0);
+  }
+
+  kms_composite_mixer_recalculate_sizes (self);
+}
+
+static void
+kms_composite_mixer_add_input (KmsCompositeMixer * self,
+    KmsCompositeMixerData * port_data)
+{
+  port_data->input = TRUE;
+  self->priv->inputs = g_list_insert_sorted (self->priv->inputs,
+      KMS_COMPOSITE_MIXER_REF (port_data), compare_port_data);
+  self->priv->n_elems++;
+
+  /* Free speaker tiles are taken right away */
+  if (self->priv->layout == KMS_COMPOSITE_LAYOUT_ACTIVE_SPEAKER &&
+      self->priv->speakers->len < self->priv->n_speakers) {
+    kms_composite_mixer_set_speaker (self, port_data,
+        self->priv->speakers->len, g_get_monotonic_time ());
+  }
+}
+
+static void
+kms_composite_mixer_remove_input (KmsCompositeMixer * self,
+    KmsCompositeMixerData * port_data)
+{
+  GList *l = g_list_find (self->priv->inputs, port_data);
+
+  port_data->input = FALSE;
+
+  if (l == NULL) {
+    return;
+  }
+
+  /* Out of the inputs first, so that it can not be selected again */
+  self->priv->inputs = g_list_delete_link (self->priv->inputs, l);
+  self->priv->n_elems--;
+
+  if (port_data->speaker_since > 0) {
+    g_ptr_array_remove (self->priv->speakers, port_data);
+    port_data->speaker_since = 0;
+    kms_composite_mixer_select_speakers (self);
+  }
+
+  KMS_COMPOSITE_MIXER_UNREF (port_data);
+}
+
+/* Must be called with video_state_mutex held and without the mixer lock. */
+/* While there are no video inputs, the background source and the */
+/* videomixer are kept in READY so that no frames are produced. */
+static void
+kms_composite_mixer_set_video_active (KmsCompositeMixer * self,
+    gboolean active)
+{
+  GstElement *elements[3];
+  guint i;
+
+  if (self->priv->videomixer == NULL || self->priv->video_active == active) {
+    return;
+  }
+
+  GST_DEBUG_OBJECT (self, "%s videomixer", active ? "Starting" : "Stopping");
+
+  self->priv->video_active = active;
+
+  /* Sources are stopped first and started last */
+  elements[0] = active ? self->priv->videomixer : self->priv->videotestsrc;
+  elements[1] = self->priv->background_capsfilter;
+  elements[2] = active ? self->priv->videotestsrc : self->priv->videomixer;
+
+  for (i = 0; i < G_N_ELEMENTS (elements); i++) {
+    gst_element_set_locked_state (elements[i], !active);
+
+    if (active) {
+      gst_element_sync_state_with_parent (elements[i]);
+    } else {
+      gst_element_set_state (elements[i], GST_STATE_READY);
+    }
+  }
+}
+
+static void
+kms_composite_mixer_stop_video_if_idle (KmsCompositeMixer * self)
+{
+  gboolean idle;
+
+  g_mutex_lock (&self->priv->video_state_mutex);
+
+  KMS_COMPOSITE_MIXER_LOCK (self);
+  idle = self->priv->n_elems == 0;
+  KMS_COMPOSITE_MIXER_UNLOCK (self);
 
-    GST_DEBUG_OBJECT (self, "counter %d id_port %d ", counter, port_data->id);
-    GST_DEBUG_OBJECT (self, "top %d left %d width %d height %d", top, left,
-        width, height);
+  if (idle) {
+    kms_composite_mixer_set_video_active (self, FALSE);
   }
 
-  g_list_free (values);
+  g_mutex_unlock (&self->priv->video_state_mutex);
 }
 
 static gboolean
@@ -224,6 +909,17 @@ remove_elements_from_pipeline (KmsCompositeMixerData * port_data)
     port_data->latency_probe_id = 0;
   }
 
+  if (port_data->caps_probe_id > 0) {
+    gst_pad_remove_probe (port_data->video_mixer_pad,
+        port_data->caps_probe_id);
+    port_data->caps_probe_id = 0;
+  }
+
+  if (port_data->hidden_probe_id > 0) {
+    gst_pad_remove_probe (port_data->tee_sink_pad, port_data->hidden_probe_id);
+    port_data->hidden_probe_id = 0;
+  }
+
   if (port_data->video_mixer_pad != NULL) {
     gst_element_release_request_pad (self->priv->videomixer,
         port_data->video_mixer_pad);
@@ -254,6 +950,8 @@ remove_elements_from_pipeline (KmsCompositeMixerData * port_data)
   port_data->tee = NULL;
   port_data->fakesink = NULL;
 
+  kms_composite_mixer_stop_video_if_idle (self);
+
   return G_SOURCE_REMOVE;
 }
 
@@ -297,19 +995,190 @@ cb_EOS_received (GstPad * pad, GstPadProbeInfo * info, gpointer data)
 static GstPadProbeReturn
 cb_latency (GstPad * pad, GstPadProbeInfo * info, gpointer data)
 {
+  KmsCompositeMixer *self = KMS_COMPOSITE_MIXER (data);
+  GstClockTime latency;
+
   if (GST_QUERY_TYPE (GST_PAD_PROBE_INFO_QUERY (info)) != GST_QUERY_LATENCY) {
     return GST_PAD_PROBE_OK;
   }
 
+  latency = g_atomic_int_get (&self->priv->latency) * GST_MSECOND;
+
   GST_LOG_OBJECT (pad, "Modifing latency query. New latency %" G_GUINT64_FORMAT,
-      (guint64) (LATENCY * GST_MSECOND));
+      (guint64) latency);
 
-  gst_query_set_latency (GST_PAD_PROBE_INFO_QUERY (info),
-      TRUE, 0, LATENCY * GST_MSECOND);
+  gst_query_set_latency (GST_PAD_PROBE_INFO_QUERY (info), TRUE, 0, latency);
 
   return GST_PAD_PROBE_HANDLED;
 }
 
+static GstPadProbeReturn
+cb_input_caps (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  KmsCompositeMixerData *port_data = (KmsCompositeMixerData *) data;
+  KmsCompositeMixer *self = port_data->mixer;
+  GstEvent *event = gst_pad_probe_info_get_event (info);
+  GstStructure *st;
+  GstCaps *caps;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CAPS) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  gst_event_parse_caps (event, &caps);
+  st = gst_caps_get_structure (caps, 0);
+
+  KMS_COMPOSITE_MIXER_LOCK (self);
+
+  if (!gst_structure_get_int (st, "width", &port_data->in_width) ||
+      !gst_structure_get_int (st, "height", &port_data->in_height)) {
+    port_data->in_width = port_data->in_height = -1;
+  }
+
+  port_data->in_format =
+      g_intern_string (gst_structure_get_string (st, "format"));
+
+  kms_composite_mixer_update_fast_path (self, port_data,
+      kms_composite_mixer_get_working_format (self));
+
+  KMS_COMPOSITE_MIXER_UNLOCK (self);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+cb_output_caps (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  KmsCompositeMixer *self = KMS_COMPOSITE_MIXER (data);
+  GstEvent *event = gst_pad_probe_info_get_event (info);
+  const gchar *working_format;
+  GstCaps *caps;
+  GList *l;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CAPS) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  /* Current caps are not updated yet, so take the format from the event */
+  gst_event_parse_caps (event, &caps);
+
+  KMS_COMPOSITE_MIXER_LOCK (self);
+
+  working_format = self->priv->format != NULL ?
+      g_intern_string (self->priv->format) :
+      g_intern_string (gst_structure_get_string (gst_caps_get_structure (caps,
+              0), "format"));
+
+  for (l = self->priv->inputs; l != NULL; l = l->next) {
+    kms_composite_mixer_update_fast_path (self, l->data, working_format);
+  }
+
+  KMS_COMPOSITE_MIXER_UNLOCK (self);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+kms_composite_mixer_update_audio_level (KmsCompositeMixerData * port_data,
+    GstBuffer * buffer)
+{
+  GstMapInfo info;
+  const gint16 *samples;
+  gint64 sum = 0;
+  gsize n, i;
+  gint level;
+
+  if (!gst_buffer_map (buffer, &info, GST_MAP_READ)) {
+    return;
+  }
+
+  samples = (const gint16 *) info.data;
+  n = info.size / sizeof (gint16);
+
+  for (i = 0; i < n; i++) {
+    sum += samples[i] * samples[i];
+  }
+
+  gst_buffer_unmap (buffer, &info);
+
+  if (n == 0) {
+    return;
+  }
+
+  /* Exponential smoothing, so that short pauses do not make a speaker lose */
+  /* its tile */
+  level = g_atomic_int_get (&port_data->audio_level);
+  level = (gint) (((gint64) level * 3 + (gint64) (sum / n)) / 4);
+  g_atomic_int_set (&port_data->audio_level, level);
+}
+
+static GstPadProbeReturn
+cb_audio_level (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  KmsCompositeMixerData *port_data = data;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    if (port_data->audio_s16 &&
+        g_atomic_int_get ((gint *) & port_data->mixer->priv->layout) ==
+        KMS_COMPOSITE_LAYOUT_ACTIVE_SPEAKER) {
+      kms_composite_mixer_update_audio_level (port_data,
+          gst_pad_probe_info_get_buffer (info));
+    }
+  } else if (GST_EVENT_TYPE (gst_pad_probe_info_get_event (info)) ==
+      GST_EVENT_CAPS) {
+    GstCaps *caps;
+    const gchar *format;
+
+    gst_event_parse_caps (gst_pad_probe_info_get_event (info), &caps);
+    format = gst_structure_get_string (gst_caps_get_structure (caps, 0),
+        "format");
+
+    /* Levels are only computed on native endian S16, which is what the */
+    /* audiomixer works with */
+    port_data->audio_s16 = (g_strcmp0 (format,
+            (G_BYTE_ORDER == G_LITTLE_ENDIAN) ? "S16LE" : "S16BE") == 0);
+    g_atomic_int_set (&port_data->audio_level, 0);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Must be called with the mixer lock held */
+static void
+kms_composite_mixer_add_audio_probe (KmsCompositeMixer * self,
+    KmsCompositeMixerData * port_data, GstPad * pad)
+{
+  if (port_data->audio_sink_pad != NULL || port_data->removing) {
+    return;
+  }
+
+  GST_DEBUG_OBJECT (self, "Measuring audio level of port %d on %"
+      GST_PTR_FORMAT, port_data->id, pad);
+
+  port_data->audio_sink_pad = g_object_ref (pad);
+  port_data->audio_probe_id = gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      cb_audio_level, KMS_COMPOSITE_MIXER_REF (port_data),
+      (GDestroyNotify) kms_ref_struct_unref);
+}
+
+/* Must be called with the mixer lock held */
+static void
+kms_composite_mixer_remove_audio_probe (KmsCompositeMixerData * port_data)
+{
+  if (port_data->audio_sink_pad == NULL) {
+    return;
+  }
+
+  if (port_data->audio_probe_id > 0) {
+    gst_pad_remove_probe (port_data->audio_sink_pad,
+        port_data->audio_probe_id);
+    port_data->audio_probe_id = 0;
+  }
+
+  g_clear_object (&port_data->audio_sink_pad);
+}
+
 static void
 kms_composite_mixer_port_data_destroy (gpointer data)
 {
@@ -321,9 +1190,16 @@ kms_composite_mixer_port_data_destroy (gpointer data)
   KMS_COMPOSITE_MIXER_LOCK (self);
 
   port_data->removing = TRUE;
+  kms_composite_mixer_remove_audio_probe (port_data);
+
+  if (KMS_COMPOSITE_MIXER_HAS_VIDEO (self)) {
+    kms_base_hub_unlink_video_sink (KMS_BASE_HUB (self), port_data->id);
+  }
+
+  if (KMS_COMPOSITE_MIXER_HAS_AUDIO (self)) {
+    kms_base_hub_unlink_audio_sink (KMS_BASE_HUB (self), port_data->id);
+  }
 
-  kms_base_hub_unlink_video_sink (KMS_BASE_HUB (self), port_data->id);
-  kms_base_hub_unlink_audio_sink (KMS_BASE_HUB (self), port_data->id);
   kms_base_hub_unlink_data_sink (KMS_BASE_HUB (self), port_data->id);
 
   if (port_data->input) {
@@ -353,8 +1229,7 @@ kms_composite_mixer_port_data_destroy (gpointer data)
       result = gst_pad_send_event (pad, event);
 
       if (port_data->input && self->priv->n_elems > 0) {
-        port_data->input = FALSE;
-        self->priv->n_elems--;
+        kms_composite_mixer_remove_input (self, port_data);
         kms_composite_mixer_recalculate_sizes (self);
       }
       KMS_COMPOSITE_MIXER_UNLOCK (self);
@@ -368,6 +1243,12 @@ kms_composite_mixer_port_data_destroy (gpointer data)
       /* EOS callback was triggered before we could remove the port data */
       /* so we have to remove elements to avoid memory leaks. */
       remove = port_data->eos_managed;
+
+      if (port_data->input) {
+        kms_composite_mixer_remove_input (self, port_data);
+        kms_composite_mixer_recalculate_sizes (self);
+      }
+
       KMS_COMPOSITE_MIXER_UNLOCK (self);
 
       if (remove) {
@@ -380,6 +1261,9 @@ kms_composite_mixer_port_data_destroy (gpointer data)
     }
     gst_element_unlink (port_data->capsfilter, port_data->tee);
     g_object_unref (pad);
+  } else if (port_data->capsfilter == NULL) {
+    /* Audio only */
+    KMS_COMPOSITE_MIXER_UNLOCK (self);
   } else {
     if (port_data->probe_id > 0) {
       gst_pad_remove_probe (port_data->video_mixer_pad, port_data->probe_id);
@@ -390,6 +1274,11 @@ kms_composite_mixer_port_data_destroy (gpointer data)
           port_data->latency_probe_id);
     }
 
+    if (port_data->caps_probe_id > 0) {
+      gst_pad_remove_probe (port_data->video_mixer_pad,
+          port_data->caps_probe_id);
+    }
+
     if (port_data->link_probe_id > 0) {
       gst_pad_remove_probe (port_data->tee_sink_pad, port_data->link_probe_id);
     }
@@ -414,6 +1303,10 @@ kms_composite_mixer_port_data_destroy (gpointer data)
     port_data->fakesink = NULL;
   }
 
+  if (self->priv->audiomixer == NULL) {
+    return;
+  }
+
   padname = g_strdup_printf (AUDIO_SINK_PAD, port_data->id);
   audiosink = gst_element_get_static_pad (self->priv->audiomixer, padname);
   gst_element_release_request_pad (self->priv->audiomixer, audiosink);
@@ -436,6 +1329,10 @@ link_to_videomixer (GstPad * pad, GstPadProbeInfo * info,
 
   mixer = KMS_COMPOSITE_MIXER (data->mixer);
   GST_DEBUG ("stream start detected %d", data->id);
+
+  g_mutex_lock (&mixer->priv->video_state_mutex);
+  kms_composite_mixer_set_video_active (mixer, TRUE);
+
   KMS_COMPOSITE_MIXER_LOCK (mixer);
 
   data->link_probe_id = 0;
@@ -448,11 +1345,10 @@ link_to_videomixer (GstPad * pad, GstPadProbeInfo * info,
   if (G_UNLIKELY (sink_pad_template == NULL)) {
     GST_ERROR_OBJECT (mixer, "Error taking a new pad from videomixer");
     KMS_COMPOSITE_MIXER_UNLOCK (mixer);
+    g_mutex_unlock (&mixer->priv->video_state_mutex);
     return GST_PAD_PROBE_DROP;
   }
 
-  data->input = TRUE;
-
   /*link tee -> videomixer */
   data->video_mixer_pad =
       gst_element_request_pad (mixer->priv->videomixer,
@@ -464,6 +1360,13 @@ link_to_videomixer (GstPad * pad, GstPadProbeInfo * info,
       mixer->priv->videomixer, GST_OBJECT_NAME (data->video_mixer_pad));
   g_object_unref (tee_src);
 
+  /* Position is set by the layout; the capsfilter already has full size */
+  g_object_set (data->video_mixer_pad, "alpha", 1.0, NULL);
+  data->cell.visible = TRUE;
+  data->cell.x = data->cell.y = -1;
+  data->cell.width = mixer->priv->output_width;
+  data->cell.height = mixer->priv->output_height;
+
   data->probe_id = gst_pad_add_probe (data->video_mixer_pad,
       GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
       (GstPadProbeCallback) cb_EOS_received,
@@ -471,16 +1374,21 @@ link_to_videomixer (GstPad * pad, GstPadProbeInfo * info,
 
   data->latency_probe_id = gst_pad_add_probe (data->video_mixer_pad,
       GST_PAD_PROBE_TYPE_QUERY_UPSTREAM,
-      (GstPadProbeCallback) cb_latency, NULL, NULL);
+      (GstPadProbeCallback) cb_latency, mixer, NULL);
+
+  data->caps_probe_id = gst_pad_add_probe (data->video_mixer_pad,
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, (GstPadProbeCallback) cb_input_caps,
+      KMS_COMPOSITE_MIXER_REF (data), (GDestroyNotify) kms_ref_struct_unref);
 
   /*recalculate the output sizes */
-  mixer->priv->n_elems++;
+  kms_composite_mixer_add_input (mixer, data);
   kms_composite_mixer_recalculate_sizes (mixer);
 
   //Recalculate latency to avoid video freezes when an element stops to send media.
   gst_bin_recalculate_latency (GST_BIN (mixer));
 
   KMS_COMPOSITE_MIXER_UNLOCK (mixer);
+  g_mutex_unlock (&mixer->priv->video_state_mutex);
 
   return GST_PAD_PROBE_REMOVE;
 }
@@ -517,31 +1425,12 @@ kms_composite_mixer_unhandle_port (KmsBaseHub * mixer, gint id)
       (kms_composite_mixer_parent_class))->unhandle_port (mixer, id);
 }
 
-static KmsCompositeMixerData *
-kms_composite_mixer_port_data_create (KmsCompositeMixer * mixer, gint id)
+static void
+kms_composite_mixer_link_video_input (KmsCompositeMixer * mixer,
+    KmsCompositeMixerData * data)
 {
-  KmsCompositeMixerData *data;
   GstPad *tee_src;
   GstCaps *filtercaps;
-  gchar *padname;
-
-  data = kms_create_composite_mixer_data ();
-  data->mixer = mixer;
-  data->id = id;
-  data->input = FALSE;
-  data->removing = FALSE;
-  data->eos_managed = FALSE;
-
-
-  // Link AUDIO input
-
-  padname = g_strdup_printf (AUDIO_SINK_PAD, data->id);
-  kms_base_hub_link_audio_sink (KMS_BASE_HUB (mixer), data->id,
-      mixer->priv->audiomixer, padname, FALSE);
-  g_free (padname);
-
-
-  // Link VIDEO input
 
   data->tee = gst_element_factory_make ("tee", NULL);
   data->fakesink = gst_element_factory_make ("fakesink", NULL);
@@ -559,11 +1448,8 @@ kms_composite_mixer_port_data_create (KmsCompositeMixer * mixer, gint id)
   gst_element_sync_state_with_parent (data->tee);
   gst_element_sync_state_with_parent (data->fakesink);
 
-  filtercaps =
-      gst_caps_new_simple ("video/x-raw",
-      "width", G_TYPE_INT, mixer->priv->output_width,
-      "height", G_TYPE_INT, mixer->priv->output_height,
-      "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1, NULL);
+  filtercaps = kms_composite_mixer_create_caps (mixer,
+      mixer->priv->output_width, mixer->priv->output_height, FALSE);
   g_object_set (data->capsfilter, "caps", filtercaps, NULL);
   gst_caps_unref (filtercaps);
 
@@ -580,11 +1466,51 @@ kms_composite_mixer_port_data_create (KmsCompositeMixer * mixer, gint id)
       "sink");
   g_object_unref (tee_src);
 
-
   data->link_probe_id = gst_pad_add_probe (data->tee_sink_pad,
       GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_BLOCK,
       (GstPadProbeCallback) link_to_videomixer,
       KMS_COMPOSITE_MIXER_REF (data), (GDestroyNotify) kms_ref_struct_unref);
+}
+
+static KmsCompositeMixerData *
+kms_composite_mixer_port_data_create (KmsCompositeMixer * mixer, gint id)
+{
+  KmsCompositeMixerData *data;
+  gchar *padname;
+
+  data = kms_create_composite_mixer_data ();
+  data->mixer = mixer;
+  data->id = id;
+  data->input = FALSE;
+  data->removing = FALSE;
+  data->eos_managed = FALSE;
+  data->in_width = data->in_height = -1;
+
+
+  // Link AUDIO input
+
+  if (KMS_COMPOSITE_MIXER_HAS_AUDIO (mixer)) {
+    GstPad *audiosink;
+
+    padname = g_strdup_printf (AUDIO_SINK_PAD, data->id);
+    kms_base_hub_link_audio_sink (KMS_BASE_HUB (mixer), data->id,
+        mixer->priv->audiomixer, padname, FALSE);
+    audiosink = gst_element_get_static_pad (mixer->priv->audiomixer, padname);
+    g_free (padname);
+
+    /* Otherwise it is attached when the audiomixer adds the pad */
+    if (audiosink != NULL) {
+      kms_composite_mixer_add_audio_probe (mixer, data, audiosink);
+      g_object_unref (audiosink);
+    }
+  }
+
+
+  // Link VIDEO input
+
+  if (KMS_COMPOSITE_MIXER_HAS_VIDEO (mixer)) {
+    kms_composite_mixer_link_video_input (mixer, data);
+  }
 
 
   // Link DATA input
@@ -614,12 +1540,45 @@ get_stream_id_from_padname (const gchar * name)
   return id;
 }
 
+static void
+audio_sink_pad_added (KmsCompositeMixer * self, GstPad * pad)
+{
+  KmsCompositeMixerData *port_data;
+  const gchar *name = GST_OBJECT_NAME (pad);
+  gint64 value;
+  gint id;
+
+  if (!g_str_has_prefix (name, AUDIO_SINK_PAD_PREFIX))
+    return;
+
+  value = g_ascii_strtoll (name + LENGTH_AUDIO_SINK_PAD_PREFIX, NULL, 10);
+  if (value < 0 || value > G_MAXINT)
+    return;
+
+  id = value;
+
+  KMS_COMPOSITE_MIXER_LOCK (self);
+
+  port_data = g_hash_table_lookup (self->priv->ports, &id);
+
+  if (port_data != NULL) {
+    kms_composite_mixer_add_audio_probe (self, port_data, pad);
+  }
+
+  KMS_COMPOSITE_MIXER_UNLOCK (self);
+}
+
 static void
 pad_added_cb (GstElement * element, GstPad * pad, gpointer data)
 {
   gint id;
   KmsCompositeMixer *self = KMS_COMPOSITE_MIXER (data);
 
+  if (gst_pad_get_direction (pad) == GST_PAD_SINK) {
+    audio_sink_pad_added (self, pad);
+    return;
+  }
+
   if (gst_pad_get_direction (pad) != GST_PAD_SRC)
     return;
 
@@ -658,20 +1617,23 @@ kms_composite_mixer_handle_port (KmsBaseHub * mixer,
 
   KMS_COMPOSITE_MIXER_LOCK (self);
 
-  if (self->priv->videomixer == NULL) {
+  if (KMS_COMPOSITE_MIXER_HAS_VIDEO (self) && self->priv->videomixer == NULL) {
     self->priv->videomixer = gst_element_factory_make ("compositor", NULL);
     g_object_set (G_OBJECT (self->priv->videomixer), "background",
         1 /*black */ , "start-time-selection", 1 /*first */ ,
-        "latency", LATENCY * GST_MSECOND, NULL);
+        "latency", self->priv->latency * GST_MSECOND, NULL);
+    self->priv->output_capsfilter =
+        gst_element_factory_make ("capsfilter", NULL);
+    g_object_set (G_OBJECT (self->priv->output_capsfilter),
+        "caps-change-mode", 1 /*delayed */ , NULL);
     self->priv->mixer_video_agnostic =
         gst_element_factory_make ("agnosticbin", NULL);
 
     gst_bin_add_many (GST_BIN (mixer), self->priv->videomixer,
-        self->priv->mixer_video_agnostic, NULL);
+        self->priv->output_capsfilter, self->priv->mixer_video_agnostic, NULL);
 
     if (self->priv->videotestsrc == NULL) {
       GstElement *capsfilter;
-      GstCaps *filtercaps;
       GstPad *pad;
       GstPadTemplate *sink_pad_template;
 
@@ -691,13 +1653,8 @@ kms_composite_mixer_handle_port (KmsBaseHub * mixer,
       g_object_set (self->priv->videotestsrc, "is-live", TRUE, "pattern",
           /*black */ 2, NULL);
 
-      filtercaps =
-          gst_caps_new_simple ("video/x-raw",
-          "width", G_TYPE_INT, self->priv->output_width,
-          "height", G_TYPE_INT, self->priv->output_height,
-          "framerate", GST_TYPE_FRACTION, 15, 1, NULL);
-      g_object_set (G_OBJECT (capsfilter), "caps", filtercaps, NULL);
-      gst_caps_unref (filtercaps);
+      self->priv->background_capsfilter = capsfilter;
+      kms_composite_mixer_update_output_caps (self);
 
       gst_bin_add_many (GST_BIN (self), self->priv->videotestsrc,
           capsfilter, NULL);
@@ -709,24 +1666,38 @@ kms_composite_mixer_handle_port (KmsBaseHub * mixer,
           NULL, NULL);
 
       gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_QUERY_UPSTREAM,
-          (GstPadProbeCallback) cb_latency, NULL, NULL);
+          (GstPadProbeCallback) cb_latency, self, NULL);
 
       gst_element_link_pads (capsfilter, NULL,
           self->priv->videomixer, GST_OBJECT_NAME (pad));
       g_object_set (pad, "xpos", 0, "ypos", 0, "alpha", 0.0, NULL);
       g_object_unref (pad);
 
-      gst_element_sync_state_with_parent (capsfilter);
-      gst_element_sync_state_with_parent (self->priv->videotestsrc);
+      /* Started along with the videomixer when the first input arrives */
+      gst_element_set_locked_state (capsfilter, TRUE);
+      gst_element_set_locked_state (self->priv->videotestsrc, TRUE);
     }
-    gst_element_sync_state_with_parent (self->priv->videomixer);
+    gst_element_set_locked_state (self->priv->videomixer, TRUE);
+    gst_element_sync_state_with_parent (self->priv->output_capsfilter);
     gst_element_sync_state_with_parent (self->priv->mixer_video_agnostic);
 
-    gst_element_link (self->priv->videomixer, self->priv->mixer_video_agnostic);
+    gst_element_link_many (self->priv->videomixer,
+        self->priv->output_capsfilter, self->priv->mixer_video_agnostic, NULL);
+
+    {
+      GstPad *pad =
+          gst_element_get_static_pad (self->priv->output_capsfilter, "src");
+
+      gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+          (GstPadProbeCallback) cb_output_caps, self, NULL);
+      g_object_unref (pad);
+    }
   }
 
-  if (self->priv->audiomixer == NULL) {
-    self->priv->audiomixer = gst_element_factory_make ("kmsaudiomixer", NULL);
+  if (KMS_COMPOSITE_MIXER_HAS_AUDIO (self) && self->priv->audiomixer == NULL) {
+    /* Both mixers name their pads sink_<port> and src_<port> */
+    self->priv->audiomixer = gst_element_factory_make (self->priv->mix_minus ?
+        "mixminus" : "kmsaudiomixer", NULL);
 
     gst_bin_add (GST_BIN (mixer), self->priv->audiomixer);
 
@@ -750,8 +1721,10 @@ kms_composite_mixer_handle_port (KmsBaseHub * mixer,
     gst_element_link (self->priv->datamixer_sink, self->priv->datamixer_src);
   }
 
-  kms_base_hub_link_video_src (KMS_BASE_HUB (self), port_id,
-      self->priv->mixer_video_agnostic, "src_%u", TRUE);
+  if (KMS_COMPOSITE_MIXER_HAS_VIDEO (self)) {
+    kms_base_hub_link_video_src (KMS_BASE_HUB (self), port_id,
+        self->priv->mixer_video_agnostic, "src_%u", TRUE);
+  }
 
   kms_base_hub_link_data_src (KMS_BASE_HUB (self), port_id,
       self->priv->datamixer_src, "src_%u", TRUE);
@@ -764,6 +1737,206 @@ kms_composite_mixer_handle_port (KmsBaseHub * mixer,
   return port_id;
 }
 
+static GstStructure *
+kms_composite_mixer_get_input_stats (KmsCompositeMixer * self, gint id)
+{
+  KmsCompositeMixerData *port_data;
+  GstStructure *stats = NULL;
+
+  KMS_COMPOSITE_MIXER_LOCK (self);
+
+  port_data = g_hash_table_lookup (self->priv->ports, &id);
+
+  if (port_data != NULL) {
+    stats = gst_structure_new ("input-stats",
+        "id", G_TYPE_INT, port_data->id,
+        "linked", G_TYPE_BOOLEAN, port_data->input,
+        "x", G_TYPE_INT, port_data->cell.x,
+        "y", G_TYPE_INT, port_data->cell.y,
+        "width", G_TYPE_INT, port_data->cell.width,
+        "height", G_TYPE_INT, port_data->cell.height,
+        "input-width", G_TYPE_INT, port_data->in_width,
+        "input-height", G_TYPE_INT, port_data->in_height,
+        "input-format", G_TYPE_STRING, port_data->in_format,
+        "fast-path", G_TYPE_BOOLEAN, port_data->fast_path, NULL);
+  } else {
+    GST_WARNING_OBJECT (self, "No port with id %d", id);
+  }
+
+  KMS_COMPOSITE_MIXER_UNLOCK (self);
+
+  return stats;
+}
+
+static gboolean
+kms_composite_mixer_is_supported_format (const gchar * format)
+{
+  guint i;
+
+  for (i = 0; supported_formats[i] != NULL; i++) {
+    if (g_strcmp0 (format, supported_formats[i]) == 0) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static void
+kms_composite_mixer_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsCompositeMixer *self = KMS_COMPOSITE_MIXER (object);
+
+  KMS_COMPOSITE_MIXER_LOCK (self);
+
+  switch (property_id) {
+    case PROP_WIDTH:
+      self->priv->output_width = g_value_get_int (value);
+      kms_composite_mixer_reset_layout (self);
+      break;
+    case PROP_HEIGHT:
+      self->priv->output_height = g_value_get_int (value);
+      kms_composite_mixer_reset_layout (self);
+      break;
+    case PROP_FRAMERATE:
+      self->priv->framerate = g_value_get_int (value);
+      kms_composite_mixer_update_output_caps (self);
+      break;
+    case PROP_FORMAT:{
+      const gchar *format = g_value_get_string (value);
+
+      if (format != NULL && *format == '\0') {
+        format = NULL;
+      }
+
+      if (format != NULL && !kms_composite_mixer_is_supported_format (format)) {
+        GST_WARNING_OBJECT (self, "Unsupported format %s", format);
+        break;
+      }
+
+      g_free (self->priv->format);
+      self->priv->format = g_strdup (format);
+      kms_composite_mixer_reset_layout (self);
+      break;
+    }
+    case PROP_LATENCY:
+      g_atomic_int_set (&self->priv->latency, g_value_get_uint (value));
+
+      if (self->priv->videomixer != NULL) {
+        g_object_set (self->priv->videomixer, "latency",
+            self->priv->latency * GST_MSECOND, NULL);
+      }
+      break;
+    case PROP_MEDIA_MODE:
+      /* Mixers are built when the first port is handled */
+      if (g_hash_table_size (self->priv->ports) > 0 ||
+          self->priv->videomixer != NULL || self->priv->audiomixer != NULL) {
+        GST_WARNING_OBJECT (self, "Media mode can not be changed once ports"
+            " have been handled");
+        break;
+      }
+
+      self->priv->media_mode = g_value_get_enum (value);
+      break;
+    case PROP_MIX_MINUS:
+      if (self->priv->audiomixer != NULL) {
+        GST_WARNING_OBJECT (self, "Mix-minus can not be changed once the"
+            " audio mixer has been built");
+        break;
+      }
+
+      self->priv->mix_minus = g_value_get_boolean (value);
+      break;
+    case PROP_LAYOUT:
+      kms_composite_mixer_set_layout (self, g_value_get_enum (value));
+      break;
+    case PROP_SPEAKERS:
+      self->priv->n_speakers = g_value_get_uint (value);
+
+      if (self->priv->layout == KMS_COMPOSITE_LAYOUT_ACTIVE_SPEAKER) {
+        kms_composite_mixer_select_speakers (self);
+        kms_composite_mixer_recalculate_sizes (self);
+      }
+      break;
+    case PROP_MAX_THUMBNAILS:
+      self->priv->max_thumbnails = g_value_get_uint (value);
+
+      if (self->priv->layout == KMS_COMPOSITE_LAYOUT_ACTIVE_SPEAKER) {
+        kms_composite_mixer_recalculate_sizes (self);
+      }
+      break;
+    case PROP_SPEAKER_HOLD_TIME:
+      self->priv->speaker_hold_time = g_value_get_uint (value);
+      break;
+    case PROP_SPEAKER_SWITCH_MARGIN:
+      self->priv->speaker_switch_margin = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  KMS_COMPOSITE_MIXER_UNLOCK (self);
+
+  if (property_id == PROP_LATENCY) {
+    gst_bin_recalculate_latency (GST_BIN (self));
+  }
+}
+
+static void
+kms_composite_mixer_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsCompositeMixer *self = KMS_COMPOSITE_MIXER (object);
+
+  KMS_COMPOSITE_MIXER_LOCK (self);
+
+  switch (property_id) {
+    case PROP_WIDTH:
+      g_value_set_int (value, self->priv->output_width);
+      break;
+    case PROP_HEIGHT:
+      g_value_set_int (value, self->priv->output_height);
+      break;
+    case PROP_FRAMERATE:
+      g_value_set_int (value, self->priv->framerate);
+      break;
+    case PROP_FORMAT:
+      g_value_set_string (value, self->priv->format);
+      break;
+    case PROP_LATENCY:
+      g_value_set_uint (value, self->priv->latency);
+      break;
+    case PROP_MEDIA_MODE:
+      g_value_set_enum (value, self->priv->media_mode);
+      break;
+    case PROP_MIX_MINUS:
+      g_value_set_boolean (value, self->priv->mix_minus);
+      break;
+    case PROP_LAYOUT:
+      g_value_set_enum (value, self->priv->layout);
+      break;
+    case PROP_SPEAKERS:
+      g_value_set_uint (value, self->priv->n_speakers);
+      break;
+    case PROP_MAX_THUMBNAILS:
+      g_value_set_uint (value, self->priv->max_thumbnails);
+      break;
+    case PROP_SPEAKER_HOLD_TIME:
+      g_value_set_uint (value, self->priv->speaker_hold_time);
+      break;
+    case PROP_SPEAKER_SWITCH_MARGIN:
+      g_value_set_uint (value, self->priv->speaker_switch_margin);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  KMS_COMPOSITE_MIXER_UNLOCK (self);
+}
+
 static void
 kms_composite_mixer_dispose (GObject * object)
 {
@@ -774,6 +1947,21 @@ kms_composite_mixer_dispose (GObject * object)
   KMS_COMPOSITE_MIXER_UNLOCK (self);
   g_clear_object (&self->priv->loop);
 
+  /* An idle videomixer is locked in READY, so the bin would not stop it */
+  if (self->priv->videomixer != NULL && !self->priv->video_active) {
+    GstElement *elements[] = { self->priv->videotestsrc,
+      self->priv->background_capsfilter, self->priv->videomixer
+    };
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (elements); i++) {
+      gst_element_set_locked_state (elements[i], FALSE);
+      gst_element_set_state (elements[i], GST_STATE_NULL);
+    }
+
+    self->priv->video_active = TRUE;
+  }
+
   G_OBJECT_CLASS (kms_composite_mixer_parent_class)->dispose (object);
 }
 
@@ -783,6 +1971,13 @@ kms_composite_mixer_finalize (GObject * object)
   KmsCompositeMixer *self = KMS_COMPOSITE_MIXER (object);
 
   g_rec_mutex_clear (&self->priv->mutex);
+  g_mutex_clear (&self->priv->video_state_mutex);
+
+  g_list_free_full (self->priv->inputs, (GDestroyNotify) kms_ref_struct_unref);
+  self->priv->inputs = NULL;
+  g_ptr_array_unref (self->priv->layouts);
+  g_ptr_array_unref (self->priv->speakers);
+  g_free (self->priv->format);
 
   if (self->priv->ports != NULL) {
     g_hash_table_unref (self->priv->ports);
@@ -803,6 +1998,8 @@ kms_composite_mixer_class_init (KmsCompositeMixerClass * klass)
       "CompositeMixer", "Generic", "Mixer element that composes n input flows"
       " in one output flow", "David Fernandez <d.fernandezlop@gmail.com>");
 
+  gobject_class->set_property = kms_composite_mixer_set_property;
+  gobject_class->get_property = kms_composite_mixer_get_property;
   gobject_class->dispose = GST_DEBUG_FUNCPTR (kms_composite_mixer_dispose);
   gobject_class->finalize = GST_DEBUG_FUNCPTR (kms_composite_mixer_finalize);
 
@@ -811,6 +2008,9 @@ kms_composite_mixer_class_init (KmsCompositeMixerClass * klass)
   base_hub_class->unhandle_port =
       GST_DEBUG_FUNCPTR (kms_composite_mixer_unhandle_port);
 
+  klass->get_input_stats =
+      GST_DEBUG_FUNCPTR (kms_composite_mixer_get_input_stats);
+
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&audio_src_factory));
   gst_element_class_add_pad_template (gstelement_class,
@@ -820,6 +2020,82 @@ kms_composite_mixer_class_init (KmsCompositeMixerClass * klass)
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&video_sink_factory));
 
+  g_object_class_install_property (gobject_class, PROP_WIDTH,
+      g_param_spec_int ("width", "Output width",
+          "Width of the composed video", 1, G_MAXINT, DEFAULT_WIDTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_HEIGHT,
+      g_param_spec_int ("height", "Output height",
+          "Height of the composed video", 1, G_MAXINT, DEFAULT_HEIGHT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FRAMERATE,
+      g_param_spec_int ("framerate", "Output framerate",
+          "Frames per second of the composed video", 1, G_MAXINT,
+          DEFAULT_FRAMERATE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FORMAT,
+      g_param_spec_string ("format", "Working format",
+          "Raw format used to scale and blend the inputs (I420, NV12 or AYUV)."
+          " NULL lets the compositor negotiate it", DEFAULT_FORMAT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LATENCY,
+      g_param_spec_uint ("latency", "Aggregation latency",
+          "Time (ms) the compositor waits for late inputs", 0, G_MAXUINT,
+          DEFAULT_LATENCY, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MEDIA_MODE,
+      g_param_spec_enum ("media-mode", "Media mode",
+          "Media mixed by the element. Only the needed mixers are built, so it"
+          " must be set before handling any port",
+          KMS_TYPE_COMPOSITE_MEDIA_MODE, DEFAULT_MEDIA_MODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MIX_MINUS,
+      g_param_spec_boolean ("mix-minus", "Mix-minus",
+          "Mix the audio once and give every port the mix minus its own"
+          " input. Must be set before handling any port",
+          DEFAULT_MIX_MINUS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LAYOUT,
+      g_param_spec_enum ("layout", "Layout",
+          "How the inputs are placed in the composed video",
+          KMS_TYPE_COMPOSITE_LAYOUT, DEFAULT_LAYOUT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SPEAKERS,
+      g_param_spec_uint ("speakers", "Speakers",
+          "Number of loudest inputs shown in the main area of the"
+          " active-speaker layout", 1, G_MAXUINT, DEFAULT_SPEAKERS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_THUMBNAILS,
+      g_param_spec_uint ("max-thumbnails", "Maximum thumbnails",
+          "Inputs shown as thumbnails below the speakers. The rest are not"
+          " drawn", 0, G_MAXUINT, DEFAULT_MAX_THUMBNAILS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SPEAKER_HOLD_TIME,
+      g_param_spec_uint ("speaker-hold-time", "Speaker hold time",
+          "Minimum time (ms) a speaker keeps its place", 0, G_MAXUINT,
+          DEFAULT_SPEAKER_HOLD_TIME,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SPEAKER_SWITCH_MARGIN,
+      g_param_spec_uint ("speaker-switch-margin", "Speaker switch margin",
+          "Level (dB) an input must exceed a speaker by to replace it", 0,
+          G_MAXUINT, DEFAULT_SPEAKER_SWITCH_MARGIN,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  obj_signals[SIGNAL_GET_INPUT_STATS] =
+      g_signal_new ("get-input-stats",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_ACTION | G_SIGNAL_RUN_LAST,
+      G_STRUCT_OFFSET (KmsCompositeMixerClass, get_input_stats), NULL, NULL,
+      __kms_elements_marshal_BOXED__INT, GST_TYPE_STRUCTURE, 1, G_TYPE_INT);
+
   /* Registers a private structure for the instantiatable type */
   g_type_class_add_private (klass, sizeof (KmsCompositeMixerPrivate));
 }
@@ -830,13 +2106,30 @@ kms_composite_mixer_init (KmsCompositeMixer * self)
   self->priv = KMS_COMPOSITE_MIXER_GET_PRIVATE (self);
 
   g_rec_mutex_init (&self->priv->mutex);
+  g_mutex_init (&self->priv->video_state_mutex);
 
   self->priv->ports = g_hash_table_new_full (g_int_hash, g_int_equal,
       release_gint, kms_composite_mixer_port_data_destroy);
   //TODO:Obtain the dimensions of the bigger input stream
-  self->priv->output_height = 600;
-  self->priv->output_width = 800;
+  self->priv->output_height = DEFAULT_HEIGHT;
+  self->priv->output_width = DEFAULT_WIDTH;
+  self->priv->framerate = DEFAULT_FRAMERATE;
+  self->priv->format = DEFAULT_FORMAT;
+  self->priv->latency = DEFAULT_LATENCY;
+  self->priv->media_mode = DEFAULT_MEDIA_MODE;
+  self->priv->mix_minus = DEFAULT_MIX_MINUS;
+  self->priv->layout = DEFAULT_LAYOUT;
+  self->priv->n_speakers = DEFAULT_SPEAKERS;
+  self->priv->max_thumbnails = DEFAULT_MAX_THUMBNAILS;
+  self->priv->speaker_hold_time = DEFAULT_SPEAKER_HOLD_TIME;
+  self->priv->speaker_switch_margin = DEFAULT_SPEAKER_SWITCH_MARGIN;
+  self->priv->speakers = g_ptr_array_new ();
+  self->priv->video_active = FALSE;
   self->priv->n_elems = 0;
+  self->priv->inputs = NULL;
+  self->priv->layouts =
+      g_ptr_array_new_with_free_func ((GDestroyNotify)
+      kms_composite_mixer_layout_free);
 
   self->priv->loop = kms_loop_new ();
 }
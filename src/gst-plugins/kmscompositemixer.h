@@ -68,6 +68,9 @@ struct _KmsCompositeMixer
 struct _KmsCompositeMixerClass
 {
   KmsBaseHubClass parent_class;
+
+  /* Actions */
+  GstStructure *(*get_input_stats) (KmsCompositeMixer * self, gint id);
 };
 
 GType kms_composite_mixer_get_type (void);
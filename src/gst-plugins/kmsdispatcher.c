@@ -21,6 +21,7 @@
 
 #include <commons/kms-core-marshal.h>
 #include "kmsdispatcher.h"
+#include "kmshubrouting.h"
 #include <commons/kmshubport.h>
 
 #define PLUGIN_NAME "dispatcher"
@@ -56,8 +57,26 @@ struct _KmsDispatcherPortData
   gint id;
   GstElement *audio_agnostic;
   GstElement *video_agnostic;
+
+  /* Ports this one takes each media from, -1 if none */
+  gint audio_source;
+  gint video_source;
 };
 
+/* Entry of a routing batch, see kms_dispatcher_parse_route */
+typedef struct _KmsDispatcherRoute
+{
+  KmsDispatcherPortData *source;
+  KmsDispatcherPortData *sink;
+  gboolean audio;
+  gboolean video;
+  gboolean connect;
+
+  /* Sources of the sink before the route, to roll it back */
+  gint previous_audio;
+  gint previous_video;
+} KmsDispatcherRoute;
+
 /* class initialization */
 
 G_DEFINE_TYPE_WITH_CODE (KmsDispatcher, kms_dispatcher,
@@ -68,6 +87,7 @@ G_DEFINE_TYPE_WITH_CODE (KmsDispatcher, kms_dispatcher,
 enum
 {
   SIGNAL_CONNECT,
+  SIGNAL_APPLY_ROUTING,
   LAST_SIGNAL
 };
 
@@ -117,6 +137,8 @@ kms_dispatcher_port_data_create (KmsDispatcher * self, gint id)
   data->audio_agnostic = gst_element_factory_make ("agnosticbin", NULL);
   data->video_agnostic = gst_element_factory_make ("agnosticbin", NULL);
   data->id = id;
+  data->audio_source = -1;
+  data->video_source = -1;
 
   gst_bin_add_many (GST_BIN (self), g_object_ref (data->audio_agnostic),
       g_object_ref (data->video_agnostic), NULL);
@@ -229,9 +251,12 @@ kms_dispatcher_connect (KmsDispatcher * self, guint source, guint sink)
           source_port->video_agnostic, "src_%u", TRUE)) {
     GST_ERROR_OBJECT (self, "Can not connect video port");
     kms_base_hub_unlink_audio_src (KMS_BASE_HUB (self), sink_port->id);
+    sink_port->audio_source = -1;
     goto end;
   }
 
+  sink_port->audio_source = source_port->id;
+  sink_port->video_source = source_port->id;
   connected = TRUE;
 
 end:
@@ -240,6 +265,227 @@ end:
   return connected;
 }
 
+/*
+ * Routes are structures with the "source" and "sink" port ids (guint), an
+ * optional "media" ("audio" or "video", both if missing) and an optional
+ * "connect" boolean, FALSE to disconnect.
+ */
+static gboolean
+kms_dispatcher_parse_route (KmsDispatcher * self, const GstStructure * s,
+    KmsDispatcherRoute * route)
+{
+  const gchar *media;
+  guint source, sink;
+
+  if (!gst_structure_get_uint (s, "source", &source) ||
+      !gst_structure_get_uint (s, "sink", &sink)) {
+    GST_ERROR_OBJECT (self, "Route without ports: %" GST_PTR_FORMAT, s);
+    return FALSE;
+  }
+
+  route->source = g_hash_table_lookup (self->priv->ports, &source);
+  if (route->source == NULL) {
+    GST_ERROR_OBJECT (self, "No source port %u found", source);
+    return FALSE;
+  }
+
+  route->sink = g_hash_table_lookup (self->priv->ports, &sink);
+  if (route->sink == NULL) {
+    GST_ERROR_OBJECT (self, "No sink port %u found", sink);
+    return FALSE;
+  }
+
+  media = gst_structure_get_string (s, "media");
+  route->audio = media == NULL || g_strcmp0 (media, "audio") == 0;
+  route->video = media == NULL || g_strcmp0 (media, "video") == 0;
+
+  if (!route->audio && !route->video) {
+    GST_ERROR_OBJECT (self, "Invalid media %s", media);
+    return FALSE;
+  }
+
+  if (!gst_structure_get_boolean (s, "connect", &route->connect)) {
+    route->connect = TRUE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+kms_dispatcher_route_media (KmsDispatcher * self, KmsDispatcherRoute * route,
+    gboolean audio)
+{
+  KmsBaseHub *hub = KMS_BASE_HUB (self);
+  gint *current;
+  gboolean linked;
+
+  current = audio ? &route->sink->audio_source : &route->sink->video_source;
+
+  if (!route->connect) {
+    /* Only if it still comes from that source */
+    if (*current == route->source->id) {
+      if (audio) {
+        kms_base_hub_unlink_audio_src (hub, route->sink->id);
+      } else {
+        kms_base_hub_unlink_video_src (hub, route->sink->id);
+      }
+
+      *current = -1;
+    }
+
+    return TRUE;
+  }
+
+  if (*current == route->source->id) {
+    return TRUE;
+  }
+
+  if (audio) {
+    linked = kms_base_hub_link_audio_src (hub, route->sink->id,
+        route->source->audio_agnostic, "src_%u", TRUE);
+  } else {
+    linked = kms_base_hub_link_video_src (hub, route->sink->id,
+        route->source->video_agnostic, "src_%u", TRUE);
+  }
+
+  if (!linked) {
+    GST_ERROR_OBJECT (self, "Can not connect port %d to %d",
+        route->source->id, route->sink->id);
+    /* Whatever was linked before is relinked on rollback */
+    *current = -1;
+    return FALSE;
+  }
+
+  *current = route->source->id;
+
+  return TRUE;
+}
+
+static void
+kms_dispatcher_restore_media (KmsDispatcher * self,
+    KmsDispatcherPortData * sink, gboolean audio, gint previous)
+{
+  KmsBaseHub *hub = KMS_BASE_HUB (self);
+  KmsDispatcherPortData *source = NULL;
+  gboolean linked = FALSE;
+  gint *current;
+
+  current = audio ? &sink->audio_source : &sink->video_source;
+
+  if (*current == previous) {
+    return;
+  }
+
+  if (previous >= 0) {
+    source = g_hash_table_lookup (self->priv->ports, &previous);
+  }
+
+  if (source != NULL) {
+    if (audio) {
+      linked = kms_base_hub_link_audio_src (hub, sink->id,
+          source->audio_agnostic, "src_%u", TRUE);
+    } else {
+      linked = kms_base_hub_link_video_src (hub, sink->id,
+          source->video_agnostic, "src_%u", TRUE);
+    }
+
+    if (!linked) {
+      GST_ERROR_OBJECT (self, "Can not restore port %d to %d", previous,
+          sink->id);
+    }
+  }
+
+  if (linked) {
+    *current = previous;
+    return;
+  }
+
+  if (audio) {
+    kms_base_hub_unlink_audio_src (hub, sink->id);
+  } else {
+    kms_base_hub_unlink_video_src (hub, sink->id);
+  }
+
+  *current = -1;
+}
+
+/*
+ * Applies a whole routing matrix diff in one pass. Nothing is applied if any
+ * route is invalid, and routes already applied are rolled back if one can
+ * not be linked. Sources and sinks involved are blocked meanwhile, so no
+ * buffer goes through a half applied matrix.
+ */
+static gboolean
+kms_dispatcher_apply_routing (KmsDispatcher * self, GPtrArray * routes)
+{
+  KmsDispatcherRoute *parsed;
+  KmsHubRoutingBlock *block;
+  gboolean applied = TRUE;
+  guint i;
+
+  parsed = g_new0 (KmsDispatcherRoute, routes->len);
+
+  KMS_DISPATCHER_LOCK (self);
+
+  for (i = 0; i < routes->len; i++) {
+    if (!kms_dispatcher_parse_route (self, g_ptr_array_index (routes, i),
+            &parsed[i])) {
+      applied = FALSE;
+      goto end;
+    }
+  }
+
+  block = kms_hub_routing_block_new ();
+
+  for (i = 0; i < routes->len; i++) {
+    if (parsed[i].audio) {
+      kms_hub_routing_block_source (block, parsed[i].source->audio_agnostic);
+      kms_hub_routing_block_sink (block, GST_ELEMENT (self),
+          parsed[i].sink->id, TRUE);
+    }
+
+    if (parsed[i].video) {
+      kms_hub_routing_block_source (block, parsed[i].source->video_agnostic);
+      kms_hub_routing_block_sink (block, GST_ELEMENT (self),
+          parsed[i].sink->id, FALSE);
+    }
+  }
+
+  for (i = 0; i < routes->len && applied; i++) {
+    KmsDispatcherRoute *route = &parsed[i];
+
+    route->previous_audio = route->sink->audio_source;
+    route->previous_video = route->sink->video_source;
+
+    if (route->audio) {
+      applied = kms_dispatcher_route_media (self, route, TRUE);
+    }
+
+    if (applied && route->video) {
+      applied = kms_dispatcher_route_media (self, route, FALSE);
+    }
+  }
+
+  if (!applied) {
+    /* Newest routes first, so every sink ends as before the batch */
+    while (i-- > 0) {
+      kms_dispatcher_restore_media (self, parsed[i].sink, TRUE,
+          parsed[i].previous_audio);
+      kms_dispatcher_restore_media (self, parsed[i].sink, FALSE,
+          parsed[i].previous_video);
+    }
+  }
+
+  kms_hub_routing_block_release (block);
+
+end:
+  KMS_DISPATCHER_UNLOCK (self);
+
+  g_free (parsed);
+
+  return applied;
+}
+
 static void
 kms_dispatcher_class_init (KmsDispatcherClass * klass)
 {
@@ -251,6 +497,7 @@ kms_dispatcher_class_init (KmsDispatcherClass * klass)
       "media flow", "Santiago Carot-Nemesio <sancane at gmail dot com>");
 
   klass->connect = GST_DEBUG_FUNCPTR (kms_dispatcher_connect);
+  klass->apply_routing = GST_DEBUG_FUNCPTR (kms_dispatcher_apply_routing);
 
   gobject_class->dispose = GST_DEBUG_FUNCPTR (kms_dispatcher_dispose);
   gobject_class->finalize = GST_DEBUG_FUNCPTR (kms_dispatcher_finalize);
@@ -268,6 +515,13 @@ kms_dispatcher_class_init (KmsDispatcherClass * klass)
       __kms_core_marshal_BOOLEAN__UINT_UINT, G_TYPE_BOOLEAN, 2, G_TYPE_UINT,
       G_TYPE_UINT);
 
+  obj_signals[SIGNAL_APPLY_ROUTING] =
+      g_signal_new ("apply-routing",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_ACTION | G_SIGNAL_RUN_LAST,
+      G_STRUCT_OFFSET (KmsDispatcherClass, apply_routing), NULL, NULL,
+      NULL, G_TYPE_BOOLEAN, 1, G_TYPE_PTR_ARRAY);
+
   /* Registers a private structure for the instantiatable type */
   g_type_class_add_private (klass, sizeof (KmsDispatcherPrivate));
 }
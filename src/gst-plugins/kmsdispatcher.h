@@ -64,6 +64,7 @@ struct _KmsDispatcherClass
 
   /* Actions */
   gboolean (*connect) (KmsDispatcher * self, guint source, guint sink);
+  gboolean (*apply_routing) (KmsDispatcher * self, GPtrArray * routes);
 };
 
 GType kms_dispatcher_get_type (void);
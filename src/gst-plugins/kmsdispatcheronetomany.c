@@ -21,6 +21,9 @@
 #include "kmsdispatcheronetomany.h"
 #include <commons/kmsagnosticcaps.h>
 #include <commons/kmshubport.h>
+#include <commons/kmsloop.h>
+#include <gst/video/video.h>
+#include <string.h>
 
 #define PLUGIN_NAME "dispatcheronetomany"
 
@@ -42,29 +45,94 @@ GST_DEBUG_CATEGORY_STATIC (kms_dispatcher_one_to_many_debug_category);
 )
 
 #define MAIN_PORT_NONE (-1)
+#define DEFAULT_FORWARD_ENCODED FALSE
+#define KEYFRAME_TIMEOUT 2000   /* ms */
+/* Agnosticbins looked past to find what a viewer endpoint accepts */
+#define MAX_AGNOSTIC_DEPTH 4
+
+typedef enum
+{
+  KMS_DISPATCHER_ONE_TO_MANY_AUDIO,
+  KMS_DISPATCHER_ONE_TO_MANY_VIDEO,
+  KMS_DISPATCHER_ONE_TO_MANY_N_MEDIA
+} KmsDispatcherOneToManyMedia;
 
 struct _KmsDispatcherOneToManyPrivate
 {
   GRecMutex mutex;
   GHashTable *ports;
+  KmsLoop *loop;
 
   gint main_port;
+  gboolean forward_encoded;
+
+  /* Every port feeds a selector and every viewer takes its output, so */
+  /* switching the source does not touch the viewers */
+  GstElement *selector[KMS_DISPATCHER_ONE_TO_MANY_N_MEDIA];
+  GstElement *output[KMS_DISPATCHER_ONE_TO_MANY_N_MEDIA];
+  /* Selector pad of the main port, NULL mutes the output */
+  GstPad *active[KMS_DISPATCHER_ONE_TO_MANY_N_MEDIA];
+  /* Transcoding branches of each output when forwarding encoded media */
+  GList *branches[KMS_DISPATCHER_ONE_TO_MANY_N_MEDIA];
+
+  /* Video pad of the new main port, waiting for a keyframe */
+  GstPad *pending;
+  gulong pending_probe;
+  gint64 pending_since;
 };
 
-typedef struct _KmsDispatcherOneToManyPortData KmsDispatcherOneToManyPortData;
-
-struct _KmsDispatcherOneToManyPortData
+/* Transcodes the output once for all the viewers that need the same caps. */
+/* The capsfilter pins the encoding, hub ports would accept anything */
+typedef struct _KmsDispatcherOneToManyBranch
+{
+  GstCaps *caps;
+  GstElement *agnostic;
+  GstElement *filter;
+  /* Viewers take the branch output from this tee */
+  GstElement *tee;
+  /* Request pad of the output tee feeding the branch */
+  GstPad *teepad;
+  guint viewers;
+} KmsDispatcherOneToManyBranch;
+
+typedef struct _KmsDispatcherOneToManyPortData
 {
   KmsDispatcherOneToMany *mixer;
   gint id;
-  GstElement *audio_agnostic;
-  GstElement *video_agnostic;
-};
+  GstElement *port;
+  /* Selector pads the port feeds */
+  GstPad *selpad[KMS_DISPATCHER_ONE_TO_MANY_N_MEDIA];
+
+  /* As viewer, branch it takes each media from, if any */
+  KmsDispatcherOneToManyBranch *branch[KMS_DISPATCHER_ONE_TO_MANY_N_MEDIA];
+} KmsDispatcherOneToManyPortData;
+
+/* Viewers linked to an output tee, checked when the caps arrive */
+typedef struct _KmsDispatcherOneToManyForward
+{
+  KmsDispatcherOneToMany *self;
+  gint viewer;
+  KmsDispatcherOneToManyMedia media;
+  /* Set once the port had something linked to check against */
+  gboolean checked;
+  gboolean incompatible;
+} KmsDispatcherOneToManyForward;
+
+typedef struct _KmsDispatcherOneToManyJoin
+{
+  KmsDispatcherOneToMany *self;
+  gint viewer;
+  KmsDispatcherOneToManyMedia media;
+  GstCaps *caps;
+} KmsDispatcherOneToManyJoin;
 
 enum
 {
   PROP_0,
-  PROP_MAIN_PORT
+  PROP_MAIN_PORT,
+  PROP_FORWARD_ENCODED,
+  PROP_DECODERS,
+  PROP_ENCODERS
 };
 
 /* class initialization */
@@ -74,27 +142,724 @@ G_DEFINE_TYPE_WITH_CODE (KmsDispatcherOneToMany, kms_dispatcher_one_to_many,
     GST_DEBUG_CATEGORY_INIT (kms_dispatcher_one_to_many_debug_category,
         PLUGIN_NAME, 0, "debug category for dispatcheronetomany element"));
 
+static gboolean
+kms_dispatcher_one_to_many_link_src (KmsDispatcherOneToMany * self, gint id,
+    KmsDispatcherOneToManyMedia media, GstElement * element,
+    const gchar * pad_name, gboolean remove_on_unlink)
+{
+  if (media == KMS_DISPATCHER_ONE_TO_MANY_AUDIO) {
+    return kms_base_hub_link_audio_src (KMS_BASE_HUB (self), id, element,
+        pad_name, remove_on_unlink);
+  } else {
+    return kms_base_hub_link_video_src (KMS_BASE_HUB (self), id, element,
+        pad_name, remove_on_unlink);
+  }
+}
+
+static GstPadProbeReturn
+kms_dispatcher_one_to_many_drop_muted (GstPad * pad, GstPadProbeInfo * info,
+    GstPad ** active)
+{
+  if (g_atomic_pointer_get (active) == NULL) {
+    return GST_PAD_PROBE_DROP;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+kms_dispatcher_one_to_many_create_outputs (KmsDispatcherOneToMany * self)
+{
+  KmsDispatcherOneToManyMedia media;
+
+  for (media = 0; media < KMS_DISPATCHER_ONE_TO_MANY_N_MEDIA; media++) {
+    GstElement *selector, *output;
+    GstPad *srcpad;
+
+    selector = gst_element_factory_make ("input-selector", NULL);
+    /* Buffers of the other ports are dropped instead of waiting */
+    g_object_set (selector, "sync-streams", FALSE, NULL);
+
+    if (self->priv->forward_encoded) {
+      output = gst_element_factory_make ("tee", NULL);
+      g_object_set (output, "allow-not-linked", TRUE, NULL);
+    } else {
+      output = gst_element_factory_make ("agnosticbin", NULL);
+    }
+
+    gst_bin_add_many (GST_BIN (self), selector, output, NULL);
+    gst_element_link (selector, output);
+    gst_element_sync_state_with_parent (output);
+    gst_element_sync_state_with_parent (selector);
+
+    /* The selector makes the first pad that pushes active if none is */
+    srcpad = gst_element_get_static_pad (selector, "src");
+    gst_pad_add_probe (srcpad,
+        GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+        (GstPadProbeCallback) kms_dispatcher_one_to_many_drop_muted,
+        &self->priv->active[media], NULL);
+    g_object_unref (srcpad);
+
+    self->priv->selector[media] = selector;
+    self->priv->output[media] = output;
+  }
+}
+
+static void
+kms_dispatcher_one_to_many_activate (KmsDispatcherOneToMany * self,
+    KmsDispatcherOneToManyMedia media, GstPad * pad)
+{
+  if (pad != NULL) {
+    g_object_set (self->priv->selector[media], "active-pad", pad, NULL);
+  }
+
+  g_atomic_pointer_set (&self->priv->active[media], pad);
+}
+
+static void
+kms_dispatcher_one_to_many_cancel_pending (KmsDispatcherOneToMany * self)
+{
+  if (self->priv->pending == NULL) {
+    return;
+  }
+
+  gst_pad_remove_probe (self->priv->pending, self->priv->pending_probe);
+  g_clear_object (&self->priv->pending);
+}
+
+static GstPadProbeReturn
+kms_dispatcher_one_to_many_wait_keyframe (GstPad * pad, GstPadProbeInfo * info,
+    KmsDispatcherOneToMany * self)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  KMS_DISPATCHER_ONE_TO_MANY_LOCK (self);
+
+  if (self->priv->pending == pad) {
+    GST_DEBUG_OBJECT (self, "Keyframe received, switching to port %d",
+        self->priv->main_port);
+    kms_dispatcher_one_to_many_activate (self, KMS_DISPATCHER_ONE_TO_MANY_VIDEO,
+        pad);
+    g_clear_object (&self->priv->pending);
+  }
+
+  KMS_DISPATCHER_ONE_TO_MANY_UNLOCK (self);
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+static gboolean
+kms_dispatcher_one_to_many_keyframe_timeout (gpointer data)
+{
+  KmsDispatcherOneToMany *self = KMS_DISPATCHER_ONE_TO_MANY (data);
+
+  KMS_DISPATCHER_ONE_TO_MANY_LOCK (self);
+
+  /* Left by an older switch otherwise */
+  if (self->priv->pending != NULL && g_get_monotonic_time () -
+      self->priv->pending_since >= KEYFRAME_TIMEOUT * G_TIME_SPAN_MILLISECOND) {
+    GST_WARNING_OBJECT (self, "No keyframe from port %d, switching anyway",
+        self->priv->main_port);
+    kms_dispatcher_one_to_many_activate (self, KMS_DISPATCHER_ONE_TO_MANY_VIDEO,
+        self->priv->pending);
+    kms_dispatcher_one_to_many_cancel_pending (self);
+  }
+
+  KMS_DISPATCHER_ONE_TO_MANY_UNLOCK (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Audio switches at once. Video keeps coming from the previous source until
+ * the new one sends a keyframe, which is requested, so that viewers do not
+ * decode from the middle of a GOP.
+ */
+static void
+kms_dispatcher_one_to_many_switch (KmsDispatcherOneToMany * self)
+{
+  KmsDispatcherOneToManyPortData *port_data = NULL;
+  KmsDispatcherOneToManyMedia media;
+  GstPad *pad;
+
+  if (self->priv->selector[KMS_DISPATCHER_ONE_TO_MANY_AUDIO] == NULL) {
+    /* No ports yet */
+    return;
+  }
+
+  kms_dispatcher_one_to_many_cancel_pending (self);
+
+  if (self->priv->main_port != MAIN_PORT_NONE) {
+    port_data = g_hash_table_lookup (self->priv->ports, &self->priv->main_port);
+  }
+
+  if (port_data == NULL) {
+    for (media = 0; media < KMS_DISPATCHER_ONE_TO_MANY_N_MEDIA; media++) {
+      kms_dispatcher_one_to_many_activate (self, media, NULL);
+    }
+
+    return;
+  }
+
+  kms_dispatcher_one_to_many_activate (self, KMS_DISPATCHER_ONE_TO_MANY_AUDIO,
+      port_data->selpad[KMS_DISPATCHER_ONE_TO_MANY_AUDIO]);
+
+  pad = port_data->selpad[KMS_DISPATCHER_ONE_TO_MANY_VIDEO];
+
+  if (pad == self->priv->active[KMS_DISPATCHER_ONE_TO_MANY_VIDEO]) {
+    return;
+  }
+
+  self->priv->pending = g_object_ref (pad);
+  self->priv->pending_since = g_get_monotonic_time ();
+  self->priv->pending_probe = gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) kms_dispatcher_one_to_many_wait_keyframe, self,
+      NULL);
+
+  /* Upstream, to the port */
+  gst_pad_push_event (pad,
+      gst_video_event_new_upstream_force_key_unit (GST_CLOCK_TIME_NONE, TRUE,
+          0));
+
+  kms_loop_timeout_add_full (self->priv->loop, G_PRIORITY_DEFAULT,
+      KEYFRAME_TIMEOUT, kms_dispatcher_one_to_many_keyframe_timeout, self,
+      NULL);
+}
+
+static KmsDispatcherOneToManyBranch *
+kms_dispatcher_one_to_many_branch_create (KmsDispatcherOneToMany * self,
+    KmsDispatcherOneToManyMedia media, GstCaps * caps)
+{
+  KmsDispatcherOneToManyBranch *branch;
+  GstPad *sinkpad;
+
+  branch = g_slice_new0 (KmsDispatcherOneToManyBranch);
+  branch->caps = gst_caps_ref (caps);
+  branch->agnostic = gst_element_factory_make ("agnosticbin", NULL);
+  branch->filter = gst_element_factory_make ("capsfilter", NULL);
+  branch->tee = gst_element_factory_make ("tee", NULL);
+
+  g_object_set (branch->filter, "caps", caps, NULL);
+  g_object_set (branch->tee, "allow-not-linked", TRUE, NULL);
+
+  gst_bin_add_many (GST_BIN (self), g_object_ref (branch->agnostic),
+      g_object_ref (branch->filter), g_object_ref (branch->tee), NULL);
+  gst_element_link_many (branch->agnostic, branch->filter, branch->tee, NULL);
+  gst_element_sync_state_with_parent (branch->tee);
+  gst_element_sync_state_with_parent (branch->filter);
+  gst_element_sync_state_with_parent (branch->agnostic);
+
+  branch->teepad = gst_element_get_request_pad (self->priv->output[media],
+      "src_%u");
+  sinkpad = gst_element_get_static_pad (branch->agnostic, "sink");
+
+  if (gst_pad_link (branch->teepad, sinkpad) != GST_PAD_LINK_OK) {
+    GST_WARNING_OBJECT (self, "Can not link transcoding branch");
+  }
+
+  g_object_unref (sinkpad);
+
+  self->priv->branches[media] = g_list_prepend (self->priv->branches[media],
+      branch);
+
+  GST_DEBUG_OBJECT (self, "New transcoding branch for %" GST_PTR_FORMAT, caps);
+
+  return branch;
+}
+
+static void
+kms_dispatcher_one_to_many_branch_remove (GstElement * element)
+{
+  GstObject *self = gst_object_get_parent (GST_OBJECT (element));
+
+  if (self != NULL) {
+    gst_bin_remove (GST_BIN (self), element);
+    gst_object_unref (self);
+  }
+
+  gst_element_set_state (element, GST_STATE_NULL);
+  g_object_unref (element);
+}
+
+static void
+kms_dispatcher_one_to_many_branch_destroy (KmsDispatcherOneToManyBranch *
+    branch)
+{
+  GstElement *tee = gst_pad_get_parent_element (branch->teepad);
+
+  kms_dispatcher_one_to_many_branch_remove (branch->agnostic);
+  kms_dispatcher_one_to_many_branch_remove (branch->filter);
+  kms_dispatcher_one_to_many_branch_remove (branch->tee);
+
+  if (tee != NULL) {
+    gst_element_release_request_pad (tee, branch->teepad);
+    gst_object_unref (tee);
+  }
+
+  g_object_unref (branch->teepad);
+  gst_caps_unref (branch->caps);
+
+  g_slice_free (KmsDispatcherOneToManyBranch, branch);
+}
+
+/* Branches without viewers are destroyed */
+static void
+kms_dispatcher_one_to_many_leave_branches (KmsDispatcherOneToMany * self,
+    KmsDispatcherOneToManyPortData * viewer)
+{
+  KmsDispatcherOneToManyMedia media;
+
+  for (media = 0; media < KMS_DISPATCHER_ONE_TO_MANY_N_MEDIA; media++) {
+    KmsDispatcherOneToManyBranch *branch = viewer->branch[media];
+
+    if (branch == NULL) {
+      continue;
+    }
+
+    viewer->branch[media] = NULL;
+
+    if (--branch->viewers > 0) {
+      continue;
+    }
+
+    self->priv->branches[media] =
+        g_list_remove (self->priv->branches[media], branch);
+    kms_dispatcher_one_to_many_branch_destroy (branch);
+  }
+}
+
+static void
+kms_dispatcher_one_to_many_join_destroy (KmsDispatcherOneToManyJoin * join)
+{
+  gst_caps_unref (join->caps);
+  g_slice_free (KmsDispatcherOneToManyJoin, join);
+}
+
+/* Moves a viewer from the tee to the branch that transcodes to its caps */
+static gboolean
+kms_dispatcher_one_to_many_join_branch (KmsDispatcherOneToManyJoin * join)
+{
+  KmsDispatcherOneToMany *self = join->self;
+  KmsDispatcherOneToManyPortData *viewer;
+  KmsDispatcherOneToManyBranch *branch = NULL;
+  GList *l;
+
+  KMS_DISPATCHER_ONE_TO_MANY_LOCK (self);
+
+  viewer = g_hash_table_lookup (self->priv->ports, &join->viewer);
+
+  if (viewer == NULL || viewer->branch[join->media] != NULL) {
+    goto end;
+  }
+
+  for (l = self->priv->branches[join->media]; l != NULL; l = l->next) {
+    KmsDispatcherOneToManyBranch *b = l->data;
+
+    if (gst_caps_is_equal (b->caps, join->caps)) {
+      branch = b;
+      break;
+    }
+  }
+
+  if (branch == NULL) {
+    branch = kms_dispatcher_one_to_many_branch_create (self, join->media,
+        join->caps);
+  }
+
+  branch->viewers++;
+  viewer->branch[join->media] = branch;
+
+  kms_dispatcher_one_to_many_link_src (self, viewer->id, join->media,
+      branch->tee, "src_%u", TRUE);
+
+end:
+  KMS_DISPATCHER_ONE_TO_MANY_UNLOCK (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+kms_dispatcher_one_to_many_forward_destroy (KmsDispatcherOneToManyForward *
+    forward)
+{
+  g_slice_free (KmsDispatcherOneToManyForward, forward);
+}
+
+static gboolean
+is_agnosticbin (GstElement * element)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+
+  return factory != NULL &&
+      g_strcmp0 (GST_OBJECT_NAME (factory), "agnosticbin") == 0;
+}
+
+static GstCaps *kms_dispatcher_one_to_many_downstream_caps (GstPad * srcpad,
+    guint depth);
+
+/* Union of what follows the linked outputs of the agnosticbin, NULL if */
+/* none is linked */
+static GstCaps *
+kms_dispatcher_one_to_many_agnostic_caps (GstElement * agnosticbin,
+    guint depth)
+{
+  GstIterator *it = gst_element_iterate_src_pads (agnosticbin);
+  GValue item = G_VALUE_INIT;
+  GstCaps *caps = NULL, *tmp;
+  gboolean done = FALSE;
+
+  while (!done) {
+    switch (gst_iterator_next (it, &item)) {
+      case GST_ITERATOR_OK:
+        tmp = kms_dispatcher_one_to_many_downstream_caps (g_value_get_object
+            (&item), depth);
+
+        if (tmp != NULL) {
+          caps = caps == NULL ? tmp : gst_caps_merge (caps, tmp);
+        }
+
+        g_value_reset (&item);
+        break;
+      case GST_ITERATOR_RESYNC:
+        gst_iterator_resync (it);
+        g_clear_pointer (&caps, gst_caps_unref);
+        break;
+      default:
+        done = TRUE;
+        break;
+    }
+  }
+
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  return caps;
+}
+
+/*
+ * Caps accepted past a source pad, NULL if it is not linked. Endpoints take
+ * media through an agnosticbin, which accepts anything and adapts it to what
+ * follows. So agnosticbins are looked past, and the caps of the elements
+ * after them, like the payloader of the negotiated codec, are used instead.
+ */
+static GstCaps *
+kms_dispatcher_one_to_many_downstream_caps (GstPad * srcpad, guint depth)
+{
+  GstPad *pad, *target;
+  GstElement *parent;
+  GstCaps *caps;
+
+  pad = gst_pad_get_peer (srcpad);
+
+  if (pad == NULL) {
+    return NULL;
+  }
+
+  for (;;) {
+    parent = gst_pad_get_parent_element (pad);
+
+    if (parent != NULL && is_agnosticbin (parent) &&
+        depth < MAX_AGNOSTIC_DEPTH) {
+      /* Unknown until something is linked after it */
+      caps = kms_dispatcher_one_to_many_agnostic_caps (parent, depth + 1);
+      gst_object_unref (parent);
+      gst_object_unref (pad);
+      return caps;
+    }
+
+    g_clear_object (&parent);
+
+    if (!GST_IS_GHOST_PAD (pad)) {
+      break;
+    }
+
+    /* Into the bin the pad belongs to */
+    target = gst_ghost_pad_get_target (GST_GHOST_PAD (pad));
+
+    if (target == NULL) {
+      break;
+    }
+
+    gst_object_unref (pad);
+    pad = target;
+  }
+
+  caps = gst_pad_query_caps (pad, NULL);
+  gst_object_unref (pad);
+
+  return caps;
+}
+
+/* Caps accepted by what is linked to the viewer port. The port itself */
+/* would take anything, so its source pads are looked past */
+static GstCaps *
+kms_dispatcher_one_to_many_viewer_caps (KmsDispatcherOneToMany * self,
+    gint viewer, KmsDispatcherOneToManyMedia media)
+{
+  KmsDispatcherOneToManyPortData *port_data;
+  KmsElementPadType type;
+  GstElement *port = NULL;
+  GstCaps *allowed = NULL;
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+  gboolean done = FALSE;
+
+  KMS_DISPATCHER_ONE_TO_MANY_LOCK (self);
+  port_data = g_hash_table_lookup (self->priv->ports, &viewer);
+  if (port_data != NULL) {
+    port = g_object_ref (port_data->port);
+  }
+  KMS_DISPATCHER_ONE_TO_MANY_UNLOCK (self);
+
+  if (port == NULL) {
+    return NULL;
+  }
+
+  type = media == KMS_DISPATCHER_ONE_TO_MANY_AUDIO ?
+      KMS_ELEMENT_PAD_TYPE_AUDIO : KMS_ELEMENT_PAD_TYPE_VIDEO;
+  it = gst_element_iterate_src_pads (port);
+
+  while (!done) {
+    switch (gst_iterator_next (it, &item)) {
+      case GST_ITERATOR_OK:{
+        GstPad *pad = g_value_get_object (&item);
+        GstCaps *caps, *tmp;
+
+        if (kms_element_get_pad_type (KMS_ELEMENT (port), pad) != type ||
+            !gst_pad_is_linked (pad)) {
+          g_value_reset (&item);
+          break;
+        }
+
+        caps = kms_dispatcher_one_to_many_downstream_caps (pad, 0);
+
+        if (caps == NULL) {
+          g_value_reset (&item);
+          break;
+        }
+
+        if (allowed == NULL) {
+          allowed = caps;
+        } else {
+          tmp = gst_caps_intersect (allowed, caps);
+          gst_caps_unref (allowed);
+          gst_caps_unref (caps);
+          allowed = tmp;
+        }
+
+        g_value_reset (&item);
+        break;
+      }
+      case GST_ITERATOR_RESYNC:
+        gst_iterator_resync (it);
+        if (allowed != NULL) {
+          gst_caps_unref (allowed);
+          allowed = NULL;
+        }
+        break;
+      default:
+        done = TRUE;
+        break;
+    }
+  }
+
+  g_value_unset (&item);
+  gst_iterator_free (it);
+  g_object_unref (port);
+
+  return allowed;
+}
+
+/* Checked when the caps change, and on buffers until the viewer port has */
+/* something linked, as it may be linked after the caps went through */
+static GstPadProbeReturn
+kms_dispatcher_one_to_many_check_forward (GstPad * pad, GstPadProbeInfo * info,
+    KmsDispatcherOneToManyForward * forward)
+{
+  KmsDispatcherOneToManyJoin *join;
+  GstCaps *caps, *allowed;
+
+  if (forward->incompatible) {
+    /* Until it is moved to a transcoding branch */
+    return GST_PAD_PROBE_DROP;
+  }
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (GST_EVENT_TYPE (event) != GST_EVENT_CAPS) {
+      return GST_PAD_PROBE_OK;
+    }
+
+    gst_event_parse_caps (event, &caps);
+    gst_caps_ref (caps);
+  } else if (forward->checked) {
+    return GST_PAD_PROBE_OK;
+  } else {
+    caps = gst_pad_get_current_caps (pad);
+
+    if (caps == NULL) {
+      return GST_PAD_PROBE_OK;
+    }
+  }
+
+  allowed = kms_dispatcher_one_to_many_viewer_caps (forward->self,
+      forward->viewer, forward->media);
+
+  if (allowed == NULL) {
+    /* Nothing linked to the port yet */
+    gst_caps_unref (caps);
+    return GST_PAD_PROBE_OK;
+  }
+
+  forward->checked = TRUE;
+
+  if (gst_caps_is_empty (allowed)) {
+    GST_WARNING_OBJECT (forward->self,
+        "Elements linked to port %d accept no common caps", forward->viewer);
+  }
+
+  if (gst_caps_is_empty (allowed) || gst_caps_can_intersect (caps, allowed)) {
+    gst_caps_unref (allowed);
+    gst_caps_unref (caps);
+    return GST_PAD_PROBE_OK;
+  }
+
+  GST_DEBUG_OBJECT (forward->self, "Port %d does not accept %" GST_PTR_FORMAT,
+      forward->viewer, caps);
+  gst_caps_unref (caps);
+
+  forward->incompatible = TRUE;
+
+  join = g_slice_new0 (KmsDispatcherOneToManyJoin);
+  join->self = forward->self;
+  join->viewer = forward->viewer;
+  join->media = forward->media;
+  join->caps = allowed;
+
+  kms_loop_idle_add_full (forward->self->priv->loop, G_PRIORITY_DEFAULT,
+      (GSourceFunc) kms_dispatcher_one_to_many_join_branch, join,
+      (GDestroyNotify) kms_dispatcher_one_to_many_join_destroy);
+
+  return GST_PAD_PROBE_DROP;
+}
+
+static void
+release_unlinked_pad (GstPad * pad, GstPad * peer, gpointer user_data)
+{
+  GstElement *element = gst_pad_get_parent_element (pad);
+
+  if (element != NULL) {
+    gst_element_release_request_pad (element, pad);
+    gst_object_unref (element);
+  }
+}
+
+/* Viewers get the encoded buffers of the source as they are, unless their */
+/* caps turn out to be incompatible */
+static void
+kms_dispatcher_one_to_many_forward (KmsDispatcherOneToMany * self, gint to,
+    KmsDispatcherOneToManyMedia media)
+{
+  GstElement *tee = self->priv->output[media];
+  KmsDispatcherOneToManyForward *forward;
+  GstPad *pad;
+
+  pad = gst_element_get_request_pad (tee, "src_%u");
+
+  forward = g_slice_new0 (KmsDispatcherOneToManyForward);
+  forward->self = self;
+  forward->viewer = to;
+  forward->media = media;
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_DATA_DOWNSTREAM,
+      (GstPadProbeCallback) kms_dispatcher_one_to_many_check_forward, forward,
+      (GDestroyNotify) kms_dispatcher_one_to_many_forward_destroy);
+
+  if (kms_dispatcher_one_to_many_link_src (self, to, media, tee,
+          GST_OBJECT_NAME (pad), FALSE)) {
+    g_signal_connect (pad, "unlinked", G_CALLBACK (release_unlinked_pad),
+        NULL);
+  } else {
+    gst_element_release_request_pad (tee, pad);
+  }
+
+  g_object_unref (pad);
+}
+
+static void
+count_codecs (const GValue * item, guint * counts)
+{
+  GstElement *element = g_value_get_object (item);
+  GstElementFactory *factory = gst_element_get_factory (element);
+  const gchar *klass;
+
+  if (factory == NULL) {
+    return;
+  }
+
+  klass = gst_element_factory_get_metadata (factory,
+      GST_ELEMENT_METADATA_KLASS);
+
+  if (klass == NULL) {
+    return;
+  }
+
+  if (strstr (klass, "Decoder") != NULL) {
+    counts[0]++;
+  } else if (strstr (klass, "Encoder") != NULL) {
+    counts[1]++;
+  }
+}
+
+/* Decoders and encoders running inside the dispatcher, at any depth */
+static void
+kms_dispatcher_one_to_many_count_codecs (KmsDispatcherOneToMany * self,
+    guint * decoders, guint * encoders)
+{
+  GstIterator *it = gst_bin_iterate_recurse (GST_BIN (self));
+  guint counts[2] = { 0, 0 };
+
+  while (gst_iterator_foreach (it, (GstIteratorForeachFunction) count_codecs,
+          counts) == GST_ITERATOR_RESYNC) {
+    gst_iterator_resync (it);
+    counts[0] = counts[1] = 0;
+  }
+
+  gst_iterator_free (it);
+
+  *decoders = counts[0];
+  *encoders = counts[1];
+}
+
 static KmsDispatcherOneToManyPortData *
 kms_dispatcher_one_to_many_port_data_create (KmsDispatcherOneToMany * mixer,
-    gint id)
+    GstElement * port, gint id)
 {
   KmsDispatcherOneToManyPortData *data =
       g_slice_new0 (KmsDispatcherOneToManyPortData);
+  KmsDispatcherOneToManyMedia media;
 
   data->mixer = mixer;
-  data->audio_agnostic = gst_element_factory_make ("agnosticbin", NULL);
-  data->video_agnostic = gst_element_factory_make ("agnosticbin", NULL);
   data->id = id;
+  data->port = g_object_ref (port);
 
-  gst_bin_add_many (GST_BIN (mixer), g_object_ref (data->audio_agnostic),
-      g_object_ref (data->video_agnostic), NULL);
-  gst_element_sync_state_with_parent (data->audio_agnostic);
-  gst_element_sync_state_with_parent (data->video_agnostic);
+  for (media = 0; media < KMS_DISPATCHER_ONE_TO_MANY_N_MEDIA; media++) {
+    data->selpad[media] =
+        gst_element_get_request_pad (mixer->priv->selector[media], "sink_%u");
+  }
 
   kms_base_hub_link_video_sink (KMS_BASE_HUB (mixer), id,
-      data->video_agnostic, "sink", FALSE);
+      mixer->priv->selector[KMS_DISPATCHER_ONE_TO_MANY_VIDEO],
+      GST_OBJECT_NAME (data->selpad[KMS_DISPATCHER_ONE_TO_MANY_VIDEO]), FALSE);
   kms_base_hub_link_audio_sink (KMS_BASE_HUB (mixer), id,
-      data->audio_agnostic, "sink", FALSE);
+      mixer->priv->selector[KMS_DISPATCHER_ONE_TO_MANY_AUDIO],
+      GST_OBJECT_NAME (data->selpad[KMS_DISPATCHER_ONE_TO_MANY_AUDIO]), FALSE);
 
   return data;
 }
@@ -105,18 +870,29 @@ kms_dispatcher_one_to_many_port_data_destroy (gpointer data)
   KmsDispatcherOneToManyPortData *port_data =
       (KmsDispatcherOneToManyPortData *) data;
   KmsDispatcherOneToMany *self = port_data->mixer;
+  KmsDispatcherOneToManyMedia media;
 
   KMS_DISPATCHER_ONE_TO_MANY_LOCK (self);
-  gst_bin_remove_many (GST_BIN (self), port_data->audio_agnostic,
-      port_data->video_agnostic, NULL);
-  KMS_DISPATCHER_ONE_TO_MANY_UNLOCK (self);
 
-  gst_element_set_state (port_data->audio_agnostic, GST_STATE_NULL);
-  gst_element_set_state (port_data->video_agnostic, GST_STATE_NULL);
+  for (media = 0; media < KMS_DISPATCHER_ONE_TO_MANY_N_MEDIA; media++) {
+    GstPad *pad = port_data->selpad[media];
+
+    if (self->priv->pending == pad) {
+      kms_dispatcher_one_to_many_cancel_pending (self);
+    }
 
-  g_clear_object (&port_data->audio_agnostic);
-  g_clear_object (&port_data->video_agnostic);
+    /* Or the selector would pick the next pad that pushes */
+    if (self->priv->active[media] == pad) {
+      kms_dispatcher_one_to_many_activate (self, media, NULL);
+    }
+
+    gst_element_release_request_pad (self->priv->selector[media], pad);
+    g_object_unref (pad);
+  }
+
+  KMS_DISPATCHER_ONE_TO_MANY_UNLOCK (self);
 
+  g_object_unref (port_data->port);
   g_slice_free (KmsDispatcherOneToManyPortData, data);
 }
 
@@ -138,55 +914,43 @@ create_gint (gint value)
 static void
 kms_dispatcher_one_to_many_link_port (KmsDispatcherOneToMany * self, gint to)
 {
-  KmsDispatcherOneToManyPortData *port_data;
-
-  KMS_DISPATCHER_ONE_TO_MANY_LOCK (self);
-  if (self->priv->main_port < 0) {
-    kms_base_hub_unlink_audio_src (KMS_BASE_HUB (self), to);
-    kms_base_hub_unlink_video_src (KMS_BASE_HUB (self), to);
-  } else {
-    port_data = g_hash_table_lookup (self->priv->ports, &self->priv->main_port);
-    kms_base_hub_link_audio_src (KMS_BASE_HUB (self), to,
-        port_data->audio_agnostic, "src_%u", TRUE);
-    kms_base_hub_link_video_src (KMS_BASE_HUB (self), to,
-        port_data->video_agnostic, "src_%u", TRUE);
+  KmsDispatcherOneToManyMedia media;
+
+  for (media = 0; media < KMS_DISPATCHER_ONE_TO_MANY_N_MEDIA; media++) {
+    if (self->priv->forward_encoded) {
+      kms_dispatcher_one_to_many_forward (self, to, media);
+    } else {
+      kms_dispatcher_one_to_many_link_src (self, to, media,
+          self->priv->output[media], "src_%u", TRUE);
+    }
   }
-
-  KMS_DISPATCHER_ONE_TO_MANY_UNLOCK (self);
-}
-
-static void
-kms_dispatcher_one_to_many_change_main_port_it (gpointer key, gpointer value,
-    gpointer data)
-{
-  KmsDispatcherOneToManyPortData *port_data = value;
-
-  kms_dispatcher_one_to_many_link_port (port_data->mixer, port_data->id);
 }
 
 static void
-kms_dispatcher_one_to_many_change_main_port (KmsDispatcherOneToMany * self)
+kms_dispatcher_one_to_many_leave_branches_it (gpointer key,
+    KmsDispatcherOneToManyPortData * viewer, KmsDispatcherOneToMany * self)
 {
-  KMS_DISPATCHER_ONE_TO_MANY_LOCK (self);
-
-  g_hash_table_foreach (self->priv->ports,
-      kms_dispatcher_one_to_many_change_main_port_it, NULL);
-
-  KMS_DISPATCHER_ONE_TO_MANY_UNLOCK (self);
+  kms_dispatcher_one_to_many_leave_branches (self, viewer);
 }
 
 static void
 kms_dispatcher_one_to_many_unhandle_port (KmsBaseHub * mixer, gint id)
 {
   KmsDispatcherOneToMany *self = KMS_DISPATCHER_ONE_TO_MANY (mixer);
+  KmsDispatcherOneToManyPortData *port_data;
 
   KMS_DISPATCHER_ONE_TO_MANY_LOCK (self);
 
+  port_data = g_hash_table_lookup (self->priv->ports, &id);
+  if (port_data != NULL) {
+    kms_dispatcher_one_to_many_leave_branches (self, port_data);
+  }
+
   g_hash_table_remove (self->priv->ports, &id);
 
   if (self->priv->main_port == id) {
     self->priv->main_port = MAIN_PORT_NONE;
-    kms_dispatcher_one_to_many_change_main_port (self);
+    kms_dispatcher_one_to_many_switch (self);
   }
 
   KMS_DISPATCHER_ONE_TO_MANY_UNLOCK (self);
@@ -210,13 +974,22 @@ kms_dispatcher_one_to_many_handle_port (KmsBaseHub * mixer,
   if (port_id < 0)
     return port_id;
 
-  port_data = kms_dispatcher_one_to_many_port_data_create (self, port_id);
-
   KMS_DISPATCHER_ONE_TO_MANY_LOCK (self);
+
+  if (self->priv->selector[KMS_DISPATCHER_ONE_TO_MANY_AUDIO] == NULL) {
+    kms_dispatcher_one_to_many_create_outputs (self);
+  }
+
+  port_data =
+      kms_dispatcher_one_to_many_port_data_create (self, mixer_port, port_id);
   g_hash_table_insert (self->priv->ports, create_gint (port_id), port_data);
 
   kms_dispatcher_one_to_many_link_port (self, port_id);
 
+  if (self->priv->main_port == port_id) {
+    kms_dispatcher_one_to_many_switch (self);
+  }
+
   KMS_DISPATCHER_ONE_TO_MANY_UNLOCK (self);
 
   return port_id;
@@ -232,8 +1005,16 @@ kms_dispatcher_one_to_many_set_property (GObject * object, guint property_id,
   switch (property_id) {
     case PROP_MAIN_PORT:
       self->priv->main_port = g_value_get_int (value);
-      kms_dispatcher_one_to_many_change_main_port (self);
+      kms_dispatcher_one_to_many_switch (self);
 
+      break;
+    case PROP_FORWARD_ENCODED:
+      if (self->priv->selector[KMS_DISPATCHER_ONE_TO_MANY_AUDIO] != NULL) {
+        GST_WARNING_OBJECT (self, "Forwarding can not change once ports exist");
+        break;
+      }
+
+      self->priv->forward_encoded = g_value_get_boolean (value);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -253,6 +1034,18 @@ kms_dispatcher_one_to_many_get_property (GObject * object, guint property_id,
     case PROP_MAIN_PORT:
       g_value_set_int (value, self->priv->main_port);
       break;
+    case PROP_FORWARD_ENCODED:
+      g_value_set_boolean (value, self->priv->forward_encoded);
+      break;
+    case PROP_DECODERS:
+    case PROP_ENCODERS:{
+      guint decoders, encoders;
+
+      kms_dispatcher_one_to_many_count_codecs (self, &decoders, &encoders);
+      g_value_set_uint (value,
+          property_id == PROP_DECODERS ? decoders : encoders);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -266,12 +1059,16 @@ kms_dispatcher_one_to_many_dispose (GObject * object)
   KmsDispatcherOneToMany *self = KMS_DISPATCHER_ONE_TO_MANY (object);
 
   KMS_DISPATCHER_ONE_TO_MANY_LOCK (self);
+  g_hash_table_foreach (self->priv->ports,
+      (GHFunc) kms_dispatcher_one_to_many_leave_branches_it, self);
   g_hash_table_remove_all (self->priv->ports);
+  kms_dispatcher_one_to_many_cancel_pending (self);
   KMS_DISPATCHER_ONE_TO_MANY_UNLOCK (self);
 
+  g_clear_object (&self->priv->loop);
+
   G_OBJECT_CLASS (kms_dispatcher_one_to_many_parent_class)->dispose (object);
 }
-
 static void
 kms_dispatcher_one_to_many_finalize (GObject * object)
 {
@@ -318,6 +1115,26 @@ kms_dispatcher_one_to_many_class_init (KmsDispatcherOneToManyClass * klass)
           "The selected main port, -1 indicates none.", -1, G_MAXINT,
           MAIN_PORT_NONE, G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class, PROP_FORWARD_ENCODED,
+      g_param_spec_boolean ("forward-encoded",
+          "Forward encoded media",
+          "Forward the main port media without transcoding it. Viewers "
+          "that do not accept it share one transcoding per caps. Can only be "
+          "set before ports are added", DEFAULT_FORWARD_ENCODED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DECODERS,
+      g_param_spec_uint ("decoders",
+          "Decoders",
+          "Number of decoders running in the dispatcher", 0, G_MAXUINT, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ENCODERS,
+      g_param_spec_uint ("encoders",
+          "Encoders",
+          "Number of encoders running in the dispatcher", 0, G_MAXUINT, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   /* Registers a private structure for the instantiatable type */
   g_type_class_add_private (klass, sizeof (KmsDispatcherOneToManyPrivate));
 }
@@ -332,6 +1149,8 @@ kms_dispatcher_one_to_many_init (KmsDispatcherOneToMany * self)
       release_gint, kms_dispatcher_one_to_many_port_data_destroy);
 
   self->priv->main_port = MAIN_PORT_NONE;
+  self->priv->forward_encoded = DEFAULT_FORWARD_ENCODED;
+  self->priv->loop = kms_loop_new ();
 }
 
 gboolean
@@ -25,6 +25,8 @@
 #include "kmsselectablemixer.h"
 #include "kmscompositemixer.h"
 #include "kmsalphablending.h"
+#include "kmsmixminus.h"
+#include "kmsoverlayblender.h"
 
 static gboolean
 kurento_init (GstPlugin * kurento)
@@ -60,6 +62,14 @@ kurento_init (GstPlugin * kurento)
   if (!kms_alpha_blending_plugin_init (kurento))
     return FALSE;
 
+  if (!kms_mix_minus_plugin_init (kurento)) {
+    return FALSE;
+  }
+
+  if (!kms_overlay_blender_plugin_init (kurento)) {
+    return FALSE;
+  }
+
   return TRUE;
 }
 
@@ -0,0 +1,103 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "kmshubrouting.h"
+
+struct _KmsHubRoutingBlock
+{
+  /* Blocked pad to probe id */
+  GHashTable *pads;
+};
+
+static GstPadProbeReturn
+block_cb (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+unblock_source (GstPad * pad, gpointer id, gpointer user_data)
+{
+  gst_pad_remove_probe (pad, GPOINTER_TO_SIZE (id));
+
+  return TRUE;
+}
+
+KmsHubRoutingBlock *
+kms_hub_routing_block_new (void)
+{
+  KmsHubRoutingBlock *block = g_slice_new0 (KmsHubRoutingBlock);
+
+  block->pads = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+
+  return block;
+}
+
+/* Takes the pad reference */
+static void
+kms_hub_routing_block_pad (KmsHubRoutingBlock * block, GstPad * pad)
+{
+  gulong id;
+
+  if (g_hash_table_contains (block->pads, pad)) {
+    g_object_unref (pad);
+    return;
+  }
+
+  id = gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM, block_cb,
+      NULL, NULL);
+  g_hash_table_insert (block->pads, pad, GSIZE_TO_POINTER (id));
+}
+
+void
+kms_hub_routing_block_source (KmsHubRoutingBlock * block,
+    GstElement * agnosticbin)
+{
+  kms_hub_routing_block_pad (block, gst_element_get_static_pad (agnosticbin,
+          "sink"));
+}
+
+void
+kms_hub_routing_block_sink (KmsHubRoutingBlock * block, GstElement * hub,
+    gint id, gboolean audio)
+{
+  gchar *name;
+  GstPad *pad;
+
+  name = g_strdup_printf ("%s_src_%d", audio ? "audio" : "video", id);
+  pad = gst_element_get_static_pad (hub, name);
+
+  if (pad != NULL) {
+    kms_hub_routing_block_pad (block, pad);
+  } else {
+    GST_WARNING_OBJECT (hub, "No pad %s to block", name);
+  }
+
+  g_free (name);
+}
+
+void
+kms_hub_routing_block_release (KmsHubRoutingBlock * block)
+{
+  g_hash_table_foreach_remove (block->pads, (GHRFunc) unblock_source, NULL);
+  g_hash_table_unref (block->pads);
+
+  g_slice_free (KmsHubRoutingBlock, block);
+}
@@ -0,0 +1,49 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_HUB_ROUTING_H__
+#define __KMS_HUB_ROUTING_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Helpers for the routing batches of the hubs. Every source and every port
+ * sink touched by a batch are blocked while their routes change. Buffers
+ * already inside the agnosticbin of a source wait at the hub output of the
+ * port they go to, so no buffer goes through a half applied matrix.
+ */
+
+typedef struct _KmsHubRoutingBlock KmsHubRoutingBlock;
+
+KmsHubRoutingBlock * kms_hub_routing_block_new (void);
+
+/* Blocks the sink pad of the agnosticbin of a source, once per batch */
+void kms_hub_routing_block_source (KmsHubRoutingBlock * block,
+    GstElement * agnosticbin);
+
+/* Blocks the hub output that feeds the port, audio or video, once per batch */
+void kms_hub_routing_block_sink (KmsHubRoutingBlock * block, GstElement * hub,
+    gint id, gboolean audio);
+
+/* Unblocks every pad and frees the batch */
+void kms_hub_routing_block_release (KmsHubRoutingBlock * block);
+
+G_END_DECLS
+
+#endif /* __KMS_HUB_ROUTING_H__ */
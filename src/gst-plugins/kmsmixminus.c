@@ -0,0 +1,881 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "kmsmixminus.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define PLUGIN_NAME "mixminus"
+
+GST_DEBUG_CATEGORY_STATIC (kms_mix_minus_debug_category);
+#define GST_CAT_DEFAULT kms_mix_minus_debug_category
+
+#define KMS_MIX_MINUS_GET_PRIVATE(obj) ( \
+  G_TYPE_INSTANCE_GET_PRIVATE (          \
+    (obj),                               \
+    KMS_TYPE_MIX_MINUS,                  \
+    KmsMixMinusPrivate                   \
+  )                                      \
+)
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define MIX_MINUS_FORMAT "S16LE"
+#else
+#define MIX_MINUS_FORMAT "S16BE"
+#endif
+
+#define MIX_MINUS_CAPS                                \
+  "audio/x-raw, "                                     \
+  "format = (string) " MIX_MINUS_FORMAT ", "          \
+  "layout = (string) interleaved, "                   \
+  "rate = (int) [ 1, MAX ], "                         \
+  "channels = (int) [ 1, MAX ]"
+
+#define SINK_PAD_PREFIX "sink_"
+#define SRC_PAD_NAME "src_%u"
+
+/* Opus and most WebRTC audio use 20 ms frames */
+#define MIX_MINUS_PERIOD (20 * GST_MSECOND)
+/* Timestamp jitter below this is not a gap, so it does not cause clicks */
+#define MIX_MINUS_ALIGNMENT_THRESHOLD (40 * GST_MSECOND)
+
+#define FRAME_NONE G_MININT64
+
+static GstStaticPadTemplate sink_factory =
+GST_STATIC_PAD_TEMPLATE (SINK_PAD_PREFIX "%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (MIX_MINUS_CAPS)
+    );
+
+static GstStaticPadTemplate src_factory =
+GST_STATIC_PAD_TEMPLATE (SRC_PAD_NAME,
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS (MIX_MINUS_CAPS)
+    );
+
+/* Mix of every input */
+static GstStaticPadTemplate mix_src_factory =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (MIX_MINUS_CAPS)
+    );
+
+struct _KmsMixMinusPrivate
+{
+  /* All inputs share the caps of the first one that negotiates. They are */
+  /* protected by the object lock and never change once set. bpf is set */
+  /* last, once the output has the caps, and then mixing starts. */
+  GstCaps *caps;
+  gint rate;
+  gint channels;
+  gint bpf;
+  guint period;                 /* Frames per output buffer */
+  gint64 threshold;             /* Frames */
+
+  /* Only used from the aggregate thread */
+  gint32 *mix;                  /* Current period, period * channels samples */
+
+  /* Written from the aggregate thread with the object lock held */
+  GstClockTime base_time;       /* Running time of the first output frame */
+  guint64 offset;               /* Frames output so far */
+};
+
+#define KMS_TYPE_MIX_MINUS_PAD (kms_mix_minus_pad_get_type ())
+#define KMS_MIX_MINUS_PAD(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+  KMS_TYPE_MIX_MINUS_PAD, KmsMixMinusPad))
+
+typedef struct _KmsMixMinusPad
+{
+  GstAggregatorPad parent;
+
+  GstPad *srcpad;
+  gboolean need_events;
+
+  /* Only used from the aggregate thread */
+  gint16 *own;                  /* Contribution to the current period */
+  gboolean has_own;
+  guint filled;                 /* Frames of the current period decided */
+  guint position;               /* Frames of the queued buffer consumed */
+  gint64 start;                 /* Output frame of the queued buffer */
+  gint64 next_frame;            /* Where the next buffer is expected */
+} KmsMixMinusPad;
+
+typedef struct _KmsMixMinusPadClass
+{
+  GstAggregatorPadClass parent_class;
+} KmsMixMinusPadClass;
+
+static GType kms_mix_minus_pad_get_type (void);
+
+G_DEFINE_TYPE (KmsMixMinusPad, kms_mix_minus_pad, GST_TYPE_AGGREGATOR_PAD);
+
+G_DEFINE_TYPE_WITH_CODE (KmsMixMinus, kms_mix_minus, GST_TYPE_AGGREGATOR,
+    GST_DEBUG_CATEGORY_INIT (kms_mix_minus_debug_category, PLUGIN_NAME,
+        0, "debug category for mixminus element"));
+
+static void
+kms_mix_minus_pad_finalize (GObject * object)
+{
+  KmsMixMinusPad *pad = KMS_MIX_MINUS_PAD (object);
+
+  g_clear_object (&pad->srcpad);
+  g_free (pad->own);
+
+  G_OBJECT_CLASS (kms_mix_minus_pad_parent_class)->finalize (object);
+}
+
+static void
+kms_mix_minus_pad_class_init (KmsMixMinusPadClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = kms_mix_minus_pad_finalize;
+}
+
+static void
+kms_mix_minus_pad_init (KmsMixMinusPad * pad)
+{
+  pad->need_events = TRUE;
+  pad->start = FRAME_NONE;
+  pad->next_frame = FRAME_NONE;
+}
+
+/* Adds one input to the 32 bits mix */
+static void
+kms_mix_minus_accumulate (gint32 * mix, const gint16 * in, gsize n)
+{
+  gsize i = 0;
+
+#ifdef __SSE2__
+  for (; i + 8 <= n; i += 8) {
+    __m128i s = _mm_loadu_si128 ((const __m128i *) (in + i));
+    __m128i *m = (__m128i *) (mix + i);
+
+    /* Sign extension: each sample is duplicated and shifted down */
+    _mm_storeu_si128 (m, _mm_add_epi32 (_mm_loadu_si128 (m),
+            _mm_srai_epi32 (_mm_unpacklo_epi16 (s, s), 16)));
+    _mm_storeu_si128 (m + 1, _mm_add_epi32 (_mm_loadu_si128 (m + 1),
+            _mm_srai_epi32 (_mm_unpackhi_epi16 (s, s), 16)));
+  }
+#endif
+
+  for (; i < n; i++) {
+    mix[i] += in[i];
+  }
+}
+
+/* out = saturate (mix - own). own is NULL when the port sent nothing */
+static void
+kms_mix_minus_subtract (const gint32 * mix, const gint16 * own, gint16 * out,
+    gsize n)
+{
+  gsize i = 0;
+
+#ifdef __SSE2__
+  for (; i + 8 <= n; i += 8) {
+    __m128i lo = _mm_loadu_si128 ((const __m128i *) (mix + i));
+    __m128i hi = _mm_loadu_si128 ((const __m128i *) (mix + i + 4));
+
+    if (own != NULL) {
+      __m128i s = _mm_loadu_si128 ((const __m128i *) (own + i));
+
+      lo = _mm_sub_epi32 (lo, _mm_srai_epi32 (_mm_unpacklo_epi16 (s, s), 16));
+      hi = _mm_sub_epi32 (hi, _mm_srai_epi32 (_mm_unpackhi_epi16 (s, s), 16));
+    }
+
+    _mm_storeu_si128 ((__m128i *) (out + i), _mm_packs_epi32 (lo, hi));
+  }
+#endif
+
+  for (; i < n; i++) {
+    gint32 value = mix[i] - (own != NULL ? own[i] : 0);
+
+    out[i] = CLAMP (value, G_MININT16, G_MAXINT16);
+  }
+}
+
+static void
+kms_mix_minus_push_events (KmsMixMinus * self, KmsMixMinusPad * pad)
+{
+  GstSegment segment;
+  gchar *stream_id;
+
+  stream_id = gst_pad_create_stream_id (pad->srcpad, GST_ELEMENT (self),
+      NULL);
+  gst_pad_push_event (pad->srcpad, gst_event_new_stream_start (stream_id));
+  g_free (stream_id);
+
+  gst_pad_push_event (pad->srcpad, gst_event_new_caps (self->priv->caps));
+
+  /* Output timestamps are running times */
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (pad->srcpad, gst_event_new_segment (&segment));
+
+  pad->need_events = FALSE;
+}
+
+static GList *
+kms_mix_minus_get_pads (KmsMixMinus * self)
+{
+  GList *pads;
+
+  GST_OBJECT_LOCK (self);
+  pads = g_list_copy_deep (GST_ELEMENT (self)->sinkpads,
+      (GCopyFunc) gst_object_ref, NULL);
+  GST_OBJECT_UNLOCK (self);
+
+  return pads;
+}
+
+static gint64
+kms_mix_minus_time_to_frame (KmsMixMinus * self, GstClockTime running_time)
+{
+  KmsMixMinusPrivate *priv = self->priv;
+
+  if (running_time >= priv->base_time) {
+    return gst_util_uint64_scale_int (running_time - priv->base_time,
+        priv->rate, GST_SECOND);
+  }
+
+  return -(gint64) gst_util_uint64_scale_int (priv->base_time - running_time,
+      priv->rate, GST_SECOND);
+}
+
+static GstClockTime
+kms_mix_minus_buffer_running_time (KmsMixMinusPad * pad, GstBuffer * buffer)
+{
+  GstClockTime running_time = GST_CLOCK_TIME_NONE;
+
+  if (GST_BUFFER_PTS_IS_VALID (buffer)) {
+    GST_OBJECT_LOCK (pad);
+    running_time =
+        gst_segment_to_running_time (&GST_AGGREGATOR_PAD (pad)->segment,
+        GST_FORMAT_TIME, GST_BUFFER_PTS (buffer));
+    GST_OBJECT_UNLOCK (pad);
+  }
+
+  return running_time;
+}
+
+/* Output frame where a new buffer starts */
+static gint64
+kms_mix_minus_buffer_start (KmsMixMinus * self, KmsMixMinusPad * pad,
+    GstBuffer * buffer)
+{
+  GstClockTime running_time;
+  gint64 start;
+
+  running_time = kms_mix_minus_buffer_running_time (pad, buffer);
+
+  if (!GST_CLOCK_TIME_IS_VALID (running_time)) {
+    /* Contiguous with the previous one */
+    return pad->next_frame != FRAME_NONE ? pad->next_frame :
+        (gint64) self->priv->offset;
+  }
+
+  start = kms_mix_minus_time_to_frame (self, running_time);
+
+  if (pad->next_frame != FRAME_NONE &&
+      ABS (start - pad->next_frame) < self->priv->threshold) {
+    start = pad->next_frame;
+  }
+
+  return start;
+}
+
+/* Sets the start of the output from the earliest data available, or from */
+/* the current time if no input has sent anything yet */
+static void
+kms_mix_minus_init_base_time (KmsMixMinus * self, GList * pads)
+{
+  GstClockTime base_time = GST_CLOCK_TIME_NONE;
+  GstClock *clock;
+  GList *l;
+
+  for (l = pads; l != NULL; l = l->next) {
+    GstBuffer *buffer = gst_aggregator_pad_get_buffer (l->data);
+    GstClockTime running_time;
+
+    if (buffer == NULL) {
+      continue;
+    }
+
+    running_time = kms_mix_minus_buffer_running_time (l->data, buffer);
+    gst_buffer_unref (buffer);
+
+    if (GST_CLOCK_TIME_IS_VALID (running_time) &&
+        (!GST_CLOCK_TIME_IS_VALID (base_time) || running_time < base_time)) {
+      base_time = running_time;
+    }
+  }
+
+  clock = gst_element_get_clock (GST_ELEMENT (self));
+
+  if (!GST_CLOCK_TIME_IS_VALID (base_time) && clock != NULL) {
+    GstClockTime now = gst_clock_get_time (clock);
+    GstClockTime element_base = gst_element_get_base_time (GST_ELEMENT (self));
+
+    base_time = now > element_base ? now - element_base : 0;
+  }
+
+  if (clock != NULL) {
+    gst_object_unref (clock);
+  }
+
+  GST_OBJECT_LOCK (self);
+  self->priv->base_time = GST_CLOCK_TIME_IS_VALID (base_time) ? base_time : 0;
+  self->priv->offset = 0;
+  GST_OBJECT_UNLOCK (self);
+
+  GST_DEBUG_OBJECT (self, "Output starts at %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (self->priv->base_time));
+}
+
+/* Adds the data of a pad to the current period. Returns TRUE when the pad */
+/* has nothing more to give to it. */
+static gboolean
+kms_mix_minus_fill_pad (KmsMixMinus * self, KmsMixMinusPad * pad)
+{
+  GstAggregatorPad *aggpad = GST_AGGREGATOR_PAD (pad);
+  KmsMixMinusPrivate *priv = self->priv;
+  gint64 period_start = priv->offset;
+  gint channels = priv->channels;
+
+  while (pad->filled < priv->period) {
+    GstBuffer *buffer = gst_aggregator_pad_get_buffer (aggpad);
+    guint frames, skip = 0, n = 0, dst;
+    gint64 start;
+
+    if (buffer == NULL) {
+      return gst_aggregator_pad_is_eos (aggpad);
+    }
+
+    frames = gst_buffer_get_size (buffer) / priv->bpf;
+
+    if (pad->position == 0) {
+      pad->start = kms_mix_minus_buffer_start (self, pad, buffer);
+    }
+
+    start = pad->start + pad->position;
+
+    if (start >= period_start + priv->period) {
+      /* Belongs to a later period */
+      gst_buffer_unref (buffer);
+      return TRUE;
+    }
+
+    /* Late data is dropped */
+    if (start < period_start + pad->filled) {
+      skip = MIN (period_start + pad->filled - start, frames - pad->position);
+    }
+
+    dst = start + skip - period_start;
+    n = MIN (frames - pad->position - skip, priv->period - dst);
+
+    if (n > 0) {
+      GstMapInfo info;
+
+      if (gst_buffer_map (buffer, &info, GST_MAP_READ)) {
+        const gint16 *in = (const gint16 *) info.data +
+            (pad->position + skip) * channels;
+
+        if (pad->own == NULL) {
+          pad->own = g_new (gint16, priv->period * channels);
+        }
+
+        if (!pad->has_own) {
+          memset (pad->own, 0, priv->period * channels * sizeof (gint16));
+          pad->has_own = TRUE;
+        }
+
+        memcpy (pad->own + dst * channels, in, n * channels * sizeof (gint16));
+        kms_mix_minus_accumulate (priv->mix + dst * channels, in,
+            n * channels);
+        gst_buffer_unmap (buffer, &info);
+      }
+
+      pad->filled = dst + n;
+    }
+
+    pad->position += skip + n;
+    gst_buffer_unref (buffer);
+
+    if (pad->position >= frames) {
+      pad->next_frame = pad->start + frames;
+      pad->position = 0;
+      gst_aggregator_pad_drop_buffer (aggpad);
+    }
+  }
+
+  return TRUE;
+}
+
+static GstFlowReturn
+kms_mix_minus_push_eos (KmsMixMinus * self, GList * pads)
+{
+  GList *l;
+
+  GST_DEBUG_OBJECT (self, "All inputs are EOS");
+
+  for (l = pads; l != NULL; l = l->next) {
+    KmsMixMinusPad *pad = l->data;
+
+    gst_pad_push_event (pad->srcpad, gst_event_new_eos ());
+  }
+
+  return GST_FLOW_EOS;
+}
+
+static GstBuffer *
+kms_mix_minus_create_output (KmsMixMinus * self, const gint16 * own)
+{
+  KmsMixMinusPrivate *priv = self->priv;
+  gsize n = priv->period * priv->channels;
+  GstBuffer *outbuf;
+  GstMapInfo info;
+
+  outbuf = gst_buffer_new_allocate (NULL, n * sizeof (gint16), NULL);
+  gst_buffer_map (outbuf, &info, GST_MAP_WRITE);
+  kms_mix_minus_subtract (priv->mix, own, (gint16 *) info.data, n);
+  gst_buffer_unmap (outbuf, &info);
+
+  GST_BUFFER_PTS (outbuf) = priv->base_time +
+      gst_util_uint64_scale_int (priv->offset, GST_SECOND, priv->rate);
+  GST_BUFFER_DURATION (outbuf) = priv->base_time +
+      gst_util_uint64_scale_int (priv->offset + priv->period, GST_SECOND,
+      priv->rate) - GST_BUFFER_PTS (outbuf);
+
+  return outbuf;
+}
+
+/* Pushes the current period to every output and starts the next one */
+static GstFlowReturn
+kms_mix_minus_push_period (KmsMixMinus * self, GList * pads)
+{
+  GstAggregator *agg = GST_AGGREGATOR (self);
+  KmsMixMinusPrivate *priv = self->priv;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GList *l;
+
+  for (l = pads; l != NULL; l = l->next) {
+    KmsMixMinusPad *pad = l->data;
+    GstFlowReturn pad_ret;
+
+    if (pad->need_events) {
+      kms_mix_minus_push_events (self, pad);
+    }
+
+    /* A participant that is not listening must not stop the others */
+    pad_ret = gst_pad_push (pad->srcpad, kms_mix_minus_create_output (self,
+            pad->has_own ? pad->own : NULL));
+
+    if (pad_ret != GST_FLOW_OK) {
+      GST_LOG_OBJECT (pad->srcpad, "Push returned %s",
+          gst_flow_get_name (pad_ret));
+    }
+
+    pad->has_own = FALSE;
+    pad->filled = 0;
+  }
+
+  if (gst_pad_is_linked (agg->srcpad)) {
+    ret = gst_aggregator_finish_buffer (agg,
+        kms_mix_minus_create_output (self, NULL));
+
+    if (ret == GST_FLOW_NOT_LINKED) {
+      ret = GST_FLOW_OK;
+    }
+  }
+
+  memset (priv->mix, 0, priv->period * priv->channels * sizeof (gint32));
+
+  GST_OBJECT_LOCK (self);
+  priv->offset += priv->period;
+  GST_OBJECT_UNLOCK (self);
+
+  return ret;
+}
+
+static GstFlowReturn
+kms_mix_minus_aggregate (GstAggregator * agg, gboolean timeout)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (agg);
+  KmsMixMinusPrivate *priv = self->priv;
+  gboolean complete = TRUE, pending = FALSE, eos;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GList *pads, *l;
+
+  pads = kms_mix_minus_get_pads (self);
+  eos = pads != NULL;
+
+  for (l = pads; l != NULL && eos; l = l->next) {
+    GstAggregatorPad *aggpad = l->data;
+    GstBuffer *buffer = gst_aggregator_pad_get_buffer (aggpad);
+
+    if (buffer != NULL) {
+      gst_buffer_unref (buffer);
+      eos = FALSE;
+    } else {
+      eos = gst_aggregator_pad_is_eos (aggpad);
+    }
+  }
+
+  /* Caps can not change once set, so they are safe to use from here */
+  if (g_atomic_int_get (&priv->bpf) == 0) {
+    if (eos) {
+      ret = kms_mix_minus_push_eos (self, pads);
+    }
+
+    goto end;
+  }
+
+  if (!GST_CLOCK_TIME_IS_VALID (priv->base_time)) {
+    kms_mix_minus_init_base_time (self, pads);
+  }
+
+  for (l = pads; l != NULL; l = l->next) {
+    KmsMixMinusPad *pad = l->data;
+
+    complete &= kms_mix_minus_fill_pad (self, pad);
+    pending |= pad->filled > 0;
+  }
+
+  if (eos) {
+    /* Whatever the inputs left in the last period goes out first */
+    if (pending) {
+      kms_mix_minus_push_period (self, pads);
+    }
+
+    ret = kms_mix_minus_push_eos (self, pads);
+    goto end;
+  }
+
+  /* Live inputs are only waited for until the deadline of the period */
+  if (complete || timeout) {
+    ret = kms_mix_minus_push_period (self, pads);
+  }
+
+end:
+  g_list_free_full (pads, gst_object_unref);
+
+  return ret;
+}
+
+/* Start of the period being mixed, the aggregator waits for live inputs */
+/* until it plus the latency */
+static GstClockTime
+kms_mix_minus_get_next_time (GstAggregator * agg)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (agg);
+  KmsMixMinusPrivate *priv = self->priv;
+  GstClockTime next;
+
+  GST_OBJECT_LOCK (self);
+
+  if (priv->bpf == 0) {
+    /* Nothing to produce until an input negotiates */
+    next = GST_CLOCK_TIME_NONE;
+  } else if (!GST_CLOCK_TIME_IS_VALID (priv->base_time)) {
+    next = 0;
+  } else {
+    next = priv->base_time + gst_util_uint64_scale_int (priv->offset,
+        GST_SECOND, priv->rate);
+  }
+
+  GST_OBJECT_UNLOCK (self);
+
+  return next;
+}
+
+static gboolean
+kms_mix_minus_set_caps (KmsMixMinus * self, GstPad * pad, GstCaps * caps)
+{
+  GstStructure *st = gst_caps_get_structure (caps, 0);
+  KmsMixMinusPrivate *priv = self->priv;
+  gint rate, channels;
+
+  GST_OBJECT_LOCK (self);
+
+  if (priv->caps != NULL) {
+    gboolean equal = gst_caps_is_equal (priv->caps, caps);
+
+    GST_OBJECT_UNLOCK (self);
+
+    if (!equal) {
+      GST_WARNING_OBJECT (pad, "Caps %" GST_PTR_FORMAT
+          " differ from the mix ones", caps);
+    }
+
+    return equal;
+  }
+
+  if (!gst_structure_get_int (st, "rate", &rate) ||
+      !gst_structure_get_int (st, "channels", &channels)) {
+    GST_OBJECT_UNLOCK (self);
+    return FALSE;
+  }
+
+  priv->caps = gst_caps_ref (caps);
+  priv->rate = rate;
+  priv->channels = channels;
+  priv->period = MAX (gst_util_uint64_scale_int (MIX_MINUS_PERIOD, rate,
+          GST_SECOND), 1);
+  priv->threshold = gst_util_uint64_scale_int (MIX_MINUS_ALIGNMENT_THRESHOLD,
+      rate, GST_SECOND);
+  priv->mix = g_new0 (gint32, priv->period * channels);
+
+  /* Later inputs are checked against the caps from here on, but nothing */
+  /* is mixed until the output has them too */
+  GST_OBJECT_UNLOCK (self);
+
+  GST_DEBUG_OBJECT (self, "Mixing with caps %" GST_PTR_FORMAT, caps);
+
+  gst_aggregator_set_src_caps (GST_AGGREGATOR (self), caps);
+  g_atomic_int_set (&priv->bpf, channels * sizeof (gint16));
+
+  return TRUE;
+}
+
+static gboolean
+kms_mix_minus_sink_event (GstAggregator * agg, GstAggregatorPad * aggpad,
+    GstEvent * event)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (agg);
+  GstCaps *caps;
+  gboolean ret;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CAPS) {
+    return GST_AGGREGATOR_CLASS (kms_mix_minus_parent_class)->sink_event (agg,
+        aggpad, event);
+  }
+
+  gst_event_parse_caps (event, &caps);
+  ret = kms_mix_minus_set_caps (self, GST_PAD (aggpad), caps);
+  gst_event_unref (event);
+
+  return ret;
+}
+
+static gboolean
+kms_mix_minus_sink_query (GstAggregator * agg, GstAggregatorPad * aggpad,
+    GstQuery * query)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (agg);
+  GstCaps *filter, *caps;
+
+  if (GST_QUERY_TYPE (query) != GST_QUERY_CAPS) {
+    return GST_AGGREGATOR_CLASS (kms_mix_minus_parent_class)->sink_query (agg,
+        aggpad, query);
+  }
+
+  gst_query_parse_caps (query, &filter);
+
+  GST_OBJECT_LOCK (self);
+  if (self->priv->caps != NULL) {
+    caps = gst_caps_ref (self->priv->caps);
+  } else {
+    caps = gst_pad_get_pad_template_caps (GST_PAD (aggpad));
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (filter != NULL) {
+    GstCaps *intersection;
+
+    intersection = gst_caps_intersect_full (filter, caps,
+        GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref (caps);
+    caps = intersection;
+  }
+
+  gst_query_set_caps_result (query, caps);
+  gst_caps_unref (caps);
+
+  return TRUE;
+}
+
+static gboolean
+kms_mix_minus_output_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  GstAggregator *agg = GST_AGGREGATOR (parent);
+
+  /* Every output has the latency of the whole mix */
+  if (GST_QUERY_TYPE (query) == GST_QUERY_LATENCY) {
+    return gst_pad_query (agg->srcpad, query);
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static GstAggregatorPad *
+kms_mix_minus_create_new_pad (GstAggregator * agg, GstPadTemplate * templ,
+    const gchar * req_name, const GstCaps * caps)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (agg);
+  GstAggregatorPad *aggpad;
+  KmsMixMinusPad *pad;
+  GstPad *srcpad;
+  gchar *srcname;
+  guint id;
+
+  aggpad = GST_AGGREGATOR_CLASS (kms_mix_minus_parent_class)->create_new_pad
+      (agg, templ, req_name, caps);
+
+  if (aggpad == NULL) {
+    return NULL;
+  }
+
+  pad = KMS_MIX_MINUS_PAD (aggpad);
+
+  if (sscanf (GST_OBJECT_NAME (aggpad), SINK_PAD_PREFIX "%u", &id) != 1) {
+    GST_ERROR_OBJECT (self, "Unexpected pad name %s", GST_OBJECT_NAME (aggpad));
+    gst_object_unref (aggpad);
+    return NULL;
+  }
+
+  srcname = g_strdup_printf (SRC_PAD_NAME, id);
+  srcpad = gst_pad_new_from_static_template (&src_factory, srcname);
+  g_free (srcname);
+
+  gst_pad_use_fixed_caps (srcpad);
+  gst_pad_set_query_function (srcpad, kms_mix_minus_output_query);
+  pad->srcpad = g_object_ref (srcpad);
+
+  /* Output goes first, so it can be linked as soon as the input appears */
+  if (!gst_element_add_pad (GST_ELEMENT (self), srcpad)) {
+    GST_ERROR_OBJECT (self, "Can not add pad %" GST_PTR_FORMAT, srcpad);
+    gst_object_unref (aggpad);
+    return NULL;
+  }
+
+  GST_DEBUG_OBJECT (self, "Added input %u", id);
+
+  return aggpad;
+}
+
+static void
+kms_mix_minus_release_pad (GstElement * element, GstPad * pad)
+{
+  KmsMixMinusPad *mix_pad = KMS_MIX_MINUS_PAD (pad);
+  GstPad *srcpad = g_object_ref (mix_pad->srcpad);
+
+  GST_ELEMENT_CLASS (kms_mix_minus_parent_class)->release_pad (element, pad);
+
+  gst_pad_set_active (srcpad, FALSE);
+  gst_element_remove_pad (element, srcpad);
+  g_object_unref (srcpad);
+}
+
+static gboolean
+kms_mix_minus_start (GstAggregator * agg)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (agg);
+  GList *pads, *l;
+
+  GST_OBJECT_LOCK (self);
+  self->priv->base_time = GST_CLOCK_TIME_NONE;
+  self->priv->offset = 0;
+  GST_OBJECT_UNLOCK (self);
+
+  pads = kms_mix_minus_get_pads (self);
+
+  for (l = pads; l != NULL; l = l->next) {
+    KmsMixMinusPad *pad = l->data;
+
+    pad->has_own = FALSE;
+    pad->filled = pad->position = 0;
+    pad->start = pad->next_frame = FRAME_NONE;
+  }
+
+  g_list_free_full (pads, gst_object_unref);
+
+  return TRUE;
+}
+
+static void
+kms_mix_minus_finalize (GObject * object)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (object);
+
+  if (self->priv->caps != NULL) {
+    gst_caps_unref (self->priv->caps);
+  }
+
+  g_free (self->priv->mix);
+
+  G_OBJECT_CLASS (kms_mix_minus_parent_class)->finalize (object);
+}
+
+static void
+kms_mix_minus_class_init (KmsMixMinusClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GstAggregatorClass *aggregator_class = GST_AGGREGATOR_CLASS (klass);
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "MixMinus", "Generic/Audio", "Mixes n audio inputs giving each input"
+      " the mix of all the others", "Kurento <kurento@googlegroups.com>");
+
+  gobject_class->finalize = GST_DEBUG_FUNCPTR (kms_mix_minus_finalize);
+
+  gstelement_class->release_pad = GST_DEBUG_FUNCPTR (kms_mix_minus_release_pad);
+
+  aggregator_class->sinkpads_type = KMS_TYPE_MIX_MINUS_PAD;
+  aggregator_class->create_new_pad =
+      GST_DEBUG_FUNCPTR (kms_mix_minus_create_new_pad);
+  aggregator_class->sink_event = GST_DEBUG_FUNCPTR (kms_mix_minus_sink_event);
+  aggregator_class->sink_query = GST_DEBUG_FUNCPTR (kms_mix_minus_sink_query);
+  aggregator_class->aggregate = GST_DEBUG_FUNCPTR (kms_mix_minus_aggregate);
+  aggregator_class->get_next_time =
+      GST_DEBUG_FUNCPTR (kms_mix_minus_get_next_time);
+  aggregator_class->start = GST_DEBUG_FUNCPTR (kms_mix_minus_start);
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sink_factory));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&src_factory));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&mix_src_factory));
+
+  /* Registers a private structure for the instantiatable type */
+  g_type_class_add_private (klass, sizeof (KmsMixMinusPrivate));
+}
+
+static void
+kms_mix_minus_init (KmsMixMinus * self)
+{
+  self->priv = KMS_MIX_MINUS_GET_PRIVATE (self);
+
+  self->priv->base_time = GST_CLOCK_TIME_NONE;
+}
+
+gboolean
+kms_mix_minus_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, PLUGIN_NAME, GST_RANK_NONE,
+      KMS_TYPE_MIX_MINUS);
+}
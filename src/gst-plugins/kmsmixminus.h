@@ -0,0 +1,85 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _KMS_MIX_MINUS_H_
+#define _KMS_MIX_MINUS_H_
+
+#include <gst/gst.h>
+
+#ifndef GST_USE_UNSTABLE_API
+#define GST_USE_UNSTABLE_API
+#endif
+#include <gst/base/gstaggregator.h>
+
+G_BEGIN_DECLS
+#define KMS_TYPE_MIX_MINUS kms_mix_minus_get_type()
+#define KMS_MIX_MINUS(obj) (            \
+  G_TYPE_CHECK_INSTANCE_CAST(           \
+    (obj),                              \
+    KMS_TYPE_MIX_MINUS,                 \
+    KmsMixMinus                         \
+  )                                     \
+)
+#define KMS_MIX_MINUS_CLASS(klass) (    \
+  G_TYPE_CHECK_CLASS_CAST (             \
+    (klass),                            \
+    KMS_TYPE_MIX_MINUS,                 \
+    KmsMixMinusClass                    \
+  )                                     \
+)
+#define KMS_IS_MIX_MINUS(obj) (         \
+  G_TYPE_CHECK_INSTANCE_TYPE (          \
+    (obj),                              \
+    KMS_TYPE_MIX_MINUS                  \
+  )                                     \
+)
+#define KMS_IS_MIX_MINUS_CLASS(klass) ( \
+  G_TYPE_CHECK_CLASS_TYPE((klass),      \
+  KMS_TYPE_MIX_MINUS)                   \
+)
+
+typedef struct _KmsMixMinus KmsMixMinus;
+typedef struct _KmsMixMinusClass KmsMixMinusClass;
+typedef struct _KmsMixMinusPrivate KmsMixMinusPrivate;
+
+/*
+ * Audio mixer with one output per input. Output "src_N" carries the mix of
+ * every input but "sink_N", and "src" the mix of all of them. The total is
+ * computed once per period and each output only subtracts its own input from
+ * it, so the cost grows linearly with the number of participants.
+ *
+ * Inputs are placed by timestamp. Live inputs that have no data when the
+ * latency deadline of a period expires count as silence for that period.
+ */
+struct _KmsMixMinus
+{
+  GstAggregator parent;
+
+  /*< private > */
+  KmsMixMinusPrivate *priv;
+};
+
+struct _KmsMixMinusClass
+{
+  GstAggregatorClass parent_class;
+};
+
+GType kms_mix_minus_get_type (void);
+
+gboolean kms_mix_minus_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+#endif /* _KMS_MIX_MINUS_H_ */
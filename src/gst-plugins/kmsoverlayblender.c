@@ -0,0 +1,1211 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "kmsoverlayblender.h"
+#include <gst/video/video.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__)) && \
+  (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define KMS_OVERLAY_BLENDER_AVX2
+#include <immintrin.h>
+#endif
+
+#define PLUGIN_NAME "overlayblender"
+
+GST_DEBUG_CATEGORY_STATIC (kms_overlay_blender_debug_category);
+#define GST_CAT_DEFAULT kms_overlay_blender_debug_category
+
+#define KMS_OVERLAY_BLENDER_GET_PRIVATE(obj) ( \
+  G_TYPE_INSTANCE_GET_PRIVATE (                \
+    (obj),                                     \
+    KMS_TYPE_OVERLAY_BLENDER,                  \
+    KmsOverlayBlenderPrivate                   \
+  )                                            \
+)
+
+#define SINK_PAD_PREFIX "sink_"
+
+#define DEFAULT_PAD_XPOS 0
+#define DEFAULT_PAD_YPOS 0
+#define DEFAULT_PAD_ZORDER 0
+#define DEFAULT_PAD_ALPHA 1.0
+#define DEFAULT_PAD_MASTER FALSE
+
+static GstStaticPadTemplate sink_factory =
+GST_STATIC_PAD_TEMPLATE (SINK_PAD_PREFIX "%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ I420, AYUV }"))
+    );
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("I420"))
+    );
+
+typedef enum
+{
+  KMS_OVERLAY_ALPHA_MIXED,
+  KMS_OVERLAY_ALPHA_OPAQUE,
+  KMS_OVERLAY_ALPHA_TRANSPARENT
+} KmsOverlayAlpha;
+
+/* Sink pads */
+
+#define KMS_TYPE_OVERLAY_BLENDER_PAD kms_overlay_blender_pad_get_type()
+#define KMS_OVERLAY_BLENDER_PAD(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+  KMS_TYPE_OVERLAY_BLENDER_PAD, KmsOverlayBlenderPad))
+
+typedef struct _KmsOverlayBlenderPad
+{
+  GstPad parent;
+
+  /* Properties, protected by the pad lock */
+  gint xpos;
+  gint ypos;
+  guint zorder;
+  gdouble alpha;
+  gboolean master;
+
+  /* Protected by the element lock */
+  GstCaps *caps;
+  GstVideoInfo info;
+  GstSegment segment;
+  gboolean eos;
+  GstBuffer *buffer;            /* Latest frame, only kept for overlays */
+  KmsOverlayAlpha alpha_class;
+} KmsOverlayBlenderPad;
+
+typedef struct _KmsOverlayBlenderPadClass
+{
+  GstPadClass parent_class;
+} KmsOverlayBlenderPadClass;
+
+enum
+{
+  PROP_PAD_0,
+  PROP_PAD_XPOS,
+  PROP_PAD_YPOS,
+  PROP_PAD_ZORDER,
+  PROP_PAD_ALPHA,
+  PROP_PAD_MASTER
+};
+
+GType kms_overlay_blender_pad_get_type (void);
+
+G_DEFINE_TYPE (KmsOverlayBlenderPad, kms_overlay_blender_pad, GST_TYPE_PAD);
+
+static void
+kms_overlay_blender_pad_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsOverlayBlenderPad *pad = KMS_OVERLAY_BLENDER_PAD (object);
+
+  GST_OBJECT_LOCK (pad);
+  switch (property_id) {
+    case PROP_PAD_XPOS:
+      pad->xpos = g_value_get_int (value);
+      break;
+    case PROP_PAD_YPOS:
+      pad->ypos = g_value_get_int (value);
+      break;
+    case PROP_PAD_ZORDER:
+      pad->zorder = g_value_get_uint (value);
+      break;
+    case PROP_PAD_ALPHA:
+      pad->alpha = g_value_get_double (value);
+      break;
+    case PROP_PAD_MASTER:
+      pad->master = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (pad);
+}
+
+static void
+kms_overlay_blender_pad_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsOverlayBlenderPad *pad = KMS_OVERLAY_BLENDER_PAD (object);
+
+  GST_OBJECT_LOCK (pad);
+  switch (property_id) {
+    case PROP_PAD_XPOS:
+      g_value_set_int (value, pad->xpos);
+      break;
+    case PROP_PAD_YPOS:
+      g_value_set_int (value, pad->ypos);
+      break;
+    case PROP_PAD_ZORDER:
+      g_value_set_uint (value, pad->zorder);
+      break;
+    case PROP_PAD_ALPHA:
+      g_value_set_double (value, pad->alpha);
+      break;
+    case PROP_PAD_MASTER:
+      g_value_set_boolean (value, pad->master);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (pad);
+}
+
+static void
+kms_overlay_blender_pad_finalize (GObject * object)
+{
+  KmsOverlayBlenderPad *pad = KMS_OVERLAY_BLENDER_PAD (object);
+
+  gst_buffer_replace (&pad->buffer, NULL);
+  gst_caps_replace (&pad->caps, NULL);
+
+  G_OBJECT_CLASS (kms_overlay_blender_pad_parent_class)->finalize (object);
+}
+
+static void
+kms_overlay_blender_pad_class_init (KmsOverlayBlenderPadClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->set_property = kms_overlay_blender_pad_set_property;
+  gobject_class->get_property = kms_overlay_blender_pad_get_property;
+  gobject_class->finalize = kms_overlay_blender_pad_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_PAD_XPOS,
+      g_param_spec_int ("xpos", "X Position", "X position of the frame",
+          G_MININT, G_MAXINT, DEFAULT_PAD_XPOS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PAD_YPOS,
+      g_param_spec_int ("ypos", "Y Position", "Y position of the frame",
+          G_MININT, G_MAXINT, DEFAULT_PAD_YPOS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PAD_ZORDER,
+      g_param_spec_uint ("zorder", "Z-Order", "Z order of the frame",
+          0, G_MAXUINT, DEFAULT_PAD_ZORDER,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PAD_ALPHA,
+      g_param_spec_double ("alpha", "Alpha", "Alpha of the frame",
+          0.0, 1.0, DEFAULT_PAD_ALPHA,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PAD_MASTER,
+      g_param_spec_boolean ("master", "Master",
+          "Frames of this pad are the base of the output", DEFAULT_PAD_MASTER,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+kms_overlay_blender_pad_init (KmsOverlayBlenderPad * pad)
+{
+  pad->xpos = DEFAULT_PAD_XPOS;
+  pad->ypos = DEFAULT_PAD_YPOS;
+  pad->zorder = DEFAULT_PAD_ZORDER;
+  pad->alpha = DEFAULT_PAD_ALPHA;
+  pad->master = DEFAULT_PAD_MASTER;
+
+  gst_video_info_init (&pad->info);
+  gst_segment_init (&pad->segment, GST_FORMAT_TIME);
+}
+
+/* Element */
+
+typedef struct _KmsOverlayBlenderLayer
+{
+  GstBuffer *buffer;
+  GstVideoInfo info;
+  guint index;                  /* Breaks zorder ties */
+  guint zorder;
+  gint alpha;                   /* [0, 256] */
+  gboolean opaque;
+
+  /* In output coordinates, the rectangle may be partially outside */
+  gint x;
+  gint y;
+  gint width;
+  gint height;
+} KmsOverlayBlenderLayer;
+
+struct _KmsOverlayBlenderPrivate
+{
+  GstPad *srcpad;
+  guint next_id;
+
+  /* Serializes output, base frames can come from several streaming threads */
+  /* while the driving pad changes */
+  GMutex push_lock;
+  /* Held while layers are collected, and to change several pads at once */
+  GMutex layout_lock;
+  GArray *layers;
+  gboolean need_stream_start;
+  gboolean need_segment;
+  GstCaps *caps;
+};
+
+G_DEFINE_TYPE_WITH_CODE (KmsOverlayBlender, kms_overlay_blender,
+    GST_TYPE_ELEMENT,
+    GST_DEBUG_CATEGORY_INIT (kms_overlay_blender_debug_category, PLUGIN_NAME,
+        0, "debug category for overlayblender element"));
+
+/* Blending kernels. Overlay alpha a in [0, 255] is scaled to [0, 256] so */
+/* that opaque pixels are copied exactly, then it is multiplied by the pad */
+/* alpha g in [0, 256]: out = (src * a + dst * (256 - a)) >> 8, which never */
+/* overflows 16 bits */
+
+typedef void (*KmsBlendLumaFunc) (guint8 * dst, const guint8 * ayuv, gint n,
+    guint g);
+typedef void (*KmsBlendChromaFunc) (guint8 * u, guint8 * v,
+    const guint8 * ayuv, gint n, guint g);
+
+static inline guint
+kms_blend_alpha (guint a, guint g)
+{
+  a += a >> 7;
+
+  return g >= 256 ? a : (a * g) >> 8;
+}
+
+static void
+kms_blend_luma_c (guint8 * dst, const guint8 * ayuv, gint n, guint g)
+{
+  gint i;
+
+  for (i = 0; i < n; i++) {
+    const guint8 *p = ayuv + 4 * i;
+    guint a = kms_blend_alpha (p[0], g);
+
+    if (a != 0) {
+      dst[i] = (p[1] * a + dst[i] * (256 - a)) >> 8;
+    }
+  }
+}
+
+/* Chroma takes the top left pixel of each 2x2 block */
+static void
+kms_blend_chroma_c (guint8 * u, guint8 * v, const guint8 * ayuv, gint n,
+    guint g)
+{
+  gint i;
+
+  for (i = 0; i < n; i++) {
+    const guint8 *p = ayuv + 8 * i;
+    guint a = kms_blend_alpha (p[0], g);
+
+    if (a != 0) {
+      u[i] = (p[2] * a + u[i] * (256 - a)) >> 8;
+      v[i] = (p[3] * a + v[i] * (256 - a)) >> 8;
+    }
+  }
+}
+
+#ifdef __SSE2__
+static inline __m128i
+kms_blend_sse2 (__m128i src, __m128i dst, __m128i a)
+{
+  return _mm_srli_epi16 (_mm_add_epi16 (_mm_mullo_epi16 (src, a),
+          _mm_mullo_epi16 (dst, _mm_sub_epi16 (_mm_set1_epi16 (256), a))), 8);
+}
+
+static inline __m128i
+kms_blend_alpha_sse2 (__m128i a, guint g)
+{
+  a = _mm_add_epi16 (a, _mm_srli_epi16 (a, 7));
+
+  if (g < 256) {
+    a = _mm_srli_epi16 (_mm_mullo_epi16 (a, _mm_set1_epi16 (g)), 8);
+  }
+
+  return a;
+}
+
+/* 8 pixels per iteration */
+static void
+kms_blend_luma_sse2 (guint8 * dst, const guint8 * ayuv, gint n, guint g)
+{
+  const __m128i mask = _mm_set1_epi32 (0xff);
+  const __m128i zero = _mm_setzero_si128 ();
+  gint i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i p0 = _mm_loadu_si128 ((const __m128i *) (ayuv + 4 * i));
+    __m128i p1 = _mm_loadu_si128 ((const __m128i *) (ayuv + 4 * i + 16));
+    __m128i a, y, d;
+
+    a = _mm_packs_epi32 (_mm_and_si128 (p0, mask), _mm_and_si128 (p1, mask));
+    a = kms_blend_alpha_sse2 (a, g);
+
+    if (_mm_movemask_epi8 (_mm_cmpeq_epi16 (a, zero)) == 0xffff) {
+      continue;
+    }
+
+    y = _mm_packs_epi32 (_mm_and_si128 (_mm_srli_epi32 (p0, 8), mask),
+        _mm_and_si128 (_mm_srli_epi32 (p1, 8), mask));
+    d = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) (dst + i)),
+        zero);
+    d = kms_blend_sse2 (y, d, a);
+    _mm_storel_epi64 ((__m128i *) (dst + i), _mm_packus_epi16 (d, d));
+  }
+
+  kms_blend_luma_c (dst + i, ayuv + 4 * i, n - i, g);
+}
+
+/* 8 chroma samples, 16 pixels, per iteration */
+static void
+kms_blend_chroma_sse2 (guint8 * u, guint8 * v, const guint8 * ayuv, gint n,
+    guint g)
+{
+  const __m128i mask = _mm_set1_epi32 (0xff);
+  const __m128i zero = _mm_setzero_si128 ();
+  gint i = 0;
+
+  /* The last odd pixel of the row may not exist, so it is never loaded */
+  for (; i + 8 < n; i += 8) {
+    const guint8 *p = ayuv + 8 * i;
+    __m128i e0, e1, a, cu, cv, d;
+
+    /* Even pixels */
+    e0 = _mm_unpacklo_epi64 (_mm_shuffle_epi32 (_mm_loadu_si128 ((const
+                    __m128i *) p), _MM_SHUFFLE (2, 0, 2, 0)),
+        _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i *) (p + 16)),
+            _MM_SHUFFLE (2, 0, 2, 0)));
+    e1 = _mm_unpacklo_epi64 (_mm_shuffle_epi32 (_mm_loadu_si128 ((const
+                    __m128i *) (p + 32)), _MM_SHUFFLE (2, 0, 2, 0)),
+        _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i *) (p + 48)),
+            _MM_SHUFFLE (2, 0, 2, 0)));
+
+    a = _mm_packs_epi32 (_mm_and_si128 (e0, mask), _mm_and_si128 (e1, mask));
+    a = kms_blend_alpha_sse2 (a, g);
+
+    if (_mm_movemask_epi8 (_mm_cmpeq_epi16 (a, zero)) == 0xffff) {
+      continue;
+    }
+
+    cu = _mm_packs_epi32 (_mm_and_si128 (_mm_srli_epi32 (e0, 16), mask),
+        _mm_and_si128 (_mm_srli_epi32 (e1, 16), mask));
+    cv = _mm_packs_epi32 (_mm_srli_epi32 (e0, 24), _mm_srli_epi32 (e1, 24));
+
+    d = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) (u + i)), zero);
+    d = kms_blend_sse2 (cu, d, a);
+    _mm_storel_epi64 ((__m128i *) (u + i), _mm_packus_epi16 (d, d));
+
+    d = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) (v + i)), zero);
+    d = kms_blend_sse2 (cv, d, a);
+    _mm_storel_epi64 ((__m128i *) (v + i), _mm_packus_epi16 (d, d));
+  }
+
+  kms_blend_chroma_c (u + i, v + i, ayuv + 8 * i, n - i, g);
+}
+#endif
+
+#ifdef KMS_OVERLAY_BLENDER_AVX2
+/* 16 pixels per iteration. Packing works per 128 bits lane, so 64 bits */
+/* blocks are reordered after each pack */
+__attribute__ ((target ("avx2")))
+static void
+kms_blend_luma_avx2 (guint8 * dst, const guint8 * ayuv, gint n, guint g)
+{
+  const __m256i mask = _mm256_set1_epi32 (0xff);
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i c256 = _mm256_set1_epi16 (256);
+  const __m256i gv = _mm256_set1_epi16 (g);
+  gint i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m256i p0 = _mm256_loadu_si256 ((const __m256i *) (ayuv + 4 * i));
+    __m256i p1 = _mm256_loadu_si256 ((const __m256i *) (ayuv + 4 * i + 32));
+    __m256i a, y, d;
+
+    a = _mm256_permute4x64_epi64 (_mm256_packs_epi32 (_mm256_and_si256 (p0,
+                mask), _mm256_and_si256 (p1, mask)), 0xd8);
+    a = _mm256_add_epi16 (a, _mm256_srli_epi16 (a, 7));
+
+    if (g < 256) {
+      a = _mm256_srli_epi16 (_mm256_mullo_epi16 (a, gv), 8);
+    }
+
+    if ((guint) _mm256_movemask_epi8 (_mm256_cmpeq_epi16 (a, zero)) ==
+        0xffffffff) {
+      continue;
+    }
+
+    y = _mm256_permute4x64_epi64 (_mm256_packs_epi32 (_mm256_and_si256
+            (_mm256_srli_epi32 (p0, 8), mask),
+            _mm256_and_si256 (_mm256_srli_epi32 (p1, 8), mask)), 0xd8);
+    d = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) (dst + i)));
+    d = _mm256_srli_epi16 (_mm256_add_epi16 (_mm256_mullo_epi16 (y, a),
+            _mm256_mullo_epi16 (d, _mm256_sub_epi16 (c256, a))), 8);
+    d = _mm256_permute4x64_epi64 (_mm256_packus_epi16 (d, d), 0xd8);
+    _mm_storeu_si128 ((__m128i *) (dst + i), _mm256_castsi256_si128 (d));
+  }
+
+#ifdef __SSE2__
+  kms_blend_luma_sse2 (dst + i, ayuv + 4 * i, n - i, g);
+#else
+  kms_blend_luma_c (dst + i, ayuv + 4 * i, n - i, g);
+#endif
+}
+#endif
+
+static KmsBlendLumaFunc kms_blend_luma = kms_blend_luma_c;
+static KmsBlendChromaFunc kms_blend_chroma = kms_blend_chroma_c;
+
+static void
+kms_overlay_blender_init_kernels (void)
+{
+#ifdef __SSE2__
+  kms_blend_luma = kms_blend_luma_sse2;
+  kms_blend_chroma = kms_blend_chroma_sse2;
+#endif
+
+#ifdef KMS_OVERLAY_BLENDER_AVX2
+  __builtin_cpu_init ();
+
+  if (__builtin_cpu_supports ("avx2")) {
+    kms_blend_luma = kms_blend_luma_avx2;
+  }
+#endif
+}
+
+static KmsOverlayAlpha
+kms_overlay_blender_classify_alpha (GstVideoInfo * info, GstBuffer * buffer)
+{
+  gboolean transparent = FALSE, opaque = FALSE;
+  GstVideoFrame frame;
+  gint x, y, width, height, stride;
+  const guint8 *data;
+
+  if (GST_VIDEO_INFO_FORMAT (info) != GST_VIDEO_FORMAT_AYUV) {
+    return KMS_OVERLAY_ALPHA_OPAQUE;
+  }
+
+  if (!gst_video_frame_map (&frame, info, buffer, GST_MAP_READ)) {
+    return KMS_OVERLAY_ALPHA_MIXED;
+  }
+
+  width = GST_VIDEO_FRAME_WIDTH (&frame);
+  height = GST_VIDEO_FRAME_HEIGHT (&frame);
+  stride = GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 0);
+  data = GST_VIDEO_FRAME_PLANE_DATA (&frame, 0);
+
+  /* Stops as soon as the frame is known to be mixed, typically on the first */
+  /* edge of a logo */
+  for (y = 0; y < height; y++) {
+    const guint8 *p = data + y * stride;
+
+    for (x = 0; x < width; x++) {
+      guint8 a = p[4 * x];
+
+      transparent |= a == 0;
+      opaque |= a == 255;
+
+      if ((a != 0 && a != 255) || (transparent && opaque)) {
+        gst_video_frame_unmap (&frame);
+        return KMS_OVERLAY_ALPHA_MIXED;
+      }
+    }
+  }
+
+  gst_video_frame_unmap (&frame);
+
+  return opaque ? KMS_OVERLAY_ALPHA_OPAQUE : KMS_OVERLAY_ALPHA_TRANSPARENT;
+}
+
+/* Object lock must be held */
+static KmsOverlayBlenderPad *
+kms_overlay_blender_get_driver (KmsOverlayBlender * self)
+{
+  KmsOverlayBlenderPad *driver = NULL;
+  guint driver_zorder = G_MAXUINT;
+  GList *l;
+
+  for (l = GST_ELEMENT (self)->sinkpads; l != NULL; l = l->next) {
+    KmsOverlayBlenderPad *pad = l->data;
+    gboolean master;
+    guint zorder;
+
+    if (pad->eos || pad->caps == NULL ||
+        GST_VIDEO_INFO_FORMAT (&pad->info) != GST_VIDEO_FORMAT_I420) {
+      continue;
+    }
+
+    GST_OBJECT_LOCK (pad);
+    master = pad->master;
+    zorder = pad->zorder;
+    GST_OBJECT_UNLOCK (pad);
+
+    if (master) {
+      return pad;
+    }
+
+    if (driver == NULL || zorder < driver_zorder) {
+      driver = pad;
+      driver_zorder = zorder;
+    }
+  }
+
+  return driver;
+}
+
+static gint
+compare_layers (gconstpointer a, gconstpointer b)
+{
+  const KmsOverlayBlenderLayer *la = a, *lb = b;
+
+  if (la->zorder != lb->zorder) {
+    return la->zorder < lb->zorder ? -1 : 1;
+  }
+
+  return la->index < lb->index ? -1 : la->index > lb->index;
+}
+
+static gboolean
+kms_overlay_blender_layer_covers (KmsOverlayBlenderLayer * top,
+    KmsOverlayBlenderLayer * layer, gint width, gint height)
+{
+  return top->x <= MAX (layer->x, 0) && top->y <= MAX (layer->y, 0) &&
+      top->x + top->width >= MIN (layer->x + layer->width, width) &&
+      top->y + top->height >= MIN (layer->y + layer->height, height);
+}
+
+/* Takes the frames to blend over the base one, sorted by zorder. Object */
+/* lock must be held */
+static void
+kms_overlay_blender_collect_layers (KmsOverlayBlender * self,
+    KmsOverlayBlenderPad * driver)
+{
+  GArray *layers = self->priv->layers;
+  gint width = GST_VIDEO_INFO_WIDTH (&driver->info);
+  gint height = GST_VIDEO_INFO_HEIGHT (&driver->info);
+  guint driver_zorder, index = 0, i;
+  GList *l;
+
+  GST_OBJECT_LOCK (driver);
+  driver_zorder = driver->zorder;
+  GST_OBJECT_UNLOCK (driver);
+
+  for (l = GST_ELEMENT (self)->sinkpads; l != NULL; l = l->next, index++) {
+    KmsOverlayBlenderPad *pad = l->data;
+    KmsOverlayBlenderLayer layer;
+    gdouble alpha;
+
+    if (pad == driver || pad->buffer == NULL ||
+        pad->alpha_class == KMS_OVERLAY_ALPHA_TRANSPARENT) {
+      continue;
+    }
+
+    GST_OBJECT_LOCK (pad);
+    layer.x = pad->xpos;
+    layer.y = pad->ypos;
+    layer.zorder = pad->zorder;
+    alpha = pad->alpha;
+    GST_OBJECT_UNLOCK (pad);
+
+    layer.alpha = (gint) (alpha * 256 + 0.5);
+    layer.width = GST_VIDEO_INFO_WIDTH (&pad->info);
+    layer.height = GST_VIDEO_INFO_HEIGHT (&pad->info);
+
+    /* The base frame is opaque, so anything below it is hidden */
+    if (layer.alpha == 0 || layer.zorder < driver_zorder ||
+        layer.x >= width || layer.y >= height ||
+        layer.x + layer.width <= 0 || layer.y + layer.height <= 0) {
+      continue;
+    }
+
+    layer.index = index;
+    layer.opaque = layer.alpha == 256 &&
+        pad->alpha_class == KMS_OVERLAY_ALPHA_OPAQUE;
+    layer.info = pad->info;
+    layer.buffer = gst_buffer_ref (pad->buffer);
+    g_array_append_val (layers, layer);
+  }
+
+  g_array_sort (layers, compare_layers);
+
+  /* Layers hidden behind an opaque one are not blended */
+  for (i = 0; i < layers->len;) {
+    KmsOverlayBlenderLayer *layer =
+        &g_array_index (layers, KmsOverlayBlenderLayer, i);
+    guint j;
+
+    for (j = i + 1; j < layers->len; j++) {
+      KmsOverlayBlenderLayer *top =
+          &g_array_index (layers, KmsOverlayBlenderLayer, j);
+
+      if (top->opaque &&
+          kms_overlay_blender_layer_covers (top, layer, width, height)) {
+        break;
+      }
+    }
+
+    if (j < layers->len) {
+      gst_buffer_unref (layer->buffer);
+      g_array_remove_index (layers, i);
+    } else {
+      i++;
+    }
+  }
+}
+
+static void
+kms_overlay_blender_blend_ayuv (GstVideoFrame * out, GstVideoFrame * in,
+    KmsOverlayBlenderLayer * layer, gint x0, gint y0, gint x1, gint y1)
+{
+  const guint8 *src = GST_VIDEO_FRAME_PLANE_DATA (in, 0);
+  gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (in, 0);
+  guint g = layer->alpha;
+  gint x, y, n;
+
+  for (y = y0; y < y1; y++) {
+    kms_blend_luma (GST_VIDEO_FRAME_COMP_DATA (out, 0) +
+        y * GST_VIDEO_FRAME_COMP_STRIDE (out, 0) + x0,
+        src + (y - layer->y) * stride + (x0 - layer->x) * 4, x1 - x0, g);
+  }
+
+  /* Chroma samples whose top left pixel is inside the rectangle */
+  x = (x0 + 1) / 2;
+  n = (x1 + 1) / 2 - x;
+
+  for (y = (y0 + 1) / 2; y < (y1 + 1) / 2; y++) {
+    kms_blend_chroma (GST_VIDEO_FRAME_COMP_DATA (out, 1) +
+        y * GST_VIDEO_FRAME_COMP_STRIDE (out, 1) + x,
+        GST_VIDEO_FRAME_COMP_DATA (out, 2) +
+        y * GST_VIDEO_FRAME_COMP_STRIDE (out, 2) + x,
+        src + (2 * y - layer->y) * stride + (2 * x - layer->x) * 4, n, g);
+  }
+}
+
+static void
+kms_overlay_blender_blend_plane (guint8 * dst, const guint8 * src, gint n,
+    guint g)
+{
+  gint i;
+
+  if (g >= 256) {
+    memcpy (dst, src, n);
+    return;
+  }
+
+  for (i = 0; i < n; i++) {
+    dst[i] = (src[i] * g + dst[i] * (256 - g)) >> 8;
+  }
+}
+
+/* I420 overlays have no alpha channel, only the pad one */
+static void
+kms_overlay_blender_blend_i420 (GstVideoFrame * out, GstVideoFrame * in,
+    KmsOverlayBlenderLayer * layer, gint x0, gint y0, gint x1, gint y1)
+{
+  guint g = layer->alpha;
+  gint c, y;
+
+  for (y = y0; y < y1; y++) {
+    kms_overlay_blender_blend_plane (GST_VIDEO_FRAME_COMP_DATA (out, 0) +
+        y * GST_VIDEO_FRAME_COMP_STRIDE (out, 0) + x0,
+        GST_VIDEO_FRAME_COMP_DATA (in, 0) +
+        (y - layer->y) * GST_VIDEO_FRAME_COMP_STRIDE (in, 0) + x0 - layer->x,
+        x1 - x0, g);
+  }
+
+  for (c = 1; c < 3; c++) {
+    gint x = (x0 + 1) / 2, n = (x1 + 1) / 2 - x;
+
+    for (y = (y0 + 1) / 2; y < (y1 + 1) / 2; y++) {
+      kms_overlay_blender_blend_plane (GST_VIDEO_FRAME_COMP_DATA (out, c) +
+          y * GST_VIDEO_FRAME_COMP_STRIDE (out, c) + x,
+          GST_VIDEO_FRAME_COMP_DATA (in, c) +
+          (2 * y - layer->y) / 2 * GST_VIDEO_FRAME_COMP_STRIDE (in, c) +
+          (2 * x - layer->x) / 2, n, g);
+    }
+  }
+}
+
+static void
+kms_overlay_blender_blend_layer (KmsOverlayBlender * self, GstVideoFrame * out,
+    KmsOverlayBlenderLayer * layer)
+{
+  gint x0 = MAX (layer->x, 0);
+  gint y0 = MAX (layer->y, 0);
+  gint x1 = MIN (layer->x + layer->width, GST_VIDEO_FRAME_WIDTH (out));
+  gint y1 = MIN (layer->y + layer->height, GST_VIDEO_FRAME_HEIGHT (out));
+  GstVideoFrame in;
+
+  if (!gst_video_frame_map (&in, &layer->info, layer->buffer, GST_MAP_READ)) {
+    GST_WARNING_OBJECT (self, "Can not map overlay frame");
+    return;
+  }
+
+  if (GST_VIDEO_FRAME_FORMAT (&in) == GST_VIDEO_FORMAT_AYUV) {
+    kms_overlay_blender_blend_ayuv (out, &in, layer, x0, y0, x1, y1);
+  } else {
+    kms_overlay_blender_blend_i420 (out, &in, layer, x0, y0, x1, y1);
+  }
+
+  gst_video_frame_unmap (&in);
+}
+
+static void
+kms_overlay_blender_push_events (KmsOverlayBlender * self, GstCaps * caps)
+{
+  if (self->priv->need_stream_start) {
+    gchar *stream_id;
+
+    stream_id = gst_pad_create_stream_id (self->priv->srcpad,
+        GST_ELEMENT (self), NULL);
+    gst_pad_push_event (self->priv->srcpad,
+        gst_event_new_stream_start (stream_id));
+    g_free (stream_id);
+    self->priv->need_stream_start = FALSE;
+  }
+
+  if (caps != NULL) {
+    gst_pad_push_event (self->priv->srcpad, gst_event_new_caps (caps));
+  }
+
+  if (self->priv->need_segment) {
+    GstSegment segment;
+
+    /* Output timestamps are running times */
+    gst_segment_init (&segment, GST_FORMAT_TIME);
+    gst_pad_push_event (self->priv->srcpad, gst_event_new_segment (&segment));
+    self->priv->need_segment = FALSE;
+  }
+}
+
+static GstFlowReturn
+kms_overlay_blender_push_base (KmsOverlayBlender * self,
+    KmsOverlayBlenderPad * pad, GstBuffer * buffer)
+{
+  GArray *layers = self->priv->layers;
+  GstCaps *caps = NULL;
+  GstClockTime pts;
+  GstVideoInfo info;
+  GstFlowReturn ret;
+  guint i;
+
+  g_mutex_lock (&self->priv->push_lock);
+
+  GST_OBJECT_LOCK (self);
+
+  if (pad != kms_overlay_blender_get_driver (self)) {
+    /* Driving pad changed meanwhile */
+    GST_OBJECT_UNLOCK (self);
+    g_mutex_unlock (&self->priv->push_lock);
+    gst_buffer_unref (buffer);
+    return GST_FLOW_OK;
+  }
+
+  if (self->priv->caps == NULL ||
+      !gst_caps_is_equal (self->priv->caps, pad->caps)) {
+    gst_caps_replace (&self->priv->caps, pad->caps);
+    caps = gst_caps_ref (pad->caps);
+  }
+
+  info = pad->info;
+  pts = gst_segment_to_running_time (&pad->segment, GST_FORMAT_TIME,
+      GST_BUFFER_PTS (buffer));
+  GST_OBJECT_UNLOCK (self);
+
+  g_mutex_lock (&self->priv->layout_lock);
+  GST_OBJECT_LOCK (self);
+  kms_overlay_blender_collect_layers (self, pad);
+  GST_OBJECT_UNLOCK (self);
+  g_mutex_unlock (&self->priv->layout_lock);
+
+  kms_overlay_blender_push_events (self, caps);
+
+  if (caps != NULL) {
+    gst_caps_unref (caps);
+  }
+
+  /* Only metadata is copied if the buffer is shared, memory is kept */
+  buffer = gst_buffer_make_writable (buffer);
+  GST_BUFFER_PTS (buffer) = pts;
+  GST_BUFFER_DTS (buffer) = GST_CLOCK_TIME_NONE;
+
+  /* Without overlays the base frame goes out untouched */
+  if (layers->len > 0) {
+    GstVideoFrame out;
+
+    if (gst_video_frame_map (&out, &info, buffer, GST_MAP_READWRITE)) {
+      for (i = 0; i < layers->len; i++) {
+        kms_overlay_blender_blend_layer (self, &out,
+            &g_array_index (layers, KmsOverlayBlenderLayer, i));
+      }
+
+      gst_video_frame_unmap (&out);
+    } else {
+      GST_WARNING_OBJECT (self, "Can not map base frame");
+    }
+
+    for (i = 0; i < layers->len; i++) {
+      gst_buffer_unref (g_array_index (layers, KmsOverlayBlenderLayer,
+              i).buffer);
+    }
+
+    g_array_set_size (layers, 0);
+  }
+
+  /* Pushed under the lock so frames from a previous driver can not be */
+  /* reordered with the ones of the new driver */
+  ret = gst_pad_push (self->priv->srcpad, buffer);
+
+  g_mutex_unlock (&self->priv->push_lock);
+
+  return ret;
+}
+
+static GstFlowReturn
+kms_overlay_blender_sink_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buffer)
+{
+  KmsOverlayBlender *self = KMS_OVERLAY_BLENDER (parent);
+  KmsOverlayBlenderPad *bpad = KMS_OVERLAY_BLENDER_PAD (pad);
+  KmsOverlayAlpha alpha_class;
+  GstVideoInfo info;
+
+  GST_OBJECT_LOCK (self);
+
+  if (bpad == kms_overlay_blender_get_driver (self)) {
+    gst_buffer_replace (&bpad->buffer, NULL);
+    GST_OBJECT_UNLOCK (self);
+
+    return kms_overlay_blender_push_base (self, bpad, buffer);
+  }
+
+  info = bpad->info;
+  GST_OBJECT_UNLOCK (self);
+
+  /* Overlays only keep their latest frame until the next base one */
+  alpha_class = kms_overlay_blender_classify_alpha (&info, buffer);
+
+  GST_OBJECT_LOCK (self);
+  gst_buffer_replace (&bpad->buffer, buffer);
+  bpad->alpha_class = alpha_class;
+  GST_OBJECT_UNLOCK (self);
+
+  gst_buffer_unref (buffer);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+kms_overlay_blender_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  KmsOverlayBlender *self = KMS_OVERLAY_BLENDER (parent);
+  KmsOverlayBlenderPad *bpad = KMS_OVERLAY_BLENDER_PAD (pad);
+  gboolean ret = TRUE, driver, eos = FALSE;
+
+  GST_OBJECT_LOCK (self);
+  driver = bpad == kms_overlay_blender_get_driver (self);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:{
+      GstVideoInfo info;
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+
+      if (gst_video_info_from_caps (&info, caps)) {
+        gst_caps_replace (&bpad->caps, caps);
+        bpad->info = info;
+        gst_buffer_replace (&bpad->buffer, NULL);
+      } else {
+        ret = FALSE;
+      }
+      break;
+    }
+    case GST_EVENT_SEGMENT:{
+      const GstSegment *segment;
+
+      gst_event_parse_segment (event, &segment);
+      gst_segment_copy_into (segment, &bpad->segment);
+      break;
+    }
+    case GST_EVENT_EOS:
+      /* Overlays keep showing their last frame */
+      bpad->eos = TRUE;
+      eos = kms_overlay_blender_get_driver (self) == NULL;
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      bpad->eos = FALSE;
+      gst_segment_init (&bpad->segment, GST_FORMAT_TIME);
+      gst_buffer_replace (&bpad->buffer, NULL);
+
+      if (driver) {
+        self->priv->need_segment = TRUE;
+      }
+      break;
+    default:
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+    case GST_EVENT_FLUSH_STOP:
+      /* Only the base stream is flushed downstream */
+      if (driver) {
+        return gst_pad_push_event (self->priv->srcpad, event);
+      }
+      break;
+    case GST_EVENT_EOS:
+      if (eos) {
+        GST_DEBUG_OBJECT (self, "No base stream left");
+        return gst_pad_push_event (self->priv->srcpad, event);
+      }
+      break;
+    default:
+      break;
+  }
+
+  gst_event_unref (event);
+
+  return ret;
+}
+
+static GstPad *
+kms_overlay_blender_get_driver_peer (KmsOverlayBlender * self)
+{
+  GstPad *pad;
+
+  GST_OBJECT_LOCK (self);
+  pad = (GstPad *) kms_overlay_blender_get_driver (self);
+  if (pad != NULL) {
+    gst_object_ref (pad);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  return pad;
+}
+
+/* Upstream goes to the base stream */
+static gboolean
+kms_overlay_blender_src_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstPad *driver;
+  gboolean ret;
+
+  driver = kms_overlay_blender_get_driver_peer (KMS_OVERLAY_BLENDER (parent));
+
+  if (driver == NULL) {
+    gst_event_unref (event);
+    return FALSE;
+  }
+
+  ret = gst_pad_push_event (driver, event);
+  gst_object_unref (driver);
+
+  return ret;
+}
+
+static gboolean
+kms_overlay_blender_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstPad *driver;
+  gboolean ret;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:
+    case GST_QUERY_ACCEPT_CAPS:
+      return gst_pad_query_default (pad, parent, query);
+    default:
+      break;
+  }
+
+  driver = kms_overlay_blender_get_driver_peer (KMS_OVERLAY_BLENDER (parent));
+
+  if (driver == NULL) {
+    return FALSE;
+  }
+
+  ret = gst_pad_peer_query (driver, query);
+  gst_object_unref (driver);
+
+  return ret;
+}
+
+static GstPad *
+kms_overlay_blender_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+  KmsOverlayBlender *self = KMS_OVERLAY_BLENDER (element);
+  GstPad *pad;
+  gchar *padname;
+  guint id;
+
+  GST_OBJECT_LOCK (self);
+
+  if (name == NULL || sscanf (name, SINK_PAD_PREFIX "%u", &id) != 1) {
+    id = self->priv->next_id;
+  }
+
+  self->priv->next_id = MAX (self->priv->next_id, id + 1);
+
+  GST_OBJECT_UNLOCK (self);
+
+  padname = g_strdup_printf (SINK_PAD_PREFIX "%u", id);
+  pad = g_object_new (KMS_TYPE_OVERLAY_BLENDER_PAD, "name", padname,
+      "direction", GST_PAD_SINK, "template", templ, NULL);
+  g_free (padname);
+
+  gst_pad_set_chain_function (pad,
+      GST_DEBUG_FUNCPTR (kms_overlay_blender_sink_chain));
+  gst_pad_set_event_function (pad,
+      GST_DEBUG_FUNCPTR (kms_overlay_blender_sink_event));
+
+  if (!gst_element_add_pad (element, pad)) {
+    GST_ERROR_OBJECT (self, "Can not add pad %" GST_PTR_FORMAT, pad);
+    gst_object_unref (pad);
+    return NULL;
+  }
+
+  return pad;
+}
+
+static void
+kms_overlay_blender_release_pad (GstElement * element, GstPad * pad)
+{
+  gst_pad_set_active (pad, FALSE);
+  gst_element_remove_pad (element, pad);
+}
+
+static GstStateChangeReturn
+kms_overlay_blender_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  KmsOverlayBlender *self = KMS_OVERLAY_BLENDER (element);
+
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED) {
+    GST_OBJECT_LOCK (self);
+    self->priv->need_stream_start = TRUE;
+    self->priv->need_segment = TRUE;
+    gst_caps_replace (&self->priv->caps, NULL);
+    GST_OBJECT_UNLOCK (self);
+  }
+
+  return
+      GST_ELEMENT_CLASS (kms_overlay_blender_parent_class)->change_state
+      (element, transition);
+}
+
+static void
+kms_overlay_blender_finalize (GObject * object)
+{
+  KmsOverlayBlender *self = KMS_OVERLAY_BLENDER (object);
+
+  gst_caps_replace (&self->priv->caps, NULL);
+  g_array_unref (self->priv->layers);
+  g_mutex_clear (&self->priv->push_lock);
+  g_mutex_clear (&self->priv->layout_lock);
+
+  G_OBJECT_CLASS (kms_overlay_blender_parent_class)->finalize (object);
+}
+
+static void
+kms_overlay_blender_class_init (KmsOverlayBlenderClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "OverlayBlender", "Filter/Editor/Video/Compositor",
+      "Blends AYUV overlays over an I420 base video",
+      "Kurento <kurento@googlegroups.com>");
+
+  gobject_class->finalize = GST_DEBUG_FUNCPTR (kms_overlay_blender_finalize);
+
+  gstelement_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (kms_overlay_blender_request_new_pad);
+  gstelement_class->release_pad =
+      GST_DEBUG_FUNCPTR (kms_overlay_blender_release_pad);
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (kms_overlay_blender_change_state);
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sink_factory));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&src_factory));
+
+  kms_overlay_blender_init_kernels ();
+
+  /* Registers a private structure for the instantiatable type */
+  g_type_class_add_private (klass, sizeof (KmsOverlayBlenderPrivate));
+}
+
+static void
+kms_overlay_blender_init (KmsOverlayBlender * self)
+{
+  self->priv = KMS_OVERLAY_BLENDER_GET_PRIVATE (self);
+
+  g_mutex_init (&self->priv->push_lock);
+  g_mutex_init (&self->priv->layout_lock);
+  self->priv->layers = g_array_new (FALSE, FALSE,
+      sizeof (KmsOverlayBlenderLayer));
+  self->priv->need_stream_start = TRUE;
+  self->priv->need_segment = TRUE;
+
+  self->priv->srcpad = gst_pad_new_from_static_template (&src_factory, "src");
+  gst_pad_use_fixed_caps (self->priv->srcpad);
+  gst_pad_set_event_function (self->priv->srcpad,
+      GST_DEBUG_FUNCPTR (kms_overlay_blender_src_event));
+  gst_pad_set_query_function (self->priv->srcpad,
+      GST_DEBUG_FUNCPTR (kms_overlay_blender_src_query));
+  gst_element_add_pad (GST_ELEMENT (self), self->priv->srcpad);
+}
+
+void
+kms_overlay_blender_lock_layout (KmsOverlayBlender * self)
+{
+  g_return_if_fail (KMS_IS_OVERLAY_BLENDER (self));
+
+  g_mutex_lock (&self->priv->layout_lock);
+}
+
+void
+kms_overlay_blender_unlock_layout (KmsOverlayBlender * self)
+{
+  g_return_if_fail (KMS_IS_OVERLAY_BLENDER (self));
+
+  g_mutex_unlock (&self->priv->layout_lock);
+}
+
+gboolean
+kms_overlay_blender_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, PLUGIN_NAME, GST_RANK_NONE,
+      KMS_TYPE_OVERLAY_BLENDER);
+}
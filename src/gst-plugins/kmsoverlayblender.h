@@ -0,0 +1,89 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _KMS_OVERLAY_BLENDER_H_
+#define _KMS_OVERLAY_BLENDER_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+#define KMS_TYPE_OVERLAY_BLENDER kms_overlay_blender_get_type()
+#define KMS_OVERLAY_BLENDER(obj) (      \
+  G_TYPE_CHECK_INSTANCE_CAST(           \
+    (obj),                              \
+    KMS_TYPE_OVERLAY_BLENDER,           \
+    KmsOverlayBlender                   \
+  )                                     \
+)
+#define KMS_OVERLAY_BLENDER_CLASS(klass) ( \
+  G_TYPE_CHECK_CLASS_CAST (                \
+    (klass),                               \
+    KMS_TYPE_OVERLAY_BLENDER,              \
+    KmsOverlayBlenderClass                 \
+  )                                        \
+)
+#define KMS_IS_OVERLAY_BLENDER(obj) (   \
+  G_TYPE_CHECK_INSTANCE_TYPE (          \
+    (obj),                              \
+    KMS_TYPE_OVERLAY_BLENDER            \
+  )                                     \
+)
+#define KMS_IS_OVERLAY_BLENDER_CLASS(klass) ( \
+  G_TYPE_CHECK_CLASS_TYPE((klass),            \
+  KMS_TYPE_OVERLAY_BLENDER)                   \
+)
+
+typedef struct _KmsOverlayBlender KmsOverlayBlender;
+typedef struct _KmsOverlayBlenderClass KmsOverlayBlenderClass;
+typedef struct _KmsOverlayBlenderPrivate KmsOverlayBlenderPrivate;
+
+/*
+ * Blends AYUV overlays over an I420 base frame. The base comes from the
+ * "master" sink pad, or from the I420 pad with the lowest zorder if none is
+ * marked, and drives the output: every base frame is pushed in place with
+ * the latest frame of each overlay blended on it. The rest of the base is not
+ * touched. Overlays that are transparent, out of the frame or hidden behind
+ * opaque ones are skipped.
+ *
+ * Sink pads have the "xpos", "ypos", "zorder" and "alpha" properties of the
+ * compositor ones, plus "master".
+ */
+struct _KmsOverlayBlender
+{
+  GstElement parent;
+
+  /*< private > */
+  KmsOverlayBlenderPrivate *priv;
+};
+
+struct _KmsOverlayBlenderClass
+{
+  GstElementClass parent_class;
+};
+
+GType kms_overlay_blender_get_type (void);
+
+/*
+ * Pad property changes made between these calls are seen together by the
+ * next frame. Frames wait meanwhile, so keep it short.
+ */
+void kms_overlay_blender_lock_layout (KmsOverlayBlender * self);
+void kms_overlay_blender_unlock_layout (KmsOverlayBlender * self);
+
+gboolean kms_overlay_blender_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+#endif /* _KMS_OVERLAY_BLENDER_H_ */
@@ -24,11 +24,17 @@
 #include <commons/kmselement.h>
 #include <commons/kmsagnosticcaps.h>
 #include "kmsplayerendpoint.h"
+#include "kmsplayersource.h"
+#include "kmsplayerseekmode.h"
+#include "kmsautoplugselectresult.h"
+#include "kms-elements-enumtypes.h"
 #include <commons/kmsloop.h>
 #include <kms-elements-marshal.h>
 
 #include <gst/app/gstappsrc.h>
 #include <gst/app/gstappsink.h>
+#include <glib/gstdio.h>
+#include <string.h>
 
 #define PLUGIN_NAME "playerendpoint"
 #define AUDIO_APPSRC "audio_appsrc"
@@ -41,11 +47,23 @@ G_DEFINE_QUARK (APPSRC_KEY, appsrc);
 #define APPSINK_KEY "appsink-key"
 G_DEFINE_QUARK (APPSINK_KEY, appsink);
 
-#define PTS_KEY "pts-key"
-G_DEFINE_QUARK (PTS_KEY, pts);
+#define BRIDGE_KEY "bridge-key"
+G_DEFINE_QUARK (BRIDGE_KEY, bridge);
 
 #define NETWORK_CACHE_DEFAULT 2000
+#define READ_AHEAD_BYTES_DEFAULT 0
+#define READ_AHEAD_TIME_DEFAULT 0
+/* Size of the file reads when reading ahead, a multiple of the page size */
+#define READ_AHEAD_BLOCKSIZE (1 << 20)
 #define PORT_RANGE_DEFAULT "0-0"
+#define SEEK_MODE_DEFAULT KMS_PLAYER_SEEK_MODE_ACCURATE
+#define RATE_DEFAULT 1.0
+#define RATE_MIN 0.1
+#define RATE_MAX 16.0
+#define TRICKMODE_KEY_UNITS_MIN_RATE 2.0
+#define MAX_INDEXED_KEYFRAMES 65536
+/* Files with a keyframe index, the least recently used is dropped */
+#define MAX_INDEXED_URIS 64
 #define IS_PREROLL TRUE
 
 GST_DEBUG_CATEGORY_STATIC (kms_player_endpoint_debug_category);
@@ -80,11 +98,20 @@ typedef struct _KmsPlayerStats
 struct _KmsPlayerEndpointPrivate
 {
   GstElement *pipeline;
-  GstElement *uridecodebin;
+  GstElement *uridecodebin;     /* A decodebin when reading ahead */
+  GstElement *read_ahead;
+  gint read_ahead_bytes;
+  gint read_ahead_time;
   KmsLoop *loop;
   gboolean use_encoded_media;
+  gboolean passthrough;
+  gboolean shared_source;
+  KmsPlayerSource *source;      /* Attached while started, if shared_source */
   gint network_cache;
   gchar *port_range;
+  KmsPlayerSeekMode seek_mode;
+  gdouble rate;
+  gint rate_pending;            /* Apply rate once the pipeline prerolls */
 
   GMutex base_time_mutex;
   gboolean reset;
@@ -98,10 +125,17 @@ enum
 {
   PROP_0,
   PROP_USE_ENCODED_MEDIA,
+  PROP_PASSTHROUGH,
+  PROP_SHARED_SOURCE,
   PROP_VIDEO_DATA,
   PROP_POSITION,
   PROP_NETWORK_CACHE,
+  PROP_READ_AHEAD_BYTES,
+  PROP_READ_AHEAD_TIME,
+  PROP_READ_AHEAD_LEVEL,
   PROP_PORT_RANGE,
+  PROP_SEEK_MODE,
+  PROP_RATE,
   PROP_PIPELINE,
   N_PROPERTIES
 };
@@ -163,6 +197,440 @@ kms_pts_data_reset (KmsPtsData * data)
   data->last_pts_orig = GST_CLOCK_TIME_NONE;
 }
 
+/*
+ * Carries the buffers of one stream from the appsink of the inner pipeline to
+ * its appsrc. Buffers are not modified: their timestamps are moved to the
+ * endpoint running time with an offset on the appsrc pad, which only changes
+ * when the base time does.
+ *
+ * appsrc may still have buffers queued with the previous offset, so a new
+ * one is applied in band, from the appsrc streaming thread, when the first
+ * buffer pushed after the change goes out.
+ */
+typedef struct _KmsPlayerBridge
+{
+  KmsPlayerEndpoint *self;
+  GstAppSrc *appsrc;
+  GstPad *srcpad;
+  GstPad *peer;
+  gint64 offset;
+  KmsPtsData *pts_data;
+  gboolean audio;
+
+  gulong probe_id;
+  GMutex lock;
+  /* Offsets not applied yet, with the count of buffers before them */
+  GQueue pending;
+  guint64 pushed;
+  guint64 output;
+} KmsPlayerBridge;
+
+typedef struct _KmsPlayerOffset
+{
+  guint64 at;
+  gint64 offset;
+} KmsPlayerOffset;
+
+static void
+kms_player_offset_destroy (gpointer data)
+{
+  g_slice_free (KmsPlayerOffset, data);
+}
+
+static GstPadProbeReturn
+kms_player_bridge_apply_offset (GstPad * pad, GstPadProbeInfo * info,
+    KmsPlayerBridge * bridge)
+{
+  KmsPlayerOffset *next;
+  gboolean changed = FALSE;
+  gint64 offset = 0;
+
+  g_mutex_lock (&bridge->lock);
+
+  while ((next = g_queue_peek_head (&bridge->pending)) != NULL &&
+      next->at <= bridge->output) {
+    offset = next->offset;
+    changed = TRUE;
+    kms_player_offset_destroy (g_queue_pop_head (&bridge->pending));
+  }
+
+  bridge->output++;
+
+  g_mutex_unlock (&bridge->lock);
+
+  if (changed) {
+    /* The segment is resent with the new offset before this buffer */
+    gst_pad_set_offset (pad, offset);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Called from the thread that pushes, after the offset changed */
+static void
+kms_player_bridge_set_offset (KmsPlayerBridge * bridge, gint64 offset)
+{
+  KmsPlayerOffset *pending = g_slice_new (KmsPlayerOffset);
+
+  pending->offset = offset;
+
+  g_mutex_lock (&bridge->lock);
+  pending->at = bridge->pushed;
+  g_queue_push_tail (&bridge->pending, pending);
+  g_mutex_unlock (&bridge->lock);
+
+  bridge->offset = offset;
+}
+
+/* Queued buffers were dropped, so is the wait for them */
+static void
+kms_player_bridge_flushed (KmsPlayerBridge * bridge)
+{
+  g_mutex_lock (&bridge->lock);
+
+  if (!g_queue_is_empty (&bridge->pending)) {
+    gst_pad_set_offset (bridge->srcpad, bridge->offset);
+    g_queue_foreach (&bridge->pending, (GFunc) kms_player_offset_destroy,
+        NULL);
+    g_queue_clear (&bridge->pending);
+  }
+
+  bridge->output = bridge->pushed;
+
+  g_mutex_unlock (&bridge->lock);
+}
+
+static KmsPlayerBridge *
+kms_player_bridge_new (KmsPlayerEndpoint * self, GstElement * appsrc,
+    gboolean audio)
+{
+  KmsPlayerBridge *bridge = g_slice_new0 (KmsPlayerBridge);
+
+  bridge->self = self;
+  bridge->audio = audio;
+  bridge->appsrc = GST_APP_SRC (g_object_ref (appsrc));
+  bridge->srcpad = gst_element_get_static_pad (appsrc, "src");
+  /* appsrc is linked once, when created */
+  bridge->peer = gst_pad_get_peer (bridge->srcpad);
+  bridge->pts_data = kms_pts_data_new ();
+
+  g_mutex_init (&bridge->lock);
+  g_queue_init (&bridge->pending);
+  /* appsrc only pushes single buffers */
+  bridge->probe_id = gst_pad_add_probe (bridge->srcpad,
+      GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) kms_player_bridge_apply_offset, bridge, NULL);
+
+  return bridge;
+}
+
+static void
+kms_player_bridge_destroy (gpointer data)
+{
+  KmsPlayerBridge *bridge = data;
+
+  gst_pad_remove_probe (bridge->srcpad, bridge->probe_id);
+  g_queue_foreach (&bridge->pending, (GFunc) kms_player_offset_destroy, NULL);
+  g_queue_clear (&bridge->pending);
+  g_mutex_clear (&bridge->lock);
+
+  g_clear_object (&bridge->peer);
+  g_clear_object (&bridge->srcpad);
+  g_clear_object (&bridge->appsrc);
+  kms_pts_data_destroy (bridge->pts_data);
+
+  g_slice_free (KmsPlayerBridge, bridge);
+}
+
+/*
+ * Keyframes seen while playing, by file, shared by all the players. Each
+ * keyframe tells if the next one in the index was seen right after it, so
+ * that no other keyframe can lie between them.
+ */
+typedef struct _KmsKeyframe
+{
+  GstClockTime pts;
+  gboolean next_known;
+} KmsKeyframe;
+
+typedef struct _KmsKeyframeIndex
+{
+  gchar *key;
+  GArray *keyframes;
+  /* In keyframe_lru */
+  GList *link;
+} KmsKeyframeIndex;
+
+G_LOCK_DEFINE_STATIC (keyframe_indexes);
+static GHashTable *keyframe_indexes = NULL;     /* <key, KmsKeyframeIndex> */
+static GQueue keyframe_lru = G_QUEUE_INIT;      /* Most recent first */
+
+/*
+ * Local files are also identified by inode, size and modification time, so
+ * a file replaced or rewritten under the same uri gets a new index. Other
+ * uris can not be checked and are only identified by themselves.
+ */
+static gchar *
+kms_keyframe_index_key (const gchar * uri)
+{
+  gchar *location, *key;
+  GStatBuf st;
+
+  if (!gst_uri_has_protocol (uri, "file")) {
+    return g_strdup (uri);
+  }
+
+  location = gst_uri_get_location (uri);
+
+  if (location == NULL || g_stat (location, &st) != 0) {
+    g_free (location);
+    return g_strdup (uri);
+  }
+
+  g_free (location);
+
+  key = g_strdup_printf ("%s#%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT
+      ":%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT, uri, (guint64) st.st_dev,
+      (guint64) st.st_ino, (gint64) st.st_size, (gint64) st.st_mtime);
+
+  return key;
+}
+
+static void
+kms_keyframe_index_destroy (KmsKeyframeIndex * index)
+{
+  g_queue_delete_link (&keyframe_lru, index->link);
+  g_array_unref (index->keyframes);
+  g_free (index->key);
+
+  g_slice_free (KmsKeyframeIndex, index);
+}
+
+/* Marks the index as the most recently used, keyframe_indexes locked */
+static void
+kms_keyframe_index_touch (KmsKeyframeIndex * index)
+{
+  g_queue_unlink (&keyframe_lru, index->link);
+  g_queue_push_head_link (&keyframe_lru, index->link);
+}
+
+static KmsKeyframeIndex *
+kms_keyframe_index_get (const gchar * key)
+{
+  KmsKeyframeIndex *index;
+
+  if (keyframe_indexes == NULL) {
+    keyframe_indexes = g_hash_table_new_full (g_str_hash, g_str_equal,
+        NULL, (GDestroyNotify) kms_keyframe_index_destroy);
+  }
+
+  index = g_hash_table_lookup (keyframe_indexes, key);
+
+  if (index != NULL) {
+    kms_keyframe_index_touch (index);
+    return index;
+  }
+
+  if (g_queue_get_length (&keyframe_lru) >= MAX_INDEXED_URIS) {
+    KmsKeyframeIndex *oldest = g_queue_peek_tail (&keyframe_lru);
+
+    GST_DEBUG ("Dropping keyframe index of %s", oldest->key);
+    g_hash_table_remove (keyframe_indexes, oldest->key);
+  }
+
+  index = g_slice_new0 (KmsKeyframeIndex);
+  index->key = g_strdup (key);
+  index->keyframes = g_array_new (FALSE, FALSE, sizeof (KmsKeyframe));
+  g_queue_push_head (&keyframe_lru, index);
+  index->link = g_queue_peek_head_link (&keyframe_lru);
+  g_hash_table_insert (keyframe_indexes, index->key, index);
+
+  return index;
+}
+
+/* Returns the position of the first keyframe not before pts */
+static guint
+kms_keyframe_index_search (GArray * index, GstClockTime pts)
+{
+  guint low = 0, high = index->len;
+
+  while (low < high) {
+    guint mid = (low + high) / 2;
+
+    if (g_array_index (index, KmsKeyframe, mid).pts < pts) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  return low;
+}
+
+static void
+kms_keyframe_index_add (const gchar * key, GstClockTime pts,
+    GstClockTime previous)
+{
+  GArray *index;
+  guint i;
+
+  G_LOCK (keyframe_indexes);
+
+  index = kms_keyframe_index_get (key)->keyframes;
+
+  i = kms_keyframe_index_search (index, pts);
+
+  if (i == index->len || g_array_index (index, KmsKeyframe, i).pts != pts) {
+    KmsKeyframe keyframe = { pts, FALSE };
+
+    if (index->len >= MAX_INDEXED_KEYFRAMES) {
+      goto end;
+    }
+
+    g_array_insert_val (index, i, keyframe);
+  }
+
+  if (i > 0 && GST_CLOCK_TIME_IS_VALID (previous) &&
+      g_array_index (index, KmsKeyframe, i - 1).pts == previous) {
+    g_array_index (index, KmsKeyframe, i - 1).next_known = TRUE;
+  }
+
+end:
+  G_UNLOCK (keyframe_indexes);
+}
+
+/*
+ * Returns the keyframe at or right before position, or GST_CLOCK_TIME_NONE
+ * if the index does not know it
+ */
+static GstClockTime
+kms_keyframe_index_lookup (const gchar * uri, GstClockTime position)
+{
+  GstClockTime pts = GST_CLOCK_TIME_NONE;
+  KmsKeyframeIndex *entry = NULL;
+  GArray *index;
+  gchar *key;
+  guint i;
+
+  key = kms_keyframe_index_key (uri);
+
+  G_LOCK (keyframe_indexes);
+
+  if (keyframe_indexes != NULL) {
+    entry = g_hash_table_lookup (keyframe_indexes, key);
+  }
+
+  if (entry == NULL) {
+    goto end;
+  }
+
+  kms_keyframe_index_touch (entry);
+  index = entry->keyframes;
+  i = kms_keyframe_index_search (index, position);
+
+  if (i < index->len && g_array_index (index, KmsKeyframe, i).pts == position) {
+    pts = position;
+  } else if (i > 0 && i < index->len &&
+      g_array_index (index, KmsKeyframe, i - 1).next_known) {
+    pts = g_array_index (index, KmsKeyframe, i - 1).pts;
+  }
+
+end:
+  G_UNLOCK (keyframe_indexes);
+
+  g_free (key);
+
+  return pts;
+}
+
+typedef struct _KmsKeyframeProbe
+{
+  /* Index key of the file when playback started */
+  gchar *key;
+  GstClockTime last;
+} KmsKeyframeProbe;
+
+static void
+kms_keyframe_probe_destroy (gpointer data)
+{
+  KmsKeyframeProbe *probe = data;
+
+  g_free (probe->key);
+  g_slice_free (KmsKeyframeProbe, probe);
+}
+
+static GstPadProbeReturn
+kms_keyframe_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  KmsKeyframeProbe *probe = data;
+  GstBuffer *buffer;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = gst_pad_probe_info_get_event (info);
+
+    /* Keyframes are only consecutive within a segment */
+    if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT ||
+        GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+      probe->last = GST_CLOCK_TIME_NONE;
+    }
+
+    return GST_PAD_PROBE_OK;
+  }
+
+  buffer = gst_pad_probe_info_get_buffer (info);
+
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT) ||
+      !GST_BUFFER_PTS_IS_VALID (buffer)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  kms_keyframe_index_add (probe->key, GST_BUFFER_PTS (buffer), probe->last);
+  probe->last = GST_BUFFER_PTS (buffer);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Indexes the keyframes of the encoded video going through pad */
+static void
+kms_player_endpoint_add_keyframe_probe (KmsPlayerEndpoint * self, GstPad * pad)
+{
+  KmsKeyframeProbe *probe = g_slice_new0 (KmsKeyframeProbe);
+
+  probe->key = kms_keyframe_index_key (KMS_URI_ENDPOINT (self)->uri);
+  probe->last = GST_CLOCK_TIME_NONE;
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      kms_keyframe_probe, probe, kms_keyframe_probe_destroy);
+}
+
+static void
+kms_player_endpoint_decodebin_element_added (GstBin * bin,
+    GstElement * element, KmsPlayerEndpoint * self)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+  const gchar *klass;
+  GstPad *sinkpad;
+
+  if (factory == NULL) {
+    return;
+  }
+
+  klass = gst_element_factory_get_metadata (factory,
+      GST_ELEMENT_METADATA_KLASS);
+
+  if (klass == NULL || strstr (klass, "Decoder") == NULL ||
+      strstr (klass, "Video") == NULL) {
+    return;
+  }
+
+  sinkpad = gst_element_get_static_pad (element, "sink");
+  if (sinkpad != NULL) {
+    kms_player_endpoint_add_keyframe_probe (self, sinkpad);
+    g_object_unref (sinkpad);
+  }
+}
+
 static void
 kms_player_endpoint_disable_decoding (KmsPlayerEndpoint * self)
 {
@@ -180,6 +648,27 @@ kms_player_endpoint_disable_decoding (KmsPlayerEndpoint * self)
   gst_caps_unref (deco_caps);
 }
 
+static KmsAutoplugSelectResult
+kms_player_endpoint_uridecodebin_autoplug_select (GstElement * uridecodebin,
+    GstPad * pad, GstCaps * caps, GstElementFactory * factory,
+    KmsPlayerEndpoint * self)
+{
+  /* Demuxers and parsers are still plugged, so that streams come out as */
+  /* complete access units that payloaders can send as they are */
+  if (self->priv->passthrough &&
+      gst_element_factory_list_is_type (factory,
+          GST_ELEMENT_FACTORY_TYPE_DECODER)) {
+    GST_DEBUG_OBJECT (self, "Passthrough: skip decoder %s for %"
+        GST_PTR_FORMAT, GST_OBJECT_NAME (factory), caps);
+    return KMS_AUTOPLUG_SELECT_SKIP;
+  }
+
+  return KMS_AUTOPLUG_SELECT_TRY;
+}
+
+static void kms_player_endpoint_set_rate (KmsPlayerEndpoint * self,
+    gdouble rate);
+
 void
 kms_player_endpoint_set_property (GObject * object, guint property_id,
     const GValue * value, GParamSpec * pspec)
@@ -194,19 +683,48 @@ kms_player_endpoint_set_property (GObject * object, guint property_id,
       }
       break;
     }
+    case PROP_PASSTHROUGH:{
+      playerendpoint->priv->passthrough = g_value_get_boolean (value);
+      if (playerendpoint->priv->passthrough) {
+        playerendpoint->priv->use_encoded_media = TRUE;
+        kms_player_endpoint_disable_decoding (playerendpoint);
+      }
+      break;
+    }
+    case PROP_SHARED_SOURCE:
+      playerendpoint->priv->shared_source = g_value_get_boolean (value);
+      break;
     case PROP_NETWORK_CACHE:
       playerendpoint->priv->network_cache = g_value_get_int (value);
       break;
+    case PROP_READ_AHEAD_BYTES:
+      playerendpoint->priv->read_ahead_bytes = g_value_get_int (value);
+      break;
+    case PROP_READ_AHEAD_TIME:
+      playerendpoint->priv->read_ahead_time = g_value_get_int (value);
+      break;
     case PROP_PORT_RANGE:
       g_free (playerendpoint->priv->port_range);
       playerendpoint->priv->port_range = g_value_dup_string (value);
       break;
+    case PROP_SEEK_MODE:
+      playerendpoint->priv->seek_mode = g_value_get_enum (value);
+      break;
+    case PROP_RATE:
+      kms_player_endpoint_set_rate (playerendpoint,
+          g_value_get_double (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
   }
 }
 
+static GstElement *kms_player_endpoint_ref_pipeline (KmsPlayerEndpoint * self);
+static gint kms_player_endpoint_get_read_ahead_level (KmsPlayerEndpoint *
+    self);
+static void kms_player_endpoint_detach_source (KmsPlayerEndpoint * self);
+
 void
 kms_player_endpoint_get_property (GObject * object, guint property_id,
     GValue * value, GParamSpec * pspec)
@@ -217,6 +735,12 @@ kms_player_endpoint_get_property (GObject * object, guint property_id,
     case PROP_USE_ENCODED_MEDIA:
       g_value_set_boolean (value, playerendpoint->priv->use_encoded_media);
       break;
+    case PROP_PASSTHROUGH:
+      g_value_set_boolean (value, playerendpoint->priv->passthrough);
+      break;
+    case PROP_SHARED_SOURCE:
+      g_value_set_boolean (value, playerendpoint->priv->shared_source);
+      break;
     case PROP_VIDEO_DATA:{
       gint64 segment_start = -1;
       gint64 segment_end = -1;
@@ -225,8 +749,9 @@ kms_player_endpoint_get_property (GObject * object, guint property_id,
       GstFormat format;
       GstStructure *video_data = NULL;
       GstQuery *query = gst_query_new_seeking (GST_FORMAT_TIME);
+      GstElement *pipeline = kms_player_endpoint_ref_pipeline (playerendpoint);
 
-      if (gst_element_query (playerendpoint->priv->pipeline, query)) {
+      if (gst_element_query (pipeline, query)) {
         gst_query_parse_seeking (query,
             &format, &seekable, &segment_start, &segment_end);
       } else {
@@ -236,12 +761,13 @@ kms_player_endpoint_get_property (GObject * object, guint property_id,
 
       gst_query_unref (query);
 
-      if (!gst_element_query_duration (playerendpoint->priv->pipeline,
-              GST_FORMAT_TIME, &duration)) {
+      if (!gst_element_query_duration (pipeline, GST_FORMAT_TIME, &duration)) {
         GST_WARNING_OBJECT (playerendpoint,
             "Impossible to get the file duration");
       }
 
+      gst_object_unref (pipeline);
+
       video_data = gst_structure_new ("video_data",
           "isSeekable", G_TYPE_BOOLEAN, seekable,
           "seekableInit", G_TYPE_INT64, segment_start,
@@ -254,10 +780,12 @@ kms_player_endpoint_get_property (GObject * object, guint property_id,
     case PROP_POSITION:{
       gint64 position = -1;
       gboolean ret = FALSE;
+      GstElement *pipeline = kms_player_endpoint_ref_pipeline (playerendpoint);
 
-      if (playerendpoint->priv->pipeline != NULL) {
-        ret = gst_element_query_position (playerendpoint->priv->pipeline,
-            GST_FORMAT_TIME, &position);
+      if (pipeline != NULL) {
+        ret = gst_element_query_position (pipeline, GST_FORMAT_TIME,
+            &position);
+        gst_object_unref (pipeline);
       }
 
       if (!ret) {
@@ -274,9 +802,25 @@ kms_player_endpoint_get_property (GObject * object, guint property_id,
     case PROP_NETWORK_CACHE:
       g_value_set_int (value, playerendpoint->priv->network_cache);
       break;
+    case PROP_READ_AHEAD_BYTES:
+      g_value_set_int (value, playerendpoint->priv->read_ahead_bytes);
+      break;
+    case PROP_READ_AHEAD_TIME:
+      g_value_set_int (value, playerendpoint->priv->read_ahead_time);
+      break;
+    case PROP_READ_AHEAD_LEVEL:
+      g_value_set_int (value,
+          kms_player_endpoint_get_read_ahead_level (playerendpoint));
+      break;
     case PROP_PORT_RANGE:
       g_value_set_string (value, playerendpoint->priv->port_range);
       break;
+    case PROP_SEEK_MODE:
+      g_value_set_enum (value, playerendpoint->priv->seek_mode);
+      break;
+    case PROP_RATE:
+      g_value_set_double (value, playerendpoint->priv->rate);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -339,6 +883,8 @@ kms_player_endpoint_dispose (GObject * object)
 {
   KmsPlayerEndpoint *self = KMS_PLAYER_ENDPOINT (object);
 
+  kms_player_endpoint_detach_source (self);
+
   g_clear_object (&self->priv->loop);
 
   if (self->priv->pipeline != NULL) {
@@ -445,51 +991,35 @@ kms_player_endpoint_mark_reset_base_time_and_set_state (KmsPlayerEndpoint *
 }
 
 static GstFlowReturn
-process_sample (GstAppSink * appsink, GstAppSrc * appsrc, GstSample * sample,
+process_buffer (KmsPlayerBridge * bridge, GstBuffer * buffer, gdouble rate,
     gboolean is_preroll)
 {
-  KmsPlayerEndpoint *self = KMS_PLAYER_ENDPOINT (GST_ELEMENT_PARENT (appsrc));
-  KmsPtsData *pts_data;
-  GstBuffer *buffer = NULL;
-  GstPad *src, *sink;
-  GstClockTime pts_orig, base_time, offset_time;
+  KmsPlayerEndpoint *self = bridge->self;
+  KmsPtsData *pts_data = bridge->pts_data;
+  GstClockTime pts_orig, pts, base_time, offset_time;
   GstFlowReturn ret = GST_FLOW_OK;
   gint64 diff;
 
-  if (sample == NULL) {
-    GST_ERROR_OBJECT (appsink, "Cannot get sample");
-    return GST_FLOW_OK;
-  }
-
-  if (gst_sample_get_buffer_list (sample) != NULL) {
-    GST_ERROR_OBJECT (appsink, "BufferList not supported");
-    g_warning ("BufferList not supported");
-  }
-
-  buffer = gst_sample_get_buffer (sample);
-  if (buffer == NULL) {
-    GST_ERROR_OBJECT (appsink, "Cannot get buffer");
+  if (bridge->audio && rate != 1.0) {
+    /* Audio is not resampled, so it would play garbled. The pipeline is */
+    /* asked not to decode it, this drops what still comes */
+    GST_LOG_OBJECT (bridge->appsrc, "Rate %f, dropping audio", rate);
     goto end;
   }
 
-  gst_buffer_ref (buffer);
-  buffer = gst_buffer_make_writable (buffer);
-
-  pts_data =
-      (KmsPtsData *) g_object_get_qdata (G_OBJECT (appsink), pts_quark ());
-
   if (!GST_BUFFER_PTS_IS_VALID (buffer) && !GST_BUFFER_DTS_IS_VALID (buffer)) {
     if (pts_data->pts_handled) {
-      GST_ERROR_OBJECT (appsink,
+      GST_ERROR_OBJECT (bridge->appsrc,
           "PTS and DTS are not valid and a previous buffer was handled.");
-      ret = GST_FLOW_OK;
       goto end;
     }
 
     goto push;
   } else if (!GST_BUFFER_PTS_IS_VALID (buffer)) {
+    buffer = gst_buffer_make_writable (buffer);
     GST_BUFFER_PTS (buffer) = GST_BUFFER_DTS (buffer);
   } else if (!GST_BUFFER_DTS_IS_VALID (buffer)) {
+    buffer = gst_buffer_make_writable (buffer);
     GST_BUFFER_DTS (buffer) = GST_BUFFER_PTS (buffer);
   }
 
@@ -497,7 +1027,7 @@ process_sample (GstAppSink * appsink, GstAppSrc * appsrc, GstSample * sample,
   pts_orig = GST_BUFFER_PTS (buffer);
 
   if (is_preroll) {
-    GST_DEBUG_OBJECT (appsink, "Preroll: reset base time");
+    GST_DEBUG_OBJECT (bridge->appsrc, "Preroll: reset base time");
 
     kms_player_endpoint_reset_base_time (self);
     kms_pts_data_reset (pts_data);
@@ -510,7 +1040,7 @@ process_sample (GstAppSink * appsink, GstAppSrc * appsrc, GstSample * sample,
       base_time = MAX (base_time, pts_data->last_pts + GST_MSECOND);
     }
 
-    offset_time = GST_BUFFER_PTS (buffer);
+    offset_time = pts_orig;
   } else {
     base_time = pts_data->base_time;
     offset_time = pts_data->offset_time;
@@ -526,13 +1056,13 @@ process_sample (GstAppSink * appsink, GstAppSrc * appsrc, GstSample * sample,
       }
 
       pts_data->base_time = base_time;
-      pts_data->offset_time = offset_time = GST_BUFFER_PTS (buffer);
+      pts_data->offset_time = offset_time = pts_orig;
     }
   }
 
   if (pts_data->last_pts_orig != GST_CLOCK_TIME_NONE) {
     if (pts_orig < pts_data->last_pts_orig) {
-      GST_ERROR_OBJECT (appsink,
+      GST_ERROR_OBJECT (bridge->appsrc,
           "Non incremental original PTS (last original PTS: %"
           GST_TIME_FORMAT ", original PTS: %" GST_TIME_FORMAT
           ", is preroll: %d). Not pushing",
@@ -540,7 +1070,7 @@ process_sample (GstAppSink * appsink, GstAppSrc * appsrc, GstSample * sample,
           is_preroll);
       goto end;
     } else if (pts_orig == pts_data->last_pts_orig) {
-      GST_DEBUG_OBJECT (appsink,
+      GST_DEBUG_OBJECT (bridge->appsrc,
           "Original PTS equals last PTS (original PTS: %" GST_TIME_FORMAT
           ", is preroll: %d). Seems to be already pushed.",
           GST_TIME_ARGS (pts_orig), is_preroll);
@@ -548,53 +1078,72 @@ process_sample (GstAppSink * appsink, GstAppSrc * appsrc, GstSample * sample,
     }
   }
 
-  diff = base_time - offset_time;
-  GST_BUFFER_DTS (buffer) += diff;
-  GST_BUFFER_PTS (buffer) += diff;
+  if (rate == 1.0) {
+    diff = base_time - offset_time;
+    pts = pts_orig + diff;
+  } else {
+    /* Timestamps advance at a different pace than the clock, a pad offset */
+    /* cannot rebase them */
+    diff = 0;
+    pts = base_time + (GstClockTime) ((pts_orig - offset_time) / rate);
+  }
 
   // HACK: Change duration 1 to -1 to avoid segmentation fault
   //problems in seeks with some formats
   if (GST_BUFFER_DURATION (buffer) == 1) {
+    buffer = gst_buffer_make_writable (buffer);
     GST_BUFFER_DURATION (buffer) = GST_CLOCK_TIME_NONE;
   }
 
-  GST_LOG_OBJECT (appsink,
-      "Is preroll: %d, buffer: %" GST_PTR_FORMAT ", original pts %"
-      GST_TIME_FORMAT, is_preroll, buffer, GST_TIME_ARGS (pts_orig));
+  GST_LOG_OBJECT (bridge->appsrc,
+      "Is preroll: %d, buffer: %" GST_PTR_FORMAT ", running time %"
+      GST_TIME_FORMAT, is_preroll, buffer, GST_TIME_ARGS (pts));
 
-  if (pts_data->last_pts != GST_CLOCK_TIME_NONE &&
-      GST_BUFFER_PTS (buffer) <= pts_data->last_pts) {
-    GST_ERROR_OBJECT (appsink,
+  if (pts_data->last_pts != GST_CLOCK_TIME_NONE && pts <= pts_data->last_pts) {
+    GST_ERROR_OBJECT (bridge->appsrc,
         "Non incremental PTS assignment (last PTS: %"
         GST_TIME_FORMAT ", PTS: %" GST_TIME_FORMAT
         ", is preroll: %d). Not pushing", GST_TIME_ARGS (pts_data->last_pts),
-        GST_TIME_ARGS (GST_BUFFER_PTS (buffer)), is_preroll);
+        GST_TIME_ARGS (pts), is_preroll);
     goto end;
   }
 
-  pts_data->last_pts = GST_BUFFER_PTS (buffer);
+  pts_data->last_pts = pts;
   pts_data->last_pts_orig = pts_orig;
 
-push:
-  src = gst_element_get_static_pad (GST_ELEMENT (appsrc), "src");
-  sink = gst_pad_get_peer (src);
-  g_object_unref (src);
-
-  if (sink != NULL) {
-    if (GST_OBJECT_FLAG_IS_SET (sink, GST_PAD_FLAG_EOS)) {
-      GST_INFO_OBJECT (sink, "Sending flush events");
-      gst_pad_send_event (sink, gst_event_new_flush_start ());
-      gst_pad_send_event (sink, gst_event_new_flush_stop (FALSE));
+  if (rate != 1.0) {
+    gint64 dts_diff;
+
+    buffer = gst_buffer_make_writable (buffer);
+    dts_diff = (gint64) (GST_BUFFER_DTS (buffer) - offset_time) / rate;
+    GST_BUFFER_DTS (buffer) = MAX ((gint64) base_time + dts_diff, 0);
+    GST_BUFFER_PTS (buffer) = pts;
+    if (GST_BUFFER_DURATION_IS_VALID (buffer)) {
+      GST_BUFFER_DURATION (buffer) /= rate;
     }
-    g_object_unref (sink);
   }
 
-  ret = gst_app_src_push_buffer (appsrc, buffer);
+  if (diff != bridge->offset) {
+    kms_player_bridge_set_offset (bridge, diff);
+  }
+
+push:
+  if (bridge->peer != NULL &&
+      GST_OBJECT_FLAG_IS_SET (bridge->peer, GST_PAD_FLAG_EOS)) {
+    GST_INFO_OBJECT (bridge->peer, "Sending flush events");
+    gst_pad_send_event (bridge->peer, gst_event_new_flush_start ());
+    gst_pad_send_event (bridge->peer, gst_event_new_flush_stop (FALSE));
+  }
+
+  ret = gst_app_src_push_buffer (bridge->appsrc, buffer);
   buffer = NULL;
-  if (ret != GST_FLOW_OK) {
-    GST_ERROR_OBJECT (appsink,
-        "Could not send buffer to '%s'. Cause: %s",
-        GST_ELEMENT_NAME (appsrc), gst_flow_get_name (ret));
+  if (ret == GST_FLOW_OK) {
+    g_mutex_lock (&bridge->lock);
+    bridge->pushed++;
+    g_mutex_unlock (&bridge->lock);
+  } else {
+    GST_ERROR_OBJECT (bridge->appsrc, "Could not send buffer. Cause: %s",
+        gst_flow_get_name (ret));
   }
 
 end:
@@ -602,6 +1151,50 @@ end:
     gst_buffer_unref (buffer);
   }
 
+  return ret;
+}
+
+static GstFlowReturn
+process_sample (GstAppSink * appsink, KmsPlayerBridge * bridge,
+    GstSample * sample, gboolean is_preroll)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBufferList *list;
+  GstBuffer *buffer;
+  GstSegment *segment;
+  gdouble rate = 1.0;
+  guint i;
+
+  if (sample == NULL) {
+    GST_ERROR_OBJECT (appsink, "Cannot get sample");
+    return GST_FLOW_OK;
+  }
+
+  segment = gst_sample_get_segment (sample);
+  if (segment != NULL && segment->rate > 0.0) {
+    rate = segment->rate;
+  }
+
+  list = gst_sample_get_buffer_list (sample);
+  buffer = gst_sample_get_buffer (sample);
+
+  if (list != NULL) {
+    for (i = 0; i < gst_buffer_list_length (list) && ret == GST_FLOW_OK; i++) {
+      ret = process_buffer (bridge,
+          gst_buffer_ref (gst_buffer_list_get (list, i)), rate, is_preroll);
+    }
+  } else if (buffer != NULL) {
+    gst_buffer_ref (buffer);
+    /* Leaves the buffer with a single reference, so that the rare cases */
+    /* that need to modify it do not copy it */
+    gst_sample_unref (sample);
+    sample = NULL;
+
+    ret = process_buffer (bridge, buffer, rate, is_preroll);
+  } else {
+    GST_ERROR_OBJECT (appsink, "Cannot get buffer");
+  }
+
   if (sample != NULL) {
     gst_sample_unref (sample);
   }
@@ -616,7 +1209,7 @@ appsink_new_preroll_cb (GstAppSink * appsink, gpointer user_data)
 
   sample = gst_app_sink_pull_preroll (appsink);
 
-  return process_sample (appsink, GST_APP_SRC (user_data), sample, IS_PREROLL);
+  return process_sample (appsink, user_data, sample, IS_PREROLL);
 }
 
 static GstFlowReturn
@@ -626,30 +1219,25 @@ appsink_new_sample_cb (GstAppSink * appsink, gpointer user_data)
 
   sample = gst_app_sink_pull_sample (appsink);
 
-  return process_sample (appsink, GST_APP_SRC (user_data), sample, !IS_PREROLL);
+  return process_sample (appsink, user_data, sample, !IS_PREROLL);
 }
 
 static void
 appsink_eos_cb (GstAppSink * appsink, gpointer user_data)
 {
-  GstAppSrc *appsrc = GST_APP_SRC (user_data);
+  KmsPlayerBridge *bridge = user_data;
   GstFlowReturn ret;
-  GstPad *pad;
 
   GST_DEBUG_OBJECT (appsink, "Send EOS event to main pipeline (via %s)",
-      GST_ELEMENT_NAME (appsrc));
-  ret = gst_app_src_end_of_stream (appsrc);
+      GST_ELEMENT_NAME (bridge->appsrc));
+  ret = gst_app_src_end_of_stream (bridge->appsrc);
   GST_DEBUG_OBJECT (appsink, "Send EOS return: %s", gst_flow_get_name (ret));
 
-  pad = gst_element_get_static_pad (GST_ELEMENT (appsrc), "src");
-  if (pad != NULL) {
-    GST_INFO_OBJECT (pad, "Send flush events");
-
-    gst_pad_send_event (pad, gst_event_new_flush_start ());
-    gst_pad_send_event (pad, gst_event_new_flush_stop (FALSE));
+  GST_INFO_OBJECT (bridge->srcpad, "Send flush events");
 
-    g_object_unref (pad);
-  }
+  gst_pad_send_event (bridge->srcpad, gst_event_new_flush_start ());
+  gst_pad_send_event (bridge->srcpad, gst_event_new_flush_stop (FALSE));
+  kms_player_bridge_flushed (bridge);
 }
 
 static GstPadProbeReturn
@@ -753,6 +1341,12 @@ kms_player_end_point_get_agnostic_for_pad (KmsPlayerEndpoint * self,
     GST_DEBUG_OBJECT (pad, "Detected video caps");
     agnosticbin = kms_element_get_video_agnosticbin (KMS_ELEMENT (self));
     kms_player_end_point_add_stat_probe (self, pad, KMS_MEDIA_TYPE_VIDEO);
+
+    if (!gst_structure_has_name (gst_caps_get_structure (caps, 0),
+            "video/x-raw")) {
+      /* Not decoded, so its keyframes are indexed here */
+      kms_player_endpoint_add_keyframe_probe (self, pad);
+    }
   }
 
   gst_caps_unref (caps);
@@ -819,8 +1413,8 @@ appsink_event_query_probe (GstPad * pad, GstPadProbeInfo * info, gpointer elemen
 }
 
 static void
-kms_player_endpoint_uridecodebin_pad_added (GstElement * element, GstPad * pad,
-    KmsPlayerEndpoint * self)
+kms_player_endpoint_link_stream (KmsPlayerEndpoint * self,
+    GstElement * pipeline, GstPad * pad)
 {
   GstElement *appsink, *appsrc;
   GstElement *agnosticbin;
@@ -833,6 +1427,7 @@ kms_player_endpoint_uridecodebin_pad_added (GstElement * element, GstPad * pad,
 
   if (agnosticbin != NULL) {
     GstAppSinkCallbacks callbacks;
+    KmsPlayerBridge *bridge;
 
     /* Create appsink */
     appsink = gst_element_factory_make ("appsink", NULL);
@@ -841,15 +1436,17 @@ kms_player_endpoint_uridecodebin_pad_added (GstElement * element, GstPad * pad,
     g_object_set (appsink, "enable-last-sample", FALSE, "emit-signals", FALSE,
         "qos", FALSE, "max-buffers", 1, NULL);
 
+    bridge = kms_player_bridge_new (self, appsrc, agnosticbin ==
+        kms_element_get_audio_agnosticbin (KMS_ELEMENT (self)));
+    g_object_set_qdata_full (G_OBJECT (appsink), bridge_quark (), bridge,
+        kms_player_bridge_destroy);
+
     callbacks.eos = appsink_eos_cb;
     callbacks.new_preroll = appsink_new_preroll_cb;
     callbacks.new_sample = appsink_new_sample_cb;
-    gst_app_sink_set_callbacks (GST_APP_SINK (appsink), &callbacks, appsrc,
+    gst_app_sink_set_callbacks (GST_APP_SINK (appsink), &callbacks, bridge,
         NULL);
 
-    g_object_set_qdata_full (G_OBJECT (appsink), pts_quark (),
-        kms_pts_data_new (), kms_pts_data_destroy);
-
     g_object_set_qdata (G_OBJECT (pad), appsink_quark (), appsink);
     g_object_set_qdata (G_OBJECT (pad), appsrc_quark (), appsrc);
   } else {
@@ -868,7 +1465,7 @@ kms_player_endpoint_uridecodebin_pad_added (GstElement * element, GstPad * pad,
         appsrc, NULL);
   }
 
-  gst_bin_add (GST_BIN (self->priv->pipeline), appsink);
+  gst_bin_add (GST_BIN (pipeline), appsink);
 
   link_ret = gst_pad_link (pad, sinkpad);
 
@@ -885,8 +1482,8 @@ kms_player_endpoint_uridecodebin_pad_added (GstElement * element, GstPad * pad,
 }
 
 static void
-kms_player_endpoint_uridecodebin_pad_removed (GstElement * element,
-    GstPad * pad, KmsPlayerEndpoint * self)
+kms_player_endpoint_unlink_stream (KmsPlayerEndpoint * self,
+    GstElement * pipeline, GstPad * pad)
 {
   GstElement *appsink, *appsrc;
 
@@ -907,10 +1504,114 @@ kms_player_endpoint_uridecodebin_pad_removed (GstElement * element,
   }
 
   if (appsink != NULL) {
-    kms_utils_bin_remove (GST_BIN (self->priv->pipeline), appsink);
+    kms_utils_bin_remove (GST_BIN (pipeline), appsink);
   }
 }
 
+static void
+kms_player_endpoint_uridecodebin_pad_added (GstElement * element, GstPad * pad,
+    KmsPlayerEndpoint * self)
+{
+  kms_player_endpoint_link_stream (self, self->priv->pipeline, pad);
+}
+
+static void
+kms_player_endpoint_uridecodebin_pad_removed (GstElement * element,
+    GstPad * pad, KmsPlayerEndpoint * self)
+{
+  kms_player_endpoint_unlink_stream (self, self->priv->pipeline, pad);
+}
+
+static void
+kms_player_endpoint_shared_stream_added (GstElement * pipeline, GstPad * pad,
+    gpointer self)
+{
+  kms_player_endpoint_link_stream (KMS_PLAYER_ENDPOINT (self), pipeline, pad);
+}
+
+static void
+kms_player_endpoint_shared_stream_removed (GstElement * pipeline,
+    GstPad * pad, gpointer self)
+{
+  kms_player_endpoint_unlink_stream (KMS_PLAYER_ENDPOINT (self), pipeline,
+      pad);
+}
+
+static GstBusSyncReply bus_sync_signal_handler (GstBus * bus, GstMessage * msg,
+    gpointer data);
+
+static void
+kms_player_endpoint_shared_message (GstMessage * msg, gpointer self)
+{
+  bus_sync_signal_handler (NULL, msg, self);
+}
+
+static const KmsPlayerSourceCallbacks shared_source_callbacks = {
+  kms_player_endpoint_shared_stream_added,
+  kms_player_endpoint_shared_stream_removed,
+  kms_player_endpoint_shared_message
+};
+
+static void
+kms_player_endpoint_attach_source (KmsPlayerEndpoint * self)
+{
+  KmsPlayerSourceSettings settings;
+  KmsPlayerSource *source;
+
+  if (self->priv->source != NULL) {
+    return;
+  }
+
+  settings.uri = KMS_URI_ENDPOINT (self)->uri;
+  settings.network_cache = self->priv->network_cache;
+  settings.port_range = self->priv->port_range;
+  settings.use_encoded_media = self->priv->use_encoded_media;
+  settings.passthrough = self->priv->passthrough;
+
+  /* Not attached under the element lock: streams are linked meanwhile */
+  source = kms_player_source_attach (&settings, &shared_source_callbacks, self);
+
+  KMS_ELEMENT_LOCK (self);
+  self->priv->source = source;
+  KMS_ELEMENT_UNLOCK (self);
+}
+
+static void
+kms_player_endpoint_detach_source (KmsPlayerEndpoint * self)
+{
+  KmsPlayerSource *source;
+
+  KMS_ELEMENT_LOCK (self);
+  source = self->priv->source;
+  self->priv->source = NULL;
+  KMS_ELEMENT_UNLOCK (self);
+
+  if (source != NULL) {
+    kms_player_source_detach (source, self);
+  }
+}
+
+/* Returns the pipeline the media is being read from */
+static GstElement *
+kms_player_endpoint_ref_pipeline (KmsPlayerEndpoint * self)
+{
+  GstElement *pipeline;
+
+  KMS_ELEMENT_LOCK (self);
+
+  if (self->priv->source != NULL) {
+    pipeline = kms_player_source_get_pipeline (self->priv->source);
+  } else if (self->priv->pipeline != NULL) {
+    pipeline = gst_object_ref (self->priv->pipeline);
+  } else {
+    pipeline = NULL;
+  }
+
+  KMS_ELEMENT_UNLOCK (self);
+
+  return pipeline;
+}
+
 static gboolean
 kms_player_endpoint_stopped (KmsUriEndpoint * obj, GError ** error)
 {
@@ -918,8 +1619,14 @@ kms_player_endpoint_stopped (KmsUriEndpoint * obj, GError ** error)
 
   GST_DEBUG_OBJECT (self, "Pipeline stopped");
 
-  // Set internal pipeline to NULL state
-  kms_player_endpoint_mark_reset_base_time_and_set_state (self, GST_STATE_NULL);
+  if (self->priv->shared_source) {
+    kms_player_endpoint_mark_reset_base_time (self);
+    kms_player_endpoint_detach_source (self);
+  } else {
+    // Set internal pipeline to NULL state
+    kms_player_endpoint_mark_reset_base_time_and_set_state (self,
+        GST_STATE_NULL);
+  }
 
   KMS_URI_ENDPOINT_GET_CLASS (self)->change_state (KMS_URI_ENDPOINT (self),
       KMS_URI_ENDPOINT_STATE_STOP);
@@ -927,6 +1634,111 @@ kms_player_endpoint_stopped (KmsUriEndpoint * obj, GError ** error)
   return TRUE;
 }
 
+static gboolean
+kms_player_endpoint_wants_read_ahead (KmsPlayerEndpoint * self)
+{
+  return (self->priv->read_ahead_bytes > 0 || self->priv->read_ahead_time > 0)
+      && gst_uri_has_protocol (KMS_URI_ENDPOINT (self)->uri, "file");
+}
+
+static void kms_player_endpoint_uridecodebin_source_setup (GstElement *
+    uridecodebin, GstElement * source, KmsPlayerEndpoint * self);
+
+/*
+ * uridecodebin reads local files straight from the demuxer thread. When
+ * reading ahead, the file is read by its own thread into a queue2 instead:
+ * filesrc ! queue2 ! decodebin. This is only done once, the uri does not
+ * change.
+ */
+static void
+kms_player_endpoint_setup_read_ahead (KmsPlayerEndpoint * self)
+{
+  GstElement *filesrc, *queue, *decodebin;
+  guint64 ring_size;
+  GstCaps *caps;
+  gchar *location;
+
+  if (self->priv->read_ahead != NULL) {
+    return;
+  }
+
+  location = gst_uri_get_location (KMS_URI_ENDPOINT (self)->uri);
+  /* Named as the uridecodebin source, errors are reported the same way */
+  filesrc = gst_element_factory_make ("filesrc", "source");
+  g_object_set (filesrc, "location", location, "blocksize",
+      READ_AHEAD_BLOCKSIZE, NULL);
+  g_free (location);
+
+  /* In ring buffer mode the data already read is kept, and seeks into it */
+  /* are served without reading the file again. Without a size in bytes */
+  /* queue2 converts its time limit with the estimated bitrate */
+  ring_size = self->priv->read_ahead_bytes;
+  queue = gst_element_factory_make ("queue2", NULL);
+  g_object_set (queue, "ring-buffer-max-size", ring_size,
+      "max-size-bytes", self->priv->read_ahead_bytes,
+      "max-size-time", self->priv->read_ahead_time * GST_MSECOND,
+      "max-size-buffers", 0, "use-buffering", FALSE, NULL);
+
+  decodebin = gst_element_factory_make ("decodebin", NULL);
+  g_object_get (self->priv->uridecodebin, "caps", &caps, NULL);
+  g_object_set (decodebin, "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  g_signal_connect (decodebin, "pad-added",
+      G_CALLBACK (kms_player_endpoint_uridecodebin_pad_added), self);
+  g_signal_connect (decodebin, "pad-removed",
+      G_CALLBACK (kms_player_endpoint_uridecodebin_pad_removed), self);
+  g_signal_connect (decodebin, "autoplug-select",
+      G_CALLBACK (kms_player_endpoint_uridecodebin_autoplug_select), self);
+  g_signal_connect (decodebin, "element-added",
+      G_CALLBACK (kms_player_endpoint_decodebin_element_added), self);
+
+  gst_bin_remove (GST_BIN (self->priv->pipeline), self->priv->uridecodebin);
+  self->priv->uridecodebin = decodebin;
+
+  gst_bin_add_many (GST_BIN (self->priv->pipeline), filesrc, queue, decodebin,
+      NULL);
+  gst_element_link_many (filesrc, queue, decodebin, NULL);
+
+  KMS_ELEMENT_LOCK (self);
+  self->priv->read_ahead = queue;
+  KMS_ELEMENT_UNLOCK (self);
+
+  kms_player_endpoint_uridecodebin_source_setup (NULL, filesrc, self);
+}
+
+/* Returns how full the read-ahead queue is, in percent, or -1 if none */
+static gint
+kms_player_endpoint_get_read_ahead_level (KmsPlayerEndpoint * self)
+{
+  guint bytes, max_bytes;
+  guint64 time, max_time;
+  guint64 level = 0;
+
+  KMS_ELEMENT_LOCK (self);
+
+  if (self->priv->read_ahead == NULL) {
+    KMS_ELEMENT_UNLOCK (self);
+    return -1;
+  }
+
+  g_object_get (self->priv->read_ahead, "current-level-bytes", &bytes,
+      "max-size-bytes", &max_bytes, "current-level-time", &time,
+      "max-size-time", &max_time, NULL);
+
+  KMS_ELEMENT_UNLOCK (self);
+
+  if (max_bytes > 0) {
+    level = MAX (level, (guint64) bytes * 100 / max_bytes);
+  }
+
+  if (max_time > 0) {
+    level = MAX (level, time * 100 / max_time);
+  }
+
+  return MIN (level, 100);
+}
+
 static gboolean
 kms_player_endpoint_started (KmsUriEndpoint * obj, GError ** error)
 {
@@ -934,9 +1746,25 @@ kms_player_endpoint_started (KmsUriEndpoint * obj, GError ** error)
 
   GST_DEBUG_OBJECT (self, "Pipeline started");
 
-  /* Set uri property in uridecodebin */
-  g_object_set (G_OBJECT (self->priv->uridecodebin), "uri",
-      KMS_URI_ENDPOINT (self)->uri, NULL);
+  if (self->priv->shared_source) {
+    kms_player_endpoint_attach_source (self);
+
+    KMS_URI_ENDPOINT_GET_CLASS (self)->change_state (KMS_URI_ENDPOINT (self),
+        KMS_URI_ENDPOINT_STATE_START);
+
+    return TRUE;
+  }
+
+  if (kms_player_endpoint_wants_read_ahead (self)) {
+    kms_player_endpoint_setup_read_ahead (self);
+  } else {
+    /* Set uri property in uridecodebin */
+    g_object_set (G_OBJECT (self->priv->uridecodebin), "uri",
+        KMS_URI_ENDPOINT (self)->uri, NULL);
+  }
+
+  /* Each playback starts with a rate 1.0 segment */
+  g_atomic_int_set (&self->priv->rate_pending, self->priv->rate != 1.0);
 
   /* Set internal pipeline to playing */
   gst_element_set_state (self->priv->pipeline, GST_STATE_PLAYING);
@@ -952,8 +1780,15 @@ kms_player_endpoint_set_position (KmsPlayerEndpoint * self, gint64 position)
 {
   GstQuery *query;
   GstEvent *seek;
+  GstSeekFlags flags;
+  gdouble rate = self->priv->rate;
   gboolean seekable = FALSE;
 
+  if (self->priv->shared_source) {
+    GST_WARNING_OBJECT (self, "Shared sources cannot be seeked");
+    return FALSE;
+  }
+
   query = gst_query_new_seeking (GST_FORMAT_TIME);
   if (!gst_element_query (self->priv->pipeline, query)) {
     GST_WARNING_OBJECT (self, "File not seekable in format time");
@@ -969,8 +1804,38 @@ kms_player_endpoint_set_position (KmsPlayerEndpoint * self, gint64 position)
     return FALSE;
   }
 
-  seek = gst_event_new_seek (1.0, GST_FORMAT_TIME,
-      GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_TRICKMODE | GST_SEEK_FLAG_ACCURATE,
+  if (self->priv->seek_mode == KMS_PLAYER_SEEK_MODE_KEYFRAME) {
+    GstClockTime keyframe =
+        kms_keyframe_index_lookup (KMS_URI_ENDPOINT (self)->uri, position);
+
+    if (GST_CLOCK_TIME_IS_VALID (keyframe)) {
+      /* Nothing to decode before the target */
+      GST_DEBUG_OBJECT (self, "Seek to indexed keyframe %" GST_TIME_FORMAT,
+          GST_TIME_ARGS (keyframe));
+      position = keyframe;
+      flags = GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE;
+    } else {
+      /* Not indexed yet, let the demuxer find it */
+      flags = GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT |
+          GST_SEEK_FLAG_SNAP_BEFORE;
+    }
+  } else {
+    flags = GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_TRICKMODE |
+        GST_SEEK_FLAG_ACCURATE;
+  }
+
+  if (self->priv->seek_mode == KMS_PLAYER_SEEK_MODE_KEYFRAME &&
+      rate >= TRICKMODE_KEY_UNITS_MIN_RATE) {
+    /* Fast forward showing only keyframes, the rest are not decoded */
+    flags |= GST_SEEK_FLAG_TRICKMODE | GST_SEEK_FLAG_TRICKMODE_KEY_UNITS;
+  }
+
+  if (rate != 1.0) {
+    /* Audio is not played at other rates, so it is not decoded either */
+    flags |= GST_SEEK_FLAG_TRICKMODE | GST_SEEK_FLAG_TRICKMODE_NO_AUDIO;
+  }
+
+  seek = gst_event_new_seek (rate, GST_FORMAT_TIME, flags,
       /* start */ GST_SEEK_TYPE_SET, position,
       /* stop */ GST_SEEK_TYPE_SET, GST_CLOCK_TIME_NONE);
 
@@ -984,6 +1849,55 @@ kms_player_endpoint_set_position (KmsPlayerEndpoint * self, gint64 position)
   return TRUE;
 }
 
+static gboolean
+kms_player_endpoint_apply_rate (gpointer user_data)
+{
+  KmsPlayerEndpoint *self = KMS_PLAYER_ENDPOINT (user_data);
+  gint64 position = 0;
+
+  /* A seek to the current position, so that the new segment carries the */
+  /* rate. The pipeline keeps its state and elements */
+  if (!gst_element_query_position (self->priv->pipeline, GST_FORMAT_TIME,
+          &position)) {
+    GST_WARNING_OBJECT (self, "Cannot get position to change rate");
+    return G_SOURCE_REMOVE;
+  }
+
+  GST_DEBUG_OBJECT (self, "Set rate %f at %" GST_TIME_FORMAT,
+      self->priv->rate, GST_TIME_ARGS (position));
+
+  kms_player_endpoint_set_position (self, position);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+kms_player_endpoint_set_rate (KmsPlayerEndpoint * self, gdouble rate)
+{
+  GstState state, pending;
+
+  if (self->priv->rate == rate) {
+    return;
+  }
+
+  self->priv->rate = rate;
+
+  if (self->priv->shared_source) {
+    GST_WARNING_OBJECT (self, "Shared sources always play at rate 1.0");
+    return;
+  }
+
+  gst_element_get_state (self->priv->pipeline, &state, &pending, 0);
+
+  if (state < GST_STATE_PAUSED || pending != GST_STATE_VOID_PENDING) {
+    /* Not prerolled yet, applied on ASYNC_DONE */
+    g_atomic_int_set (&self->priv->rate_pending, TRUE);
+    return;
+  }
+
+  kms_player_endpoint_apply_rate (self);
+}
+
 static gboolean
 kms_player_endpoint_paused (KmsUriEndpoint * obj, GError ** error)
 {
@@ -992,6 +1906,18 @@ kms_player_endpoint_paused (KmsUriEndpoint * obj, GError ** error)
 
   GST_DEBUG_OBJECT (self, "Pipeline paused");
 
+  if (self->priv->shared_source) {
+    /* Other players keep the source running, this one just leaves it and */
+    /* joins it again, live, when started */
+    kms_player_endpoint_mark_reset_base_time (self);
+    kms_player_endpoint_detach_source (self);
+
+    KMS_URI_ENDPOINT_GET_CLASS (self)->change_state (KMS_URI_ENDPOINT (self),
+        KMS_URI_ENDPOINT_STATE_PAUSE);
+
+    return TRUE;
+  }
+
   /* Set internal pipeline to paused */
   ret =
       kms_player_endpoint_mark_reset_base_time_and_set_state (self,
@@ -1057,6 +1983,35 @@ kms_player_endpoint_collect_media_stats (KmsElement * obj, gboolean enable)
       (kms_player_endpoint_parent_class)->collect_media_stats (obj, enable);
 }
 
+static GstStructure *
+kms_player_endpoint_stats (KmsElement * obj, gchar * selector)
+{
+  KmsPlayerEndpoint *self = KMS_PLAYER_ENDPOINT (obj);
+  GstStructure *stats, *e_stats;
+  gint level;
+
+  /* chain up */
+  stats =
+      KMS_ELEMENT_CLASS (kms_player_endpoint_parent_class)->stats (obj,
+      selector);
+
+  level = kms_player_endpoint_get_read_ahead_level (self);
+
+  if (level < 0) {
+    return stats;
+  }
+
+  e_stats = kms_stats_get_element_stats (stats);
+
+  if (e_stats == NULL) {
+    return stats;
+  }
+
+  gst_structure_set (e_stats, "read-ahead-level", G_TYPE_INT, level, NULL);
+
+  return stats;
+}
+
 static void
 kms_player_endpoint_class_init (KmsPlayerEndpointClass * klass)
 {
@@ -1080,6 +2035,7 @@ kms_player_endpoint_class_init (KmsPlayerEndpointClass * klass)
 
   kms_element_class->collect_media_stats =
       GST_DEBUG_FUNCPTR (kms_player_endpoint_collect_media_stats);
+  kms_element_class->stats = GST_DEBUG_FUNCPTR (kms_player_endpoint_stats);
 
   klass->set_position = kms_player_endpoint_set_position;
 
@@ -1089,6 +2045,19 @@ kms_player_endpoint_class_init (KmsPlayerEndpointClass * klass)
           "could have an unexpected behaviour if keyframes are lost",
           FALSE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
 
+  g_object_class_install_property (gobject_class, PROP_PASSTHROUGH,
+      g_param_spec_boolean ("passthrough", "passthrough",
+          "Like use-encoded-media, but streams that are not in a supported "
+          "format are discarded instead of decoded. No decoder is created",
+          FALSE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_SHARED_SOURCE,
+      g_param_spec_boolean ("shared-source", "Shared source",
+          "Share the ingest and decoding with the other players of the same "
+          "uri and settings. Shared sources cannot be seeked, and pausing "
+          "just stops receiving from it",
+          FALSE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
   g_object_class_install_property (gobject_class, PROP_VIDEO_DATA,
       g_param_spec_boxed ("video-data", "video data",
           "Get video data from played data",
@@ -1105,12 +2074,48 @@ kms_player_endpoint_class_init (KmsPlayerEndpointClass * klass)
           0, G_MAXINT, NETWORK_CACHE_DEFAULT,
           G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
 
+  g_object_class_install_property (gobject_class, PROP_READ_AHEAD_BYTES,
+      g_param_spec_int ("read-ahead-bytes", "Read-ahead bytes",
+          "When playing local files, read up to this amount of bytes ahead "
+          "of the demuxer in its own thread. Data already read is reused "
+          "by seeks (0 = disabled)",
+          0, G_MAXINT, READ_AHEAD_BYTES_DEFAULT,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_READ_AHEAD_TIME,
+      g_param_spec_int ("read-ahead-time", "Read-ahead time",
+          "When playing local files, read up to this amount of ms ahead "
+          "of the demuxer in its own thread (0 = disabled)",
+          0, G_MAXINT, READ_AHEAD_TIME_DEFAULT,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_READ_AHEAD_LEVEL,
+      g_param_spec_int ("read-ahead-level", "Read-ahead level",
+          "Fill level of the read-ahead queue in percent, -1 if not used",
+          -1, 100, -1, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (gobject_class, PROP_PORT_RANGE,
       g_param_spec_string ("port-range", "UDP port range for RTSP client",
           "Range of ports that can be allocated when acting as RTSP client, "
           "eg. '3000-3005' ('0-0' = no restrictions)", PORT_RANGE_DEFAULT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_SEEK_MODE,
+      g_param_spec_enum ("seek-mode", "Seek mode",
+          "How set-position seeks: decoding forward from the previous "
+          "keyframe up to the exact position, or jumping to that keyframe",
+          KMS_TYPE_PLAYER_SEEK_MODE, SEEK_MODE_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_RATE,
+      g_param_spec_double ("rate", "Playback rate",
+          "Playback speed, 1.0 being normal speed. Changed on the current "
+          "playback without restarting it. In keyframe seek mode, rates "
+          "from 2.0 on only decode keyframes. Audio is muted at rates other "
+          "than 1.0. Ignored by shared sources",
+          RATE_MIN, RATE_MAX, RATE_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (gobject_class, PROP_PIPELINE,
       g_param_spec_object ("pipeline", "Internal pipeline",
           "PlayerEndpoint's private pipeline",
@@ -1238,6 +2243,14 @@ bus_sync_signal_handler (GstBus * bus, GstMessage * msg, gpointer data)
     kms_loop_idle_add_full (self->priv->loop, G_PRIORITY_HIGH_IDLE,
         kms_player_endpoint_emit_EOS_signal, g_object_ref (self),
         g_object_unref);
+  } else if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ASYNC_DONE &&
+      GST_MESSAGE_SRC (msg) == GST_OBJECT (self->priv->pipeline)) {
+    if (g_atomic_int_compare_and_exchange (&self->priv->rate_pending, TRUE,
+            FALSE)) {
+      kms_loop_idle_add_full (self->priv->loop, G_PRIORITY_HIGH_IDLE,
+          kms_player_endpoint_apply_rate, g_object_ref (self),
+          g_object_unref);
+    }
   } else if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
     if (g_str_has_prefix (GST_OBJECT_NAME (msg->src), "decodebin")) {
       kms_loop_idle_add_full (self->priv->loop, G_PRIORITY_HIGH_IDLE,
@@ -1291,14 +2304,18 @@ kms_player_endpoint_uridecodebin_element_added (GstBin * bin,
     GstElement * element, gpointer data)
 {
   KmsPlayerEndpoint *self = KMS_PLAYER_ENDPOINT (data);
+  const gchar *name = gst_plugin_feature_get_name (GST_PLUGIN_FEATURE
+      (gst_element_get_factory (element)));
 
-  if (g_strcmp0 (gst_plugin_feature_get_name (GST_PLUGIN_FEATURE
-              (gst_element_get_factory (element))), RTSPSRC) == 0) {
+  if (g_strcmp0 (name, RTSPSRC) == 0) {
     g_object_set (G_OBJECT (element),
         "latency", self->priv->network_cache,
         "drop-on-latency", TRUE,
         "port-range", self->priv->port_range,
         NULL);
+  } else if (g_strcmp0 (name, "decodebin") == 0) {
+    g_signal_connect (element, "element-added",
+        G_CALLBACK (kms_player_endpoint_decodebin_element_added), self);
   }
 }
 
@@ -1369,6 +2386,8 @@ kms_player_endpoint_init (KmsPlayerEndpoint * self)
       gst_element_factory_make ("uridecodebin", NULL);
   self->priv->network_cache = NETWORK_CACHE_DEFAULT;
   self->priv->port_range = g_strdup (PORT_RANGE_DEFAULT);
+  self->priv->seek_mode = SEEK_MODE_DEFAULT;
+  self->priv->rate = RATE_DEFAULT;
 
   self->priv->stats.probes = kms_list_new_full (g_direct_equal, g_object_unref,
       (GDestroyNotify) kms_stats_probe_destroy);
@@ -1382,6 +2401,8 @@ kms_player_endpoint_init (KmsPlayerEndpoint * self)
       G_CALLBACK (kms_player_endpoint_uridecodebin_source_setup), self);
   g_signal_connect (self->priv->uridecodebin, "element-added",
       G_CALLBACK (kms_player_endpoint_uridecodebin_element_added), self);
+  g_signal_connect (self->priv->uridecodebin, "autoplug-select",
+      G_CALLBACK (kms_player_endpoint_uridecodebin_autoplug_select), self);
 
   /* Eat all async messages such as buffering messages */
   bus = gst_pipeline_get_bus (GST_PIPELINE (self->priv->pipeline));
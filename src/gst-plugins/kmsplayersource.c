@@ -0,0 +1,447 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "kmsplayersource.h"
+#include "kmsautoplugselectresult.h"
+#include <commons/kmsutils.h>
+#include <commons/kmsagnosticcaps.h>
+
+#define RTSPSRC "rtspsrc"
+
+GST_DEBUG_CATEGORY_STATIC (kms_player_source_debug_category);
+#define GST_CAT_DEFAULT kms_player_source_debug_category
+
+typedef struct _KmsPlayerSourceClient
+{
+  KmsPlayerSourceCallbacks callbacks;
+  gpointer user_data;
+} KmsPlayerSourceClient;
+
+/* Per player part of a stream */
+typedef struct _KmsPlayerSourceBranch
+{
+  GstPad *teepad;
+  GstElement *queue;
+} KmsPlayerSourceBranch;
+
+typedef struct _KmsPlayerSourceStream
+{
+  GstElement *tee;
+  GHashTable *branches;         /* <user_data, KmsPlayerSourceBranch> */
+} KmsPlayerSourceStream;
+
+struct _KmsPlayerSource
+{
+  gchar *key;
+  GstElement *pipeline;
+  GstElement *uridecodebin;
+  gint network_cache;
+  gchar *port_range;
+  gboolean passthrough;
+
+  GRecMutex mutex;
+  GSList *clients;
+  GHashTable *streams;          /* <GstPad, KmsPlayerSourceStream> */
+};
+
+/* Sources being played, by settings */
+G_LOCK_DEFINE_STATIC (sources);
+static GHashTable *sources = NULL;
+
+#define KMS_PLAYER_SOURCE_LOCK(source) \
+  (g_rec_mutex_lock (&(source)->mutex))
+#define KMS_PLAYER_SOURCE_UNLOCK(source) \
+  (g_rec_mutex_unlock (&(source)->mutex))
+
+static gchar *
+kms_player_source_settings_to_key (const KmsPlayerSourceSettings * settings)
+{
+  return g_strdup_printf ("%s|%d|%s|%d|%d", settings->uri,
+      settings->network_cache, settings->port_range,
+      settings->use_encoded_media, settings->passthrough);
+}
+
+static KmsPlayerSourceClient *
+kms_player_source_find_client (KmsPlayerSource * source, gpointer user_data)
+{
+  GSList *l;
+
+  for (l = source->clients; l != NULL; l = l->next) {
+    KmsPlayerSourceClient *client = l->data;
+
+    if (client->user_data == user_data) {
+      return client;
+    }
+  }
+
+  return NULL;
+}
+
+static void
+kms_player_source_add_branch (KmsPlayerSource * source,
+    KmsPlayerSourceStream * stream, KmsPlayerSourceClient * client)
+{
+  KmsPlayerSourceBranch *branch;
+  GstPad *sinkpad, *srcpad;
+
+  branch = g_slice_new0 (KmsPlayerSourceBranch);
+  branch->queue = gst_element_factory_make ("queue", NULL);
+  /* A slow player must not hold the others back */
+  g_object_set (branch->queue, "leaky", 2, NULL);
+
+  gst_bin_add (GST_BIN (source->pipeline), branch->queue);
+  gst_element_sync_state_with_parent (branch->queue);
+
+  branch->teepad = gst_element_get_request_pad (stream->tee, "src_%u");
+  sinkpad = gst_element_get_static_pad (branch->queue, "sink");
+  gst_pad_link (branch->teepad, sinkpad);
+  g_object_unref (sinkpad);
+
+  g_hash_table_insert (stream->branches, client->user_data, branch);
+
+  srcpad = gst_element_get_static_pad (branch->queue, "src");
+  client->callbacks.stream_added (source->pipeline, srcpad, client->user_data);
+  g_object_unref (srcpad);
+}
+
+static void
+kms_player_source_remove_branch (KmsPlayerSource * source,
+    KmsPlayerSourceStream * stream, KmsPlayerSourceClient * client)
+{
+  KmsPlayerSourceBranch *branch;
+  GstPad *srcpad;
+
+  branch = g_hash_table_lookup (stream->branches, client->user_data);
+  if (branch == NULL) {
+    return;
+  }
+
+  g_hash_table_steal (stream->branches, client->user_data);
+
+  /* Stop the data first, so that the player branch is removed idle */
+  gst_element_release_request_pad (stream->tee, branch->teepad);
+  g_object_unref (branch->teepad);
+
+  srcpad = gst_element_get_static_pad (branch->queue, "src");
+  client->callbacks.stream_removed (source->pipeline, srcpad,
+      client->user_data);
+  g_object_unref (srcpad);
+
+  kms_utils_bin_remove (GST_BIN (source->pipeline), branch->queue);
+
+  g_slice_free (KmsPlayerSourceBranch, branch);
+}
+
+static void
+kms_player_source_stream_destroy (gpointer data)
+{
+  KmsPlayerSourceStream *stream = data;
+
+  g_hash_table_unref (stream->branches);
+  g_slice_free (KmsPlayerSourceStream, stream);
+}
+
+static void
+kms_player_source_pad_added (GstElement * element, GstPad * pad,
+    KmsPlayerSource * source)
+{
+  KmsPlayerSourceStream *stream;
+  GstPad *sinkpad;
+  GSList *l;
+
+  GST_DEBUG_OBJECT (pad, "Shared stream added");
+
+  stream = g_slice_new0 (KmsPlayerSourceStream);
+  stream->branches = g_hash_table_new (NULL, NULL);
+  stream->tee = gst_element_factory_make ("tee", NULL);
+  g_object_set (stream->tee, "allow-not-linked", TRUE, NULL);
+
+  gst_bin_add (GST_BIN (source->pipeline), stream->tee);
+  gst_element_sync_state_with_parent (stream->tee);
+
+  sinkpad = gst_element_get_static_pad (stream->tee, "sink");
+  gst_pad_link (pad, sinkpad);
+  g_object_unref (sinkpad);
+
+  KMS_PLAYER_SOURCE_LOCK (source);
+
+  g_hash_table_insert (source->streams, pad, stream);
+
+  for (l = source->clients; l != NULL; l = l->next) {
+    kms_player_source_add_branch (source, stream, l->data);
+  }
+
+  KMS_PLAYER_SOURCE_UNLOCK (source);
+}
+
+static void
+kms_player_source_pad_removed (GstElement * element, GstPad * pad,
+    KmsPlayerSource * source)
+{
+  KmsPlayerSourceStream *stream;
+  GSList *l;
+
+  if (GST_PAD_IS_SINK (pad)) {
+    return;
+  }
+
+  GST_DEBUG_OBJECT (pad, "Shared stream removed");
+
+  KMS_PLAYER_SOURCE_LOCK (source);
+
+  stream = g_hash_table_lookup (source->streams, pad);
+  if (stream == NULL) {
+    KMS_PLAYER_SOURCE_UNLOCK (source);
+    return;
+  }
+
+  g_hash_table_steal (source->streams, pad);
+
+  for (l = source->clients; l != NULL; l = l->next) {
+    kms_player_source_remove_branch (source, stream, l->data);
+  }
+
+  KMS_PLAYER_SOURCE_UNLOCK (source);
+
+  kms_utils_bin_remove (GST_BIN (source->pipeline), stream->tee);
+  kms_player_source_stream_destroy (stream);
+}
+
+static KmsAutoplugSelectResult
+kms_player_source_autoplug_select (GstElement * uridecodebin, GstPad * pad,
+    GstCaps * caps, GstElementFactory * factory, KmsPlayerSource * source)
+{
+  if (source->passthrough &&
+      gst_element_factory_list_is_type (factory,
+          GST_ELEMENT_FACTORY_TYPE_DECODER)) {
+    return KMS_AUTOPLUG_SELECT_SKIP;
+  }
+
+  return KMS_AUTOPLUG_SELECT_TRY;
+}
+
+static void
+kms_player_source_element_added (GstBin * bin, GstElement * element,
+    KmsPlayerSource * source)
+{
+  if (g_strcmp0 (gst_plugin_feature_get_name (GST_PLUGIN_FEATURE
+              (gst_element_get_factory (element))), RTSPSRC) == 0) {
+    g_object_set (G_OBJECT (element),
+        "latency", source->network_cache,
+        "drop-on-latency", TRUE, "port-range", source->port_range, NULL);
+  }
+}
+
+static GstBusSyncReply
+kms_player_source_bus_sync_handler (GstBus * bus, GstMessage * msg,
+    gpointer data)
+{
+  KmsPlayerSource *source = data;
+  GSList *l;
+
+  KMS_PLAYER_SOURCE_LOCK (source);
+
+  for (l = source->clients; l != NULL; l = l->next) {
+    KmsPlayerSourceClient *client = l->data;
+
+    client->callbacks.message (msg, client->user_data);
+  }
+
+  KMS_PLAYER_SOURCE_UNLOCK (source);
+
+  return GST_BUS_PASS;
+}
+
+static KmsPlayerSource *
+kms_player_source_new (const KmsPlayerSourceSettings * settings,
+    gchar * key)
+{
+  KmsPlayerSource *source = g_slice_new0 (KmsPlayerSource);
+  GstBus *bus;
+
+  source->key = key;
+  source->network_cache = settings->network_cache;
+  source->port_range = g_strdup (settings->port_range);
+  source->passthrough = settings->passthrough;
+  source->streams = g_hash_table_new_full (NULL, NULL, NULL,
+      kms_player_source_stream_destroy);
+  g_rec_mutex_init (&source->mutex);
+
+  source->pipeline = gst_pipeline_new ("sharedpipeline");
+  source->uridecodebin = gst_element_factory_make ("uridecodebin", NULL);
+  g_object_set (source->uridecodebin, "uri", settings->uri, "download", TRUE,
+      NULL);
+
+  if (settings->use_encoded_media || settings->passthrough) {
+    GstCaps *caps = gst_caps_from_string (KMS_AGNOSTIC_NO_RTP_CAPS);
+
+    g_object_set (source->uridecodebin, "caps", caps, NULL);
+    gst_caps_unref (caps);
+  }
+
+  g_signal_connect (source->uridecodebin, "pad-added",
+      G_CALLBACK (kms_player_source_pad_added), source);
+  g_signal_connect (source->uridecodebin, "pad-removed",
+      G_CALLBACK (kms_player_source_pad_removed), source);
+  g_signal_connect (source->uridecodebin, "element-added",
+      G_CALLBACK (kms_player_source_element_added), source);
+  g_signal_connect (source->uridecodebin, "autoplug-select",
+      G_CALLBACK (kms_player_source_autoplug_select), source);
+
+  gst_bin_add (GST_BIN (source->pipeline), source->uridecodebin);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (source->pipeline));
+  gst_bus_set_sync_handler (bus, kms_player_source_bus_sync_handler, source,
+      NULL);
+  g_object_unref (bus);
+
+  return source;
+}
+
+static void
+kms_player_source_destroy (KmsPlayerSource * source)
+{
+  GstBus *bus;
+
+  GST_DEBUG ("Stopping shared source %s", source->key);
+
+  /* Removes the remaining streams through pad-removed */
+  gst_element_set_state (source->pipeline, GST_STATE_NULL);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (source->pipeline));
+  gst_bus_set_sync_handler (bus, NULL, NULL, NULL);
+  g_object_unref (bus);
+
+  g_signal_handlers_disconnect_by_data (source->uridecodebin, source);
+  gst_object_unref (source->pipeline);
+
+  g_hash_table_unref (source->streams);
+  g_rec_mutex_clear (&source->mutex);
+  g_free (source->port_range);
+  g_free (source->key);
+
+  g_slice_free (KmsPlayerSource, source);
+}
+
+KmsPlayerSource *
+kms_player_source_attach (const KmsPlayerSourceSettings * settings,
+    const KmsPlayerSourceCallbacks * callbacks, gpointer user_data)
+{
+  static gsize debug_init = 0;
+  KmsPlayerSourceClient *client;
+  KmsPlayerSource *source;
+  GHashTableIter iter;
+  gpointer stream;
+  gboolean start;
+  gchar *key;
+
+  if (g_once_init_enter (&debug_init)) {
+    GST_DEBUG_CATEGORY_INIT (kms_player_source_debug_category,
+        "playersource", 0, "Shared source of PlayerEndpoints");
+    g_once_init_leave (&debug_init, 1);
+  }
+
+  key = kms_player_source_settings_to_key (settings);
+
+  G_LOCK (sources);
+
+  if (sources == NULL) {
+    sources = g_hash_table_new (g_str_hash, g_str_equal);
+  }
+
+  source = g_hash_table_lookup (sources, key);
+  if (source == NULL) {
+    GST_DEBUG ("Creating shared source %s", key);
+    source = kms_player_source_new (settings, key);
+    g_hash_table_insert (sources, source->key, source);
+  } else {
+    g_free (key);
+  }
+
+  KMS_PLAYER_SOURCE_LOCK (source);
+
+  G_UNLOCK (sources);
+
+  client = g_slice_new0 (KmsPlayerSourceClient);
+  client->callbacks = *callbacks;
+  client->user_data = user_data;
+
+  start = source->clients == NULL;
+  source->clients = g_slist_prepend (source->clients, client);
+
+  g_hash_table_iter_init (&iter, source->streams);
+  while (g_hash_table_iter_next (&iter, NULL, &stream)) {
+    kms_player_source_add_branch (source, stream, client);
+  }
+
+  KMS_PLAYER_SOURCE_UNLOCK (source);
+
+  if (start) {
+    gst_element_set_state (source->pipeline, GST_STATE_PLAYING);
+  }
+
+  return source;
+}
+
+void
+kms_player_source_detach (KmsPlayerSource * source, gpointer user_data)
+{
+  KmsPlayerSourceClient *client;
+  GHashTableIter iter;
+  gpointer stream;
+  gboolean last;
+
+  G_LOCK (sources);
+  KMS_PLAYER_SOURCE_LOCK (source);
+
+  client = kms_player_source_find_client (source, user_data);
+  if (client == NULL) {
+    KMS_PLAYER_SOURCE_UNLOCK (source);
+    G_UNLOCK (sources);
+    return;
+  }
+
+  g_hash_table_iter_init (&iter, source->streams);
+  while (g_hash_table_iter_next (&iter, NULL, &stream)) {
+    kms_player_source_remove_branch (source, stream, client);
+  }
+
+  source->clients = g_slist_remove (source->clients, client);
+  g_slice_free (KmsPlayerSourceClient, client);
+
+  last = source->clients == NULL;
+  if (last) {
+    /* New players will open a new source from now on */
+    g_hash_table_remove (sources, source->key);
+  }
+
+  KMS_PLAYER_SOURCE_UNLOCK (source);
+  G_UNLOCK (sources);
+
+  if (last) {
+    kms_player_source_destroy (source);
+  }
+}
+
+GstElement *
+kms_player_source_get_pipeline (KmsPlayerSource * source)
+{
+  return gst_object_ref (source->pipeline);
+}
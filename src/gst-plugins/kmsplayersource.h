@@ -0,0 +1,69 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _KMS_PLAYER_SOURCE_H_
+#define _KMS_PLAYER_SOURCE_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Ingest and decode of one URI shared by every player attached with the same
+ * settings. The source runs its own pipeline while it has players attached.
+ * Each player gets a branch of every decoded stream, which it links as it
+ * would link a uridecodebin pad, and every message posted on the pipeline.
+ */
+typedef struct _KmsPlayerSource KmsPlayerSource;
+
+typedef struct _KmsPlayerSourceSettings
+{
+  const gchar *uri;
+  gint network_cache;
+  const gchar *port_range;
+  gboolean use_encoded_media;
+  gboolean passthrough;
+} KmsPlayerSourceSettings;
+
+typedef struct _KmsPlayerSourceCallbacks
+{
+  void (*stream_added) (GstElement * pipeline, GstPad * pad,
+      gpointer user_data);
+  void (*stream_removed) (GstElement * pipeline, GstPad * pad,
+      gpointer user_data);
+  void (*message) (GstMessage * msg, gpointer user_data);
+} KmsPlayerSourceCallbacks;
+
+/*
+ * Callbacks may be called from streaming threads, and for streams that
+ * already exist before this function returns. user_data identifies the
+ * player in kms_player_source_detach.
+ */
+KmsPlayerSource *kms_player_source_attach (
+    const KmsPlayerSourceSettings * settings,
+    const KmsPlayerSourceCallbacks * callbacks, gpointer user_data);
+
+/*
+ * Removes the branches of the player, calling stream_removed for each of
+ * them. The source stops when its last player is detached.
+ */
+void kms_player_source_detach (KmsPlayerSource * source, gpointer user_data);
+
+/* Returns a new reference to the pipeline of the source */
+GstElement *kms_player_source_get_pipeline (KmsPlayerSource * source);
+
+G_END_DECLS
+#endif /* _KMS_PLAYER_SOURCE_H_ */
@@ -21,10 +21,16 @@
 
 #include <commons/kms-core-marshal.h>
 #include "kmsselectablemixer.h"
+#include "kmshubrouting.h"
 #include <commons/kmshubport.h>
 
 #define PLUGIN_NAME "selectablemixer"
 
+/* Sources a mix adds to a shared one to be built on it */
+#define MAX_INCREMENTAL_SOURCES 2
+/* Sources a port must hear, besides itself, to use a mix-minus group */
+#define MIN_GROUP_SOURCES 2
+
 #define KMS_SELECTABLE_MIXER_LOCK(e) \
   (g_rec_mutex_lock (&(e)->priv->mutex))
 
@@ -46,6 +52,45 @@ struct _KmsSelectableMixerPrivate
 {
   GRecMutex mutex;
   GHashTable *ports;
+  /* Audio mixes by source set key */
+  GHashTable *mixes;
+  /* Mix-minus groups by source set key */
+  GHashTable *groups;
+};
+
+typedef struct _KmsSelectableMixerMix KmsSelectableMixerMix;
+typedef struct _KmsSelectableMixerGroup KmsSelectableMixerGroup;
+
+/*
+ * Mix-minus of a set of sources. Its "src" output is the mix of the whole
+ * set and "src_N" the mix without source N, so all the ports that hear
+ * everyone in the set but themselves share a single mix.
+ */
+struct _KmsSelectableMixerGroup
+{
+  gchar *key;
+  GArray *sources;
+  GstElement *mixminus;
+  guint refs;
+};
+
+/*
+ * Audio mix of a set of sources, shared by every port listening to exactly
+ * that set. A mix may be built as a smaller one plus a few sources, or be
+ * taken from an output of a mix-minus group, in which case it has no
+ * audiomixer.
+ */
+struct _KmsSelectableMixerMix
+{
+  gchar *key;
+  GArray *sources;
+  GstElement *audiomixer;
+  GstElement *tee;
+  KmsSelectableMixerMix *base;
+  KmsSelectableMixerGroup *group;
+  /* Source left out of the group output, -1 for the whole set */
+  gint minus;
+  guint refs;
 };
 
 typedef struct _KmsSelectableMixerPortData KmsSelectableMixerPortData;
@@ -53,12 +98,31 @@ typedef struct _KmsSelectableMixerPortData KmsSelectableMixerPortData;
 struct _KmsSelectableMixerPortData
 {
   KmsSelectableMixer *mixer;
-  GstElement *audiomixer;
   gint id;
+  /* Sorted ids of the ports it listens to, and their mix */
+  GArray *audio_sources;
+  KmsSelectableMixerMix *mix;
   GstElement *audio_agnostic;
   GstElement *video_agnostic;
+
+  /* Port this one takes video from, -1 if none */
+  gint video_source;
 };
 
+/* Entry of a routing batch, see kms_selectable_mixer_parse_route */
+typedef struct _KmsSelectableMixerRoute
+{
+  KmsSelectableMixerPortData *source;
+  KmsSelectableMixerPortData *sink;
+  gboolean audio;
+  gboolean connect;
+
+  /* To roll it back: whether the audio set changed, and the video source */
+  /* of the sink before the route */
+  gboolean changed;
+  gint previous;
+} KmsSelectableMixerRoute;
+
 /* class initialization */
 
 G_DEFINE_TYPE_WITH_CODE (KmsSelectableMixer, kms_selectable_mixer,
@@ -71,6 +135,7 @@ enum
   SIGNAL_CONNECT_VIDEO,
   SIGNAL_CONNECT_AUDIO,
   SIGNAL_DISCONNECT_AUDIO,
+  SIGNAL_APPLY_ROUTING,
   LAST_SIGNAL
 };
 
@@ -142,62 +207,6 @@ release_sink_pads (GstElement * audiomixer)
   gst_iterator_free (it);
 }
 
-static gboolean
-disconnect_elements (GstElement * agnosticbin, GstElement * audiomixer)
-{
-  gboolean done = FALSE, disconnected = FALSE;
-  GValue val = G_VALUE_INIT;
-  GstIterator *it;
-
-  it = gst_element_iterate_src_pads (agnosticbin);
-  do {
-    switch (gst_iterator_next (it, &val)) {
-      case GST_ITERATOR_OK:
-      {
-        GstPad *srcpad, *sinkpad;
-        GstElement *mixer;
-
-        srcpad = g_value_get_object (&val);
-        sinkpad = gst_pad_get_peer (srcpad);
-        mixer = gst_pad_get_parent_element (sinkpad);
-
-        if (mixer == audiomixer) {
-          GST_DEBUG ("Unlink %" GST_PTR_FORMAT " and %" GST_PTR_FORMAT,
-              agnosticbin, mixer);
-
-          if (!gst_pad_unlink (srcpad, sinkpad)) {
-            GST_ERROR ("Can not unlink %" GST_PTR_FORMAT " and %"
-                GST_PTR_FORMAT, srcpad, sinkpad);
-          }
-
-          gst_element_release_request_pad (mixer, sinkpad);
-          gst_element_release_request_pad (agnosticbin, srcpad);
-          disconnected |= TRUE;
-        }
-
-        gst_object_unref (sinkpad);
-        gst_object_unref (mixer);
-        g_value_reset (&val);
-        break;
-      }
-      case GST_ITERATOR_RESYNC:
-        gst_iterator_resync (it);
-        break;
-      case GST_ITERATOR_ERROR:
-        GST_ERROR ("Error iterating over %s's src pads",
-            GST_ELEMENT_NAME (agnosticbin));
-      case GST_ITERATOR_DONE:
-        g_value_unset (&val);
-        done = TRUE;
-        break;
-    }
-  } while (!done);
-
-  gst_iterator_free (it);
-
-  return disconnected;
-}
-
 static void
 kms_selectable_mixer_port_data_destroy (gpointer data)
 {
@@ -206,20 +215,17 @@ kms_selectable_mixer_port_data_destroy (gpointer data)
 
   KMS_SELECTABLE_MIXER_LOCK (self);
 
-  release_sink_pads (port_data->audiomixer);
-
   gst_bin_remove_many (GST_BIN (self), port_data->audio_agnostic,
-      port_data->video_agnostic, port_data->audiomixer, NULL);
+      port_data->video_agnostic, NULL);
 
-  KMS_SELECTABLE_MIXER_LOCK (self);
+  KMS_SELECTABLE_MIXER_UNLOCK (self);
 
-  gst_element_set_state (port_data->audiomixer, GST_STATE_NULL);
   gst_element_set_state (port_data->audio_agnostic, GST_STATE_NULL);
   gst_element_set_state (port_data->video_agnostic, GST_STATE_NULL);
 
-  g_clear_object (&port_data->audiomixer);
   g_clear_object (&port_data->video_agnostic);
   g_clear_object (&port_data->audio_agnostic);
+  g_array_unref (port_data->audio_sources);
 
   g_slice_free (KmsSelectableMixerPortData, data);
 }
@@ -230,28 +236,480 @@ kms_selectable_mixer_port_data_create (KmsSelectableMixer * self, gint id)
   KmsSelectableMixerPortData *data = g_slice_new0 (KmsSelectableMixerPortData);
 
   data->mixer = self;
-  data->audiomixer = gst_element_factory_make ("audiomixerbin", NULL);
+  data->audio_sources = g_array_new (FALSE, FALSE, sizeof (gint));
   data->audio_agnostic = gst_element_factory_make ("agnosticbin", NULL);
   data->video_agnostic = gst_element_factory_make ("agnosticbin", NULL);
   data->id = id;
+  data->video_source = -1;
 
   gst_bin_add_many (GST_BIN (self), g_object_ref (data->audio_agnostic),
-      g_object_ref (data->video_agnostic), data->audiomixer, NULL);
+      g_object_ref (data->video_agnostic), NULL);
 
   gst_element_sync_state_with_parent (data->audio_agnostic);
   gst_element_sync_state_with_parent (data->video_agnostic);
-  gst_element_sync_state_with_parent (data->audiomixer);
 
   kms_base_hub_link_video_sink (KMS_BASE_HUB (self), id, data->video_agnostic,
       "sink", FALSE);
   kms_base_hub_link_audio_sink (KMS_BASE_HUB (self), id, data->audio_agnostic,
       "sink", FALSE);
-  kms_base_hub_link_audio_src (KMS_BASE_HUB (self), id, data->audiomixer,
-      "src", FALSE);
 
   return data;
 }
 
+static gchar *
+create_mix_key (GArray * sources)
+{
+  GString *key = g_string_new (NULL);
+  guint i;
+
+  for (i = 0; i < sources->len; i++) {
+    g_string_append_printf (key, "%d,", g_array_index (sources, gint, i));
+  }
+
+  return g_string_free (key, FALSE);
+}
+
+static gboolean
+contains (GArray * sources, gint id)
+{
+  guint i;
+
+  for (i = 0; i < sources->len; i++) {
+    if (g_array_index (sources, gint, i) == id) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/* Both sorted */
+static gboolean
+is_subset (GArray * a, GArray * b)
+{
+  guint i, j = 0;
+
+  for (i = 0; i < a->len; i++) {
+    while (j < b->len && g_array_index (b, gint, j) < g_array_index (a, gint,
+            i)) {
+      j++;
+    }
+
+    if (j == b->len || g_array_index (b, gint, j) != g_array_index (a, gint,
+            i)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/* Biggest shared mix that the set can be built on with a few more sources */
+static KmsSelectableMixerMix *
+kms_selectable_mixer_find_base (KmsSelectableMixer * self, GArray * sources)
+{
+  KmsSelectableMixerMix *base = NULL;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, self->priv->mixes);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    KmsSelectableMixerMix *mix = value;
+
+    /* Not worth it below two sources, and one step only as each one adds */
+    /* latency */
+    if (mix->base != NULL || mix->sources->len < 2 ||
+        mix->sources->len >= sources->len ||
+        sources->len - mix->sources->len > MAX_INCREMENTAL_SOURCES) {
+      continue;
+    }
+
+    if ((base == NULL || mix->sources->len > base->sources->len) &&
+        is_subset (mix->sources, sources)) {
+      base = mix;
+    }
+  }
+
+  return base;
+}
+
+static KmsSelectableMixerGroup *
+kms_selectable_mixer_group_create (KmsSelectableMixer * self, GArray * sources)
+{
+  KmsSelectableMixerGroup *group = g_slice_new0 (KmsSelectableMixerGroup);
+  guint i;
+
+  group->sources = g_array_ref (sources);
+  group->key = create_mix_key (sources);
+  group->mixminus = gst_element_factory_make ("mixminus", NULL);
+
+  gst_bin_add (GST_BIN (self), g_object_ref (group->mixminus));
+  gst_element_sync_state_with_parent (group->mixminus);
+
+  for (i = 0; i < sources->len; i++) {
+    gint id = g_array_index (sources, gint, i);
+    KmsSelectableMixerPortData *source;
+    gchar *name;
+
+    source = g_hash_table_lookup (self->priv->ports, &id);
+    /* Input N feeds output "src_N" */
+    name = g_strdup_printf ("sink_%d", id);
+
+    if (!gst_element_link_pads (source->audio_agnostic, NULL, group->mixminus,
+            name)) {
+      GST_ERROR_OBJECT (self, "Can not link port %d to mix-minus %s", id,
+          group->key);
+    }
+
+    g_free (name);
+  }
+
+  g_hash_table_insert (self->priv->groups, group->key, group);
+
+  GST_DEBUG_OBJECT (self, "New mix-minus group %s", group->key);
+
+  return group;
+}
+
+static void
+kms_selectable_mixer_group_unref (KmsSelectableMixer * self,
+    KmsSelectableMixerGroup * group)
+{
+  if (--group->refs > 0) {
+    return;
+  }
+
+  /* A retired group is no longer in the table, maybe replaced by a new one */
+  if (g_hash_table_lookup (self->priv->groups, group->key) == group) {
+    g_hash_table_remove (self->priv->groups, group->key);
+  }
+
+  release_sink_pads (group->mixminus);
+  gst_bin_remove (GST_BIN (self), group->mixminus);
+  gst_element_set_state (group->mixminus, GST_STATE_NULL);
+
+  g_clear_object (&group->mixminus);
+  g_array_unref (group->sources);
+  g_free (group->key);
+
+  g_slice_free (KmsSelectableMixerGroup, group);
+}
+
+static gchar *
+kms_selectable_mixer_group_pad_name (KmsSelectableMixerMix * mix)
+{
+  if (mix->minus < 0) {
+    return g_strdup ("src");
+  }
+
+  return g_strdup_printf ("src_%d", mix->minus);
+}
+
+/*
+ * A port that hears everyone in a set but itself takes the mix from the
+ * group of the whole set, and so does a port that hears the whole set if
+ * that group already exists
+ */
+static void
+kms_selectable_mixer_find_group (KmsSelectableMixer * self,
+    KmsSelectableMixerMix * mix, gint sink)
+{
+  GArray *sources;
+  gchar *key;
+  guint i;
+
+  mix->group = g_hash_table_lookup (self->priv->groups, mix->key);
+
+  if (mix->group != NULL) {
+    mix->minus = -1;
+    mix->group->refs++;
+    return;
+  }
+
+  if (sink < 0 || contains (mix->sources, sink) ||
+      mix->sources->len < MIN_GROUP_SOURCES) {
+    return;
+  }
+
+  mix->minus = sink;
+  sources = g_array_sized_new (FALSE, FALSE, sizeof (gint),
+      mix->sources->len + 1);
+
+  for (i = 0; i < mix->sources->len; i++) {
+    gint id = g_array_index (mix->sources, gint, i);
+
+    if (sink >= 0 && sink < id) {
+      g_array_append_val (sources, sink);
+      sink = -1;
+    }
+
+    g_array_append_val (sources, id);
+  }
+
+  if (sink >= 0) {
+    g_array_append_val (sources, sink);
+  }
+
+  key = create_mix_key (sources);
+  mix->group = g_hash_table_lookup (self->priv->groups, key);
+  g_free (key);
+
+  if (mix->group == NULL) {
+    mix->group = kms_selectable_mixer_group_create (self, sources);
+  }
+
+  g_array_unref (sources);
+  mix->group->refs++;
+}
+
+static KmsSelectableMixerMix *
+kms_selectable_mixer_mix_create (KmsSelectableMixer * self, GArray * sources,
+    gint sink)
+{
+  KmsSelectableMixerMix *mix = g_slice_new0 (KmsSelectableMixerMix);
+  guint i;
+
+  mix->sources = g_array_ref (sources);
+  mix->key = create_mix_key (sources);
+  mix->minus = -1;
+  mix->tee = gst_element_factory_make ("tee", NULL);
+  g_object_set (mix->tee, "allow-not-linked", TRUE, NULL);
+
+  gst_bin_add (GST_BIN (self), g_object_ref (mix->tee));
+  gst_element_sync_state_with_parent (mix->tee);
+
+  kms_selectable_mixer_find_group (self, mix, sink);
+
+  if (mix->group != NULL) {
+    gchar *name = kms_selectable_mixer_group_pad_name (mix);
+
+    GST_DEBUG_OBJECT (self, "Mixing %s from %s of group %s", mix->key, name,
+        mix->group->key);
+
+    if (!gst_element_link_pads (mix->group->mixminus, name, mix->tee, "sink")) {
+      GST_ERROR_OBJECT (self, "Can not link %s of group %s", name,
+          mix->group->key);
+    }
+
+    g_free (name);
+    g_hash_table_insert (self->priv->mixes, mix->key, mix);
+
+    return mix;
+  }
+
+  mix->audiomixer = gst_element_factory_make ("audiomixerbin", NULL);
+  gst_bin_add (GST_BIN (self), g_object_ref (mix->audiomixer));
+  gst_element_link (mix->audiomixer, mix->tee);
+  gst_element_sync_state_with_parent (mix->audiomixer);
+
+  mix->base = kms_selectable_mixer_find_base (self, sources);
+
+  if (mix->base != NULL) {
+    GST_DEBUG_OBJECT (self, "Mixing %s as %s plus %u sources", mix->key,
+        mix->base->key, sources->len - mix->base->sources->len);
+    mix->base->refs++;
+    gst_element_link (mix->base->tee, mix->audiomixer);
+  }
+
+  for (i = 0; i < sources->len; i++) {
+    gint id = g_array_index (sources, gint, i);
+    KmsSelectableMixerPortData *source;
+
+    if (mix->base != NULL && contains (mix->base->sources, id)) {
+      continue;
+    }
+
+    source = g_hash_table_lookup (self->priv->ports, &id);
+    gst_element_link (source->audio_agnostic, mix->audiomixer);
+  }
+
+  g_hash_table_insert (self->priv->mixes, mix->key, mix);
+
+  return mix;
+}
+
+static void
+kms_selectable_mixer_mix_unref (KmsSelectableMixer * self,
+    KmsSelectableMixerMix * mix)
+{
+  if (--mix->refs > 0) {
+    return;
+  }
+
+  if (g_hash_table_lookup (self->priv->mixes, mix->key) == mix) {
+    g_hash_table_remove (self->priv->mixes, mix->key);
+  }
+
+  if (mix->group != NULL) {
+    gchar *name = kms_selectable_mixer_group_pad_name (mix);
+
+    gst_element_unlink_pads (mix->group->mixminus, name, mix->tee, "sink");
+    g_free (name);
+  } else {
+    release_sink_pads (mix->audiomixer);
+    gst_bin_remove (GST_BIN (self), mix->audiomixer);
+    gst_element_set_state (mix->audiomixer, GST_STATE_NULL);
+  }
+
+  gst_bin_remove (GST_BIN (self), mix->tee);
+  gst_element_set_state (mix->tee, GST_STATE_NULL);
+
+  if (mix->base != NULL) {
+    kms_selectable_mixer_mix_unref (self, mix->base);
+  }
+
+  if (mix->group != NULL) {
+    kms_selectable_mixer_group_unref (self, mix->group);
+  }
+
+  g_clear_object (&mix->audiomixer);
+  g_clear_object (&mix->tee);
+  g_array_unref (mix->sources);
+  g_free (mix->key);
+
+  g_slice_free (KmsSelectableMixerMix, mix);
+}
+
+/* Whether the mix, or the one it is built on, takes input from the port */
+static gboolean
+kms_selectable_mixer_mix_uses_group_of (KmsSelectableMixerMix * mix, gint id)
+{
+  for (; mix != NULL; mix = mix->base) {
+    if (mix->group != NULL && contains (mix->group->sources, id)) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static gboolean
+kms_selectable_mixer_group_has (gpointer key, KmsSelectableMixerGroup * group,
+    gint * id)
+{
+  return contains (group->sources, *id);
+}
+
+static gboolean
+kms_selectable_mixer_mix_uses (gpointer key, KmsSelectableMixerMix * mix,
+    gint * id)
+{
+  return kms_selectable_mixer_mix_uses_group_of (mix, *id);
+}
+
+/*
+ * Takes the groups with the port, and the mixes fed by them, out of the
+ * tables. Ports still using them keep them until they get new ones.
+ */
+static void
+kms_selectable_mixer_retire_groups (KmsSelectableMixer * self, gint id)
+{
+  g_hash_table_foreach_remove (self->priv->groups,
+      (GHRFunc) kms_selectable_mixer_group_has, &id);
+  g_hash_table_foreach_remove (self->priv->mixes,
+      (GHRFunc) kms_selectable_mixer_mix_uses, &id);
+}
+
+/* Links the port audio output to the mix of its current source set */
+static void
+kms_selectable_mixer_update_mix (KmsSelectableMixer * self,
+    KmsSelectableMixerPortData * sink)
+{
+  KmsSelectableMixerMix *old = sink->mix, *mix = NULL;
+
+  if (sink->audio_sources->len > 0) {
+    gchar *key = create_mix_key (sink->audio_sources);
+
+    mix = g_hash_table_lookup (self->priv->mixes, key);
+    g_free (key);
+
+    if (mix == NULL) {
+      GArray *sources = g_array_sized_new (FALSE, FALSE, sizeof (gint),
+          sink->audio_sources->len);
+
+      g_array_append_vals (sources, sink->audio_sources->data,
+          sink->audio_sources->len);
+      mix = kms_selectable_mixer_mix_create (self, sources, sink->id);
+      g_array_unref (sources);
+    }
+  }
+
+  if (mix == old) {
+    return;
+  }
+
+  if (mix != NULL) {
+    mix->refs++;
+    kms_base_hub_link_audio_src (KMS_BASE_HUB (self), sink->id, mix->tee,
+        "src_%u", TRUE);
+  } else {
+    kms_base_hub_unlink_audio_src (KMS_BASE_HUB (self), sink->id);
+  }
+
+  sink->mix = mix;
+
+  if (old != NULL) {
+    kms_selectable_mixer_mix_unref (self, old);
+  }
+}
+
+/* Returns whether the set changed, the mix is not updated */
+static gboolean
+kms_selectable_mixer_set_audio_source (KmsSelectableMixerPortData * sink,
+    gint source, gboolean listen)
+{
+  guint i;
+
+  for (i = 0; i < sink->audio_sources->len; i++) {
+    gint id = g_array_index (sink->audio_sources, gint, i);
+
+    if (id == source) {
+      if (!listen) {
+        g_array_remove_index (sink->audio_sources, i);
+      }
+
+      return !listen;
+    }
+
+    if (id > source) {
+      break;
+    }
+  }
+
+  if (listen) {
+    g_array_insert_val (sink->audio_sources, i, source);
+  }
+
+  return listen;
+}
+
+static void
+kms_selectable_mixer_remove_audio_source (gpointer key,
+    KmsSelectableMixerPortData * sink, gint * source)
+{
+  if (kms_selectable_mixer_set_audio_source (sink, *source, FALSE)) {
+    kms_selectable_mixer_update_mix (sink->mixer, sink);
+  }
+}
+
+static void
+kms_selectable_mixer_leave_group (gpointer key,
+    KmsSelectableMixerPortData * sink, gint * id)
+{
+  if (kms_selectable_mixer_mix_uses_group_of (sink->mix, *id)) {
+    kms_selectable_mixer_update_mix (sink->mixer, sink);
+  }
+}
+
+static void
+kms_selectable_mixer_clear_audio (gpointer key,
+    KmsSelectableMixerPortData * sink, KmsSelectableMixer * self)
+{
+  g_array_set_size (sink->audio_sources, 0);
+  kms_selectable_mixer_update_mix (self, sink);
+}
+
 static void
 kms_selectable_mixer_dispose (GObject * object)
 {
@@ -262,11 +720,16 @@ kms_selectable_mixer_dispose (GObject * object)
   KMS_SELECTABLE_MIXER_LOCK (self);
 
   if (self->priv->ports != NULL) {
+    g_hash_table_foreach (self->priv->ports,
+        (GHFunc) kms_selectable_mixer_clear_audio, self);
     g_hash_table_remove_all (self->priv->ports);
     g_hash_table_unref (self->priv->ports);
     self->priv->ports = NULL;
   }
 
+  g_clear_pointer (&self->priv->mixes, g_hash_table_unref);
+  g_clear_pointer (&self->priv->groups, g_hash_table_unref);
+
   KMS_SELECTABLE_MIXER_UNLOCK (self);
 
   G_OBJECT_CLASS (kms_selectable_mixer_parent_class)->dispose (object);
@@ -288,12 +751,26 @@ static void
 kms_selectable_mixer_unhandle_port (KmsBaseHub * hub, gint id)
 {
   KmsSelectableMixer *self = KMS_SELECTABLE_MIXER (hub);
+  KmsSelectableMixerPortData *port_data;
 
   KMS_SELECTABLE_MIXER_LOCK (self);
 
+  port_data = g_hash_table_lookup (self->priv->ports, &id);
+
+  if (port_data != NULL) {
+    /* Before any update, so no new mix is taken from them */
+    kms_selectable_mixer_retire_groups (self, id);
+    kms_selectable_mixer_clear_audio (NULL, port_data, self);
+    g_hash_table_foreach (self->priv->ports,
+        (GHFunc) kms_selectable_mixer_remove_audio_source, &id);
+    /* Also sets without the port may be mixed by a group with it */
+    g_hash_table_foreach (self->priv->ports,
+        (GHFunc) kms_selectable_mixer_leave_group, &id);
+  }
+
   g_hash_table_remove (self->priv->ports, &id);
 
-  KMS_SELECTABLE_MIXER_LOCK (self);
+  KMS_SELECTABLE_MIXER_UNLOCK (self);
 
   KMS_BASE_HUB_CLASS (kms_selectable_mixer_parent_class)->unhandle_port (hub,
       id);
@@ -349,6 +826,8 @@ kms_selectable_mixer_connect_video (KmsSelectableMixer * self, guint source,
           kms_base_hub_link_video_src (KMS_BASE_HUB (self), sink_port->id,
               source_port->video_agnostic, "src_%u", TRUE))) {
     GST_ERROR_OBJECT (self, "Can not connect video port");
+  } else {
+    sink_port->video_source = source_port->id;
   }
 
 end:
@@ -374,8 +853,9 @@ kms_selectable_mixer_connect_audio (KmsSelectableMixer * self, guint source,
 
   sink_port = g_hash_table_lookup (self->priv->ports, &sink);
   if (sink_port != NULL) {
-    connected =
-        gst_element_link (source_port->audio_agnostic, sink_port->audiomixer);
+    kms_selectable_mixer_set_audio_source (sink_port, source_port->id, TRUE);
+    kms_selectable_mixer_update_mix (self, sink_port);
+    connected = TRUE;
   } else {
     GST_ERROR_OBJECT (self, "No sink port %u found", source);
   }
@@ -404,8 +884,9 @@ kms_selectable_mixer_disconnect_audio (KmsSelectableMixer * self, guint source,
 
   sink_port = g_hash_table_lookup (self->priv->ports, &sink);
   if (sink_port != NULL) {
-    disconnected = disconnect_elements (source_port->audio_agnostic,
-        sink_port->audiomixer);
+    disconnected = kms_selectable_mixer_set_audio_source (sink_port,
+        source_port->id, FALSE);
+    kms_selectable_mixer_update_mix (self, sink_port);
   } else {
     GST_ERROR_OBJECT (self, "No sink port %u found", source);
   }
@@ -417,6 +898,195 @@ end:
   return disconnected;
 }
 
+/*
+ * Routes are structures with the "source" and "sink" port ids (guint), the
+ * "media" ("audio" or "video") and an optional "connect" boolean, FALSE to
+ * disconnect.
+ */
+static gboolean
+kms_selectable_mixer_parse_route (KmsSelectableMixer * self,
+    const GstStructure * s, KmsSelectableMixerRoute * route)
+{
+  const gchar *media;
+  guint source, sink;
+
+  if (!gst_structure_get_uint (s, "source", &source) ||
+      !gst_structure_get_uint (s, "sink", &sink)) {
+    GST_ERROR_OBJECT (self, "Route without ports: %" GST_PTR_FORMAT, s);
+    return FALSE;
+  }
+
+  route->source = g_hash_table_lookup (self->priv->ports, &source);
+  if (route->source == NULL) {
+    GST_ERROR_OBJECT (self, "No source port %u found", source);
+    return FALSE;
+  }
+
+  route->sink = g_hash_table_lookup (self->priv->ports, &sink);
+  if (route->sink == NULL) {
+    GST_ERROR_OBJECT (self, "No sink port %u found", sink);
+    return FALSE;
+  }
+
+  media = gst_structure_get_string (s, "media");
+  if (g_strcmp0 (media, "audio") == 0) {
+    route->audio = TRUE;
+  } else if (g_strcmp0 (media, "video") == 0) {
+    route->audio = FALSE;
+  } else {
+    GST_ERROR_OBJECT (self, "Invalid media %s", media);
+    return FALSE;
+  }
+
+  if (!gst_structure_get_boolean (s, "connect", &route->connect)) {
+    route->connect = TRUE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+kms_selectable_mixer_route (KmsSelectableMixer * self,
+    KmsSelectableMixerRoute * route)
+{
+  KmsSelectableMixerPortData *source = route->source, *sink = route->sink;
+
+  if (route->audio) {
+    /* Mixes are updated once the whole set is known */
+    route->changed = kms_selectable_mixer_set_audio_source (sink, source->id,
+        route->connect);
+    return TRUE;
+  }
+
+  if (!route->connect) {
+    /* Only if it still comes from that source */
+    if (sink->video_source == source->id) {
+      kms_base_hub_unlink_video_src (KMS_BASE_HUB (self), sink->id);
+      sink->video_source = -1;
+    }
+
+    return TRUE;
+  }
+
+  if (sink->video_source == source->id) {
+    return TRUE;
+  }
+
+  if (!kms_base_hub_link_video_src (KMS_BASE_HUB (self), sink->id,
+          source->video_agnostic, "src_%u", TRUE)) {
+    GST_ERROR_OBJECT (self, "Can not connect video port");
+    /* Whatever was linked before is relinked on rollback */
+    sink->video_source = -1;
+    return FALSE;
+  }
+
+  sink->video_source = source->id;
+
+  return TRUE;
+}
+
+static void
+kms_selectable_mixer_unroute (KmsSelectableMixer * self,
+    KmsSelectableMixerRoute * route)
+{
+  KmsSelectableMixerPortData *source = NULL, *sink = route->sink;
+
+  if (route->audio) {
+    if (route->changed) {
+      kms_selectable_mixer_set_audio_source (sink, route->source->id,
+          !route->connect);
+    }
+
+    return;
+  }
+
+  if (sink->video_source == route->previous) {
+    return;
+  }
+
+  if (route->previous >= 0) {
+    source = g_hash_table_lookup (self->priv->ports, &route->previous);
+  }
+
+  if (source != NULL && kms_base_hub_link_video_src (KMS_BASE_HUB (self),
+          sink->id, source->video_agnostic, "src_%u", TRUE)) {
+    sink->video_source = source->id;
+    return;
+  }
+
+  if (source != NULL) {
+    GST_ERROR_OBJECT (self, "Can not restore port %d to %d", source->id,
+        sink->id);
+  }
+
+  kms_base_hub_unlink_video_src (KMS_BASE_HUB (self), sink->id);
+  sink->video_source = -1;
+}
+
+/*
+ * Applies a whole routing matrix diff in one pass. Nothing is applied if any
+ * route is invalid, and routes already applied are rolled back if one can
+ * not be linked. Sources and sinks involved are blocked meanwhile, so no
+ * buffer goes through a half applied matrix.
+ */
+static gboolean
+kms_selectable_mixer_apply_routing (KmsSelectableMixer * self,
+    GPtrArray * routes)
+{
+  KmsSelectableMixerRoute *parsed;
+  KmsHubRoutingBlock *block;
+  gboolean applied = TRUE;
+  guint i;
+
+  parsed = g_new0 (KmsSelectableMixerRoute, routes->len);
+
+  KMS_SELECTABLE_MIXER_LOCK (self);
+
+  for (i = 0; i < routes->len; i++) {
+    if (!kms_selectable_mixer_parse_route (self, g_ptr_array_index (routes,
+                i), &parsed[i])) {
+      applied = FALSE;
+      goto end;
+    }
+  }
+
+  block = kms_hub_routing_block_new ();
+
+  for (i = 0; i < routes->len; i++) {
+    kms_hub_routing_block_source (block, parsed[i].audio ?
+        parsed[i].source->audio_agnostic : parsed[i].source->video_agnostic);
+    kms_hub_routing_block_sink (block, GST_ELEMENT (self), parsed[i].sink->id,
+        parsed[i].audio);
+  }
+
+  for (i = 0; i < routes->len && applied; i++) {
+    parsed[i].previous = parsed[i].sink->video_source;
+    applied = kms_selectable_mixer_route (self, &parsed[i]);
+  }
+
+  if (!applied) {
+    /* Newest routes first, so every sink ends as before the batch */
+    while (i-- > 0) {
+      kms_selectable_mixer_unroute (self, &parsed[i]);
+    }
+  } else {
+    for (i = 0; i < routes->len; i++) {
+      if (parsed[i].audio) {
+        kms_selectable_mixer_update_mix (self, parsed[i].sink);
+      }
+    }
+  }
+
+  kms_hub_routing_block_release (block);
+
+end:
+  KMS_SELECTABLE_MIXER_UNLOCK (self);
+
+  g_free (parsed);
+
+  return applied;
+}
+
 static void
 kms_selectable_mixer_class_init (KmsSelectableMixerClass * klass)
 {
@@ -433,6 +1103,8 @@ kms_selectable_mixer_class_init (KmsSelectableMixerClass * klass)
   klass->connect_audio = GST_DEBUG_FUNCPTR (kms_selectable_mixer_connect_audio);
   klass->disconnect_audio =
       GST_DEBUG_FUNCPTR (kms_selectable_mixer_disconnect_audio);
+  klass->apply_routing =
+      GST_DEBUG_FUNCPTR (kms_selectable_mixer_apply_routing);
 
   gobject_class->dispose = GST_DEBUG_FUNCPTR (kms_selectable_mixer_dispose);
   gobject_class->finalize = GST_DEBUG_FUNCPTR (kms_selectable_mixer_finalize);
@@ -467,6 +1139,13 @@ kms_selectable_mixer_class_init (KmsSelectableMixerClass * klass)
       __kms_core_marshal_BOOLEAN__UINT_UINT, G_TYPE_BOOLEAN, 2, G_TYPE_UINT,
       G_TYPE_UINT);
 
+  obj_signals[SIGNAL_APPLY_ROUTING] =
+      g_signal_new ("apply-routing",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_ACTION | G_SIGNAL_RUN_LAST,
+      G_STRUCT_OFFSET (KmsSelectableMixerClass, apply_routing), NULL, NULL,
+      NULL, G_TYPE_BOOLEAN, 1, G_TYPE_PTR_ARRAY);
+
   /* Registers a private structure for the instantiatable type */
   g_type_class_add_private (klass, sizeof (KmsSelectableMixerPrivate));
 }
@@ -477,6 +1156,8 @@ kms_selectable_mixer_init (KmsSelectableMixer * self)
   self->priv = KMS_SELECTABLE_MIXER_GET_PRIVATE (self);
   self->priv->ports = g_hash_table_new_full (g_int_hash, g_int_equal,
       destroy_gint, kms_selectable_mixer_port_data_destroy);
+  self->priv->mixes = g_hash_table_new (g_str_hash, g_str_equal);
+  self->priv->groups = g_hash_table_new (g_str_hash, g_str_equal);
 
   g_rec_mutex_init (&self->priv->mutex);
 }
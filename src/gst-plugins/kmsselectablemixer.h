@@ -73,6 +73,7 @@ struct _KmsSelectableMixerClass
   gboolean (*connect_video) (KmsSelectableMixer * self, guint source, guint sink);
   gboolean (*connect_audio) (KmsSelectableMixer * self, guint source, guint sink);
   gboolean (*disconnect_audio) (KmsSelectableMixer * self, guint source, guint sink);
+  gboolean (*apply_routing) (KmsSelectableMixer * self, GPtrArray * routes);
 };
 
 GType kms_selectable_mixer_get_type (void);
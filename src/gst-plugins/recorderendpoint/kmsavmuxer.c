@@ -26,6 +26,7 @@
 #include <commons/kmsagnosticcaps.h>
 
 #include "kmsavmuxer.h"
+#include "kmsfilesink.h"
 
 #define OBJECT_NAME "avmuxer"
 #define KMS_AV_MUXER_NAME OBJECT_NAME
@@ -33,6 +34,17 @@
 #define parent_class kms_av_muxer_parent_class
 #define KEY_AV_MUXER_PAD_PROBE_ID "kms-muxing-pipeline-key-probe-id"
 
+#define DEFAULT_FRAGMENT_DURATION 0
+
+enum
+{
+  PROP_0,
+  PROP_FRAGMENT_DURATION,
+  N_PROPERTIES
+};
+
+static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
+
 GST_DEBUG_CATEGORY_STATIC (kms_av_muxer_debug_category);
 #define GST_CAT_DEFAULT kms_av_muxer_debug_category
 
@@ -54,6 +66,8 @@ struct _KmsAVMuxerPrivate
   GstClockTime lastAudioPts;
 
   gboolean sink_signaled;
+  gboolean segmented;
+  guint fragment_duration;
 };
 
 typedef struct _BufferListItData
@@ -123,16 +137,69 @@ kms_av_muxer_remove_src (KmsBaseMediaMuxer * obj, const gchar * id)
   return FALSE;
 }
 
+static void
+kms_av_muxer_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsAVMuxer *self = KMS_AV_MUXER (object);
+
+  KMS_BASE_MEDIA_MUXER_LOCK (self);
+
+  switch (property_id) {
+    case PROP_FRAGMENT_DURATION:
+      self->priv->fragment_duration = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  KMS_BASE_MEDIA_MUXER_UNLOCK (self);
+}
+
+static void
+kms_av_muxer_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsAVMuxer *self = KMS_AV_MUXER (object);
+
+  KMS_BASE_MEDIA_MUXER_LOCK (self);
+
+  switch (property_id) {
+    case PROP_FRAGMENT_DURATION:
+      g_value_set_uint (value, self->priv->fragment_duration);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  KMS_BASE_MEDIA_MUXER_UNLOCK (self);
+}
+
 static void
 kms_av_muxer_class_init (KmsAVMuxerClass * klass)
 {
   KmsBaseMediaMuxerClass *basemediamuxerclass;
+  GObjectClass *objclass;
+
+  objclass = G_OBJECT_CLASS (klass);
+  objclass->set_property = kms_av_muxer_set_property;
+  objclass->get_property = kms_av_muxer_get_property;
 
   basemediamuxerclass = KMS_BASE_MEDIA_MUXER_CLASS (klass);
   basemediamuxerclass->set_state = kms_av_muxer_set_state;
   basemediamuxerclass->add_src = kms_av_muxer_add_src;
   basemediamuxerclass->remove_src = kms_av_muxer_remove_src;
 
+  obj_properties[PROP_FRAGMENT_DURATION] =
+      g_param_spec_uint (KMS_AV_MUXER_FRAGMENT_DURATION, "Fragment duration",
+      "Write MP4 profiles as fragments of this duration in milliseconds "
+      "(0 = not fragmented)", 0, G_MAXUINT, DEFAULT_FRAGMENT_DURATION,
+      (G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
+  g_object_class_install_properties (objclass, N_PROPERTIES, obj_properties);
+
   g_type_class_add_private (klass, sizeof (KmsAVMuxerPrivate));
 }
 
@@ -166,9 +233,16 @@ kms_av_muxer_create_muxer (KmsAVMuxer * self)
           gst_element_factory_find ("filesink");
       GstElementFactory *sink_factory =
           gst_element_get_factory (self->priv->sink);
-
-      if ((gst_element_factory_get_element_type (sink_factory) !=
-              gst_element_factory_get_element_type (file_sink_factory))) {
+      gboolean seekable = KMS_IS_FILE_SINK (self->priv->sink) ||
+          (gst_element_factory_get_element_type (sink_factory) ==
+          gst_element_factory_get_element_type (file_sink_factory));
+
+      if (self->priv->fragment_duration > 0) {
+        /* Each fragment is written once complete, nothing is kept for EOS */
+        /* but the random access index, which needs seeking to be written */
+        g_object_set (mux, "fragment-duration", self->priv->fragment_duration,
+            "streamable", !seekable, NULL);
+      } else if (!seekable) {
         g_object_set (mux, "faststart", TRUE, NULL);
       }
 
@@ -184,9 +258,21 @@ kms_av_muxer_create_muxer (KmsAVMuxer * self)
 }
 
 static const gchar *
-kms_av_muxer_get_sink_pad_name (KmsRecordingProfile profile,
-    KmsElementPadType type)
+kms_av_muxer_get_sink_pad_name (KmsAVMuxer * self, KmsElementPadType type)
 {
+  KmsRecordingProfile profile = KMS_BASE_MEDIA_MUXER_GET_PROFILE (self);
+
+  if (self->priv->segmented) {
+    /* splitmuxsink pads */
+    if (type == KMS_ELEMENT_PAD_TYPE_VIDEO) {
+      return "video";
+    } else if (type == KMS_ELEMENT_PAD_TYPE_AUDIO) {
+      return "audio_%u";
+    } else {
+      return NULL;
+    }
+  }
+
   if (type == KMS_ELEMENT_PAD_TYPE_VIDEO) {
     if (profile == KMS_RECORDING_PROFILE_JPEG_VIDEO_ONLY) {
       return "sink";
@@ -203,6 +289,8 @@ kms_av_muxer_get_sink_pad_name (KmsRecordingProfile profile,
 static void
 kms_av_muxer_prepare_pipeline (KmsAVMuxer * self)
 {
+  GstElement *segmenter;
+
   self->priv->videosrc = gst_element_factory_make ("appsrc", "videoSrc");
   self->priv->audiosrc = gst_element_factory_make ("appsrc", "audioSrc");
 
@@ -210,27 +298,41 @@ kms_av_muxer_prepare_pipeline (KmsAVMuxer * self)
       KMS_BASE_MEDIA_MUXER_GET_CLASS (self)->create_sink (KMS_BASE_MEDIA_MUXER
       (self), KMS_BASE_MEDIA_MUXER_GET_URI (self));
 
-  g_object_set (self->priv->videosrc, "block", TRUE, "format", GST_FORMAT_TIME,
-      "max-bytes", 0, NULL);
-  g_object_set (self->priv->audiosrc, "block", TRUE, "format", GST_FORMAT_TIME,
-      "max-bytes", 0, NULL);
+  /* The recorder bounds the queues, pushing never blocks its caller */
+  g_object_set (self->priv->videosrc, "block", FALSE, "format",
+      GST_FORMAT_TIME, "max-bytes", 0, NULL);
+  g_object_set (self->priv->audiosrc, "block", FALSE, "format",
+      GST_FORMAT_TIME, "max-bytes", 0, NULL);
 
   self->priv->mux = kms_av_muxer_create_muxer (self);
 
-  gst_bin_add_many (GST_BIN (KMS_BASE_MEDIA_MUXER_GET_PIPELINE (self)),
-      self->priv->videosrc, self->priv->audiosrc, self->priv->mux,
-      self->priv->sink, NULL);
+  segmenter =
+      kms_base_media_muxer_create_segmenter (KMS_BASE_MEDIA_MUXER (self),
+      self->priv->mux, self->priv->sink);
+
+  if (segmenter != NULL) {
+    /* The segmenter owns muxer and sink, sources are linked to it instead */
+    self->priv->mux = segmenter;
+    self->priv->segmented = TRUE;
 
-  if (!gst_element_link (self->priv->mux, self->priv->sink)) {
-    GST_ERROR_OBJECT (self, "Could not link elements: %"
-        GST_PTR_FORMAT ", %" GST_PTR_FORMAT, self->priv->mux, self->priv->sink);
+    gst_bin_add_many (GST_BIN (KMS_BASE_MEDIA_MUXER_GET_PIPELINE (self)),
+        self->priv->videosrc, self->priv->audiosrc, self->priv->mux, NULL);
+  } else {
+    gst_bin_add_many (GST_BIN (KMS_BASE_MEDIA_MUXER_GET_PIPELINE (self)),
+        self->priv->videosrc, self->priv->audiosrc, self->priv->mux,
+        self->priv->sink, NULL);
+
+    if (!gst_element_link (self->priv->mux, self->priv->sink)) {
+      GST_ERROR_OBJECT (self, "Could not link elements: %"
+          GST_PTR_FORMAT ", %" GST_PTR_FORMAT, self->priv->mux,
+          self->priv->sink);
+    }
   }
 
   if (kms_recording_profile_supports_type (KMS_BASE_MEDIA_MUXER_GET_PROFILE
           (self), KMS_ELEMENT_PAD_TYPE_VIDEO)) {
     const gchar *pad_name =
-        kms_av_muxer_get_sink_pad_name (KMS_BASE_MEDIA_MUXER_GET_PROFILE (self),
-        KMS_ELEMENT_PAD_TYPE_VIDEO);
+        kms_av_muxer_get_sink_pad_name (self, KMS_ELEMENT_PAD_TYPE_VIDEO);
 
     if (pad_name == NULL) {
       GST_ERROR_OBJECT (self, "Unsupported pad for recording");
@@ -248,8 +350,7 @@ kms_av_muxer_prepare_pipeline (KmsAVMuxer * self)
   if (kms_recording_profile_supports_type (KMS_BASE_MEDIA_MUXER_GET_PROFILE
           (self), KMS_ELEMENT_PAD_TYPE_AUDIO)) {
     const gchar *pad_name =
-        kms_av_muxer_get_sink_pad_name (KMS_BASE_MEDIA_MUXER_GET_PROFILE (self),
-        KMS_ELEMENT_PAD_TYPE_AUDIO);
+        kms_av_muxer_get_sink_pad_name (self, KMS_ELEMENT_PAD_TYPE_AUDIO);
 
     if (pad_name == NULL) {
       GST_ERROR_OBJECT (self, "Unsupported pad for recording");
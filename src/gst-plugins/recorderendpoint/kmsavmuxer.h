@@ -40,6 +40,7 @@ G_BEGIN_DECLS
   KMS_TYPE_AV_MUXER))
 
 #define KMS_AV_MUXER_PROFILE "profile"
+#define KMS_AV_MUXER_FRAGMENT_DURATION "fragment-duration"
 
 typedef struct _KmsAVMuxer KmsAVMuxer;
 typedef struct _KmsAVMuxerClass KmsAVMuxerClass;
@@ -19,11 +19,13 @@
 #include "config.h"
 #endif
 
+#include <string.h>
 #include <gst/gst.h>
 #include <commons/kmsutils.h>
 #include <commons/kms-core-enumtypes.h>
 
 #include "kmsbasemediamuxer.h"
+#include "kmsfilesink.h"
 
 #define OBJECT_NAME "basemediamuxer"
 
@@ -36,6 +38,7 @@ G_DEFINE_TYPE_WITH_CODE (KmsBaseMediaMuxer, kms_base_media_muxer, G_TYPE_OBJECT,
     GST_DEBUG_CATEGORY_INIT (kms_base_media_muxer_debug_category, OBJECT_NAME,
         0, "debug category for muxing pipeline object"));
 
+#define FILE_PROTO "file"
 #define HTTP_PROTO "http"
 #define HTTPS_PROTO "https"
 
@@ -46,11 +49,17 @@ enum
   PROP_0,
   PROP_URI,
   PROP_PROFILE,
+  PROP_SEGMENT_DURATION,
+  PROP_SEGMENT_SIZE,
   N_PROPERTIES
 };
 
 #define KMA_BASE_MEDIA_MUXER_DEFAULT_URI NULL
 #define KMA_BASE_MEDIA_MUXER_DEFAULT_RECORDING_PROFILE KMS_RECORDING_PROFILE_WEBM
+#define KMA_BASE_MEDIA_MUXER_DEFAULT_SEGMENT_DURATION 0
+#define KMA_BASE_MEDIA_MUXER_DEFAULT_SEGMENT_SIZE 0
+
+#define SEGMENT_INDEX_FORMAT "_%05d"
 
 static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
 
@@ -154,6 +163,31 @@ kms_base_media_muxer_get_sink_fallback (KmsBaseMediaMuxer * self,
   return sink;
 }
 
+static GstElement *
+kms_base_media_muxer_get_file_sink (KmsBaseMediaMuxer * self,
+    const gchar * uri)
+{
+  GstElement *sink = NULL;
+  gchar *prot, *location;
+
+  prot = gst_uri_get_protocol (uri);
+
+  if (g_strcmp0 (prot, FILE_PROTO) == 0) {
+    /* Writes large blocks off the muxer thread */
+    sink = gst_element_factory_make (KMS_FILE_SINK_FACTORY_NAME, NULL);
+  }
+
+  if (sink != NULL) {
+    location = gst_uri_get_location (uri);
+    g_object_set (sink, "location", location, NULL);
+    g_free (location);
+  }
+
+  g_free (prot);
+
+  return sink;
+}
+
 static GstElement *
 kms_base_media_muxer_get_sink (KmsBaseMediaMuxer * self, const gchar * uri)
 {
@@ -170,6 +204,13 @@ kms_base_media_muxer_get_sink (KmsBaseMediaMuxer * self, const gchar * uri)
     goto invalid_uri;
   }
 
+  sink = kms_base_media_muxer_get_file_sink (self, uri);
+
+  if (sink != NULL) {
+    GST_DEBUG_OBJECT (sink, "Muxer sink created for URI '%s'", uri);
+    goto end;
+  }
+
   sink = gst_element_make_from_uri (GST_URI_SINK, uri, NULL, &err);
 
   if (sink == NULL) {
@@ -240,6 +281,75 @@ end:
   return sink;
 }
 
+/* "/rec/a.webm" becomes "/rec/a_%05d.webm" */
+static gchar *
+kms_base_media_muxer_get_segment_location (const gchar * uri)
+{
+  gchar *location, *escaped, *base, *ext, *pattern;
+  gchar **parts;
+
+  location = gst_uri_get_location (uri);
+  parts = g_strsplit (location, "%", -1);
+  escaped = g_strjoinv ("%%", parts);
+  g_strfreev (parts);
+  g_free (location);
+
+  base = strrchr (escaped, '/');
+  ext = strrchr (base != NULL ? base : escaped, '.');
+
+  if (ext == NULL) {
+    pattern = g_strconcat (escaped, SEGMENT_INDEX_FORMAT, NULL);
+  } else {
+    pattern = g_strdup_printf ("%.*s" SEGMENT_INDEX_FORMAT "%s",
+        (gint) (ext - escaped), escaped, ext);
+  }
+
+  g_free (escaped);
+
+  return pattern;
+}
+
+GstElement *
+kms_base_media_muxer_create_segmenter (KmsBaseMediaMuxer * obj,
+    GstElement * mux, GstElement * sink)
+{
+  GstElement *segmenter;
+  gchar *location;
+
+  g_return_val_if_fail (KMS_IS_BASE_MEDIA_MUXER (obj), NULL);
+
+  if (obj->segment_duration == 0 && obj->segment_size == 0) {
+    return NULL;
+  }
+
+  if (obj->profile == KMS_RECORDING_PROFILE_JPEG_VIDEO_ONLY) {
+    GST_WARNING_OBJECT (obj, "JPEG recordings cannot be segmented");
+    return NULL;
+  }
+
+  if (!KMS_IS_FILE_SINK (sink)) {
+    GST_WARNING_OBJECT (obj, "Only local files can be segmented, recording"
+        " '%s' to a single file", obj->uri);
+    return NULL;
+  }
+
+  segmenter = gst_element_factory_make ("splitmuxsink", NULL);
+
+  if (segmenter == NULL) {
+    GST_ERROR_OBJECT (obj, "No splitmuxsink factory available, recording"
+        " '%s' to a single file", obj->uri);
+    return NULL;
+  }
+
+  location = kms_base_media_muxer_get_segment_location (obj->uri);
+  g_object_set (segmenter, "location", location, "muxer", mux, "sink", sink,
+      "max-size-time", obj->segment_duration, "max-size-bytes",
+      obj->segment_size, NULL);
+  g_free (location);
+
+  return segmenter;
+}
+
 static GstElement *
 kms_base_media_muxer_create_sink_impl (KmsBaseMediaMuxer * self,
     const gchar * uri)
@@ -279,6 +389,12 @@ kms_base_media_muxer_set_property (GObject * object, guint property_id,
     case PROP_PROFILE:
       self->profile = g_value_get_enum (value);
       break;
+    case PROP_SEGMENT_DURATION:
+      self->segment_duration = g_value_get_uint64 (value);
+      break;
+    case PROP_SEGMENT_SIZE:
+      self->segment_size = g_value_get_uint64 (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -302,6 +418,12 @@ kms_base_media_muxer_get_property (GObject * object, guint property_id,
     case PROP_PROFILE:
       g_value_set_enum (value, self->profile);
       break;
+    case PROP_SEGMENT_DURATION:
+      g_value_set_uint64 (value, self->segment_duration);
+      break;
+    case PROP_SEGMENT_SIZE:
+      g_value_set_uint64 (value, self->segment_size);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -338,6 +460,20 @@ kms_base_media_muxer_class_init (KmsBaseMediaMuxerClass * klass)
       KMA_BASE_MEDIA_MUXER_DEFAULT_RECORDING_PROFILE,
       (G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
 
+  obj_properties[PROP_SEGMENT_DURATION] =
+      g_param_spec_uint64 (KMS_BASE_MEDIA_MUXER_SEGMENT_DURATION,
+      "Segment duration", "Start a new file after this time, in nanoseconds, "
+      "at the next keyframe (0 = disabled)", 0, G_MAXUINT64,
+      KMA_BASE_MEDIA_MUXER_DEFAULT_SEGMENT_DURATION,
+      (G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
+  obj_properties[PROP_SEGMENT_SIZE] =
+      g_param_spec_uint64 (KMS_BASE_MEDIA_MUXER_SEGMENT_SIZE,
+      "Segment size", "Start a new file after this number of bytes, at the "
+      "next keyframe (0 = disabled)", 0, G_MAXUINT64,
+      KMA_BASE_MEDIA_MUXER_DEFAULT_SEGMENT_SIZE,
+      (G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
   g_object_class_install_properties (objclass, N_PROPERTIES, obj_properties);
 
   obj_signals[SIGNAL_ON_SINK_ADDED] =
@@ -51,6 +51,8 @@ G_BEGIN_DECLS
 #define KMS_BASE_MEDIA_MUXER_PROFILE "profile"
 #define KMS_BASE_MEDIA_MUXER_SINK "sink"
 #define KMS_BASE_MEDIA_MUXER_URI "uri"
+#define KMS_BASE_MEDIA_MUXER_SEGMENT_DURATION "segment-duration"
+#define KMS_BASE_MEDIA_MUXER_SEGMENT_SIZE "segment-size"
 
 #define KMS_BASE_MEDIA_MUXER_LOCK(elem) \
   (g_rec_mutex_lock (&KMS_BASE_MEDIA_MUXER ((elem))->mutex))
@@ -75,6 +77,8 @@ struct _KmsBaseMediaMuxer
   GRecMutex mutex;
   gchar *uri;
   KmsRecordingProfile profile;
+  GstClockTime segment_duration;
+  guint64 segment_size;
 };
 
 struct _KmsBaseMediaMuxerClass
@@ -111,6 +115,17 @@ void kms_base_media_muxer_dot_file (KmsBaseMediaMuxer *obj);
 GstElement * kms_base_media_muxer_add_src (KmsBaseMediaMuxer *obj, KmsMediaType type, const gchar *id);
 gboolean kms_base_media_muxer_remove_src (KmsBaseMediaMuxer *obj, const gchar *id);
 
+/* <protected> */
+
+/*
+ * Returns a splitmuxsink that starts a new file with mux and sink each
+ * segment-duration or segment-size, at the first keyframe after the limit.
+ * Returns NULL if the muxer does not segment its output, leaving mux and
+ * sink untouched.
+ */
+GstElement * kms_base_media_muxer_create_segmenter (KmsBaseMediaMuxer *obj,
+  GstElement *mux, GstElement *sink);
+
 G_END_DECLS
 
 #endif
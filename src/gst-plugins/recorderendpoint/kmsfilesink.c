@@ -0,0 +1,1090 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/* O_DIRECT */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gst/gst.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "kmsfilesink.h"
+
+#define PLUGIN_NAME KMS_FILE_SINK_FACTORY_NAME
+
+#define parent_class kms_file_sink_parent_class
+
+GST_DEBUG_CATEGORY_STATIC (kms_file_sink_debug_category);
+#define GST_CAT_DEFAULT kms_file_sink_debug_category
+
+#define KMS_FILE_SINK_GET_PRIVATE(obj) ( \
+  G_TYPE_INSTANCE_GET_PRIVATE (          \
+    (obj),                               \
+    KMS_TYPE_FILE_SINK,                  \
+    KmsFileSinkPrivate                   \
+  )                                      \
+)
+
+/* Offset and size of O_DIRECT writes must be multiples of the logical */
+/* block size of the device, which is never bigger than a page */
+#define IO_ALIGNMENT 4096
+#define ALIGN_UP(n) ((((n) + IO_ALIGNMENT - 1) / IO_ALIGNMENT) * IO_ALIGNMENT)
+
+#define DEFAULT_BLOCK_SIZE (512 * 1024)
+#define MAX_BLOCK_SIZE (64 * 1024 * 1024)
+#define DEFAULT_QUEUE_DEPTH 2
+#define MAX_QUEUE_DEPTH 64
+#define DEFAULT_DIRECT_IO FALSE
+#define DEFAULT_SYNC_INTERVAL 0 /* ms */
+
+/* Pool threads spend their time blocked in the kernel */
+#define POOL_THREADS_PER_CPU 2
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+  PROP_BLOCK_SIZE,
+  PROP_QUEUE_DEPTH,
+  PROP_DIRECT_IO,
+  PROP_SYNC_INTERVAL,
+  N_PROPERTIES
+};
+
+static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+typedef struct _KmsFileSinkBlock
+{
+  KmsFileSink *sink;
+  guint8 *data;
+  guint64 offset;
+  gsize len;
+  gboolean sync;
+} KmsFileSinkBlock;
+
+struct _KmsFileSinkPrivate
+{
+  gchar *location;
+  guint block_size;
+  guint queue_depth;
+  gboolean direct_io;
+  guint sync_interval;
+
+  gint fd;
+  /* Buffered descriptor for unaligned rewrites, fd itself without O_DIRECT */
+  gint patch_fd;
+  gboolean padded;
+  /* Pipes and devices are written in order, from the streaming thread */
+  gboolean seekable;
+
+  /* Block being filled, the file ends where its data ends */
+  KmsFileSinkBlock *current;
+  guint64 position;
+  gboolean dirty;
+  gint64 last_sync;
+
+  /* Protects the fields below, which pool threads also update */
+  GMutex mutex;
+  GCond cond;
+  GQueue free_blocks;
+  guint n_blocks;
+  guint inflight;
+  gint error;
+
+#ifdef HAVE_LIBURING
+  struct io_uring ring;
+  gboolean use_uring;
+#endif
+};
+
+G_DEFINE_TYPE_WITH_CODE (KmsFileSink, kms_file_sink, GST_TYPE_BASE_SINK,
+    GST_DEBUG_CATEGORY_INIT (kms_file_sink_debug_category, PLUGIN_NAME,
+        0, "debug category for file sink element"));
+
+static gint
+kms_file_sink_pwrite_all (gint fd, const guint8 * data, gsize len,
+    guint64 offset)
+{
+  ssize_t ret;
+
+  while (len > 0) {
+    ret = pwrite (fd, data, len, offset);
+
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return errno;
+    }
+
+    data += ret;
+    len -= ret;
+    offset += ret;
+  }
+
+  return 0;
+}
+
+static gint
+kms_file_sink_write_all (gint fd, const guint8 * data, gsize len)
+{
+  ssize_t ret;
+
+  while (len > 0) {
+    ret = write (fd, data, len);
+
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return errno;
+    }
+
+    data += ret;
+    len -= ret;
+  }
+
+  return 0;
+}
+
+static gsize
+kms_file_sink_block_write_len (KmsFileSink * self, KmsFileSinkBlock * block)
+{
+  return self->priv->padded ? ALIGN_UP (block->len) : block->len;
+}
+
+static gint
+kms_file_sink_block_write (KmsFileSink * self, KmsFileSinkBlock * block)
+{
+  gsize len = kms_file_sink_block_write_len (self, block);
+
+  if (!self->priv->seekable) {
+    return kms_file_sink_write_all (self->priv->fd, block->data, len);
+  }
+
+  return kms_file_sink_pwrite_all (self->priv->fd, block->data, len,
+      block->offset);
+}
+
+static KmsFileSinkBlock *
+kms_file_sink_block_new (KmsFileSink * self)
+{
+  KmsFileSinkBlock *block;
+  gpointer data;
+
+  if (posix_memalign (&data, IO_ALIGNMENT, self->priv->block_size) != 0) {
+    g_error ("%s: failed to allocate %u bytes", G_STRLOC,
+        self->priv->block_size);
+  }
+
+  block = g_slice_new0 (KmsFileSinkBlock);
+  block->sink = self;
+  block->data = data;
+
+  return block;
+}
+
+static void
+kms_file_sink_block_free (KmsFileSinkBlock * block)
+{
+  free (block->data);
+  g_slice_free (KmsFileSinkBlock, block);
+}
+
+/* Returns block to the free list, block is NULL for a sync operation */
+static void
+kms_file_sink_block_done (KmsFileSink * self, KmsFileSinkBlock * block,
+    gint error)
+{
+  g_mutex_lock (&self->priv->mutex);
+
+  if (error != 0 && self->priv->error == 0) {
+    GST_ERROR_OBJECT (self, "Write failed: %s", g_strerror (error));
+    self->priv->error = error;
+  }
+
+  if (block != NULL) {
+    g_queue_push_tail (&self->priv->free_blocks, block);
+  }
+
+  self->priv->inflight--;
+  g_cond_broadcast (&self->priv->cond);
+
+  g_mutex_unlock (&self->priv->mutex);
+}
+
+static void
+kms_file_sink_pool_write (gpointer data, gpointer user_data)
+{
+  KmsFileSinkBlock *block = data;
+  KmsFileSink *self = block->sink;
+  gint error;
+
+  error = kms_file_sink_block_write (self, block);
+
+  /* Covers the writes completed so far, which is enough for periodic syncs */
+  if (error == 0 && block->sync && fdatasync (self->priv->fd) < 0) {
+    error = errno;
+  }
+
+  kms_file_sink_block_done (self, block, error);
+}
+
+/* Shared by every sink, so threads do not grow with recordings */
+static GThreadPool *
+kms_file_sink_get_pool (void)
+{
+  static gsize init = 0;
+  static GThreadPool *pool;
+
+  if (g_once_init_enter (&init)) {
+    pool = g_thread_pool_new (kms_file_sink_pool_write, NULL,
+        POOL_THREADS_PER_CPU * g_get_num_processors (), FALSE, NULL);
+    g_once_init_leave (&init, 1);
+  }
+
+  return pool;
+}
+
+#ifdef HAVE_LIBURING
+
+static gint
+kms_file_sink_uring_complete (KmsFileSink * self, KmsFileSinkBlock * block,
+    gint res)
+{
+  gsize len;
+
+  if (res < 0) {
+    return -res;
+  }
+
+  if (block == NULL) {
+    return 0;
+  }
+
+  len = kms_file_sink_block_write_len (self, block);
+
+  if ((gsize) res < len) {
+    /* Short write, complete it from here */
+    return kms_file_sink_pwrite_all (self->priv->fd, block->data + res,
+        len - res, block->offset + res);
+  }
+
+  return 0;
+}
+
+/* Processes available completions, waiting for one if wait is set */
+static void
+kms_file_sink_uring_reap (KmsFileSink * self, gboolean wait)
+{
+  struct io_uring_cqe *cqe;
+  KmsFileSinkBlock *block;
+  gint ret;
+
+  for (;;) {
+    if (wait) {
+      ret = io_uring_wait_cqe (&self->priv->ring, &cqe);
+    } else {
+      ret = io_uring_peek_cqe (&self->priv->ring, &cqe);
+    }
+
+    if (ret == -EINTR) {
+      continue;
+    }
+
+    if (ret < 0) {
+      break;
+    }
+
+    block = io_uring_cqe_get_data (cqe);
+    ret = cqe->res;
+    io_uring_cqe_seen (&self->priv->ring, cqe);
+
+    kms_file_sink_block_done (self, block,
+        kms_file_sink_uring_complete (self, block, ret));
+    wait = FALSE;
+  }
+}
+
+static struct io_uring_sqe *
+kms_file_sink_uring_get_sqe (KmsFileSink * self)
+{
+  struct io_uring_sqe *sqe;
+
+  while ((sqe = io_uring_get_sqe (&self->priv->ring)) == NULL) {
+    io_uring_submit (&self->priv->ring);
+    kms_file_sink_uring_reap (self, TRUE);
+  }
+
+  return sqe;
+}
+
+static void
+kms_file_sink_uring_submit (KmsFileSink * self, KmsFileSinkBlock * block)
+{
+  struct io_uring_sqe *sqe;
+  gint ret;
+
+  sqe = kms_file_sink_uring_get_sqe (self);
+  io_uring_prep_write (sqe, self->priv->fd, block->data,
+      kms_file_sink_block_write_len (self, block), block->offset);
+  io_uring_sqe_set_data (sqe, block);
+
+  if (block->sync) {
+    g_mutex_lock (&self->priv->mutex);
+    self->priv->inflight++;
+    g_mutex_unlock (&self->priv->mutex);
+
+    /* Drained, so it starts once every previous write has completed */
+    sqe = kms_file_sink_uring_get_sqe (self);
+    io_uring_prep_fsync (sqe, self->priv->fd, IORING_FSYNC_DATASYNC);
+    io_uring_sqe_set_data (sqe, NULL);
+    sqe->flags |= IOSQE_IO_DRAIN;
+  }
+
+  ret = io_uring_submit (&self->priv->ring);
+
+  if (ret < 0) {
+    kms_file_sink_block_done (self, block, -ret);
+
+    if (block->sync) {
+      kms_file_sink_block_done (self, NULL, -ret);
+    }
+  }
+}
+
+#endif /* HAVE_LIBURING */
+
+/* Called with the mutex held, it is released while waiting */
+static void
+kms_file_sink_wait_completion (KmsFileSink * self)
+{
+#ifdef HAVE_LIBURING
+  if (self->priv->use_uring) {
+    g_mutex_unlock (&self->priv->mutex);
+    kms_file_sink_uring_reap (self, TRUE);
+    g_mutex_lock (&self->priv->mutex);
+    return;
+  }
+#endif
+
+  g_cond_wait (&self->priv->cond, &self->priv->mutex);
+}
+
+/* Waits for every submitted write and returns the first error, if any */
+static gint
+kms_file_sink_drain (KmsFileSink * self)
+{
+  gint error;
+
+  g_mutex_lock (&self->priv->mutex);
+
+  while (self->priv->inflight > 0) {
+    kms_file_sink_wait_completion (self);
+  }
+
+  error = self->priv->error;
+
+  g_mutex_unlock (&self->priv->mutex);
+
+  return error;
+}
+
+static KmsFileSinkBlock *
+kms_file_sink_get_block (KmsFileSink * self, guint64 offset)
+{
+  KmsFileSinkBlock *block;
+
+#ifdef HAVE_LIBURING
+  if (self->priv->use_uring) {
+    kms_file_sink_uring_reap (self, FALSE);
+  }
+#endif
+
+  g_mutex_lock (&self->priv->mutex);
+
+  /* One block is filled while the others are written */
+  while ((block = g_queue_pop_head (&self->priv->free_blocks)) == NULL) {
+    if (self->priv->n_blocks <= self->priv->queue_depth) {
+      block = kms_file_sink_block_new (self);
+      self->priv->n_blocks++;
+      break;
+    }
+
+    kms_file_sink_wait_completion (self);
+  }
+
+  g_mutex_unlock (&self->priv->mutex);
+
+  block->offset = offset;
+  block->len = 0;
+
+  return block;
+}
+
+static gboolean
+kms_file_sink_sync_due (KmsFileSink * self, gint64 now)
+{
+  guint interval = g_atomic_int_get (&self->priv->sync_interval);
+
+  return interval > 0 &&
+      now - self->priv->last_sync >= interval * G_TIME_SPAN_MILLISECOND;
+}
+
+static void
+kms_file_sink_submit (KmsFileSink * self, KmsFileSinkBlock * block)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  block->sync = self->priv->seekable && kms_file_sink_sync_due (self, now);
+
+  if (block->sync) {
+    self->priv->last_sync = now;
+  }
+
+  g_mutex_lock (&self->priv->mutex);
+  self->priv->inflight++;
+  g_mutex_unlock (&self->priv->mutex);
+
+  if (!self->priv->seekable) {
+    /* Concurrent writes would reach the pipe out of order */
+    kms_file_sink_pool_write (block, NULL);
+    return;
+  }
+
+#ifdef HAVE_LIBURING
+  if (self->priv->use_uring) {
+    kms_file_sink_uring_submit (self, block);
+    return;
+  }
+#endif
+
+  g_thread_pool_push (kms_file_sink_get_pool (), block, NULL);
+}
+
+/* Appends zeros if data is NULL */
+static void
+kms_file_sink_append (KmsFileSink * self, const guint8 * data, gsize size)
+{
+  KmsFileSinkBlock *block = self->priv->current;
+  guint64 next;
+  gsize n;
+
+  while (size > 0) {
+    n = MIN (size, self->priv->block_size - block->len);
+
+    if (data != NULL) {
+      memcpy (block->data + block->len, data, n);
+      data += n;
+    } else {
+      memset (block->data + block->len, 0, n);
+    }
+
+    block->len += n;
+    size -= n;
+
+    if (block->len == self->priv->block_size) {
+      next = block->offset + block->len;
+      kms_file_sink_submit (self, block);
+      block = self->priv->current = kms_file_sink_get_block (self, next);
+    }
+  }
+}
+
+/* Writes data that the file already has, like headers completed by muxers */
+static gint
+kms_file_sink_overwrite (KmsFileSink * self, const guint8 * data, gsize size,
+    guint64 offset)
+{
+  KmsFileSinkBlock *block = self->priv->current;
+  gsize skip;
+  gint error;
+
+  if (offset + size > block->offset) {
+    skip = offset >= block->offset ? 0 : block->offset - offset;
+    memcpy (block->data + (offset + skip - block->offset), data + skip,
+        size - skip);
+    size = skip;
+  }
+
+  if (size == 0) {
+    return 0;
+  }
+
+  if (!self->priv->seekable) {
+    GST_WARNING_OBJECT (self, "Cannot rewrite %" G_GSIZE_FORMAT " bytes at %"
+        G_GUINT64_FORMAT ", the output is not seekable", size, offset);
+    return ESPIPE;
+  }
+
+  /* Previous blocks must be on the file before they are patched */
+  error = kms_file_sink_drain (self);
+
+  if (error != 0) {
+    return error;
+  }
+
+  return kms_file_sink_pwrite_all (self->priv->patch_fd, data, size, offset);
+}
+
+static gint
+kms_file_sink_write (KmsFileSink * self, const guint8 * data, gsize size)
+{
+  KmsFileSinkBlock *block = self->priv->current;
+  guint64 end = block->offset + block->len;
+  guint64 offset = self->priv->position;
+  gsize n;
+  gint error;
+
+  self->priv->position += size;
+  self->priv->dirty = TRUE;
+
+  if (offset > end) {
+    /* Holes read as zeros anyway */
+    kms_file_sink_append (self, NULL, offset - end);
+    end = offset;
+  }
+
+  if (offset < end) {
+    n = MIN (size, end - offset);
+    error = kms_file_sink_overwrite (self, data, n, offset);
+
+    if (error != 0) {
+      return error;
+    }
+
+    data += n;
+    size -= n;
+  }
+
+  kms_file_sink_append (self, data, size);
+
+  return 0;
+}
+
+/* Writes the current block and waits until the file is complete. The block */
+/* stays in memory, so later data is still appended to it. */
+static gint
+kms_file_sink_flush (KmsFileSink * self)
+{
+  KmsFileSinkBlock *block = self->priv->current;
+  gsize len;
+  gint error;
+
+  error = kms_file_sink_drain (self);
+
+  if (error != 0 || !self->priv->dirty) {
+    return error;
+  }
+
+  if (block->len > 0) {
+    len = kms_file_sink_block_write_len (self, block);
+    memset (block->data + block->len, 0, len - block->len);
+
+    error = kms_file_sink_block_write (self, block);
+
+    if (error != 0) {
+      return error;
+    }
+
+    if (!self->priv->seekable) {
+      /* Already sent, data written later goes after it */
+      block->offset += block->len;
+      block->len = 0;
+    }
+  }
+
+  /* Removes the padding of the last block */
+  if (self->priv->padded
+      && ftruncate (self->priv->fd, block->offset + block->len) < 0) {
+    return errno;
+  }
+
+  if (g_atomic_int_get (&self->priv->sync_interval) > 0) {
+    if (self->priv->seekable && fdatasync (self->priv->fd) < 0) {
+      return errno;
+    }
+
+    self->priv->last_sync = g_get_monotonic_time ();
+  }
+
+  self->priv->dirty = FALSE;
+
+  return 0;
+}
+
+static void
+kms_file_sink_post_write_error (KmsFileSink * self, gint error)
+{
+  GST_ELEMENT_ERROR (self, RESOURCE, WRITE,
+      ("Error while writing to file \"%s\".", self->priv->location),
+      ("%s", g_strerror (error)));
+}
+
+static GstFlowReturn
+kms_file_sink_render (GstBaseSink * sink, GstBuffer * buffer)
+{
+  KmsFileSink *self = KMS_FILE_SINK (sink);
+  GstMapInfo info;
+  GstMemory *mem;
+  guint i, n;
+  gint error = 0;
+
+  n = gst_buffer_n_memory (buffer);
+
+  for (i = 0; i < n && error == 0; i++) {
+    mem = gst_buffer_peek_memory (buffer, i);
+
+    if (!gst_memory_map (mem, &info, GST_MAP_READ)) {
+      GST_ELEMENT_ERROR (self, RESOURCE, WRITE, (NULL),
+          ("Failed to map memory"));
+      return GST_FLOW_ERROR;
+    }
+
+    error = kms_file_sink_write (self, info.data, info.size);
+    gst_memory_unmap (mem, &info);
+  }
+
+  /* Slow streams take long to fill a block, so what it has is written */
+  /* when the sync interval elapses instead of only being in memory */
+  if (error == 0 && kms_file_sink_sync_due (self, g_get_monotonic_time ())) {
+    error = kms_file_sink_flush (self);
+  }
+
+  if (error == 0) {
+    g_mutex_lock (&self->priv->mutex);
+    error = self->priv->error;
+    g_mutex_unlock (&self->priv->mutex);
+  }
+
+  if (error != 0) {
+    kms_file_sink_post_write_error (self, error);
+    return GST_FLOW_ERROR;
+  }
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+kms_file_sink_event (GstBaseSink * sink, GstEvent * event)
+{
+  KmsFileSink *self = KMS_FILE_SINK (sink);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_SEGMENT:{
+      const GstSegment *segment;
+
+      gst_event_parse_segment (event, &segment);
+
+      /* Muxers seek back this way to complete headers */
+      if (segment->format == GST_FORMAT_BYTES) {
+        GST_LOG_OBJECT (self, "Seek to %" G_GUINT64_FORMAT, segment->start);
+        self->priv->position = segment->start;
+      }
+      break;
+    }
+    case GST_EVENT_EOS:{
+      gint error = kms_file_sink_flush (self);
+
+      if (error != 0) {
+        kms_file_sink_post_write_error (self, error);
+        gst_event_unref (event);
+        return FALSE;
+      }
+
+      gst_element_post_message (GST_ELEMENT (self),
+          gst_message_new_element (GST_OBJECT (self),
+              gst_structure_new (KMS_FILE_SINK_COMPLETE_MESSAGE, "location",
+                  G_TYPE_STRING, self->priv->location, NULL)));
+      break;
+    }
+    default:
+      break;
+  }
+
+  return GST_BASE_SINK_CLASS (parent_class)->event (sink, event);
+}
+
+static gboolean
+kms_file_sink_query (GstBaseSink * sink, GstQuery * query)
+{
+  KmsFileSink *self = KMS_FILE_SINK (sink);
+  GstFormat format;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_POSITION:
+      gst_query_parse_position (query, &format, NULL);
+
+      if (format != GST_FORMAT_DEFAULT && format != GST_FORMAT_BYTES) {
+        return FALSE;
+      }
+
+      gst_query_set_position (query, GST_FORMAT_BYTES, self->priv->position);
+      return TRUE;
+    case GST_QUERY_FORMATS:
+      gst_query_set_formats (query, 2, GST_FORMAT_DEFAULT, GST_FORMAT_BYTES);
+      return TRUE;
+    case GST_QUERY_SEEKING:
+      gst_query_parse_seeking (query, &format, NULL, NULL, NULL);
+
+      if (format == GST_FORMAT_DEFAULT || format == GST_FORMAT_BYTES) {
+        gst_query_set_seeking (query, GST_FORMAT_BYTES, self->priv->seekable,
+            0, -1);
+      } else {
+        gst_query_set_seeking (query, format, FALSE, 0, -1);
+      }
+      return TRUE;
+    default:
+      return GST_BASE_SINK_CLASS (parent_class)->query (sink, query);
+  }
+}
+
+/* Pipes and character devices fail positioned writes with ESPIPE */
+static gboolean
+kms_file_sink_is_seekable (gint fd)
+{
+  struct stat st;
+
+  if (fstat (fd, &st) < 0) {
+    return FALSE;
+  }
+
+  if (!S_ISREG (st.st_mode) && !S_ISBLK (st.st_mode)) {
+    return FALSE;
+  }
+
+  return lseek (fd, 0, SEEK_CUR) >= 0;
+}
+
+static gboolean
+kms_file_sink_open (KmsFileSink * self)
+{
+  gint flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  gint fd;
+
+  self->priv->padded = FALSE;
+  self->priv->fd = self->priv->patch_fd = open (self->priv->location, flags,
+      0644);
+
+  if (self->priv->fd < 0) {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_WRITE,
+        ("Could not open file \"%s\" for writing.", self->priv->location),
+        ("%s", g_strerror (errno)));
+    return FALSE;
+  }
+
+  self->priv->seekable = kms_file_sink_is_seekable (self->priv->fd);
+
+  if (!self->priv->seekable) {
+    GST_INFO_OBJECT (self, "'%s' is not seekable, writing sequentially",
+        self->priv->location);
+    return TRUE;
+  }
+
+  if (!self->priv->direct_io) {
+    return TRUE;
+  }
+
+  fd = open (self->priv->location, O_WRONLY | O_CLOEXEC | O_DIRECT);
+
+  if (fd < 0) {
+    GST_WARNING_OBJECT (self, "O_DIRECT not supported for '%s' (%s),"
+        " using buffered writes", self->priv->location, g_strerror (errno));
+    return TRUE;
+  }
+
+  /* The buffered descriptor is kept for unaligned rewrites */
+  self->priv->fd = fd;
+  self->priv->padded = TRUE;
+
+  return TRUE;
+}
+
+static gboolean
+kms_file_sink_start (GstBaseSink * sink)
+{
+  KmsFileSink *self = KMS_FILE_SINK (sink);
+
+  if (self->priv->location == NULL || self->priv->location[0] == '\0') {
+    GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND,
+        ("No file name specified for writing."), (NULL));
+    return FALSE;
+  }
+
+  if (!kms_file_sink_open (self)) {
+    return FALSE;
+  }
+
+#ifdef HAVE_LIBURING
+  if (self->priv->seekable) {
+    /* Room for every write in flight and its sync */
+    gint ret = io_uring_queue_init (2 * self->priv->queue_depth + 2,
+        &self->priv->ring, 0);
+
+    self->priv->use_uring = ret == 0;
+
+    if (ret < 0) {
+      GST_INFO_OBJECT (self, "io_uring not available (%s), writing from a"
+          " thread pool", g_strerror (-ret));
+    }
+  }
+#endif
+
+  self->priv->error = 0;
+  self->priv->position = 0;
+  self->priv->dirty = FALSE;
+  self->priv->last_sync = g_get_monotonic_time ();
+  self->priv->current = kms_file_sink_get_block (self, 0);
+
+  GST_DEBUG_OBJECT (self, "Writing to '%s' in blocks of %u bytes%s",
+      self->priv->location, self->priv->block_size,
+      self->priv->padded ? " with O_DIRECT" : "");
+
+  return TRUE;
+}
+
+static gboolean
+kms_file_sink_stop (GstBaseSink * sink)
+{
+  KmsFileSink *self = KMS_FILE_SINK (sink);
+  KmsFileSinkBlock *block;
+  gint error;
+
+  if (self->priv->fd < 0) {
+    return TRUE;
+  }
+
+  error = kms_file_sink_flush (self);
+
+  if (error != 0) {
+    kms_file_sink_post_write_error (self, error);
+  }
+
+  g_queue_push_tail (&self->priv->free_blocks, self->priv->current);
+  self->priv->current = NULL;
+
+  while ((block = g_queue_pop_head (&self->priv->free_blocks)) != NULL) {
+    kms_file_sink_block_free (block);
+  }
+
+  self->priv->n_blocks = 0;
+
+#ifdef HAVE_LIBURING
+  if (self->priv->use_uring) {
+    io_uring_queue_exit (&self->priv->ring);
+    self->priv->use_uring = FALSE;
+  }
+#endif
+
+  if (self->priv->patch_fd != self->priv->fd) {
+    close (self->priv->patch_fd);
+  }
+
+  close (self->priv->fd);
+  self->priv->fd = self->priv->patch_fd = -1;
+
+  return TRUE;
+}
+
+static void
+kms_file_sink_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsFileSink *self = KMS_FILE_SINK (object);
+
+  GST_OBJECT_LOCK (self);
+
+  /* Only the sync interval can change while the file is open */
+  if (property_id != PROP_SYNC_INTERVAL && self->priv->fd >= 0) {
+    GST_WARNING_OBJECT (self, "Cannot change %s while writing",
+        pspec->name);
+    GST_OBJECT_UNLOCK (self);
+    return;
+  }
+
+  switch (property_id) {
+    case PROP_LOCATION:
+      g_free (self->priv->location);
+      self->priv->location = g_value_dup_string (value);
+      break;
+    case PROP_BLOCK_SIZE:
+      self->priv->block_size = ALIGN_UP (g_value_get_uint (value));
+      break;
+    case PROP_QUEUE_DEPTH:
+      self->priv->queue_depth = g_value_get_uint (value);
+      break;
+    case PROP_DIRECT_IO:
+      self->priv->direct_io = g_value_get_boolean (value);
+      break;
+    case PROP_SYNC_INTERVAL:
+      g_atomic_int_set (&self->priv->sync_interval, g_value_get_uint (value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+kms_file_sink_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsFileSink *self = KMS_FILE_SINK (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (property_id) {
+    case PROP_LOCATION:
+      g_value_set_string (value, self->priv->location);
+      break;
+    case PROP_BLOCK_SIZE:
+      g_value_set_uint (value, self->priv->block_size);
+      break;
+    case PROP_QUEUE_DEPTH:
+      g_value_set_uint (value, self->priv->queue_depth);
+      break;
+    case PROP_DIRECT_IO:
+      g_value_set_boolean (value, self->priv->direct_io);
+      break;
+    case PROP_SYNC_INTERVAL:
+      g_value_set_uint (value, g_atomic_int_get (&self->priv->sync_interval));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+kms_file_sink_finalize (GObject * object)
+{
+  KmsFileSink *self = KMS_FILE_SINK (object);
+
+  GST_DEBUG_OBJECT (self, "finalize");
+
+  g_free (self->priv->location);
+  g_mutex_clear (&self->priv->mutex);
+  g_cond_clear (&self->priv->cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+kms_file_sink_class_init (KmsFileSinkClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSinkClass *basesink_class = GST_BASE_SINK_CLASS (klass);
+
+  gobject_class->set_property = kms_file_sink_set_property;
+  gobject_class->get_property = kms_file_sink_get_property;
+  gobject_class->finalize = kms_file_sink_finalize;
+
+  basesink_class->start = GST_DEBUG_FUNCPTR (kms_file_sink_start);
+  basesink_class->stop = GST_DEBUG_FUNCPTR (kms_file_sink_stop);
+  basesink_class->render = GST_DEBUG_FUNCPTR (kms_file_sink_render);
+  basesink_class->event = GST_DEBUG_FUNCPTR (kms_file_sink_event);
+  basesink_class->query = GST_DEBUG_FUNCPTR (kms_file_sink_query);
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "File sink for recordings", "Sink/File",
+      "Writes to a file in large aligned blocks submitted asynchronously",
+      "Kurento <kurento@googlegroups.com>");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sink_template));
+
+  obj_properties[PROP_LOCATION] = g_param_spec_string ("location",
+      "File Location", "Location of the file to write", NULL,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  obj_properties[PROP_BLOCK_SIZE] = g_param_spec_uint ("block-size",
+      "Block size", "Size in bytes of each write, rounded up to a multiple"
+      " of " G_STRINGIFY (IO_ALIGNMENT), IO_ALIGNMENT, MAX_BLOCK_SIZE,
+      DEFAULT_BLOCK_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  obj_properties[PROP_QUEUE_DEPTH] = g_param_spec_uint ("queue-depth",
+      "Queue depth", "Maximum number of blocks being written while the next"
+      " one is filled", 1, MAX_QUEUE_DEPTH, DEFAULT_QUEUE_DEPTH,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  obj_properties[PROP_DIRECT_IO] = g_param_spec_boolean ("direct-io",
+      "Direct I/O", "Bypass the page cache (O_DIRECT) where supported",
+      DEFAULT_DIRECT_IO, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  obj_properties[PROP_SYNC_INTERVAL] = g_param_spec_uint ("sync-interval",
+      "Sync interval", "Minimum time in milliseconds between fdatasync"
+      " calls, also done on EOS. Partial blocks are written at least this"
+      " often (0 = never sync)", 0, G_MAXUINT,
+      DEFAULT_SYNC_INTERVAL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (gobject_class, N_PROPERTIES,
+      obj_properties);
+
+  g_type_class_add_private (klass, sizeof (KmsFileSinkPrivate));
+}
+
+static void
+kms_file_sink_init (KmsFileSink * self)
+{
+  self->priv = KMS_FILE_SINK_GET_PRIVATE (self);
+
+  self->priv->block_size = DEFAULT_BLOCK_SIZE;
+  self->priv->queue_depth = DEFAULT_QUEUE_DEPTH;
+  self->priv->direct_io = DEFAULT_DIRECT_IO;
+  self->priv->sync_interval = DEFAULT_SYNC_INTERVAL;
+  self->priv->fd = self->priv->patch_fd = -1;
+
+  g_mutex_init (&self->priv->mutex);
+  g_cond_init (&self->priv->cond);
+  g_queue_init (&self->priv->free_blocks);
+
+  gst_base_sink_set_sync (GST_BASE_SINK (self), FALSE);
+}
+
+gboolean
+kms_file_sink_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, PLUGIN_NAME, GST_RANK_NONE,
+      KMS_TYPE_FILE_SINK);
+}
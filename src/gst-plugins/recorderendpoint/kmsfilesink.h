@@ -0,0 +1,77 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _KMS_FILE_SINK_H_
+#define _KMS_FILE_SINK_H_
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesink.h>
+
+G_BEGIN_DECLS
+#define KMS_TYPE_FILE_SINK               \
+  (kms_file_sink_get_type())
+#define KMS_FILE_SINK_CAST(obj)          \
+  ((KmsFileSink *)(obj))
+#define KMS_FILE_SINK(obj)               \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),     \
+  KMS_TYPE_FILE_SINK,KmsFileSink))
+#define KMS_FILE_SINK_CLASS(klass)       \
+  (G_TYPE_CHECK_CLASS_CAST((klass),      \
+  KMS_TYPE_FILE_SINK,                    \
+  KmsFileSinkClass))
+#define KMS_IS_FILE_SINK(obj)            \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),     \
+  KMS_TYPE_FILE_SINK))
+#define KMS_IS_FILE_SINK_CLASS(klass)    \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),      \
+  KMS_TYPE_FILE_SINK))
+
+#define KMS_FILE_SINK_FACTORY_NAME "kmsfilesink"
+
+/*
+ * Element message posted when EOS has been written, with the file name in
+ * the "location" field. The file is complete on disk at that point.
+ */
+#define KMS_FILE_SINK_COMPLETE_MESSAGE "kms-file-sink-complete"
+
+typedef struct _KmsFileSink KmsFileSink;
+typedef struct _KmsFileSinkClass KmsFileSinkClass;
+typedef struct _KmsFileSinkPrivate KmsFileSinkPrivate;
+
+/*
+ * Writes recordings in large aligned blocks that are submitted in the
+ * background, with io_uring when available and a thread pool otherwise, so
+ * the muxer thread only copies data.
+ */
+struct _KmsFileSink
+{
+  GstBaseSink parent;
+
+  /*< private > */
+  KmsFileSinkPrivate *priv;
+};
+
+struct _KmsFileSinkClass
+{
+  GstBaseSinkClass parent_class;
+};
+
+GType kms_file_sink_get_type ();
+
+gboolean kms_file_sink_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+#endif
@@ -102,7 +102,9 @@ kms_ksr_muxer_add_src (KmsBaseMediaMuxer * obj, KmsMediaType type,
   }
 
   appsrc = gst_element_factory_make ("appsrc", NULL);
-  g_object_set (appsrc, "block", TRUE, "format", GST_FORMAT_TIME, NULL);
+  /* The recorder bounds the queue, pushing never blocks its caller */
+  g_object_set (appsrc, "block", FALSE, "format", GST_FORMAT_TIME,
+      "max-bytes", 0, NULL);
 
   gst_bin_add (GST_BIN (KMS_BASE_MEDIA_MUXER_GET_PIPELINE (self)), appsrc);
 
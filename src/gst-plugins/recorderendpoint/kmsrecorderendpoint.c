@@ -40,6 +40,7 @@
 #include "kmsbasemediamuxer.h"
 #include "kmsavmuxer.h"
 #include "kmsksrmuxer.h"
+#include "kmsfilesink.h"
 
 #define PLUGIN_NAME "recorderendpoint"
 
@@ -47,8 +48,9 @@
 
 #define DEFAULT_RECORDING_PROFILE KMS_RECORDING_PROFILE_NONE
 
-#define KMS_BASE_TIME_KEY "base-time-key"
-G_DEFINE_QUARK (KMS_BASE_TIME_KEY, base_time_key);
+#define DEFAULT_WRITE_BEHIND_BYTES (8 * 1024 * 1024)
+#define HIGH_WATER_PERCENT 75
+#define LOW_WATER_PERCENT 50
 
 #define KMS_PAD_ID_KEY "kms-pad-id-key"
 G_DEFINE_QUARK (KMS_PAD_ID_KEY, kms_pad_id_key);
@@ -56,6 +58,9 @@ G_DEFINE_QUARK (KMS_PAD_ID_KEY, kms_pad_id_key);
 #define KMS_APPSRC_ID_KEY "kms-appsrc-id-key"
 G_DEFINE_QUARK (KMS_APPSRC_ID_KEY, kms_appsrc_id_key);
 
+#define KMS_WRITE_BEHIND_KEY "kms-write-behind-key"
+G_DEFINE_QUARK (KMS_WRITE_BEHIND_KEY, kms_write_behind_key);
+
 GST_DEBUG_CATEGORY_STATIC (kms_recorder_endpoint_debug_category);
 #define GST_CAT_DEFAULT kms_recorder_endpoint_debug_category
 
@@ -92,11 +97,26 @@ enum
   PROP_0,
   PROP_DVR,
   PROP_PROFILE,
+  PROP_WRITE_BEHIND_BYTES,
+  PROP_DIRECT_IO,
+  PROP_SYNC_INTERVAL,
+  PROP_SEGMENT_DURATION,
+  PROP_SEGMENT_SIZE,
+  PROP_FRAGMENT_DURATION,
   N_PROPERTIES
 };
 
 static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
 
+enum
+{
+  SIGNAL_WRITE_BEHIND_HIGH_WATER,
+  SIGNAL_SEGMENT_CLOSED,
+  LAST_SIGNAL
+};
+
+static guint kms_recorder_endpoint_signals[LAST_SIGNAL] = { 0 };
+
 typedef enum
 {
   KMS_RECORDER_ENDPOINT_COMPLETED = 0,
@@ -122,6 +142,26 @@ typedef struct _KmsSinkPadData
   gboolean requested;
 } KmsSinkPadData;
 
+/* Only used from the streaming thread of its appsink */
+typedef struct _KmsWriteBehindData
+{
+  KmsMediaType type;
+  gboolean high_water;
+  gboolean waiting_keyframe;
+  guint64 dropped;
+} KmsWriteBehindData;
+
+typedef struct _BaseTimeType
+{
+  GstClockTime pts;
+  GstClockTime dts;
+  GstClockTime audio_gaps;
+  GstClockTime paused_time;
+  /* Changes on every reset, so a buffer read before it does not seed the */
+  /* base time of the next recording */
+  guint generation;
+} BaseTimeType;
+
 typedef struct _KmsRecorderStats
 {
   gchar *id;
@@ -133,12 +173,23 @@ typedef struct _KmsRecorderStats
 struct _KmsRecorderEndpointPrivate
 {
   KmsRecordingProfile profile;
-  GstClockTime paused_time;
   GstClockTime paused_start;
   gboolean use_dvr;
+  guint write_behind_bytes;
+  gboolean direct_io;
+  guint sync_interval;
+  GstClockTime segment_duration;
+  guint64 segment_size;
+  guint fragment_duration;
   GstTaskPool *pool;
   KmsBaseMediaMuxer *mux;
+
+  /* Written with base_time_lock held, odd base_time_seq while writing. */
+  /* Streaming threads read it without locking, see read_base_time */
   GMutex base_time_lock;
+  BaseTimeType base_time;
+  gint base_time_seq;
+  gint recording;               /* Whether buffers are recorded */
 
   GSList *sink_probes;
   GHashTable *srcs;
@@ -186,6 +237,77 @@ sink_pad_data_destroy (KmsSinkPadData * data)
   g_slice_free (KmsSinkPadData, data);
 }
 
+static KmsWriteBehindData *
+write_behind_data_new (KmsMediaType type)
+{
+  KmsWriteBehindData *data;
+
+  data = g_slice_new0 (KmsWriteBehindData);
+  data->type = type;
+
+  return data;
+}
+
+static void
+write_behind_data_destroy (KmsWriteBehindData * data)
+{
+  g_slice_free (KmsWriteBehindData, data);
+}
+
+static void
+kms_recorder_endpoint_write_base_time_begin (KmsRecorderEndpoint * self)
+{
+  BASE_TIME_LOCK (self);
+  g_atomic_int_inc (&self->priv->base_time_seq);
+}
+
+static void
+kms_recorder_endpoint_write_base_time_end (KmsRecorderEndpoint * self)
+{
+  g_atomic_int_inc (&self->priv->base_time_seq);
+  BASE_TIME_UNLOCK (self);
+}
+
+static void
+kms_recorder_endpoint_reset_base_time (KmsRecorderEndpoint * self)
+{
+  self->priv->base_time.pts = GST_CLOCK_TIME_NONE;
+  self->priv->base_time.dts = GST_CLOCK_TIME_NONE;
+  self->priv->base_time.audio_gaps = 0;
+  self->priv->base_time.paused_time = 0;
+  self->priv->base_time.generation++;
+}
+
+/* Retries while a writer runs, which only happens on state changes, the */
+/* first buffers of a recording and audio gaps */
+static void
+kms_recorder_endpoint_read_base_time (KmsRecorderEndpoint * self,
+    BaseTimeType * base_time)
+{
+  gint seq;
+
+  do {
+    seq = g_atomic_int_get (&self->priv->base_time_seq);
+    *base_time = self->priv->base_time;
+    /* Full barrier, the copy is done before checking seq again */
+  } while ((seq & 1) || g_atomic_int_add (&self->priv->base_time_seq, 0) != seq);
+}
+
+/* Called with the element lock held whenever state or transition change */
+static void
+kms_recorder_endpoint_update_recording (KmsRecorderEndpoint * self)
+{
+  KmsUriEndpointState state;
+  gboolean recording;
+
+  state = kms_uri_endpoint_get_state (KMS_URI_ENDPOINT (self));
+  recording = (state == KMS_URI_ENDPOINT_STATE_START &&
+      self->priv->transition == KMS_RECORDER_ENDPOINT_COMPLETED) ||
+      self->priv->transition == KMS_RECORDER_ENDPOINT_STARTING;
+
+  g_atomic_int_set (&self->priv->recording, recording);
+}
+
 static MarkBufferProbeData *
 mark_buffer_probe_data_new ()
 {
@@ -250,17 +372,72 @@ send_eos (GstElement * appsrc)
   }
 }
 
-typedef struct _BaseTimeType
+/*
+ * Appsrcs do not block, so buffers wait in their queues while the muxer or
+ * the sink are slow instead of blocking the streaming thread of the upstream
+ * element. This bounds those queues: once over the high water mark video
+ * waits for the next keyframe, dropping the frames that depend on the ones
+ * already dropped, and once full keyframes are dropped too. Audio is never
+ * dropped.
+ */
+static gboolean
+kms_recorder_endpoint_write_behind (KmsRecorderEndpoint * self,
+    GstAppSink * appsink, GstAppSrc * appsrc, GstBuffer * buffer)
 {
-  GstClockTime pts;
-  GstClockTime dts;
-  GstClockTime audio_gaps;
-} BaseTimeType;
+  KmsWriteBehindData *data;
+  guint64 max, level;
+  gboolean delta;
 
-static void
-release_base_time_type (gpointer data)
-{
-  g_slice_free (BaseTimeType, data);
+  max = g_atomic_int_get (&self->priv->write_behind_bytes);
+  data = g_object_get_qdata (G_OBJECT (appsink), kms_write_behind_key_quark ());
+
+  if (max == 0 || data == NULL) {
+    return TRUE;
+  }
+
+  level = gst_app_src_get_current_level_bytes (appsrc);
+
+  if (level >= max * HIGH_WATER_PERCENT / 100) {
+    if (!data->high_water) {
+      const gchar *media =
+          data->type == KMS_MEDIA_TYPE_AUDIO ? "audio" : "video";
+
+      data->high_water = TRUE;
+      GST_WARNING_OBJECT (self, "Storage too slow, %" G_GUINT64_FORMAT
+          " bytes of %s waiting", level, media);
+      g_signal_emit (self,
+          kms_recorder_endpoint_signals[SIGNAL_WRITE_BEHIND_HIGH_WATER], 0,
+          media);
+    }
+  } else if (level < max * LOW_WATER_PERCENT / 100) {
+    data->high_water = FALSE;
+  }
+
+  if (data->type != KMS_MEDIA_TYPE_VIDEO ||
+      GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_HEADER)) {
+    return TRUE;
+  }
+
+  delta = GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  if ((delta && (data->high_water || data->waiting_keyframe)) ||
+      (!delta && level + gst_buffer_get_size (buffer) > max)) {
+    GST_LOG_OBJECT (appsink, "Queue at %" G_GUINT64_FORMAT
+        " bytes, drop buffer %" GST_PTR_FORMAT, level, buffer);
+    data->waiting_keyframe = TRUE;
+    data->dropped++;
+    return FALSE;
+  }
+
+  if (!delta && data->waiting_keyframe) {
+    GST_DEBUG_OBJECT (appsink, "Keyframe after %" G_GUINT64_FORMAT
+        " dropped buffers", data->dropped);
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+    data->waiting_keyframe = FALSE;
+    data->dropped = 0;
+  }
+
+  return TRUE;
 }
 
 // Adjust timestamps to avoid gaps created by paused recordings.
@@ -269,11 +446,8 @@ recv_sample (GstAppSink * appsink, gpointer user_data)
 {
   KmsRecorderEndpoint *self =
       KMS_RECORDER_ENDPOINT (GST_OBJECT_PARENT (appsink));
-  KmsUriEndpointState state = KMS_URI_ENDPOINT_STATE_STOP;
-  BaseTimeType *base_time = NULL;
-  GstCaps *caps = NULL;
+  BaseTimeType base_time;
 
-  gboolean unlock_element = FALSE;
   GstSample *sample = NULL;
   GstFlowReturn ret = GST_FLOW_OK;
 
@@ -304,14 +478,10 @@ recv_sample (GstAppSink * appsink, gpointer user_data)
 
   const GstSegment *segment = gst_sample_get_segment (sample);
 
-  unlock_element = TRUE;
-  KMS_ELEMENT_LOCK (self);
-
-  state = kms_uri_endpoint_get_state (KMS_URI_ENDPOINT (self));
+  /* Before checking the flag, as stopping clears it before the reset */
+  kms_recorder_endpoint_read_base_time (self, &base_time);
 
-  if (!((state == KMS_URI_ENDPOINT_STATE_START &&
-              self->priv->transition == KMS_RECORDER_ENDPOINT_COMPLETED) ||
-          self->priv->transition == KMS_RECORDER_ENDPOINT_STARTING)) {
+  if (!g_atomic_int_get (&self->priv->recording)) {
     GST_LOG_OBJECT (appsink,
         "Not recording, drop buffer %" GST_PTR_FORMAT, buffer);
     ret = GST_FLOW_OK;
@@ -336,34 +506,39 @@ recv_sample (GstAppSink * appsink, gpointer user_data)
     }
   }
 
-  BASE_TIME_LOCK (self);
+  // The first buffers of a recording set the base time.
+  if ((!GST_CLOCK_TIME_IS_VALID (base_time.pts)
+          && GST_BUFFER_PTS_IS_VALID (buffer))
+      || (!GST_CLOCK_TIME_IS_VALID (base_time.dts)
+          && GST_BUFFER_DTS_IS_VALID (buffer))) {
+    kms_recorder_endpoint_write_base_time_begin (self);
 
-  // First time this runs, create a new BaseTime storage.
-  {
-    base_time = g_object_get_qdata (G_OBJECT (self), base_time_key_quark ());
-    if (base_time == NULL) {
-      base_time = g_slice_new0 (BaseTimeType);
-      base_time->pts = GST_CLOCK_TIME_NONE;
-      base_time->dts = GST_CLOCK_TIME_NONE;
-      base_time->audio_gaps = 0;
-
-      g_object_set_qdata_full (G_OBJECT (self), base_time_key_quark (),
-          base_time, release_base_time_type);
+    if (self->priv->base_time.generation != base_time.generation) {
+      /* The recording it belongs to stopped meanwhile */
+      kms_recorder_endpoint_write_base_time_end (self);
+      GST_LOG_OBJECT (appsink,
+          "Recording stopped, drop buffer %" GST_PTR_FORMAT, buffer);
+      gst_buffer_unref (buffer);
+      goto end;
     }
 
-    if (!GST_CLOCK_TIME_IS_VALID (base_time->pts)
+    if (!GST_CLOCK_TIME_IS_VALID (self->priv->base_time.pts)
         && GST_BUFFER_PTS_IS_VALID (buffer)) {
-      base_time->pts = GST_BUFFER_PTS (buffer);
+      self->priv->base_time.pts = GST_BUFFER_PTS (buffer);
       GST_DEBUG_OBJECT (self, "Setting PTS base time to %" GST_TIME_FORMAT,
-          GST_TIME_ARGS (base_time->pts));
+          GST_TIME_ARGS (self->priv->base_time.pts));
     }
 
-    if (!GST_CLOCK_TIME_IS_VALID (base_time->dts)
+    if (!GST_CLOCK_TIME_IS_VALID (self->priv->base_time.dts)
         && GST_BUFFER_DTS_IS_VALID (buffer)) {
-      base_time->dts = GST_BUFFER_DTS (buffer);
+      self->priv->base_time.dts = GST_BUFFER_DTS (buffer);
       GST_DEBUG_OBJECT (self, "Setting DTS base time to %" GST_TIME_FORMAT,
-          GST_TIME_ARGS (base_time->dts));
+          GST_TIME_ARGS (self->priv->base_time.dts));
     }
+
+    base_time = self->priv->base_time;
+
+    kms_recorder_endpoint_write_base_time_end (self);
   }
 
   // Adjust PTS/DTS of all buffers, so recordings are always created with an
@@ -373,10 +548,10 @@ recv_sample (GstAppSink * appsink, gpointer user_data)
     // The 'paused_time' doesn't account exactly for all the time, it is missing
     // some milliseconds. Maybe due to latency in upstream elements?
 
-    if (GST_CLOCK_TIME_IS_VALID (base_time->pts)
+    if (GST_CLOCK_TIME_IS_VALID (base_time.pts)
         && GST_BUFFER_PTS_IS_VALID (buffer)) {
       const GstClockTime offset =
-          base_time->pts + base_time->audio_gaps + self->priv->paused_time;
+          base_time.pts + base_time.audio_gaps + base_time.paused_time;
       // PTS -= offset, but preventing underflows.
       if (GST_BUFFER_PTS (buffer) > offset) {
         GST_BUFFER_PTS (buffer) -= offset;
@@ -385,10 +560,10 @@ recv_sample (GstAppSink * appsink, gpointer user_data)
       }
     }
 
-    if (GST_CLOCK_TIME_IS_VALID (base_time->dts)
+    if (GST_CLOCK_TIME_IS_VALID (base_time.dts)
         && GST_BUFFER_DTS_IS_VALID (buffer)) {
       const GstClockTime offset =
-          base_time->dts + base_time->audio_gaps + self->priv->paused_time;
+          base_time.dts + base_time.audio_gaps + base_time.paused_time;
       // DTS -= offset, but preventing underflows.
       if (GST_BUFFER_DTS (buffer) > offset) {
         GST_BUFFER_DTS (buffer) -= offset;
@@ -398,23 +573,17 @@ recv_sample (GstAppSink * appsink, gpointer user_data)
     }
   }
 
-  BASE_TIME_UNLOCK (self);
-
   // Set some flags to make sure the buffer is appropriately handled downstream.
   GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_LIVE);
   if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_HEADER)) {
     GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
   }
 
-  KMS_ELEMENT_UNLOCK (self);
-  unlock_element = FALSE;
-
-  caps = gst_app_src_get_caps (appsrc);
-  if (caps == NULL) {
-    GST_ERROR_OBJECT (appsrc, "Trying to push buffer without setting caps");
-  } else {
-    gst_caps_unref (caps);
+  if (!kms_recorder_endpoint_write_behind (self, appsink, appsrc, buffer)) {
+    gst_buffer_unref (buffer);
+    goto end;
   }
+
   ret = gst_app_src_push_buffer (appsrc, buffer);
 
   if (ret != GST_FLOW_OK) {
@@ -424,10 +593,6 @@ recv_sample (GstAppSink * appsink, gpointer user_data)
   }
 
 end:
-  if (unlock_element) {
-    KMS_ELEMENT_UNLOCK (self);
-  }
-
   if (sample != NULL) {
     gst_sample_unref (sample);
   }
@@ -459,6 +624,7 @@ kms_recorder_endpoint_change_state (KmsRecorderEndpoint * self,
   }
 
   self->priv->transition = transition;
+  kms_recorder_endpoint_update_recording (self);
 }
 
 static void
@@ -484,6 +650,7 @@ kms_recorder_endpoint_sync_state_changed (KmsRecorderEndpoint * self,
 
   KMS_URI_ENDPOINT_GET_CLASS (self)->change_state (KMS_URI_ENDPOINT (self),
       state);
+  kms_recorder_endpoint_update_recording (self);
 
   KMS_ELEMENT_UNLOCK (KMS_ELEMENT (self));
 }
@@ -511,6 +678,7 @@ kms_recorder_endpoint_async_state_changed (KmsRecorderEndpoint * self,
 
     KMS_URI_ENDPOINT_GET_CLASS (self)->change_state (KMS_URI_ENDPOINT (self),
         state);
+    kms_recorder_endpoint_update_recording (self);
   } else {
     KmsUriEndpointState current;
 
@@ -803,15 +971,12 @@ kms_recorder_endpoint_stopped (KmsUriEndpoint * obj, GError ** error)
   kms_recorder_endpoint_remove_pads (self);
 
   // Reset base time data
-  BASE_TIME_LOCK (self);
+  kms_recorder_endpoint_write_base_time_begin (self);
+  kms_recorder_endpoint_reset_base_time (self);
+  kms_recorder_endpoint_write_base_time_end (self);
 
-  g_object_set_qdata_full (G_OBJECT (self), base_time_key_quark (), NULL, NULL);
-
-  self->priv->paused_time = G_GUINT64_CONSTANT (0);
   self->priv->paused_start = GST_CLOCK_TIME_NONE;
 
-  BASE_TIME_UNLOCK (self);
-
   if (self->priv->playing) {
     if (!self->priv->sent_eos) {
       KMS_ELEMENT_UNLOCK (self);
@@ -879,17 +1044,16 @@ kms_recorder_endpoint_started (KmsUriEndpoint * obj, GError ** error)
   kms_base_media_muxer_set_state (self->priv->mux, GST_STATE_PLAYING);
   KMS_ELEMENT_LOCK (self);
 
-  BASE_TIME_LOCK (self);
-
   if (GST_CLOCK_TIME_IS_VALID (self->priv->paused_start)) {
-    self->priv->paused_time +=
+    kms_recorder_endpoint_write_base_time_begin (self);
+    self->priv->base_time.paused_time +=
         gst_clock_get_time (kms_base_media_muxer_get_clock (self->priv->mux)) -
         self->priv->paused_start;
+    kms_recorder_endpoint_write_base_time_end (self);
+
     self->priv->paused_start = GST_CLOCK_TIME_NONE;
   }
 
-  BASE_TIME_UNLOCK (self);
-
   kms_recorder_generate_pads (self);
 
   if (self->priv->playing) {
@@ -1063,21 +1227,23 @@ appsink_event_probe (GstPad * pad, GstPadProbeInfo * info,
     isn't, so it will reach downstream elements such as this one.
     */
 
-    // Get the RecorderEndpoint base timings, if any yet.
-    BaseTimeType *base_time =
-        g_object_get_qdata (G_OBJECT (self), base_time_key_quark ());
-
     // Get the current appsink caps to see if this is applies to the audio.
     GstAppSink *appsink = GST_APP_SINK (gst_pad_get_parent_element (pad));
     caps = gst_app_sink_get_caps (appsink);
 
-    if (base_time != NULL && kms_utils_caps_is_audio (caps)) {
+    if (kms_utils_caps_is_audio (caps)) {
       GstClockTime gap_pts;
       GstClockTime gap_duration;
       gst_event_parse_gap (event, &gap_pts, &gap_duration);
 
-      // This will later be used to adjust timestamp of audio buffers.
-      base_time->audio_gaps += gap_duration;
+      // This will later be used to adjust timestamp of audio buffers, once
+      // the recording has a base time.
+      kms_recorder_endpoint_write_base_time_begin (self);
+      if (GST_CLOCK_TIME_IS_VALID (self->priv->base_time.pts) ||
+          GST_CLOCK_TIME_IS_VALID (self->priv->base_time.dts)) {
+        self->priv->base_time.audio_gaps += gap_duration;
+      }
+      kms_recorder_endpoint_write_base_time_end (self);
 
       // The GAP event has been handled here, so no need to pass it downstream.
       ret = GST_PAD_PROBE_DROP;
@@ -1160,6 +1326,9 @@ link_sinkpad_cb (GstPad * pad, GstObject * parent, GstPad * peer)
   }
 
   appsink = gst_pad_get_parent_element (target);
+  g_object_set_qdata_full (G_OBJECT (appsink), kms_write_behind_key_quark (),
+      write_behind_data_new (type),
+      (GDestroyNotify) write_behind_data_destroy);
   g_object_set_qdata_full (G_OBJECT (appsink), kms_appsrc_id_key_quark (),
       appsrc, NULL);
   g_object_unref (appsink);
@@ -1359,6 +1528,11 @@ kms_recorder_endpoint_on_sink_added (KmsBaseMediaMuxer * obj,
 
   KMS_ELEMENT_LOCK (KMS_ELEMENT (self));
 
+  if (KMS_IS_FILE_SINK (sink)) {
+    g_object_set (sink, "direct-io", self->priv->direct_io, "sync-interval",
+        self->priv->sync_interval, NULL);
+  }
+
   self->priv->sink_probes = g_slist_append (self->priv->sink_probes, sprobe);
 
   if (self->priv->stats.enabled) {
@@ -1381,7 +1555,11 @@ kms_recorder_endpoint_create_base_media_muxer (KmsRecorderEndpoint * self)
   } else {
     mux = KMS_BASE_MEDIA_MUXER (kms_av_muxer_new
         (KMS_BASE_MEDIA_MUXER_PROFILE, self->priv->profile,
-            KMS_BASE_MEDIA_MUXER_URI, KMS_URI_ENDPOINT (self)->uri, NULL));
+            KMS_BASE_MEDIA_MUXER_URI, KMS_URI_ENDPOINT (self)->uri,
+            KMS_BASE_MEDIA_MUXER_SEGMENT_DURATION, self->priv->segment_duration,
+            KMS_BASE_MEDIA_MUXER_SEGMENT_SIZE, self->priv->segment_size,
+            KMS_AV_MUXER_FRAGMENT_DURATION, self->priv->fragment_duration,
+            NULL));
   }
 
   self->priv->mux = mux;
@@ -1439,6 +1617,25 @@ kms_recorder_endpoint_set_property (GObject * object, guint property_id,
 
       break;
     }
+    case PROP_WRITE_BEHIND_BYTES:
+      g_atomic_int_set (&self->priv->write_behind_bytes,
+          g_value_get_uint (value));
+      break;
+    case PROP_DIRECT_IO:
+      self->priv->direct_io = g_value_get_boolean (value);
+      break;
+    case PROP_SYNC_INTERVAL:
+      self->priv->sync_interval = g_value_get_uint (value);
+      break;
+    case PROP_SEGMENT_DURATION:
+      self->priv->segment_duration = g_value_get_uint64 (value);
+      break;
+    case PROP_SEGMENT_SIZE:
+      self->priv->segment_size = g_value_get_uint64 (value);
+      break;
+    case PROP_FRAGMENT_DURATION:
+      self->priv->fragment_duration = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -1461,6 +1658,24 @@ kms_recorder_endpoint_get_property (GObject * object, guint property_id,
       g_value_set_enum (value, self->priv->profile);
       break;
     }
+    case PROP_WRITE_BEHIND_BYTES:
+      g_value_set_uint (value, self->priv->write_behind_bytes);
+      break;
+    case PROP_DIRECT_IO:
+      g_value_set_boolean (value, self->priv->direct_io);
+      break;
+    case PROP_SYNC_INTERVAL:
+      g_value_set_uint (value, self->priv->sync_interval);
+      break;
+    case PROP_SEGMENT_DURATION:
+      g_value_set_uint64 (value, self->priv->segment_duration);
+      break;
+    case PROP_SEGMENT_SIZE:
+      g_value_set_uint64 (value, self->priv->segment_size);
+      break;
+    case PROP_FRAGMENT_DURATION:
+      g_value_set_uint (value, self->priv->fragment_duration);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -1957,9 +2172,56 @@ kms_recorder_endpoint_class_init (KmsRecorderEndpointClass * klass)
       "The profile used for encapsulating the media",
       KMS_TYPE_RECORDING_PROFILE, DEFAULT_RECORDING_PROFILE, G_PARAM_READWRITE);
 
+  obj_properties[PROP_WRITE_BEHIND_BYTES] =
+      g_param_spec_uint ("write-behind-bytes", "Write-behind bytes",
+      "Bytes of each stream that can wait to be written while the storage "
+      "is slow. Over this, video is dropped up to the next keyframe. Audio "
+      "is never dropped (0 = unlimited)", 0, G_MAXUINT,
+      DEFAULT_WRITE_BEHIND_BYTES, G_PARAM_READWRITE);
+
+  obj_properties[PROP_DIRECT_IO] = g_param_spec_boolean ("direct-io",
+      "Direct I/O", "Write recordings to files bypassing the page cache "
+      "(O_DIRECT) where the file system supports it. Applied when the file "
+      "is opened", FALSE, G_PARAM_READWRITE);
+
+  obj_properties[PROP_SYNC_INTERVAL] = g_param_spec_uint ("sync-interval",
+      "Sync interval", "Minimum time in milliseconds between fdatasync calls "
+      "on recorded files (0 = never sync)", 0, G_MAXUINT, 0,
+      G_PARAM_READWRITE);
+
+  obj_properties[PROP_SEGMENT_DURATION] =
+      g_param_spec_uint64 ("segment-duration", "Segment duration",
+      "Record to a new file after this time, in nanoseconds, at the next "
+      "keyframe. Only for local files, set before the profile "
+      "(0 = disabled)", 0, G_MAXUINT64, 0, G_PARAM_READWRITE);
+
+  obj_properties[PROP_SEGMENT_SIZE] =
+      g_param_spec_uint64 ("segment-size", "Segment size",
+      "Record to a new file after this number of bytes, at the next "
+      "keyframe. Only for local files, set before the profile "
+      "(0 = disabled)", 0, G_MAXUINT64, 0, G_PARAM_READWRITE);
+
+  obj_properties[PROP_FRAGMENT_DURATION] =
+      g_param_spec_uint ("fragment-duration", "Fragment duration",
+      "Record MP4 profiles as fragmented MP4, with fragments of this "
+      "duration in milliseconds. Set before the profile "
+      "(0 = not fragmented)", 0, G_MAXUINT, 0, G_PARAM_READWRITE);
+
   g_object_class_install_properties (gobject_class,
       N_PROPERTIES, obj_properties);
 
+  kms_recorder_endpoint_signals[SIGNAL_WRITE_BEHIND_HIGH_WATER] =
+      g_signal_new ("write-behind-high-water",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+      g_cclosure_marshal_VOID__STRING, G_TYPE_NONE, 1, G_TYPE_STRING);
+
+  kms_recorder_endpoint_signals[SIGNAL_SEGMENT_CLOSED] =
+      g_signal_new ("segment-closed",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+      g_cclosure_marshal_VOID__STRING, G_TYPE_NONE, 1, G_TYPE_STRING);
+
   /* Registers a private structure for the instantiatable type */
   g_type_class_add_private (klass, sizeof (KmsRecorderEndpointPrivate));
 }
@@ -2035,6 +2297,17 @@ bus_sync_signal_handler (GstBus *bus, GstMessage *msg, gpointer data)
 
     break;
   }
+  case GST_MESSAGE_ELEMENT:
+    /* Segments are complete before the EOS of the whole recording */
+    if (gst_message_has_name (msg, KMS_FILE_SINK_COMPLETE_MESSAGE)
+        && (self->priv->segment_duration > 0 || self->priv->segment_size > 0)) {
+      const gchar *location = gst_structure_get_string (
+          gst_message_get_structure (msg), "location");
+
+      g_signal_emit (self,
+          kms_recorder_endpoint_signals[SIGNAL_SEGMENT_CLOSED], 0, location);
+    }
+    break;
   case GST_MESSAGE_EOS:
     gst_task_pool_push (
         self->priv->pool, kms_recorder_endpoint_on_eos_message, self, NULL);
@@ -2089,8 +2362,9 @@ kms_recorder_endpoint_init (KmsRecorderEndpoint * self)
       g_object_unref);
 
   self->priv->profile = DEFAULT_RECORDING_PROFILE;
+  self->priv->write_behind_bytes = DEFAULT_WRITE_BEHIND_BYTES;
 
-  self->priv->paused_time = G_GUINT64_CONSTANT (0);
+  kms_recorder_endpoint_reset_base_time (self);
   self->priv->paused_start = GST_CLOCK_TIME_NONE;
 
   self->priv->sink_pad_data = g_hash_table_new_full (g_str_hash, g_str_equal,
@@ -2111,6 +2385,10 @@ kms_recorder_endpoint_init (KmsRecorderEndpoint * self)
 gboolean
 kms_recorder_endpoint_plugin_init (GstPlugin * plugin)
 {
+  if (!kms_file_sink_plugin_init (plugin)) {
+    return FALSE;
+  }
+
   return gst_element_register (plugin, PLUGIN_NAME, GST_RANK_NONE,
       KMS_TYPE_RECORDER_ENDPOINT);
 }
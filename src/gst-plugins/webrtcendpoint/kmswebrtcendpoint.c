@@ -21,8 +21,8 @@
 
 #include "kmswebrtcendpoint.h"
 #include "kmswebrtcsession.h"
+#include "kmswebrtclooppool.h"
 #include <commons/constants.h>
-#include <commons/kmsloop.h>
 #include <commons/kmsutils.h>
 #include <commons/sdp_utils.h>
 #include <commons/kmsrefstruct.h>
@@ -98,8 +98,7 @@ static guint kms_webrtc_endpoint_signals[LAST_SIGNAL] = { 0 };
 
 struct _KmsWebrtcEndpointPrivate
 {
-  KmsLoop *loop;
-  GMainContext *context;
+  GMainContext *context;         /* Shared with other endpoints, see kmswebrtclooppool.h */
 
   gchar *stun_server_ip;
   guint stun_server_port;
@@ -618,7 +617,10 @@ kms_webrtc_endpoint_dispose (GObject * object)
 
   KMS_ELEMENT_LOCK (self);
 
-  g_clear_object (&self->priv->loop);
+  if (self->priv->context != NULL) {
+    kms_webrtc_loop_pool_release (self->priv->context);
+    self->priv->context = NULL;
+  }
 
   KMS_ELEMENT_UNLOCK (self);
 
@@ -642,8 +644,6 @@ kms_webrtc_endpoint_finalize (GObject * object)
   g_free (self->priv->external_ipv4);
   g_free (self->priv->external_ipv6);
 
-  g_main_context_unref (self->priv->context);
-
   /* chain up */
   G_OBJECT_CLASS (kms_webrtc_endpoint_parent_class)->finalize (object);
 }
@@ -992,8 +992,7 @@ kms_webrtc_endpoint_init (KmsWebrtcEndpoint * self)
   self->priv->external_ipv6 = DEFAULT_EXTERNAL_IPV6;
   self->priv->niceagent_ice_tcp = DEFAULT_NICEAGENT_ICE_TCP;
 
-  self->priv->loop = kms_loop_new ();
-  g_object_get (self->priv->loop, "context", &self->priv->context, NULL);
+  self->priv->context = kms_webrtc_loop_pool_acquire ();
 }
 
 gboolean
@@ -0,0 +1,200 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "kmswebrtclooppool.h"
+#include <gst/gst.h>
+#include <commons/kmsloop.h>
+
+#define GST_CAT_DEFAULT kmswebrtclooppool
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmswebrtclooppool"
+
+typedef struct _KmsWebrtcLoopPoolEntry
+{
+  KmsLoop *loop;
+  GMainContext *context;
+  guint users;
+} KmsWebrtcLoopPoolEntry;
+
+static GMutex pool_mutex;
+static GPtrArray *pool_entries = NULL;
+static guint pool_size;
+static gboolean pool_size_set = FALSE;
+
+static void
+kms_webrtc_loop_pool_init (void)
+{
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init)) {
+    GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+        GST_DEFAULT_NAME);
+    g_once_init_leave (&init, 1);
+  }
+}
+
+/* Must be called with pool_mutex held */
+static guint
+kms_webrtc_loop_pool_get_size_unlocked (void)
+{
+  if (!pool_size_set) {
+    pool_size = g_get_num_processors ();
+    pool_size_set = TRUE;
+  }
+
+  return pool_size;
+}
+
+void
+kms_webrtc_loop_pool_set_size (guint size)
+{
+  kms_webrtc_loop_pool_init ();
+
+  g_mutex_lock (&pool_mutex);
+  pool_size = size;
+  pool_size_set = TRUE;
+  g_mutex_unlock (&pool_mutex);
+
+  GST_INFO ("WebRtcEndpoint loop pool size set to %u", size);
+}
+
+guint
+kms_webrtc_loop_pool_get_size (void)
+{
+  guint size;
+
+  g_mutex_lock (&pool_mutex);
+  size = kms_webrtc_loop_pool_get_size_unlocked ();
+  g_mutex_unlock (&pool_mutex);
+
+  return size;
+}
+
+guint
+kms_webrtc_loop_pool_get_n_loops (void)
+{
+  guint n;
+
+  g_mutex_lock (&pool_mutex);
+  n = (pool_entries != NULL) ? pool_entries->len : 0;
+  g_mutex_unlock (&pool_mutex);
+
+  return n;
+}
+
+static KmsWebrtcLoopPoolEntry *
+kms_webrtc_loop_pool_entry_new (void)
+{
+  KmsWebrtcLoopPoolEntry *entry = g_slice_new0 (KmsWebrtcLoopPoolEntry);
+
+  entry->loop = kms_loop_new ();
+  g_object_get (entry->loop, "context", &entry->context, NULL);
+
+  return entry;
+}
+
+GMainContext *
+kms_webrtc_loop_pool_acquire (void)
+{
+  KmsWebrtcLoopPoolEntry *entry = NULL;
+  guint size, i;
+
+  kms_webrtc_loop_pool_init ();
+
+  g_mutex_lock (&pool_mutex);
+
+  if (pool_entries == NULL) {
+    pool_entries = g_ptr_array_new ();
+  }
+
+  size = kms_webrtc_loop_pool_get_size_unlocked ();
+
+  if (size == KMS_WEBRTC_LOOP_POOL_DEDICATED || pool_entries->len < size) {
+    entry = kms_webrtc_loop_pool_entry_new ();
+    g_ptr_array_add (pool_entries, entry);
+  } else {
+    /* Least loaded loop */
+    for (i = 0; i < pool_entries->len; i++) {
+      KmsWebrtcLoopPoolEntry *e = g_ptr_array_index (pool_entries, i);
+
+      if (entry == NULL || e->users < entry->users) {
+        entry = e;
+      }
+    }
+  }
+
+  entry->users++;
+
+  GST_DEBUG ("Assigned loop %p (%u users, %u loops)", entry->loop,
+      entry->users, pool_entries->len);
+
+  g_mutex_unlock (&pool_mutex);
+
+  return g_main_context_ref (entry->context);
+}
+
+void
+kms_webrtc_loop_pool_release (GMainContext * context)
+{
+  KmsWebrtcLoopPoolEntry *entry = NULL;
+  guint i;
+
+  g_return_if_fail (context != NULL);
+
+  g_mutex_lock (&pool_mutex);
+
+  for (i = 0; pool_entries != NULL && i < pool_entries->len; i++) {
+    KmsWebrtcLoopPoolEntry *e = g_ptr_array_index (pool_entries, i);
+
+    if (e->context == context) {
+      entry = e;
+      break;
+    }
+  }
+
+  if (entry == NULL) {
+    g_mutex_unlock (&pool_mutex);
+    GST_WARNING ("Context %p does not belong to the loop pool", context);
+    g_main_context_unref (context);
+    return;
+  }
+
+  if (--entry->users > 0) {
+    entry = NULL;
+  } else {
+    g_ptr_array_remove_index_fast (pool_entries, i);
+  }
+
+  g_mutex_unlock (&pool_mutex);
+
+  g_main_context_unref (context);
+
+  if (entry == NULL) {
+    return;
+  }
+
+  /* Last user gone. The loop thread is stopped out of the pool lock, as it
+   * could be waiting for it while releasing another endpoint */
+  GST_DEBUG ("Freeing unused loop %p", entry->loop);
+  g_main_context_unref (entry->context);
+  g_object_unref (entry->loop);
+  g_slice_free (KmsWebrtcLoopPoolEntry, entry);
+}
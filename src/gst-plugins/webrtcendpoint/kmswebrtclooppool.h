@@ -0,0 +1,52 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_WEBRTC_LOOP_POOL_H__
+#define __KMS_WEBRTC_LOOP_POOL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Process-wide pool of event loop threads shared by all WebRtcEndpoints.
+ * ICE (libnice), DTLS and SCTP sources of every endpoint are attached to the
+ * GMainContext of one of these loops, so the number of threads no longer
+ * grows with the number of endpoints.
+ *
+ * A pool size of 0 restores the old behaviour: one dedicated loop for each
+ * endpoint.
+ */
+
+#define KMS_WEBRTC_LOOP_POOL_DEDICATED 0
+
+/* Change the maximum number of loops. Already assigned endpoints are not
+ * moved; the new size applies to the following acquisitions. */
+void kms_webrtc_loop_pool_set_size (guint size);
+guint kms_webrtc_loop_pool_get_size (void);
+
+/* Number of loops (threads) currently running */
+guint kms_webrtc_loop_pool_get_n_loops (void);
+
+/* Returns a new reference to the context of the least loaded loop */
+GMainContext * kms_webrtc_loop_pool_acquire (void);
+/* Gives back a context obtained with kms_webrtc_loop_pool_acquire () */
+void kms_webrtc_loop_pool_release (GMainContext * context);
+
+G_END_DECLS
+
+#endif /* __KMS_WEBRTC_LOOP_POOL_H__ */
@@ -0,0 +1,265 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "CertificatePool.hpp"
+#include "CertificateManager.hpp"
+#include <gst/gst.h>
+#include <algorithm>
+
+#define GST_CAT_DEFAULT kurento_certificate_pool
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "KurentoCertificatePool"
+
+namespace kurento
+{
+
+static const char *
+keyTypeToString (CertificatePool::KeyType keyType)
+{
+  return keyType == CertificatePool::KeyType::RSA ? "RSA" : "ECDSA";
+}
+
+CertificatePool::CertificatePool (KeyType keyType, unsigned int size,
+                                  unsigned int maxUses,
+                                  std::chrono::seconds maxAge) :
+  keyType (keyType), size (size), maxUses (maxUses), maxAge (maxAge),
+  hits (0), misses (0)
+{
+  static std::once_flag debug_flag;
+
+  std::call_once (debug_flag, [] () {
+    GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+                             GST_DEFAULT_NAME);
+  });
+
+  GST_INFO ("Creating %s certificate pool, size: %u, max uses: %u"
+            ", max age: %llds", keyTypeToString (keyType), size, maxUses,
+            (long long) maxAge.count () );
+
+  thread = std::thread (&CertificatePool::refill, this);
+}
+
+CertificatePool::~CertificatePool ()
+{
+  {
+    std::unique_lock<std::mutex> lock (mutex);
+    stop = true;
+  }
+
+  cond.notify_all ();
+  thread.join ();
+}
+
+std::string
+CertificatePool::generate ()
+{
+  if (keyType == KeyType::RSA) {
+    return CertificateManager::generateRSACertificate ();
+  }
+
+  return CertificateManager::generateECDSACertificate ();
+}
+
+bool
+CertificatePool::isExpired (const Certificate &certificate) const
+{
+  if (maxAge.count () == 0) {
+    return false;
+  }
+
+  return std::chrono::steady_clock::now () >= certificate.expires;
+}
+
+/* Called with the mutex held, returns whether any certificate was retired */
+bool
+CertificatePool::retireExpired ()
+{
+  size_t count = certificates.size ();
+
+  certificates.erase (std::remove_if (certificates.begin (),
+                                      certificates.end (),
+  [this] (const Certificate & c) {
+    return isExpired (c);
+  }), certificates.end () );
+
+  if (certificates.size () == count) {
+    return false;
+  }
+
+  GST_DEBUG ("Retired %zu expired %s certificates",
+             count - certificates.size (), keyTypeToString (keyType) );
+
+  return true;
+}
+
+/*
+ * Lifetime of the next certificate added to the pool. While the pool fills
+ * up, the n-th certificate only lives n / size of maxAge, so that expiries are
+ * spread evenly and renewing them one at a time keeps up. Called with the
+ * mutex held.
+ */
+std::chrono::steady_clock::duration
+CertificatePool::lifetime () const
+{
+  std::chrono::steady_clock::duration age = maxAge;
+
+  if (certificates.size () + 1 >= size) {
+    return age;
+  }
+
+  return age * (certificates.size () + 1) / size;
+}
+
+void
+CertificatePool::addCertificate (const std::string &pem, unsigned int uses)
+{
+  std::unique_lock<std::mutex> lock (mutex);
+
+  if (certificates.size () >= size || (maxUses > 0 && uses >= maxUses) ) {
+    return;
+  }
+
+  certificates.push_back ({pem, std::chrono::steady_clock::now () + lifetime (),
+                           uses});
+}
+
+std::string
+CertificatePool::getCertificate ()
+{
+  std::unique_lock<std::mutex> lock (mutex);
+
+  if (retireExpired () ) {
+    cond.notify_one ();
+  }
+
+  if (certificates.empty () ) {
+    lock.unlock ();
+    misses++;
+
+    GST_INFO ("%s certificate pool is empty; generating synchronously",
+              keyTypeToString (keyType) );
+    std::string pem = generate ();
+
+    if (!pem.empty () ) {
+      addCertificate (pem, 1);
+    }
+
+    cond.notify_one ();
+    return pem;
+  }
+
+  hits++;
+
+  /* Round robin among the warm certificates */
+  Certificate certificate = certificates.front ();
+  certificates.pop_front ();
+  certificate.uses++;
+
+  if (maxUses == 0 || certificate.uses < maxUses) {
+    certificates.push_back (certificate);
+  } else {
+    GST_DEBUG ("Retiring %s certificate after %u uses",
+               keyTypeToString (keyType), certificate.uses);
+    cond.notify_one ();
+  }
+
+  return certificate.pem;
+}
+
+/*
+ * Waits until the certificate closest to expiry is due and generates its
+ * successor before retiring it, so requests keep finding a warm certificate.
+ * Called with the lock held on a full, non empty pool.
+ */
+void
+CertificatePool::renewOldest (std::unique_lock<std::mutex> &lock)
+{
+  /* Half the spacing between expiries to generate the successor */
+  std::chrono::steady_clock::duration margin = maxAge;
+  std::chrono::steady_clock::time_point renewAt;
+  auto oldest = [this] () {
+    return std::min_element (certificates.begin (), certificates.end (),
+    [] (const Certificate & a, const Certificate & b) {
+      return a.expires < b.expires;
+    });
+  };
+
+  margin /= 2 * size;
+  renewAt = oldest ()->expires - margin;
+
+  if (std::chrono::steady_clock::now () < renewAt) {
+    cond.wait_until (lock, renewAt);
+    return;
+  }
+
+  lock.unlock ();
+  std::string pem = generate ();
+  lock.lock ();
+
+  if (pem.empty () ) {
+    GST_WARNING ("Cannot renew %s certificate; retrying later",
+                 keyTypeToString (keyType) );
+    cond.wait_for (lock, std::chrono::seconds (1) );
+    return;
+  }
+
+  certificates.push_back ({pem, std::chrono::steady_clock::now () + maxAge, 0});
+  /* The pool may have changed while unlocked, retire whatever is oldest now */
+  certificates.erase (oldest () );
+
+  GST_DEBUG ("%s certificate renewed", keyTypeToString (keyType) );
+}
+
+void
+CertificatePool::refill ()
+{
+  std::unique_lock<std::mutex> lock (mutex);
+
+  while (!stop) {
+    retireExpired ();
+
+    if (certificates.size () >= size) {
+      if (certificates.empty () || maxAge.count () == 0) {
+        cond.wait (lock);
+      } else {
+        renewOldest (lock);
+      }
+
+      continue;
+    }
+
+    lock.unlock ();
+    std::string pem = generate ();
+    lock.lock ();
+
+    if (pem.empty () ) {
+      GST_WARNING ("Cannot generate %s certificate; retrying later",
+                   keyTypeToString (keyType) );
+      cond.wait_for (lock, std::chrono::seconds (1) );
+      continue;
+    }
+
+    if (certificates.size () < size) {
+      certificates.push_back ({pem, std::chrono::steady_clock::now () + lifetime (),
+                               0});
+      GST_DEBUG ("%s certificate pool refilled (%zu/%u)",
+                 keyTypeToString (keyType), certificates.size (), size);
+    }
+  }
+}
+
+} /* kurento */
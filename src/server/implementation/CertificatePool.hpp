@@ -0,0 +1,98 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __CERTIFICATE_POOL_HPP__
+#define __CERTIFICATE_POOL_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace kurento
+{
+
+/*
+ * Keeps a set of self-signed certificates generated in background, so that
+ * creating a WebRtcEndpoint does not pay for the key generation.
+ *
+ * Certificates are handed out in round robin and retired after being used
+ * `maxUses` times or once they are older than `maxAge`; a value of 0 disables
+ * the corresponding limit. Retired certificates are replaced asynchronously.
+ *
+ * Expiry times are spread over `maxAge` and each certificate is replaced
+ * before it expires, so age based rotation never leaves the pool empty.
+ */
+class CertificatePool
+{
+public:
+  enum class KeyType { RSA, ECDSA };
+
+  CertificatePool (KeyType keyType, unsigned int size, unsigned int maxUses,
+                   std::chrono::seconds maxAge);
+  ~CertificatePool ();
+
+  /* Falls back to synchronous generation if the pool is empty */
+  std::string getCertificate ();
+
+  uint64_t getHits () const
+  {
+    return hits;
+  }
+
+  uint64_t getMisses () const
+  {
+    return misses;
+  }
+
+private:
+  struct Certificate {
+    std::string pem;
+    std::chrono::steady_clock::time_point expires;
+    unsigned int uses;
+  };
+
+  std::string generate ();
+  bool isExpired (const Certificate &certificate) const;
+  bool retireExpired ();
+  std::chrono::steady_clock::duration lifetime () const;
+  void addCertificate (const std::string &pem, unsigned int uses);
+  void renewOldest (std::unique_lock<std::mutex> &lock);
+  void refill ();
+
+  KeyType keyType;
+  unsigned int size;
+  unsigned int maxUses;
+  std::chrono::seconds maxAge;
+
+  std::deque<Certificate> certificates;
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool stop = false;
+  std::thread thread;
+
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> misses;
+};
+
+} /* kurento */
+
+#endif /* __CERTIFICATE_POOL_HPP__ */
@@ -22,6 +22,7 @@
 #include "HubPortImpl.hpp"
 #include <AlphaBlendingImplFactory.hpp>
 #include "AlphaBlendingImpl.hpp"
+#include "AlphaBlendingPortProperties.hpp"
 #include <jsonrpc/JsonSerializer.hpp>
 #include <KurentoException.hpp>
 #include <gst/gst.h>
@@ -33,6 +34,7 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define FACTORY_NAME "alphablending"
 #define MASTER_PORT "set-master"
 #define SET_PORT_PROPERTIES "set-port-properties"
+#define SET_PORTS_PROPERTIES "set-ports-properties"
 
 namespace kurento
 {
@@ -81,6 +83,33 @@ void AlphaBlendingImpl::setPortProperties (float relativeX, float relativeY,
   gst_structure_free (data);
 }
 
+void AlphaBlendingImpl::setPortsProperties (const
+    std::vector<std::shared_ptr<AlphaBlendingPortProperties>> &ports)
+{
+  GPtrArray *data;
+
+  data = g_ptr_array_new_full (ports.size(),
+                               (GDestroyNotify) gst_structure_free);
+
+  for (auto &properties : ports) {
+    std::shared_ptr<HubPortImpl> mixerPort =
+      std::dynamic_pointer_cast<HubPortImpl> (properties->getPort() );
+
+    g_ptr_array_add (data, gst_structure_new ("data",
+                     "port", G_TYPE_INT, mixerPort->getHandlerId(),
+                     "relative_x", G_TYPE_FLOAT, properties->getRelativeX(),
+                     "relative_y", G_TYPE_FLOAT, properties->getRelativeY(),
+                     "relative_width", G_TYPE_FLOAT, properties->getRelativeWidth(),
+                     "relative_height", G_TYPE_FLOAT, properties->getRelativeHeight(),
+                     "z_order", G_TYPE_INT, properties->getZOrder(),
+                     NULL) );
+  }
+
+  GST_DEBUG ("set properties of %u ports", data->len);
+  g_signal_emit_by_name (element, SET_PORTS_PROPERTIES, data);
+  g_ptr_array_unref (data);
+}
+
 MediaObjectImpl *
 AlphaBlendingImplFactory::createObject (const boost::property_tree::ptree &conf,
                                         std::shared_ptr<MediaPipeline>
@@ -45,6 +45,8 @@ public:
   void setMaster (std::shared_ptr<HubPort> source, int zOrder);
   void setPortProperties (float relativeX, float relativeY, int zOrder,
                           float relativeWidth, float relativeHeight, std::shared_ptr<HubPort> port);
+  void setPortsProperties (const
+                           std::vector<std::shared_ptr<AlphaBlendingPortProperties>> &ports);
 
   /* Next methods are automatically implemented by code generator */
   virtual bool connect (const std::string &eventType,
@@ -16,11 +16,17 @@
  */
 #include <gst/gst.h>
 #include "MediaPipeline.hpp"
+#include "HubPortImpl.hpp"
 #include <CompositeImplFactory.hpp>
 #include "CompositeImpl.hpp"
+#include "CompositeInputStats.hpp"
+#include "CompositeMediaMode.hpp"
+#include "CompositeLayout.hpp"
 #include <jsonrpc/JsonSerializer.hpp>
 #include <KurentoException.hpp>
 #include <gst/gst.h>
+#include "kmscompositemediamode.h"
+#include "kmscompositelayout.h"
 
 #define GST_CAT_DEFAULT kurento_composite_impl
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
@@ -28,20 +34,324 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 
 #define FACTORY_NAME "compositemixer"
 
+#define WIDTH "width"
+#define HEIGHT "height"
+#define FRAMERATE "framerate"
+#define FORMAT "format"
+#define LATENCY "latency"
+#define GET_INPUT_STATS "get-input-stats"
+#define MEDIA_MODE "media-mode"
+#define MIX_MINUS "mix-minus"
+#define LAYOUT "layout"
+#define SPEAKERS "speakers"
+#define MAX_THUMBNAILS "max-thumbnails"
+#define SPEAKER_HOLD_TIME "speaker-hold-time"
+#define SPEAKER_SWITCH_MARGIN "speaker-switch-margin"
+
 namespace kurento
 {
 
 CompositeImpl::CompositeImpl (const boost::property_tree::ptree &conf,
-                              std::shared_ptr<MediaPipeline> mediaPipeline) : HubImpl (conf,
+                              std::shared_ptr<MediaPipeline> mediaPipeline,
+                              std::shared_ptr<CompositeMediaMode> mediaMode,
+                              bool mixMinus) : HubImpl (conf,
                                     std::dynamic_pointer_cast<MediaObjectImpl> (mediaPipeline), FACTORY_NAME)
 {
+  KmsCompositeMediaMode mode;
+
+  switch (mediaMode->getValue () ) {
+  case CompositeMediaMode::AUDIO:
+    mode = KMS_COMPOSITE_MEDIA_MODE_AUDIO;
+    break;
+
+  case CompositeMediaMode::VIDEO:
+    mode = KMS_COMPOSITE_MEDIA_MODE_VIDEO;
+    break;
+
+  default:
+    mode = KMS_COMPOSITE_MEDIA_MODE_AUDIO_VIDEO;
+    break;
+  }
+
+  g_object_set (G_OBJECT (element), MEDIA_MODE, mode, MIX_MINUS, mixMinus,
+                NULL);
+}
+
+int
+CompositeImpl::getWidth ()
+{
+  int width;
+
+  g_object_get (G_OBJECT (element), WIDTH, &width, NULL);
+
+  return width;
+}
+
+void
+CompositeImpl::setWidth (int width)
+{
+  if (width <= 0) {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "Width must be greater than 0");
+  }
+
+  g_object_set (G_OBJECT (element), WIDTH, width, NULL);
+}
+
+int
+CompositeImpl::getHeight ()
+{
+  int height;
+
+  g_object_get (G_OBJECT (element), HEIGHT, &height, NULL);
+
+  return height;
+}
+
+void
+CompositeImpl::setHeight (int height)
+{
+  if (height <= 0) {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "Height must be greater than 0");
+  }
+
+  g_object_set (G_OBJECT (element), HEIGHT, height, NULL);
+}
+
+int
+CompositeImpl::getFramerate ()
+{
+  int framerate;
+
+  g_object_get (G_OBJECT (element), FRAMERATE, &framerate, NULL);
+
+  return framerate;
+}
+
+void
+CompositeImpl::setFramerate (int framerate)
+{
+  if (framerate <= 0) {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "Framerate must be greater than 0");
+  }
+
+  g_object_set (G_OBJECT (element), FRAMERATE, framerate, NULL);
+}
+
+std::string
+CompositeImpl::getPixelFormat ()
+{
+  gchar *format;
+  std::string ret;
+
+  g_object_get (G_OBJECT (element), FORMAT, &format, NULL);
+
+  if (format != NULL) {
+    ret = format;
+    g_free (format);
+  }
+
+  return ret;
+}
+
+void
+CompositeImpl::setPixelFormat (const std::string &pixelFormat)
+{
+  if (!pixelFormat.empty () && pixelFormat != "I420" && pixelFormat != "NV12"
+      && pixelFormat != "AYUV") {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "Unsupported pixel format: " + pixelFormat);
+  }
+
+  g_object_set (G_OBJECT (element), FORMAT,
+                pixelFormat.empty () ? NULL : pixelFormat.c_str (), NULL);
+}
+
+int
+CompositeImpl::getLatency ()
+{
+  guint latency;
+
+  g_object_get (G_OBJECT (element), LATENCY, &latency, NULL);
+
+  return latency;
+}
+
+void
+CompositeImpl::setLatency (int latency)
+{
+  if (latency < 0) {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "Latency can not be negative");
+  }
+
+  g_object_set (G_OBJECT (element), LATENCY, (guint) latency, NULL);
+}
+
+std::shared_ptr<CompositeLayout>
+CompositeImpl::getLayout ()
+{
+  KmsCompositeLayout layout;
+
+  g_object_get (G_OBJECT (element), LAYOUT, &layout, NULL);
+
+  if (layout == KMS_COMPOSITE_LAYOUT_ACTIVE_SPEAKER) {
+    return std::make_shared<CompositeLayout> (CompositeLayout::ACTIVE_SPEAKER);
+  }
+
+  return std::make_shared<CompositeLayout> (CompositeLayout::GRID);
+}
+
+void
+CompositeImpl::setLayout (std::shared_ptr<CompositeLayout> layout)
+{
+  KmsCompositeLayout value;
+
+  switch (layout->getValue () ) {
+  case CompositeLayout::ACTIVE_SPEAKER:
+    value = KMS_COMPOSITE_LAYOUT_ACTIVE_SPEAKER;
+    break;
+
+  default:
+    value = KMS_COMPOSITE_LAYOUT_GRID;
+    break;
+  }
+
+  g_object_set (G_OBJECT (element), LAYOUT, value, NULL);
+}
+
+int
+CompositeImpl::getSpeakers ()
+{
+  guint speakers;
+
+  g_object_get (G_OBJECT (element), SPEAKERS, &speakers, NULL);
+
+  return speakers;
+}
+
+void
+CompositeImpl::setSpeakers (int speakers)
+{
+  if (speakers <= 0) {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "Speakers must be greater than 0");
+  }
+
+  g_object_set (G_OBJECT (element), SPEAKERS, (guint) speakers, NULL);
+}
+
+int
+CompositeImpl::getMaxThumbnails ()
+{
+  guint maxThumbnails;
+
+  g_object_get (G_OBJECT (element), MAX_THUMBNAILS, &maxThumbnails, NULL);
+
+  return maxThumbnails;
+}
+
+void
+CompositeImpl::setMaxThumbnails (int maxThumbnails)
+{
+  if (maxThumbnails < 0) {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "Max thumbnails can not be negative");
+  }
+
+  g_object_set (G_OBJECT (element), MAX_THUMBNAILS, (guint) maxThumbnails,
+                NULL);
+}
+
+int
+CompositeImpl::getSpeakerHoldTime ()
+{
+  guint holdTime;
+
+  g_object_get (G_OBJECT (element), SPEAKER_HOLD_TIME, &holdTime, NULL);
+
+  return holdTime;
+}
+
+void
+CompositeImpl::setSpeakerHoldTime (int speakerHoldTime)
+{
+  if (speakerHoldTime < 0) {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "Speaker hold time can not be negative");
+  }
+
+  g_object_set (G_OBJECT (element), SPEAKER_HOLD_TIME,
+                (guint) speakerHoldTime, NULL);
+}
+
+int
+CompositeImpl::getSpeakerSwitchMargin ()
+{
+  guint margin;
+
+  g_object_get (G_OBJECT (element), SPEAKER_SWITCH_MARGIN, &margin, NULL);
+
+  return margin;
+}
+
+void
+CompositeImpl::setSpeakerSwitchMargin (int speakerSwitchMargin)
+{
+  if (speakerSwitchMargin < 0) {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "Speaker switch margin can not be negative");
+  }
+
+  g_object_set (G_OBJECT (element), SPEAKER_SWITCH_MARGIN,
+                (guint) speakerSwitchMargin, NULL);
+}
+
+std::shared_ptr<CompositeInputStats>
+CompositeImpl::getInputStats (std::shared_ptr<HubPort> hubPort)
+{
+  std::shared_ptr<HubPortImpl> port =
+    std::dynamic_pointer_cast<HubPortImpl> (hubPort);
+  std::shared_ptr<CompositeInputStats> inputStats;
+  GstStructure *stats = NULL;
+  gboolean linked, fastPath;
+  gint x, y, width, height, inputWidth, inputHeight;
+  gchar *inputFormat = NULL;
+
+  g_signal_emit_by_name (G_OBJECT (element), GET_INPUT_STATS,
+                         port->getHandlerId (), &stats);
+
+  if (stats == NULL) {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "HubPort does not belong to this Composite");
+  }
+
+  gst_structure_get (stats, "linked", G_TYPE_BOOLEAN, &linked,
+                     "x", G_TYPE_INT, &x, "y", G_TYPE_INT, &y,
+                     "width", G_TYPE_INT, &width, "height", G_TYPE_INT, &height,
+                     "input-width", G_TYPE_INT, &inputWidth,
+                     "input-height", G_TYPE_INT, &inputHeight,
+                     "input-format", G_TYPE_STRING, &inputFormat,
+                     "fast-path", G_TYPE_BOOLEAN, &fastPath, NULL);
+  gst_structure_free (stats);
+
+  inputStats = std::make_shared<CompositeInputStats> (linked, x, y, width,
+               height, inputWidth, inputHeight,
+               inputFormat != NULL ? inputFormat : "", fastPath);
+  g_free (inputFormat);
+
+  return inputStats;
 }
 
 MediaObjectImpl *
 CompositeImplFactory::createObject (const boost::property_tree::ptree &conf,
-                                    std::shared_ptr<MediaPipeline> mediaPipeline) const
+                                    std::shared_ptr<MediaPipeline> mediaPipeline,
+                                    std::shared_ptr<CompositeMediaMode> mediaMode,
+                                    bool mixMinus) const
 {
-  return new CompositeImpl (conf, mediaPipeline);
+  return new CompositeImpl (conf, mediaPipeline, mediaMode, mixMinus);
 }
 
 CompositeImpl::StaticConstructor CompositeImpl::staticConstructor;
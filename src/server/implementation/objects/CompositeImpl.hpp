@@ -36,10 +36,44 @@ class CompositeImpl : public HubImpl, public virtual Composite
 public:
 
   CompositeImpl (const boost::property_tree::ptree &conf,
-                 std::shared_ptr<MediaPipeline> mediaPipeline);
+                 std::shared_ptr<MediaPipeline> mediaPipeline,
+                 std::shared_ptr<CompositeMediaMode> mediaMode, bool mixMinus);
 
   virtual ~CompositeImpl () {};
 
+  int getWidth () override;
+  void setWidth (int width) override;
+
+  int getHeight () override;
+  void setHeight (int height) override;
+
+  int getFramerate () override;
+  void setFramerate (int framerate) override;
+
+  std::string getPixelFormat () override;
+  void setPixelFormat (const std::string &pixelFormat) override;
+
+  int getLatency () override;
+  void setLatency (int latency) override;
+
+  std::shared_ptr<CompositeLayout> getLayout () override;
+  void setLayout (std::shared_ptr<CompositeLayout> layout) override;
+
+  int getSpeakers () override;
+  void setSpeakers (int speakers) override;
+
+  int getMaxThumbnails () override;
+  void setMaxThumbnails (int maxThumbnails) override;
+
+  int getSpeakerHoldTime () override;
+  void setSpeakerHoldTime (int speakerHoldTime) override;
+
+  int getSpeakerSwitchMargin () override;
+  void setSpeakerSwitchMargin (int speakerSwitchMargin) override;
+
+  std::shared_ptr<CompositeInputStats> getInputStats (std::shared_ptr<HubPort>
+      hubPort) override;
+
   /* Next methods are automatically implemented by code generator */
   virtual bool connect (const std::string &eventType,
                         std::shared_ptr<EventHandler> handler);
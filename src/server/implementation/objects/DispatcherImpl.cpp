@@ -17,6 +17,8 @@
 #include <gst/gst.h>
 #include "MediaPipeline.hpp"
 #include "HubPortImpl.hpp"
+#include "HubRoute.hpp"
+#include "MediaType.hpp"
 #include <DispatcherImplFactory.hpp>
 #include "DispatcherImpl.hpp"
 #include <jsonrpc/JsonSerializer.hpp>
@@ -28,6 +30,7 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define GST_DEFAULT_NAME "KurentoDispatcherImpl"
 
 #define FACTORY_NAME "dispatcher"
+#define APPLY_ROUTING "apply-routing"
 
 namespace kurento
 {
@@ -57,6 +60,57 @@ void DispatcherImpl::connect (std::shared_ptr<HubPort> source,
   }
 }
 
+void DispatcherImpl::applyRouting (const
+                                   std::vector<std::shared_ptr<HubRoute>> &routes)
+{
+  GPtrArray *data;
+  bool applied;
+
+  data = g_ptr_array_new_full (routes.size(),
+                               (GDestroyNotify) gst_structure_free);
+
+  for (auto &route : routes) {
+    std::shared_ptr<HubPortImpl> sourcePort =
+      std::dynamic_pointer_cast<HubPortImpl> (route->getSource() );
+    std::shared_ptr<HubPortImpl> sinkPort =
+      std::dynamic_pointer_cast<HubPortImpl> (route->getSink() );
+    GstStructure *s;
+
+    s = gst_structure_new ("route",
+                           "source", G_TYPE_UINT, sourcePort->getHandlerId(),
+                           "sink", G_TYPE_UINT, sinkPort->getHandlerId(),
+                           "connect", G_TYPE_BOOLEAN,
+                           !route->isSetConnect() || route->getConnect(),
+                           NULL);
+
+    if (route->isSetMedia() ) {
+      switch (route->getMedia()->getValue() ) {
+      case MediaType::AUDIO:
+        gst_structure_set (s, "media", G_TYPE_STRING, "audio", NULL);
+        break;
+
+      case MediaType::VIDEO:
+        gst_structure_set (s, "media", G_TYPE_STRING, "video", NULL);
+        break;
+
+      default:
+        gst_structure_free (s);
+        g_ptr_array_unref (data);
+        throw KurentoException (UNSUPPORTED_MEDIA_TYPE, "Invalid media type");
+      }
+    }
+
+    g_ptr_array_add (data, s);
+  }
+
+  g_signal_emit_by_name (G_OBJECT (element), APPLY_ROUTING, data, &applied);
+  g_ptr_array_unref (data);
+
+  if (!applied) {
+    throw KurentoException (CONNECT_ERROR, "Can not apply routing");
+  }
+}
+
 MediaObjectImpl *
 DispatcherImplFactory::createObject (const boost::property_tree::ptree &conf,
                                      std::shared_ptr<MediaPipeline> mediaPipeline) const
@@ -26,6 +26,7 @@ namespace kurento
 
 class MediaPipeline;
 class HubPort;
+class HubRoute;
 class DispatcherImpl;
 
 void Serialize (std::shared_ptr<DispatcherImpl> &object,
@@ -42,6 +43,7 @@ public:
   virtual ~DispatcherImpl () {};
 
   void connect (std::shared_ptr<HubPort> source, std::shared_ptr<HubPort> sink);
+  void applyRouting (const std::vector<std::shared_ptr<HubRoute>> &routes);
 
   /* Next methods are automatically implemented by code generator */
   virtual bool connect (const std::string &eventType,
@@ -30,15 +30,20 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 
 #define FACTORY_NAME "dispatcheronetomany"
 #define MAIN_PORT "main"
+#define FORWARD_ENCODED "forward-encoded"
+#define DECODERS "decoders"
+#define ENCODERS "encoders"
 
 namespace kurento
 {
 
 DispatcherOneToManyImpl::DispatcherOneToManyImpl (const
     boost::property_tree::ptree &conf,
-    std::shared_ptr<MediaPipeline> mediaPipeline) : HubImpl (conf,
+    std::shared_ptr<MediaPipeline> mediaPipeline,
+    bool forwardEncoded) : HubImpl (conf,
           std::dynamic_pointer_cast<MediaObjectImpl> (mediaPipeline), FACTORY_NAME)
 {
+  g_object_set (G_OBJECT (element), FORWARD_ENCODED, forwardEncoded, NULL);
 }
 
 void DispatcherOneToManyImpl::setSource (std::shared_ptr<HubPort> source)
@@ -54,11 +59,30 @@ void DispatcherOneToManyImpl::removeSource ()
   g_object_set (G_OBJECT (element), MAIN_PORT, -1, NULL);
 }
 
+int DispatcherOneToManyImpl::getDecoders ()
+{
+  guint decoders;
+
+  g_object_get (G_OBJECT (element), DECODERS, &decoders, NULL);
+
+  return decoders;
+}
+
+int DispatcherOneToManyImpl::getEncoders ()
+{
+  guint encoders;
+
+  g_object_get (G_OBJECT (element), ENCODERS, &encoders, NULL);
+
+  return encoders;
+}
+
 MediaObjectImpl *
 DispatcherOneToManyImplFactory::createObject (const boost::property_tree::ptree
-    &conf, std::shared_ptr<MediaPipeline> mediaPipeline) const
+    &conf, std::shared_ptr<MediaPipeline> mediaPipeline,
+    bool forwardEncoded) const
 {
-  return new DispatcherOneToManyImpl (conf, mediaPipeline);
+  return new DispatcherOneToManyImpl (conf, mediaPipeline, forwardEncoded);
 }
 
 DispatcherOneToManyImpl::StaticConstructor
@@ -38,13 +38,17 @@ class DispatcherOneToManyImpl : public HubImpl,
 public:
 
   DispatcherOneToManyImpl (const boost::property_tree::ptree &conf,
-                           std::shared_ptr<MediaPipeline> mediaPipeline);
+                           std::shared_ptr<MediaPipeline> mediaPipeline,
+                           bool forwardEncoded);
 
   virtual ~DispatcherOneToManyImpl () {};
 
   void setSource (std::shared_ptr<HubPort> source);
   void removeSource ();
 
+  int getDecoders ();
+  int getEncoders ();
+
   /* Next methods are automatically implemented by code generator */
   virtual bool connect (const std::string &eventType,
                         std::shared_ptr<EventHandler> handler);
@@ -18,6 +18,7 @@
 #include "MediaPipeline.hpp"
 #include "MediaType.hpp"
 #include "HubPortImpl.hpp"
+#include "HubRoute.hpp"
 #include <MixerImplFactory.hpp>
 #include "MixerImpl.hpp"
 #include <jsonrpc/JsonSerializer.hpp>
@@ -29,6 +30,7 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define GST_DEFAULT_NAME "KurentoMixerImpl"
 
 #define FACTORY_NAME "selectablemixer"
+#define APPLY_ROUTING "apply-routing"
 
 namespace kurento
 {
@@ -106,6 +108,59 @@ void MixerImpl::disconnect (std::shared_ptr<MediaType> media,
   }
 }
 
+void MixerImpl::applyRouting (const std::vector<std::shared_ptr<HubRoute>>
+                              &routes)
+{
+  GPtrArray *data;
+  bool applied;
+
+  data = g_ptr_array_new_full (routes.size(),
+                               (GDestroyNotify) gst_structure_free);
+
+  for (auto &route : routes) {
+    std::shared_ptr<HubPortImpl> sourcePort =
+      std::dynamic_pointer_cast<HubPortImpl> (route->getSource() );
+    std::shared_ptr<HubPortImpl> sinkPort =
+      std::dynamic_pointer_cast<HubPortImpl> (route->getSink() );
+    const gchar *media;
+
+    if (!route->isSetMedia() ) {
+      g_ptr_array_unref (data);
+      throw KurentoException (UNSUPPORTED_MEDIA_TYPE,
+                              "Media type is required for mixer routes");
+    }
+
+    switch (route->getMedia()->getValue() ) {
+    case MediaType::AUDIO:
+      media = "audio";
+      break;
+
+    case MediaType::VIDEO:
+      media = "video";
+      break;
+
+    default:
+      g_ptr_array_unref (data);
+      throw KurentoException (UNSUPPORTED_MEDIA_TYPE, "Invalid media type");
+    }
+
+    g_ptr_array_add (data, gst_structure_new ("route",
+                     "source", G_TYPE_UINT, sourcePort->getHandlerId(),
+                     "sink", G_TYPE_UINT, sinkPort->getHandlerId(),
+                     "media", G_TYPE_STRING, media,
+                     "connect", G_TYPE_BOOLEAN,
+                     !route->isSetConnect() || route->getConnect(),
+                     NULL) );
+  }
+
+  g_signal_emit_by_name (G_OBJECT (element), APPLY_ROUTING, data, &applied);
+  g_ptr_array_unref (data);
+
+  if (!applied) {
+    throw KurentoException (CONNECT_ERROR, "Can not apply routing");
+  }
+}
+
 MediaObjectImpl *
 MixerImplFactory::createObject (const boost::property_tree::ptree &conf,
                                 std::shared_ptr<MediaPipeline> mediaPipeline) const
@@ -26,6 +26,7 @@ namespace kurento
 
 class MediaPipeline;
 class MediaType;
+class HubRoute;
 class HubPort;
 class MixerImpl;
 
@@ -48,6 +49,9 @@ public:
   virtual void disconnect (std::shared_ptr<MediaType> media,
       std::shared_ptr<HubPort> source, std::shared_ptr<HubPort> sink) override;
 
+  virtual void applyRouting (const std::vector<std::shared_ptr<HubRoute>>
+      &routes) override;
+
   /* Next methods are automatically implemented by code generator */
   virtual bool connect (const std::string &eventType,
       std::shared_ptr<EventHandler> handler) override;
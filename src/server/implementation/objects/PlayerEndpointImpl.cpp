@@ -17,6 +17,7 @@
 #include <gst/gst.h>
 #include "MediaPipeline.hpp"
 #include "VideoInfo.hpp"
+#include "PlayerSeekMode.hpp"
 #include <PlayerEndpointImplFactory.hpp>
 #include "PlayerEndpointImpl.hpp"
 #include <DotGraph.hpp>
@@ -25,6 +26,7 @@
 #include <memory>
 #include <gst/gst.h>
 #include "SignalHandler.hpp"
+#include "kmsplayerseekmode.h"
 
 #define GST_CAT_DEFAULT kurento_player_endpoint_impl
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
@@ -35,6 +37,11 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define POSITION "position"
 #define PIPELINE "pipeline"
 #define SET_POSITION "set-position"
+#define READ_AHEAD_BYTES "read-ahead-bytes"
+#define READ_AHEAD_TIME "read-ahead-time"
+#define READ_AHEAD_LEVEL "read-ahead-level"
+#define SEEK_MODE "seek-mode"
+#define RATE "rate"
 #define NS_TO_MS 1000000
 #define RTSP_CLIENT_PORT_RANGE "rtspClientPortRange"
 
@@ -104,13 +111,16 @@ void PlayerEndpointImpl::postConstructor()
 PlayerEndpointImpl::PlayerEndpointImpl (const boost::property_tree::ptree &conf,
                                         std::shared_ptr<MediaPipeline>
                                         mediaPipeline, const std::string &uri,
-                                        bool useEncodedMedia, int networkCache) : UriEndpointImpl (conf,
+                                        bool useEncodedMedia, int networkCache,
+                                        bool passthrough,
+                                        bool sharedSource) : UriEndpointImpl (conf,
                                               std::dynamic_pointer_cast<MediaObjectImpl> (mediaPipeline), FACTORY_NAME, uri)
 {
   GstElement *element = getGstreamerElement();
 
   g_object_set (G_OBJECT (element), "use-encoded-media", useEncodedMedia,
-                "network-cache", networkCache, NULL);
+                "network-cache", networkCache, "passthrough", passthrough,
+                "shared-source", sharedSource, NULL);
 
   std::string portRange;
   if (getConfigValue <std::string, PlayerEndpoint> (&portRange,
@@ -190,6 +200,87 @@ void PlayerEndpointImpl::setPosition (int64_t position)
   }
 }
 
+int PlayerEndpointImpl::getReadAheadBytes ()
+{
+  int readAheadBytes;
+
+  g_object_get (G_OBJECT (element), READ_AHEAD_BYTES, &readAheadBytes, NULL);
+
+  return readAheadBytes;
+}
+
+void PlayerEndpointImpl::setReadAheadBytes (int readAheadBytes)
+{
+  g_object_set (G_OBJECT (element), READ_AHEAD_BYTES, readAheadBytes, NULL);
+}
+
+int PlayerEndpointImpl::getReadAheadTime ()
+{
+  int readAheadTime;
+
+  g_object_get (G_OBJECT (element), READ_AHEAD_TIME, &readAheadTime, NULL);
+
+  return readAheadTime;
+}
+
+void PlayerEndpointImpl::setReadAheadTime (int readAheadTime)
+{
+  g_object_set (G_OBJECT (element), READ_AHEAD_TIME, readAheadTime, NULL);
+}
+
+int PlayerEndpointImpl::getReadAheadLevel ()
+{
+  int readAheadLevel;
+
+  g_object_get (G_OBJECT (element), READ_AHEAD_LEVEL, &readAheadLevel, NULL);
+
+  return readAheadLevel;
+}
+
+std::shared_ptr<PlayerSeekMode> PlayerEndpointImpl::getSeekMode ()
+{
+  KmsPlayerSeekMode seekMode;
+
+  g_object_get (G_OBJECT (element), SEEK_MODE, &seekMode, NULL);
+
+  if (seekMode == KMS_PLAYER_SEEK_MODE_KEYFRAME) {
+    return std::make_shared<PlayerSeekMode> (PlayerSeekMode::KEYFRAME);
+  }
+
+  return std::make_shared<PlayerSeekMode> (PlayerSeekMode::ACCURATE);
+}
+
+void PlayerEndpointImpl::setSeekMode (std::shared_ptr<PlayerSeekMode> seekMode)
+{
+  KmsPlayerSeekMode value;
+
+  switch (seekMode->getValue () ) {
+  case PlayerSeekMode::KEYFRAME:
+    value = KMS_PLAYER_SEEK_MODE_KEYFRAME;
+    break;
+
+  default:
+    value = KMS_PLAYER_SEEK_MODE_ACCURATE;
+    break;
+  }
+
+  g_object_set (G_OBJECT (element), SEEK_MODE, value, NULL);
+}
+
+float PlayerEndpointImpl::getRate ()
+{
+  gdouble rate;
+
+  g_object_get (G_OBJECT (element), RATE, &rate, NULL);
+
+  return rate;
+}
+
+void PlayerEndpointImpl::setRate (float rate)
+{
+  g_object_set (G_OBJECT (element), RATE, (gdouble) rate, NULL);
+}
+
 void PlayerEndpointImpl::play ()
 {
   start();
@@ -199,10 +290,11 @@ MediaObjectImpl *
 PlayerEndpointImplFactory::createObject (const boost::property_tree::ptree
     &conf,
     std::shared_ptr<MediaPipeline> mediaPipeline, const std::string &uri,
-    bool useEncodedMedia, int networkCache) const
+    bool useEncodedMedia, int networkCache, bool passthrough,
+    bool sharedSource) const
 {
   return new PlayerEndpointImpl (conf, mediaPipeline, uri, useEncodedMedia,
-                                 networkCache);
+                                 networkCache, passthrough, sharedSource);
 }
 
 PlayerEndpointImpl::StaticConstructor PlayerEndpointImpl::staticConstructor;
@@ -39,7 +39,8 @@ public:
 
   PlayerEndpointImpl (const boost::property_tree::ptree &conf,
                       std::shared_ptr<MediaPipeline> mediaPipeline, const std::string &uri,
-                      bool useEncodedMedia, int networkCache);
+                      bool useEncodedMedia, int networkCache, bool passthrough,
+                      bool sharedSource);
 
   virtual ~PlayerEndpointImpl ();
 
@@ -50,6 +51,20 @@ public:
   virtual int64_t getPosition() override;
   virtual void setPosition (int64_t position) override;
 
+  virtual int getReadAheadBytes () override;
+  virtual void setReadAheadBytes (int readAheadBytes) override;
+
+  virtual int getReadAheadTime () override;
+  virtual void setReadAheadTime (int readAheadTime) override;
+
+  virtual int getReadAheadLevel () override;
+
+  virtual std::shared_ptr<PlayerSeekMode> getSeekMode () override;
+  virtual void setSeekMode (std::shared_ptr<PlayerSeekMode> seekMode) override;
+
+  virtual float getRate () override;
+  virtual void setRate (float rate) override;
+
   virtual std::string getElementGstreamerDot() override;
 
   /* Next methods are automatically implemented by code generator */
@@ -41,6 +41,11 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 
 #define TIMEOUT 4 /* seconds */
 
+#define WRITE_BEHIND_BYTES "write-behind-bytes"
+#define SEGMENT_DURATION "segment-duration"
+#define SEGMENT_SIZE "segment-size"
+#define FRAGMENT_DURATION "fragment-duration"
+
 namespace kurento
 {
 
@@ -71,12 +76,27 @@ RecorderEndpointImpl::RecorderEndpointImpl (const boost::property_tree::ptree
     &conf,
     std::shared_ptr<MediaPipeline> mediaPipeline, const std::string &uri,
     std::shared_ptr<MediaProfileSpecType> mediaProfile,
-    bool stopOnEndOfStream) : UriEndpointImpl (conf,
+    bool stopOnEndOfStream, int segmentDuration,
+    int64_t segmentSize, int fragmentDuration) : UriEndpointImpl (conf,
           std::dynamic_pointer_cast<MediaObjectImpl> (mediaPipeline), FACTORY_NAME, uri)
 {
   g_object_set (G_OBJECT (getGstreamerElement() ), "accept-eos",
                 stopOnEndOfStream, NULL);
 
+  if (segmentDuration < 0 || segmentSize < 0) {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "segmentDuration and segmentSize cannot be negative");
+  }
+
+  if (segmentDuration > 0 || segmentSize > 0) {
+    checkSegmentable (uri, mediaProfile);
+  }
+
+  // The muxer is created with the profile, so segments are configured first
+  g_object_set (G_OBJECT (element), SEGMENT_DURATION,
+                (guint64) segmentDuration * GST_SECOND, SEGMENT_SIZE,
+                (guint64) segmentSize, NULL);
+
   switch (mediaProfile->getValue() ) {
   case MediaProfileSpecType::WEBM:
     g_object_set ( G_OBJECT (element), "profile", KMS_RECORDING_PROFILE_WEBM, NULL);
@@ -135,6 +155,26 @@ RecorderEndpointImpl::RecorderEndpointImpl (const boost::property_tree::ptree
     GST_INFO ("Set JPEG profile");
     break;
 
+  case MediaProfileSpecType::MP4_FRAGMENTED:
+    useFragmentedMp4 (fragmentDuration);
+    g_object_set ( G_OBJECT (element), "profile", KMS_RECORDING_PROFILE_MP4, NULL);
+    GST_INFO ("Set MP4 FRAGMENTED profile");
+    break;
+
+  case MediaProfileSpecType::MP4_FRAGMENTED_VIDEO_ONLY:
+    useFragmentedMp4 (fragmentDuration);
+    g_object_set ( G_OBJECT (element), "profile",
+                   KMS_RECORDING_PROFILE_MP4_VIDEO_ONLY, NULL);
+    GST_INFO ("Set MP4 FRAGMENTED VIDEO ONLY profile");
+    break;
+
+  case MediaProfileSpecType::MP4_FRAGMENTED_AUDIO_ONLY:
+    useFragmentedMp4 (fragmentDuration);
+    g_object_set ( G_OBJECT (element), "profile",
+                   KMS_RECORDING_PROFILE_MP4_AUDIO_ONLY, NULL);
+    GST_INFO ("Set MP4 FRAGMENTED AUDIO ONLY profile");
+    break;
+
   case MediaProfileSpecType::KURENTO_SPLIT_RECORDER:
     if (!RecorderEndpointImpl::support_ksr) {
       throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
@@ -147,6 +187,40 @@ RecorderEndpointImpl::RecorderEndpointImpl (const boost::property_tree::ptree
   }
 }
 
+// Segments are split files, so they are written by the local file sink and
+// need a container that can be split
+void RecorderEndpointImpl::checkSegmentable (const std::string &uri,
+    std::shared_ptr<MediaProfileSpecType> mediaProfile)
+{
+  if (!gst_uri_has_protocol (uri.c_str(), "file") ) {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "Only file:// URIs can be segmented");
+  }
+
+  switch (mediaProfile->getValue() ) {
+  case MediaProfileSpecType::JPEG_VIDEO_ONLY:
+  case MediaProfileSpecType::KURENTO_SPLIT_RECORDER:
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "JPEG and split recordings cannot be segmented");
+
+  default:
+    break;
+  }
+}
+
+// Fragmented profiles are the MP4 ones with a fragment duration, which has
+// to be set before the profile creates the muxer
+void RecorderEndpointImpl::useFragmentedMp4 (int fragmentDuration)
+{
+  if (fragmentDuration <= 0) {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "fragmentDuration must be positive");
+  }
+
+  g_object_set (G_OBJECT (element), FRAGMENT_DURATION,
+                (guint) fragmentDuration, NULL);
+}
+
 void RecorderEndpointImpl::postConstructor()
 {
   UriEndpointImpl::postConstructor();
@@ -158,6 +232,61 @@ void RecorderEndpointImpl::postConstructor()
                                       std::placeholders::_2) ),
                           std::dynamic_pointer_cast<RecorderEndpointImpl>
                           (shared_from_this() ) );
+
+  handlerOnWriteBehindHighWater = register_signal_handler (G_OBJECT (element),
+                                  "write-behind-high-water",
+                                  std::function <void (GstElement *, gchar *) >
+                                  (std::bind (&RecorderEndpointImpl::onWriteBehindHighWater,
+                                      this, std::placeholders::_2) ),
+                                  std::dynamic_pointer_cast<RecorderEndpointImpl>
+                                  (shared_from_this() ) );
+
+  handlerOnSegmentClosed = register_signal_handler (G_OBJECT (element),
+                           "segment-closed",
+                           std::function <void (GstElement *, gchar *) >
+                           (std::bind (&RecorderEndpointImpl::onSegmentClosed, this,
+                                       std::placeholders::_2) ),
+                           std::dynamic_pointer_cast<RecorderEndpointImpl>
+                           (shared_from_this() ) );
+}
+
+void
+RecorderEndpointImpl::onSegmentClosed (gchar *path)
+{
+  try {
+    SegmentClosed event (shared_from_this (), SegmentClosed::getName (),
+                         path);
+    sigcSignalEmit(signalSegmentClosed, event);
+  } catch (const std::bad_weak_ptr &e) {
+    // shared_from_this()
+    GST_ERROR ("BUG creating %s: %s", SegmentClosed::getName ().c_str (),
+               e.what ());
+  }
+}
+
+void
+RecorderEndpointImpl::onWriteBehindHighWater (gchar *media)
+{
+  std::shared_ptr<MediaType> type;
+
+  if (g_strcmp0 (media, "audio") == 0) {
+    type = std::make_shared<MediaType>(MediaType::AUDIO);
+  } else if (g_strcmp0 (media, "video") == 0) {
+    type = std::make_shared<MediaType>(MediaType::VIDEO);
+  } else {
+    GST_ERROR ("Unsupported media %s", media);
+    return;
+  }
+
+  try {
+    WriteBehindHighWater event (shared_from_this (),
+                                WriteBehindHighWater::getName (), type);
+    sigcSignalEmit(signalWriteBehindHighWater, event);
+  } catch (const std::bad_weak_ptr &e) {
+    // shared_from_this()
+    GST_ERROR ("BUG creating %s: %s",
+               WriteBehindHighWater::getName ().c_str (), e.what ());
+  }
 }
 
 void
@@ -247,6 +376,14 @@ RecorderEndpointImpl::~RecorderEndpointImpl()
     unregister_signal_handler (element, handlerOnStateChanged);
   }
 
+  if (handlerOnWriteBehindHighWater > 0) {
+    unregister_signal_handler (element, handlerOnWriteBehindHighWater);
+  }
+
+  if (handlerOnSegmentClosed > 0) {
+    unregister_signal_handler (element, handlerOnSegmentClosed);
+  }
+
   g_object_get (getGstreamerElement(), "state", &state, NULL);
 
   if (state != 0 /* stop */) {
@@ -259,6 +396,27 @@ void RecorderEndpointImpl::record ()
   start();
 }
 
+int RecorderEndpointImpl::getWriteBehindBytes ()
+{
+  guint writeBehindBytes;
+
+  g_object_get (G_OBJECT (element), WRITE_BEHIND_BYTES, &writeBehindBytes,
+                NULL);
+
+  return writeBehindBytes;
+}
+
+void RecorderEndpointImpl::setWriteBehindBytes (int writeBehindBytes)
+{
+  if (writeBehindBytes < 0) {
+    throw KurentoException (MEDIA_OBJECT_ILLEGAL_PARAM_ERROR,
+                            "writeBehindBytes cannot be negative");
+  }
+
+  g_object_set (G_OBJECT (element), WRITE_BEHIND_BYTES,
+                (guint) writeBehindBytes, NULL);
+}
+
 void RecorderEndpointImpl::stopAndWait ()
 {
   stop();
@@ -330,10 +488,12 @@ RecorderEndpointImplFactory::createObject (const boost::property_tree::ptree
     &conf, std::shared_ptr<MediaPipeline>
     mediaPipeline, const std::string &uri,
     std::shared_ptr<MediaProfileSpecType> mediaProfile,
-    bool stopOnEndOfStream) const
+    bool stopOnEndOfStream, int segmentDuration, int64_t segmentSize,
+    int fragmentDuration) const
 {
   return new RecorderEndpointImpl (conf, mediaPipeline, uri, mediaProfile,
-                                   stopOnEndOfStream);
+                                   stopOnEndOfStream, segmentDuration,
+                                   segmentSize, fragmentDuration);
 }
 
 RecorderEndpointImpl::StaticConstructor RecorderEndpointImpl::staticConstructor;
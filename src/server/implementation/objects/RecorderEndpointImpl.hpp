@@ -40,7 +40,8 @@ public:
 
   RecorderEndpointImpl (const boost::property_tree::ptree &conf,
                         std::shared_ptr<MediaPipeline> mediaPipeline, const std::string &uri,
-                        std::shared_ptr<MediaProfileSpecType> mediaProfile, bool stopOnEndOfStream);
+                        std::shared_ptr<MediaProfileSpecType> mediaProfile, bool stopOnEndOfStream,
+                        int segmentDuration, int64_t segmentSize, int fragmentDuration);
 
   virtual ~RecorderEndpointImpl ();
 
@@ -55,6 +56,11 @@ public:
   sigc::signal<void, Recording> signalRecording;
   sigc::signal<void, Paused> signalPaused;
   sigc::signal<void, Stopped> signalStopped;
+  sigc::signal<void, WriteBehindHighWater> signalWriteBehindHighWater;
+  sigc::signal<void, SegmentClosed> signalSegmentClosed;
+
+  virtual int getWriteBehindBytes () override;
+  virtual void setWriteBehindBytes (int writeBehindBytes) override;
 
   virtual void invoke (std::shared_ptr<MediaObjectImpl> obj,
                        const std::string &methodName, const Json::Value &params,
@@ -73,11 +79,18 @@ protected:
 private:
   static bool support_ksr;
   gulong handlerOnStateChanged = 0;
+  gulong handlerOnWriteBehindHighWater = 0;
+  gulong handlerOnSegmentClosed = 0;
   std::mutex mtx;
   std::condition_variable cv;
   gint state{};
 
   void onStateChanged (gint state);
+  void onWriteBehindHighWater (gchar *media);
+  void onSegmentClosed (gchar *path);
+  void checkSegmentable (const std::string &uri,
+                         std::shared_ptr<MediaProfileSpecType> mediaProfile);
+  void useFragmentedMp4 (int fragmentDuration);
   void waitForStateChange (gint state);
 
   void collectEndpointStats (std::map <std::string, std::shared_ptr<Stats>>
@@ -29,6 +29,7 @@
 #include <IceComponentState.hpp>
 #include <SignalHandler.hpp>
 #include <webrtcendpoint/kmsicebaseagent.h>
+#include <webrtcendpoint/kmswebrtclooppool.h>
 
 #include <StatsType.hpp>
 #include <RTCDataChannelState.hpp>
@@ -42,6 +43,7 @@
 #include <boost/algorithm/string.hpp>
 
 #include <CertificateManager.hpp>
+#include <CertificatePool.hpp>
 
 #define GST_CAT_DEFAULT kurento_web_rtc_endpoint_impl
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
@@ -58,6 +60,10 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define PARAM_NETWORK_INTERFACES "networkInterfaces"
 #define PARAM_IP_IGNORE_LIST "ipIgnoreList"
 #define PARAM_NICEAGENT_ICE_TCP "niceAgentIceTcp"
+#define PARAM_EVENT_LOOP_THREADS "eventLoopThreads"
+#define PARAM_CERTIFICATE_POOL_SIZE "certificatePoolSize"
+#define PARAM_CERTIFICATE_MAX_USES "certificateMaxUses"
+#define PARAM_CERTIFICATE_MAX_AGE "certificateMaxAge"
 
 #define PROP_EXTERNAL_ADDRESS "external-address"
 #define PROP_EXTERNAL_IPV4 "external-ipv4"
@@ -70,9 +76,14 @@ namespace kurento
 {
 
 static const uint DEFAULT_STUN_PORT = 3478;
+static const uint DEFAULT_CERTIFICATE_POOL_SIZE = 4;
+static const uint DEFAULT_CERTIFICATE_MAX_USES = 0;
+static const uint DEFAULT_CERTIFICATE_MAX_AGE = 0;
 
-static std::once_flag check_openh264, certificates_flag;
+static std::once_flag check_openh264, certificates_flag, loop_pool_flag;
 static std::string defaultCertificateRSA, defaultCertificateECDSA;
+static std::shared_ptr<CertificatePool> certificatePoolRSA,
+       certificatePoolECDSA;
 
 // "H264" gets added at runtime by check_support_for_h264()
 static std::vector<std::string> supported_codecs = { "VP8", "opus", "PCMU" };
@@ -152,6 +163,15 @@ WebRtcEndpointImpl::generateDefaultCertificates ()
   defaultCertificateECDSA = "";
   defaultCertificateRSA = "";
 
+  uint poolSize, maxUses, maxAge;
+
+  getConfigValue <uint, WebRtcEndpoint> (&poolSize,
+                                         PARAM_CERTIFICATE_POOL_SIZE, DEFAULT_CERTIFICATE_POOL_SIZE);
+  getConfigValue <uint, WebRtcEndpoint> (&maxUses,
+                                         PARAM_CERTIFICATE_MAX_USES, DEFAULT_CERTIFICATE_MAX_USES);
+  getConfigValue <uint, WebRtcEndpoint> (&maxAge,
+                                         PARAM_CERTIFICATE_MAX_AGE, DEFAULT_CERTIFICATE_MAX_AGE);
+
   std::string pemUriRSA;
   if (getConfigValue <std::string, WebRtcEndpoint> (&pemUriRSA,
       "pemCertificateRSA")) {
@@ -163,8 +183,10 @@ WebRtcEndpointImpl::generateDefaultCertificates ()
       GST_WARNING ("pemCertificate is deprecated. Please use pemCertificateRSA instead");
       defaultCertificateRSA = getCerficateFromFile (pemUri);
     } else {
-      GST_INFO ("Unable to load the RSA certificate from file. Using the default certificate.");
-      defaultCertificateRSA = CertificateManager::generateRSACertificate ();
+      GST_INFO ("Unable to load the RSA certificate from file. Using generated certificates.");
+      certificatePoolRSA = std::make_shared<CertificatePool>
+                           (CertificatePool::KeyType::RSA, poolSize, maxUses,
+                            std::chrono::seconds (maxAge) );
     }
   }
 
@@ -173,8 +195,25 @@ WebRtcEndpointImpl::generateDefaultCertificates ()
       "pemCertificateECDSA")) {
     defaultCertificateECDSA = getCerficateFromFile (pemUriECDSA);
   } else {
-    GST_INFO ("Unable to load the ECDSA certificate from file. Using the default certificate.");
-    defaultCertificateECDSA = CertificateManager::generateECDSACertificate ();
+    GST_INFO ("Unable to load the ECDSA certificate from file. Using generated certificates.");
+    certificatePoolECDSA = std::make_shared<CertificatePool>
+                           (CertificatePool::KeyType::ECDSA, poolSize, maxUses,
+                            std::chrono::seconds (maxAge) );
+  }
+}
+
+void
+WebRtcEndpointImpl::configureLoopPool ()
+{
+  uint eventLoopThreads;
+
+  if (getConfigValue <uint, WebRtcEndpoint> (&eventLoopThreads,
+      PARAM_EVENT_LOOP_THREADS)) {
+    GST_INFO ("Event loop threads for ICE/DTLS: %u", eventLoopThreads);
+    kms_webrtc_loop_pool_set_size (eventLoopThreads);
+  } else {
+    GST_DEBUG ("No event loop threads found in config;"
+               " using one per CPU core: %u", kms_webrtc_loop_pool_get_size ());
   }
 }
 
@@ -499,6 +538,8 @@ WebRtcEndpointImpl::WebRtcEndpointImpl (const boost::property_tree::ptree &conf,
                        (mediaPipeline), FACTORY_NAME)
 {
   std::call_once (check_openh264, check_support_for_h264);
+  std::call_once (loop_pool_flag,
+                  std::bind (&WebRtcEndpointImpl::configureLoopPool, this) );
   std::call_once (certificates_flag,
                   std::bind (&WebRtcEndpointImpl::generateDefaultCertificates, this) );
 
@@ -624,9 +665,15 @@ WebRtcEndpointImpl::WebRtcEndpointImpl (const boost::property_tree::ptree &conf,
 
   switch (certificateKeyType->getValue () ) {
   case CertificateKeyType::RSA: {
-    if (defaultCertificateRSA != "") {
+    std::string certificateRSA = defaultCertificateRSA;
+
+    if (certificateRSA == "" && certificatePoolRSA) {
+      certificateRSA = certificatePoolRSA->getCertificate ();
+    }
+
+    if (certificateRSA != "") {
       g_object_set ( G_OBJECT (element), "pem-certificate",
-                     defaultCertificateRSA.c_str(),
+                     certificateRSA.c_str(),
                      NULL);
     }
 
@@ -634,9 +681,15 @@ WebRtcEndpointImpl::WebRtcEndpointImpl (const boost::property_tree::ptree &conf,
   }
 
   case CertificateKeyType::ECDSA: {
-    if (defaultCertificateECDSA != "") {
+    std::string certificateECDSA = defaultCertificateECDSA;
+
+    if (certificateECDSA == "" && certificatePoolECDSA) {
+      certificateECDSA = certificatePoolECDSA->getCertificate ();
+    }
+
+    if (certificateECDSA != "") {
       g_object_set ( G_OBJECT (element), "pem-certificate",
-                     defaultCertificateECDSA.c_str(),
+                     certificateECDSA.c_str(),
                      NULL);
     }
 
@@ -878,6 +931,38 @@ WebRtcEndpointImpl::setTurnUrl (const std::string &turnUrl)
                  NULL);
 }
 
+int64_t
+WebRtcEndpointImpl::getCertificatePoolHits ()
+{
+  int64_t hits = 0;
+
+  if (certificatePoolRSA) {
+    hits += certificatePoolRSA->getHits ();
+  }
+
+  if (certificatePoolECDSA) {
+    hits += certificatePoolECDSA->getHits ();
+  }
+
+  return hits;
+}
+
+int64_t
+WebRtcEndpointImpl::getCertificatePoolMisses ()
+{
+  int64_t misses = 0;
+
+  if (certificatePoolRSA) {
+    misses += certificatePoolRSA->getMisses ();
+  }
+
+  if (certificatePoolECDSA) {
+    misses += certificatePoolECDSA->getMisses ();
+  }
+
+  return misses;
+}
+
 std::vector<std::shared_ptr<IceCandidatePair>>
     WebRtcEndpointImpl::getICECandidatePairs ()
 {
@@ -73,6 +73,9 @@ public:
   std::string getTurnUrl () override;
   void setTurnUrl (const std::string &turnUrl) override;
 
+  int64_t getCertificatePoolHits () override;
+  int64_t getCertificatePoolMisses () override;
+
   std::vector<std::shared_ptr<IceCandidatePair>> getICECandidatePairs () override;
 
   std::vector<std::shared_ptr<IceConnection>> getIceConnectionState () override;
@@ -143,6 +146,7 @@ private:
   void checkUri (std::string &uri);
   std::string getCerficateFromFile (std::string &path);
   void generateDefaultCertificates ();
+  void configureLoopPool ();
 
   std::map < std::string, std::shared_ptr<IceCandidatePair >> candidatePairs;
   std::map < std::string, std::shared_ptr<IceConnection>> iceConnectionState;
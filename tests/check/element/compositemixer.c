@@ -20,6 +20,8 @@
 
 #include <gst/check/gstcheck.h>
 #include <gst/gst.h>
+#include <string.h>
+#include <sys/resource.h>
 
 #define KMS_ELEMENT_PAD_TYPE_VIDEO 2
 #define KMS_ELEMENT_PAD_TYPE_AUDIO 1
@@ -31,6 +33,7 @@ GstElement *pipeline;
 GMainLoop *loop;
 GstElement *hubport1, *hubport2, *hubport3;
 
+#ifdef ENABLE_EXPERIMENTAL_TESTS
 static gboolean
 quit_main_loop_idle (gpointer data)
 {
@@ -191,6 +194,317 @@ GST_START_TEST (connection)
 }
 
 GST_END_TEST
+#endif
+GST_START_TEST (output_properties)
+{
+  GstElement *mixer = gst_element_factory_make ("compositemixer", NULL);
+  gint width, height, framerate;
+  gchar *format;
+  guint latency;
+
+  g_object_get (mixer, "width", &width, "height", &height, "framerate",
+      &framerate, "format", &format, "latency", &latency, NULL);
+
+  fail_unless (width == 800);
+  fail_unless (height == 600);
+  fail_unless (framerate == 15);
+  fail_unless (format == NULL);
+  fail_unless (latency == 600);
+
+  g_object_set (mixer, "width", 640, "height", 360, "framerate", 10,
+      "format", "I420", "latency", 100, NULL);
+
+  g_object_get (mixer, "width", &width, "height", &height, "framerate",
+      &framerate, "format", &format, "latency", &latency, NULL);
+
+  fail_unless (width == 640);
+  fail_unless (height == 360);
+  fail_unless (framerate == 10);
+  fail_unless (g_strcmp0 (format, "I420") == 0);
+  fail_unless (latency == 100);
+  g_free (format);
+
+  /* Unsupported formats are ignored */
+  g_object_set (mixer, "format", "RGB", NULL);
+  g_object_get (mixer, "format", &format, NULL);
+  fail_unless (g_strcmp0 (format, "I420") == 0);
+  g_free (format);
+
+  /* Empty string goes back to negotiation */
+  g_object_set (mixer, "format", "", NULL);
+  g_object_get (mixer, "format", &format, NULL);
+  fail_unless (format == NULL);
+
+  gst_object_unref (mixer);
+}
+
+GST_END_TEST
+GST_START_TEST (input_stats)
+{
+  GstElement *mixer = gst_element_factory_make ("compositemixer", NULL);
+  GstElement *hubport = gst_element_factory_make ("hubport", NULL);
+  GstElement *bin = gst_pipeline_new (NULL);
+  GstStructure *stats;
+  gboolean linked, fast_path;
+  gint handler_id;
+
+  gst_bin_add_many (GST_BIN (bin), mixer, hubport, NULL);
+
+  g_signal_emit_by_name (mixer, "get-input-stats", 1000, &stats);
+  fail_unless (stats == NULL);
+
+  g_signal_emit_by_name (mixer, "handle-port", hubport, &handler_id);
+  g_signal_emit_by_name (mixer, "get-input-stats", handler_id, &stats);
+  fail_unless (stats != NULL);
+
+  /* No media has been received yet */
+  fail_unless (gst_structure_get (stats, "linked", G_TYPE_BOOLEAN, &linked,
+          "fast-path", G_TYPE_BOOLEAN, &fast_path, NULL));
+  fail_if (linked);
+  fail_if (fast_path);
+  gst_structure_free (stats);
+
+  g_signal_emit_by_name (mixer, "unhandle-port", handler_id);
+  gst_object_unref (bin);
+}
+
+GST_END_TEST
+#define MEDIA_MODE_AUDIO 1
+
+static gboolean
+bin_has_element (GstBin * bin, const gchar * factory_name)
+{
+  gboolean found = FALSE;
+  GList *l;
+
+  GST_OBJECT_LOCK (bin);
+
+  for (l = bin->children; l != NULL && !found; l = l->next) {
+    GstElementFactory *factory = gst_element_get_factory (l->data);
+
+    found = factory != NULL &&
+        g_strcmp0 (GST_OBJECT_NAME (factory), factory_name) == 0;
+  }
+
+  GST_OBJECT_UNLOCK (bin);
+
+  return found;
+}
+
+GST_START_TEST (audio_only_mode)
+{
+  GstElement *mixer = gst_element_factory_make ("compositemixer", NULL);
+  GstElement *hubport = gst_element_factory_make ("hubport", NULL);
+  GstElement *bin = gst_pipeline_new (NULL);
+  gint handler_id, mode;
+
+  gst_bin_add_many (GST_BIN (bin), mixer, hubport, NULL);
+
+  g_object_set (mixer, "media-mode", MEDIA_MODE_AUDIO, NULL);
+  g_signal_emit_by_name (mixer, "handle-port", hubport, &handler_id);
+
+  fail_unless (bin_has_element (GST_BIN (mixer), "kmsaudiomixer"));
+  fail_if (bin_has_element (GST_BIN (mixer), "compositor"));
+  fail_if (bin_has_element (GST_BIN (mixer), "videotestsrc"));
+
+  /* Mode can not be changed once the mixers are built */
+  g_object_set (mixer, "media-mode", 0, NULL);
+  g_object_get (mixer, "media-mode", &mode, NULL);
+  fail_unless (mode == MEDIA_MODE_AUDIO);
+
+  g_signal_emit_by_name (mixer, "unhandle-port", handler_id);
+  gst_object_unref (bin);
+}
+
+GST_END_TEST
+#define LAYOUT_ACTIVE_SPEAKER 1
+GST_START_TEST (active_speaker_layout)
+{
+  GstElement *mixer = gst_element_factory_make ("compositemixer", NULL);
+  GstElement *hubport = gst_element_factory_make ("hubport", NULL);
+  GstElement *bin = gst_pipeline_new (NULL);
+  guint speakers, thumbnails, hold_time, margin;
+  gint handler_id, layout;
+
+  gst_bin_add_many (GST_BIN (bin), mixer, hubport, NULL);
+
+  g_object_get (mixer, "layout", &layout, "speakers", &speakers,
+      "max-thumbnails", &thumbnails, "speaker-hold-time", &hold_time,
+      "speaker-switch-margin", &margin, NULL);
+
+  fail_unless (layout == 0);
+  fail_unless (speakers == 1);
+  fail_unless (thumbnails == 8);
+  fail_unless (hold_time == 2000);
+  fail_unless (margin == 6);
+
+  g_signal_emit_by_name (mixer, "handle-port", hubport, &handler_id);
+
+  /* Layout can be switched at runtime, in both directions */
+  g_object_set (mixer, "layout", LAYOUT_ACTIVE_SPEAKER, "speakers", 2,
+      "max-thumbnails", 4, "speaker-hold-time", 500,
+      "speaker-switch-margin", 3, NULL);
+  g_object_get (mixer, "layout", &layout, "speakers", &speakers,
+      "max-thumbnails", &thumbnails, "speaker-hold-time", &hold_time,
+      "speaker-switch-margin", &margin, NULL);
+
+  fail_unless (layout == LAYOUT_ACTIVE_SPEAKER);
+  fail_unless (speakers == 2);
+  fail_unless (thumbnails == 4);
+  fail_unless (hold_time == 500);
+  fail_unless (margin == 3);
+
+  g_object_set (mixer, "layout", 0, NULL);
+  g_object_get (mixer, "layout", &layout, NULL);
+  fail_unless (layout == 0);
+
+  g_signal_emit_by_name (mixer, "unhandle-port", handler_id);
+  gst_object_unref (bin);
+}
+
+GST_END_TEST
+#ifdef ENABLE_EXPERIMENTAL_TESTS
+#define BENCHMARK_DURATION 10   /* seconds */
+
+typedef struct _BenchmarkData
+{
+  GMutex mutex;
+  guint frames;
+  struct rusage start;
+  gboolean started;
+} BenchmarkData;
+
+static gdouble
+rusage_to_us (const struct rusage *usage)
+{
+  return (usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * G_USEC_PER_SEC +
+      usage->ru_utime.tv_usec + usage->ru_stime.tv_usec;
+}
+
+static void
+benchmark_handoff_cb (GstElement * object, GstBuffer * buffer, GstPad * pad,
+    BenchmarkData * data)
+{
+  g_mutex_lock (&data->mutex);
+
+  /* CPU is accounted from the first output frame, so the setup is excluded */
+  if (!data->started) {
+    getrusage (RUSAGE_SELF, &data->start);
+    data->started = TRUE;
+  } else {
+    data->frames++;
+  }
+
+  g_mutex_unlock (&data->mutex);
+}
+
+static void
+benchmark_pad_added (GstElement * hubport, GstPad * new_pad,
+    BenchmarkData * data)
+{
+  GstElement *element;
+  GstPad *pad;
+
+  if (g_strcmp0 (GST_OBJECT_NAME (new_pad), SINK_VIDEO_STREAM) == 0) {
+    element = gst_element_factory_make ("videotestsrc", NULL);
+    g_object_set (element, "is-live", TRUE, NULL);
+    gst_bin_add (GST_BIN (pipeline), element);
+    pad = gst_element_get_static_pad (element, "src");
+    fail_if (gst_pad_link (pad, new_pad) != GST_PAD_LINK_OK);
+  } else if (data != NULL && gst_pad_get_direction (new_pad) == GST_PAD_SRC) {
+    element = gst_element_factory_make ("fakesink", NULL);
+    g_object_set (element, "async", FALSE, "sync", FALSE,
+        "signal-handoffs", TRUE, NULL);
+    g_signal_connect (element, "handoff", G_CALLBACK (benchmark_handoff_cb),
+        data);
+    gst_bin_add (GST_BIN (pipeline), element);
+    pad = gst_element_get_static_pad (element, "sink");
+    fail_if (gst_pad_link (new_pad, pad) != GST_PAD_LINK_OK);
+  } else {
+    return;
+  }
+
+  gst_element_sync_state_with_parent (element);
+  g_object_unref (pad);
+}
+
+static void
+run_cpu_per_frame_benchmark (guint n_inputs, const gchar * format)
+{
+  GstElement *mixer = gst_element_factory_make ("compositemixer", NULL);
+  GstElement *hubports[n_inputs];
+  gint handlers[n_inputs];
+  BenchmarkData data;
+  struct rusage end;
+  gchar *padname;
+  guint i;
+
+  memset (&data, 0, sizeof (data));
+  g_mutex_init (&data.mutex);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  pipeline = gst_pipeline_new (NULL);
+
+  g_object_set (mixer, "format", format, NULL);
+  gst_bin_add (GST_BIN (pipeline), mixer);
+
+  for (i = 0; i < n_inputs; i++) {
+    hubports[i] = gst_element_factory_make ("hubport", NULL);
+    gst_bin_add (GST_BIN (pipeline), hubports[i]);
+    /* Only the first port consumes the composed video */
+    g_signal_connect (hubports[i], "pad-added",
+        G_CALLBACK (benchmark_pad_added), i == 0 ? &data : NULL);
+
+    if (i == 0) {
+      g_signal_emit_by_name (hubports[i], "request-new-pad",
+          KMS_ELEMENT_PAD_TYPE_VIDEO, NULL, GST_PAD_SRC, &padname);
+      g_free (padname);
+    }
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  for (i = 0; i < n_inputs; i++) {
+    g_signal_emit_by_name (mixer, "handle-port", hubports[i], &handlers[i]);
+  }
+
+  g_timeout_add_seconds (BENCHMARK_DURATION, quit_main_loop_idle, loop);
+  g_main_loop_run (loop);
+
+  getrusage (RUSAGE_SELF, &end);
+
+  g_mutex_lock (&data.mutex);
+  fail_unless (data.frames > 0);
+  GST_INFO ("%u inputs, format %s: %u frames, %.1f us of CPU per frame",
+      n_inputs, format != NULL ? format : "negotiated", data.frames,
+      (rusage_to_us (&end) - rusage_to_us (&data.start)) / data.frames);
+  g_mutex_unlock (&data.mutex);
+
+  for (i = 0; i < n_inputs; i++) {
+    g_signal_emit_by_name (mixer, "unhandle-port", handlers[i]);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_main_loop_unref (loop);
+  g_mutex_clear (&data.mutex);
+}
+
+GST_START_TEST (cpu_per_frame_benchmark)
+{
+  const gchar *formats[] = { NULL, "AYUV", "I420", "NV12" };
+  guint inputs[] = { 4, 9, 16 };
+  guint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (inputs); i++) {
+    for (j = 0; j < G_N_ELEMENTS (formats); j++) {
+      run_cpu_per_frame_benchmark (inputs[i], formats[j]);
+    }
+  }
+}
+
+GST_END_TEST
+#endif
 /*
  * End of test cases
  */
@@ -201,7 +515,17 @@ composite_mixer_suite (void)
   TCase *tc_chain = tcase_create ("element");
 
   suite_add_tcase (s, tc_chain);
+#ifdef ENABLE_EXPERIMENTAL_TESTS
   tcase_add_test (tc_chain, connection);
+#endif
+  tcase_add_test (tc_chain, output_properties);
+  tcase_add_test (tc_chain, input_stats);
+  tcase_add_test (tc_chain, audio_only_mode);
+  tcase_add_test (tc_chain, active_speaker_layout);
+#ifdef ENABLE_EXPERIMENTAL_TESTS
+  tcase_set_timeout (tc_chain, 600);
+  tcase_add_test (tc_chain, cpu_per_frame_benchmark);
+#endif
 
   return s;
 }
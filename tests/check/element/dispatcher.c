@@ -168,6 +168,158 @@ GST_START_TEST (connection)
   g_main_loop_unref (loop);
 }
 
+GST_END_TEST
+static GstStructure *
+create_route (gint source, gint sink, gboolean connect)
+{
+  return gst_structure_new ("route", "source", G_TYPE_UINT, source, "sink",
+      G_TYPE_UINT, sink, "connect", G_TYPE_BOOLEAN, connect, NULL);
+}
+
+/* Element behind the ghost pad of the hub for the port */
+static GstElement *
+get_hub_element (GstElement * hub, const gchar * prefix, gint id)
+{
+  GstElement *element = NULL;
+  GstPad *pad, *target;
+  gchar *name;
+
+  name = g_strdup_printf ("%s%d", prefix, id);
+  pad = gst_element_get_static_pad (hub, name);
+  g_free (name);
+
+  if (pad == NULL) {
+    return NULL;
+  }
+
+  target = gst_ghost_pad_get_target (GST_GHOST_PAD (pad));
+
+  if (target != NULL) {
+    element = gst_pad_get_parent_element (target);
+    g_object_unref (target);
+  }
+
+  g_object_unref (pad);
+
+  return element;
+}
+
+/* Whether the video of the sink port comes from the source, any if -1 */
+static gboolean
+is_routed (GstElement * hub, gint source, gint sink)
+{
+  GstElement *from = get_hub_element (hub, "video_src_", sink);
+  GstElement *agnostic = NULL;
+  gboolean routed;
+
+  if (source >= 0) {
+    agnostic = get_hub_element (hub, "video_sink_", source);
+  }
+
+  routed = from == agnostic;
+
+  g_clear_object (&from);
+  g_clear_object (&agnostic);
+
+  return routed;
+}
+
+GST_START_TEST (apply_routing)
+{
+  gint handlerId1, handlerId2, handlerId3;
+  gint signalId1, signalId2, signalId3;
+  gchar *padname1, *padname2, *padname3;
+  GstElement *mixer = gst_element_factory_make ("dispatcher", NULL);
+  GPtrArray *routes;
+  gboolean applied;
+
+  hubport1 = gst_element_factory_make ("hubport", NULL);
+  hubport2 = gst_element_factory_make ("hubport", NULL);
+  hubport3 = gst_element_factory_make ("hubport", NULL);
+  loop = g_main_loop_new (NULL, FALSE);
+  pipeline = gst_pipeline_new ("pipeline");
+
+  gst_bin_add_many (GST_BIN (pipeline), hubport1,
+      hubport2, hubport3, mixer, NULL);
+
+  signalId1 =
+      g_signal_connect (hubport1, "pad-added", G_CALLBACK (srcpad_added),
+      &padname1);
+  signalId2 =
+      g_signal_connect (hubport2, "pad-added", G_CALLBACK (srcpad_added),
+      &padname2);
+  signalId3 =
+      g_signal_connect (hubport3, "pad-added", G_CALLBACK (srcpad_added),
+      &padname3);
+
+  g_signal_emit_by_name (hubport1, "request-new-pad",
+      KMS_ELEMENT_PAD_TYPE_VIDEO, NULL, GST_PAD_SRC, &padname1);
+  fail_if (padname1 == NULL);
+
+  g_signal_emit_by_name (hubport2, "request-new-pad",
+      KMS_ELEMENT_PAD_TYPE_VIDEO, NULL, GST_PAD_SRC, &padname2);
+  fail_if (padname2 == NULL);
+
+  g_signal_emit_by_name (hubport3, "request-new-pad",
+      KMS_ELEMENT_PAD_TYPE_VIDEO, NULL, GST_PAD_SRC, &padname3);
+  fail_if (padname3 == NULL);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  g_signal_emit_by_name (mixer, "handle-port", hubport1, &handlerId1);
+  g_signal_emit_by_name (mixer, "handle-port", hubport2, &handlerId2);
+  g_signal_emit_by_name (mixer, "handle-port", hubport3, &handlerId3);
+
+  routes = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_structure_free);
+  g_ptr_array_add (routes, create_route (handlerId3, handlerId2, TRUE));
+  g_signal_emit_by_name (mixer, "apply-routing", routes, &applied);
+  fail_unless (applied);
+  g_ptr_array_unref (routes);
+
+  /* Rejected as a whole because of the unknown port */
+  routes = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_structure_free);
+  g_ptr_array_add (routes, create_route (handlerId1, handlerId2, TRUE));
+  g_ptr_array_add (routes, create_route (handlerId2, handlerId1, TRUE));
+  g_ptr_array_add (routes, create_route (handlerId1, G_MAXINT, TRUE));
+  g_signal_emit_by_name (mixer, "apply-routing", routes, &applied);
+  fail_if (applied);
+  g_ptr_array_unref (routes);
+
+  fail_unless (is_routed (mixer, handlerId3, handlerId2));
+  fail_unless (is_routed (mixer, -1, handlerId1));
+  fail_unless (is_routed (mixer, -1, handlerId3));
+
+  routes = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_structure_free);
+  g_ptr_array_add (routes, create_route (handlerId1, handlerId2, TRUE));
+  g_ptr_array_add (routes, create_route (handlerId3, handlerId1, TRUE));
+  g_ptr_array_add (routes, create_route (handlerId3, handlerId3, TRUE));
+  g_ptr_array_add (routes, create_route (handlerId3, handlerId3, FALSE));
+  g_signal_emit_by_name (mixer, "apply-routing", routes, &applied);
+  fail_unless (applied);
+  g_ptr_array_unref (routes);
+
+  fail_unless (is_routed (mixer, handlerId1, handlerId2));
+  fail_unless (is_routed (mixer, handlerId3, handlerId1));
+  fail_unless (is_routed (mixer, -1, handlerId3));
+
+  g_main_loop_run (loop);
+
+  g_signal_emit_by_name (mixer, "unhandle-port", handlerId1);
+  g_signal_emit_by_name (mixer, "unhandle-port", handlerId2);
+  g_signal_emit_by_name (mixer, "unhandle-port", handlerId3);
+
+  g_signal_handler_disconnect (hubport1, signalId1);
+  g_signal_handler_disconnect (hubport2, signalId2);
+  g_signal_handler_disconnect (hubport3, signalId3);
+
+  g_free (padname1);
+  g_free (padname2);
+  g_free (padname3);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (GST_OBJECT (pipeline));
+  g_main_loop_unref (loop);
+}
+
 GST_END_TEST
 /*
  * End of test cases
@@ -180,6 +332,7 @@ dispatcher_suite (void)
 
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, connection);
+  tcase_add_test (tc_chain, apply_routing);
 
   return s;
 }
@@ -34,6 +34,10 @@ gint handlerId1, handlerId2, handlerId3, handlerId4, handlerId5;
 gchar *padname3, *padname4, *padname5;
 GMutex mutex;
 int connected = 0;
+/* Caps accepted behind ports 3 and 4, NULL for anything */
+const gchar *viewer_caps = NULL;
+/* Put an agnosticbin before them, as endpoints do */
+gboolean viewer_agnostic = FALSE;
 
 static gboolean
 quit_main_loop_idle (gpointer data)
@@ -48,12 +52,7 @@ static void
 handoff_cb (GstElement * object, GstBuffer * arg0, GstPad * arg1,
     gpointer user_data)
 {
-  GstPad *pad, *peer_pad;
-  GstElement *hubport;
-
-  pad = gst_element_get_static_pad (object, "sink");
-  peer_pad = gst_pad_get_peer (pad);
-  hubport = gst_pad_get_parent_element (peer_pad);
+  GstElement *hubport = g_object_get_data (G_OBJECT (object), "hubport");
 
   if (hubport == hubport3) {
     GST_INFO_OBJECT (object, "Handoff 3");
@@ -72,10 +71,6 @@ handoff_cb (GstElement * object, GstBuffer * arg0, GstPad * arg1,
     handoff_5 = TRUE;
   }
 
-  g_object_unref (pad);
-  g_object_unref (peer_pad);
-  g_object_unref (hubport);
-
   if (handoff_3 && handoff_4 && handoff_5) {
     g_idle_add (quit_main_loop_idle, user_data);
   }
@@ -112,7 +107,7 @@ srcpad_added (GstElement * hubport, GstPad * new_pad, gpointer user_data)
 {
   gchar *padname, *expected_name;
   GstPad *sinkpad;
-  GstElement *fakesink;
+  GstElement *fakesink, *filter = NULL, *agnostic = NULL;
   GstElement *videosrc;
 
   padname = gst_pad_get_name (new_pad);
@@ -156,26 +151,63 @@ srcpad_added (GstElement * hubport, GstPad * new_pad, gpointer user_data)
   fakesink = gst_element_factory_make ("fakesink", NULL);
   g_object_set (G_OBJECT (fakesink), "async", FALSE, "sync", FALSE,
       "signal-handoffs", TRUE, NULL);
+  g_object_set_data (G_OBJECT (fakesink), "hubport", hubport);
   g_signal_connect (fakesink, "handoff", G_CALLBACK (handoff_cb), loop);
 
   gst_bin_add (GST_BIN (pipeline), fakesink);
 
-  sinkpad = gst_element_get_static_pad (fakesink, "sink");
+  if (viewer_caps != NULL && hubport != hubport5) {
+    GstCaps *caps = gst_caps_from_string (viewer_caps);
+
+    filter = gst_element_factory_make ("capsfilter", NULL);
+    g_object_set (filter, "caps", caps, NULL);
+    gst_caps_unref (caps);
+    gst_bin_add (GST_BIN (pipeline), filter);
+    fail_unless (gst_element_link (filter, fakesink));
+
+    if (viewer_agnostic) {
+      agnostic = gst_element_factory_make ("agnosticbin", NULL);
+      gst_bin_add (GST_BIN (pipeline), agnostic);
+      fail_unless (gst_element_link (agnostic, filter));
+      sinkpad = gst_element_get_static_pad (agnostic, "sink");
+    } else {
+      sinkpad = gst_element_get_static_pad (filter, "sink");
+    }
+  } else {
+    sinkpad = gst_element_get_static_pad (fakesink, "sink");
+  }
+
   fail_if (gst_pad_link (new_pad, sinkpad) != GST_PAD_LINK_OK);
 
   gst_element_sync_state_with_parent (fakesink);
 
+  if (filter != NULL) {
+    gst_element_sync_state_with_parent (filter);
+  }
+
+  if (agnostic != NULL) {
+    gst_element_sync_state_with_parent (agnostic);
+  }
+
   g_object_unref (sinkpad);
 
 end:
   g_free (padname);
 }
 
-GST_START_TEST (connection)
+static void
+run_connection (gboolean forward_encoded, const gchar * caps,
+    gboolean agnostic, guint expected_encoders)
 {
   gint signalId1, signalId2, signalId3, signalId4, signalId5;
 
+  handoff_3 = handoff_4 = handoff_5 = FALSE;
+  connected = 0;
+  viewer_caps = caps;
+  viewer_agnostic = agnostic;
+
   mixer = gst_element_factory_make ("dispatcheronetomany", NULL);
+  g_object_set (mixer, "forward-encoded", forward_encoded, NULL);
   g_mutex_init (&mutex);
 
   hubport1 = gst_element_factory_make ("hubport", NULL);
@@ -212,6 +244,25 @@ GST_START_TEST (connection)
 
   g_main_loop_run (loop);
 
+  if (forward_encoded) {
+    guint decoders, encoders, i;
+
+    /* Viewers may join their branch after the first buffers */
+    for (i = 0; i < 50; i++) {
+      g_object_get (mixer, "decoders", &decoders, "encoders", &encoders, NULL);
+
+      if (encoders >= expected_encoders) {
+        break;
+      }
+
+      g_usleep (100 * G_TIME_SPAN_MILLISECOND);
+    }
+
+    /* The source is raw, viewers that reject it share one encoder */
+    fail_unless (decoders == 0);
+    fail_unless (encoders == expected_encoders);
+  }
+
   g_signal_emit_by_name (mixer, "unhandle-port", handlerId1);
   g_signal_emit_by_name (mixer, "unhandle-port", handlerId2);
   g_signal_emit_by_name (mixer, "unhandle-port", handlerId3);
@@ -233,7 +284,205 @@ GST_START_TEST (connection)
   g_mutex_clear (&mutex);
 }
 
+GST_START_TEST (connection)
+{
+  run_connection (FALSE, NULL, FALSE, 0);
+}
+
+GST_END_TEST
+GST_START_TEST (forward_encoded)
+{
+  /* Fakesinks accept the raw source as it is */
+  run_connection (TRUE, NULL, FALSE, 0);
+}
+
+GST_END_TEST
+GST_START_TEST (forward_encoded_shared_branch)
+{
+  /* Ports 3 and 4 reject raw video, port 5 takes it as it is */
+  run_connection (TRUE, "video/x-vp8", FALSE, 1);
+}
+
+GST_END_TEST
+GST_START_TEST (forward_encoded_agnostic_viewers)
+{
+  /* The agnosticbins would take raw video, what follows them would not */
+  run_connection (TRUE, "video/x-vp8", TRUE, 1);
+}
+
+GST_END_TEST
+#ifdef ENABLE_EXPERIMENTAL_TESTS
+/* videotestsrc patterns, told apart by their first luma byte */
+#define PATTERN_BLACK 2
+#define PATTERN_WHITE 3
+#define BLACK_Y 16
+#define WHITE_Y 235
+
+typedef struct _SwitchBenchmark
+{
+  GstElement *pipeline;
+  GstElement *dispatcher;
+  GMutex mutex;
+  GCond cond;
+  guint8 expected;
+  gint64 received;
+} SwitchBenchmark;
+
+static void
+benchmark_handoff_cb (GstElement * object, GstBuffer * buffer, GstPad * pad,
+    SwitchBenchmark * bench)
+{
+  GstMapInfo info;
+
+  if (!gst_buffer_map (buffer, &info, GST_MAP_READ)) {
+    return;
+  }
+
+  g_mutex_lock (&bench->mutex);
+  if (bench->received == 0 && info.size > 0 && info.data[0] == bench->expected) {
+    bench->received = g_get_monotonic_time ();
+    g_cond_signal (&bench->cond);
+  }
+  g_mutex_unlock (&bench->mutex);
+
+  gst_buffer_unmap (buffer, &info);
+}
+
+static void
+benchmark_pad_added (GstElement * hubport, GstPad * new_pad,
+    SwitchBenchmark * bench)
+{
+  GstElement *element;
+  GstPad *pad;
+
+  if (gst_pad_get_direction (new_pad) == GST_PAD_SINK) {
+    if (g_strcmp0 (GST_OBJECT_NAME (new_pad), SINK_VIDEO_STREAM) != 0) {
+      return;
+    }
+
+    element = gst_element_factory_make ("videotestsrc", NULL);
+    g_object_set (element, "is-live", TRUE, "pattern",
+        GPOINTER_TO_INT (g_object_get_data (G_OBJECT (hubport), "pattern")),
+        NULL);
+    pad = gst_element_get_static_pad (element, "src");
+    gst_bin_add (GST_BIN (bench->pipeline), element);
+    fail_if (gst_pad_link (pad, new_pad) != GST_PAD_LINK_OK);
+  } else {
+    element = gst_element_factory_make ("fakesink", NULL);
+    g_object_set (element, "async", FALSE, "sync", FALSE, NULL);
+
+    if (g_object_get_data (G_OBJECT (hubport), "measured") != NULL) {
+      g_object_set (element, "signal-handoffs", TRUE, NULL);
+      g_signal_connect (element, "handoff",
+          G_CALLBACK (benchmark_handoff_cb), bench);
+    }
+
+    pad = gst_element_get_static_pad (element, "sink");
+    gst_bin_add (GST_BIN (bench->pipeline), element);
+    fail_if (gst_pad_link (new_pad, pad) != GST_PAD_LINK_OK);
+  }
+
+  gst_element_sync_state_with_parent (element);
+  g_object_unref (pad);
+}
+
+static gint
+benchmark_add_port (SwitchBenchmark * bench, gint pattern, gboolean viewer,
+    gboolean measured)
+{
+  GstElement *hubport = gst_element_factory_make ("hubport", NULL);
+  gchar *padname = NULL;
+  gint id;
+
+  g_object_set_data (G_OBJECT (hubport), "pattern", GINT_TO_POINTER (pattern));
+  g_object_set_data (G_OBJECT (hubport), "measured",
+      GINT_TO_POINTER (measured));
+  g_signal_connect (hubport, "pad-added", G_CALLBACK (benchmark_pad_added),
+      bench);
+
+  gst_bin_add (GST_BIN (bench->pipeline), hubport);
+  gst_element_sync_state_with_parent (hubport);
+  g_signal_emit_by_name (bench->dispatcher, "handle-port", hubport, &id);
+
+  if (viewer) {
+    g_signal_emit_by_name (hubport, "request-new-pad",
+        KMS_ELEMENT_PAD_TYPE_VIDEO, NULL, GST_PAD_SRC, &padname);
+    fail_if (padname == NULL);
+    g_free (padname);
+  }
+
+  return id;
+}
+
+/* Waits until the measured viewer shows the source painted as expected */
+static gint64
+benchmark_switch (SwitchBenchmark * bench, gint source, guint8 expected,
+    gint64 * call)
+{
+  gint64 start, end;
+
+  g_mutex_lock (&bench->mutex);
+  bench->expected = expected;
+  bench->received = 0;
+  g_mutex_unlock (&bench->mutex);
+
+  start = g_get_monotonic_time ();
+  g_object_set (bench->dispatcher, "main", source, NULL);
+  *call = g_get_monotonic_time () - start;
+
+  g_mutex_lock (&bench->mutex);
+  end = g_get_monotonic_time () + 10 * G_TIME_SPAN_SECOND;
+  while (bench->received == 0) {
+    fail_unless (g_cond_wait_until (&bench->cond, &bench->mutex, end));
+  }
+  end = bench->received;
+  g_mutex_unlock (&bench->mutex);
+
+  return end - start;
+}
+
+GST_START_TEST (switch_benchmark)
+{
+  guint viewers[] = { 10, 100, 500 };
+  guint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (viewers); i++) {
+    SwitchBenchmark bench;
+    gint64 call, latency;
+    gint black, white;
+
+    bench.pipeline = gst_pipeline_new (NULL);
+    bench.dispatcher = gst_element_factory_make ("dispatcheronetomany", NULL);
+    g_mutex_init (&bench.mutex);
+    g_cond_init (&bench.cond);
+    bench.received = 0;
+
+    gst_bin_add (GST_BIN (bench.pipeline), bench.dispatcher);
+    gst_element_set_state (bench.pipeline, GST_STATE_PLAYING);
+
+    black = benchmark_add_port (&bench, PATTERN_BLACK, FALSE, FALSE);
+    white = benchmark_add_port (&bench, PATTERN_WHITE, FALSE, FALSE);
+
+    for (j = 0; j < viewers[i]; j++) {
+      benchmark_add_port (&bench, 0, TRUE, j == 0);
+    }
+
+    benchmark_switch (&bench, black, BLACK_Y, &call);
+    latency = benchmark_switch (&bench, white, WHITE_Y, &call);
+
+    GST_INFO ("%u viewers: setting the source took %" G_GINT64_FORMAT
+        " us, first frame of the new source after %" G_GINT64_FORMAT " us",
+        viewers[i], call, latency);
+
+    gst_element_set_state (bench.pipeline, GST_STATE_NULL);
+    gst_object_unref (bench.pipeline);
+    g_mutex_clear (&bench.mutex);
+    g_cond_clear (&bench.cond);
+  }
+}
+
 GST_END_TEST
+#endif
 /*
  * End of test cases
  */
@@ -245,6 +494,13 @@ dispatcher_one_to_many_suite (void)
 
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, connection);
+  tcase_add_test (tc_chain, forward_encoded);
+  tcase_add_test (tc_chain, forward_encoded_shared_branch);
+  tcase_add_test (tc_chain, forward_encoded_agnostic_viewers);
+#ifdef ENABLE_EXPERIMENTAL_TESTS
+  tcase_set_timeout (tc_chain, 600);
+  tcase_add_test (tc_chain, switch_benchmark);
+#endif
 
   return s;
 }
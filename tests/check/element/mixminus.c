@@ -0,0 +1,552 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+#include <sys/resource.h>
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define AUDIO_CAPS "audio/x-raw,format=S16LE,layout=interleaved,channels=1"
+#else
+#define AUDIO_CAPS "audio/x-raw,format=S16BE,layout=interleaved,channels=1"
+#endif
+
+#define N_INPUTS 3
+#define N_BUFFERS 20
+#define N_SAMPLES 100
+/* Output periods of 20 ms are 162 samples at this rate, which is not a */
+/* multiple of the SIMD width, so the scalar tail is tested too */
+#define ODD_RATE 8100
+
+static const gint16 input_values[N_INPUTS] = { 20000, 20000, 1000 };
+/* Last output saturates */
+static const gint16 expected_values[N_INPUTS] = { 21000, 21000, G_MAXINT16 };
+
+typedef struct _MixMinusOutput
+{
+  GMainLoop *loop;
+  gint16 expected;
+  gboolean received;
+} MixMinusOutput;
+
+static MixMinusOutput outputs[N_INPUTS];
+static GMutex mutex;
+
+static gboolean
+quit_main_loop_idle (gpointer data)
+{
+  GMainLoop *loop = data;
+
+  g_main_loop_quit (loop);
+  return FALSE;
+}
+
+static void
+check_output_cb (GstElement * object, GstBuffer * buffer, GstPad * pad,
+    MixMinusOutput * output)
+{
+  gboolean done = TRUE, match = TRUE;
+  const gint16 *samples;
+  GstMapInfo info;
+  guint i;
+
+  fail_unless (gst_buffer_map (buffer, &info, GST_MAP_READ));
+  samples = (const gint16 *) info.data;
+
+  for (i = 0; i < info.size / sizeof (gint16); i++) {
+    match &= samples[i] == output->expected;
+  }
+
+  gst_buffer_unmap (buffer, &info);
+
+  /* The last period is completed with silence after the inputs end */
+  if (!match) {
+    return;
+  }
+
+  g_mutex_lock (&mutex);
+  output->received = TRUE;
+
+  for (i = 0; i < N_INPUTS; i++) {
+    done &= outputs[i].received;
+  }
+  g_mutex_unlock (&mutex);
+
+  if (done) {
+    g_idle_add (quit_main_loop_idle, output->loop);
+  }
+}
+
+static GstElement *
+add_input (GstElement * pipeline, GstElement * mixer, GstCaps * caps,
+    GstElement * sink)
+{
+  GstElement *appsrc = gst_element_factory_make ("appsrc", NULL);
+  GstPad *sinkpad, *srcpad;
+  gchar *name;
+
+  g_object_set (appsrc, "caps", caps, "format", GST_FORMAT_TIME, NULL);
+  g_object_set (sink, "async", FALSE, "sync", FALSE, "signal-handoffs",
+      TRUE, NULL);
+  gst_bin_add_many (GST_BIN (pipeline), appsrc, sink, NULL);
+
+  sinkpad = gst_element_get_request_pad (mixer, "sink_%u");
+  srcpad = gst_element_get_static_pad (appsrc, "src");
+  fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK);
+  g_object_unref (srcpad);
+
+  /* Each input comes with its own output */
+  name = g_strdup_printf ("src_%s", GST_OBJECT_NAME (sinkpad) + 5);
+  fail_unless (gst_element_link_pads (mixer, name, sink, "sink"));
+  g_free (name);
+  g_object_unref (sinkpad);
+
+  return appsrc;
+}
+
+static GstBuffer *
+create_constant_buffer (gint16 value, guint n)
+{
+  GstBuffer *buffer = gst_buffer_new_allocate (NULL,
+      N_SAMPLES * sizeof (gint16), NULL);
+  GstMapInfo info;
+  guint i;
+
+  gst_buffer_map (buffer, &info, GST_MAP_WRITE);
+
+  for (i = 0; i < N_SAMPLES; i++) {
+    ((gint16 *) info.data)[i] = value;
+  }
+
+  gst_buffer_unmap (buffer, &info);
+
+  GST_BUFFER_DURATION (buffer) =
+      gst_util_uint64_scale_int (N_SAMPLES, GST_SECOND, 8000);
+  GST_BUFFER_PTS (buffer) = n * GST_BUFFER_DURATION (buffer);
+
+  return buffer;
+}
+
+GST_START_TEST (mix_minus)
+{
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *mixer = gst_element_factory_make ("mixminus", NULL);
+  GstElement *appsrcs[N_INPUTS];
+  GstCaps *caps;
+  guint i;
+
+  caps = gst_caps_from_string (AUDIO_CAPS ",rate=8000");
+  gst_bin_add (GST_BIN (pipeline), mixer);
+
+  for (i = 0; i < N_INPUTS; i++) {
+    GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+
+    outputs[i].loop = loop;
+    outputs[i].expected = expected_values[i];
+    outputs[i].received = FALSE;
+    g_signal_connect (sink, "handoff", G_CALLBACK (check_output_cb),
+        &outputs[i]);
+
+    appsrcs[i] = add_input (pipeline, mixer, caps, sink);
+  }
+
+  gst_caps_unref (caps);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  for (i = 0; i < N_INPUTS; i++) {
+    GstFlowReturn ret;
+    guint j;
+
+    for (j = 0; j < N_BUFFERS; j++) {
+      GstBuffer *buffer = create_constant_buffer (input_values[i], j);
+
+      g_signal_emit_by_name (appsrcs[i], "push-buffer", buffer, &ret);
+      gst_buffer_unref (buffer);
+    }
+
+    g_signal_emit_by_name (appsrcs[i], "end-of-stream", &ret);
+  }
+
+  g_main_loop_run (loop);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST
+#define N_RANDOM_SAMPLES (N_BUFFERS * N_SAMPLES)
+static gint16 random_inputs[N_INPUTS][N_RANDOM_SAMPLES];
+static gint random_checked;
+
+/* Compares each output with a scalar mix of the other inputs */
+static void
+check_random_output_cb (GstElement * object, GstBuffer * buffer, GstPad * pad,
+    gpointer index)
+{
+  guint64 first = gst_util_uint64_scale_round (GST_BUFFER_PTS (buffer),
+      ODD_RATE, GST_SECOND);
+  guint own = GPOINTER_TO_UINT (index);
+  const gint16 *samples;
+  GstMapInfo info;
+  guint i, j;
+
+  fail_unless (gst_buffer_map (buffer, &info, GST_MAP_READ));
+  samples = (const gint16 *) info.data;
+
+  for (i = 0; i < info.size / sizeof (gint16); i++) {
+    gint32 expected = 0;
+
+    if (first + i >= N_RANDOM_SAMPLES) {
+      break;
+    }
+
+    for (j = 0; j < N_INPUTS; j++) {
+      if (j != own) {
+        expected += random_inputs[j][first + i];
+      }
+    }
+
+    fail_unless (samples[i] == CLAMP (expected, G_MININT16, G_MAXINT16),
+        "Output %u, sample %" G_GUINT64_FORMAT ": %d, expected %d", own,
+        first + i, samples[i], CLAMP (expected, G_MININT16, G_MAXINT16));
+    g_atomic_int_inc (&random_checked);
+  }
+
+  gst_buffer_unmap (buffer, &info);
+}
+
+static gboolean
+bus_eos_cb (GstBus * bus, GstMessage * msg, gpointer loop)
+{
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS) {
+    g_main_loop_quit (loop);
+  }
+
+  return TRUE;
+}
+
+GST_START_TEST (random_input)
+{
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *mixer = gst_element_factory_make ("mixminus", NULL);
+  GstElement *appsrcs[N_INPUTS];
+  GRand *rand = g_rand_new_with_seed (42);
+  GstBus *bus;
+  GstCaps *caps;
+  guint i, j;
+
+  caps = gst_caps_from_string (AUDIO_CAPS ",rate=" G_STRINGIFY (ODD_RATE));
+  gst_bin_add (GST_BIN (pipeline), mixer);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  gst_bus_add_watch (bus, bus_eos_cb, loop);
+
+  for (i = 0; i < N_INPUTS; i++) {
+    GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+
+    /* Full range, so that sums saturate on both sides */
+    for (j = 0; j < N_RANDOM_SAMPLES; j++) {
+      random_inputs[i][j] = g_rand_int_range (rand, G_MININT16,
+          G_MAXINT16 + 1);
+    }
+
+    g_signal_connect (sink, "handoff", G_CALLBACK (check_random_output_cb),
+        GUINT_TO_POINTER (i));
+    appsrcs[i] = add_input (pipeline, mixer, caps, sink);
+  }
+
+  gst_caps_unref (caps);
+  random_checked = 0;
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  for (i = 0; i < N_INPUTS; i++) {
+    GstFlowReturn ret;
+
+    for (j = 0; j < N_BUFFERS; j++) {
+      GstBuffer *buffer = gst_buffer_new_allocate (NULL,
+          N_SAMPLES * sizeof (gint16), NULL);
+
+      gst_buffer_fill (buffer, 0, random_inputs[i] + j * N_SAMPLES,
+          N_SAMPLES * sizeof (gint16));
+      GST_BUFFER_PTS (buffer) = gst_util_uint64_scale_int (j * N_SAMPLES,
+          GST_SECOND, ODD_RATE);
+      GST_BUFFER_DURATION (buffer) = gst_util_uint64_scale_int ((j + 1) *
+          N_SAMPLES, GST_SECOND, ODD_RATE) - GST_BUFFER_PTS (buffer);
+
+      g_signal_emit_by_name (appsrcs[i], "push-buffer", buffer, &ret);
+      gst_buffer_unref (buffer);
+    }
+
+    g_signal_emit_by_name (appsrcs[i], "end-of-stream", &ret);
+  }
+
+  g_main_loop_run (loop);
+
+  /* Every sample of every output has been compared */
+  fail_unless (g_atomic_int_get (&random_checked) ==
+      N_INPUTS * N_RANDOM_SAMPLES);
+
+  gst_bus_remove_watch (bus);
+  gst_object_unref (bus);
+  g_rand_free (rand);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST
+/* A live input that never sends anything must not stall the mix, even */
+/* once the other inputs end */
+GST_START_TEST (stalled_input)
+{
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *mixer = gst_element_factory_make ("mixminus", NULL);
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+  GstElement *talking, *silent;
+  GstFlowReturn ret;
+  GstCaps *caps;
+  guint j;
+
+  caps = gst_caps_from_string (AUDIO_CAPS ",rate=8000");
+  gst_bin_add (GST_BIN (pipeline), mixer);
+
+  /* Only the output of the silent input is checked */
+  outputs[0].received = TRUE;
+  outputs[1].loop = loop;
+  outputs[1].expected = 1000;
+  outputs[1].received = FALSE;
+  outputs[2].received = TRUE;
+
+  talking = add_input (pipeline, mixer, caps,
+      gst_element_factory_make ("fakesink", NULL));
+  g_signal_connect (sink, "handoff", G_CALLBACK (check_output_cb),
+      &outputs[1]);
+  silent = add_input (pipeline, mixer, caps, sink);
+
+  g_object_set (talking, "is-live", TRUE, "min-latency", (gint64) 0, NULL);
+  g_object_set (silent, "is-live", TRUE, "min-latency", (gint64) 0, NULL);
+  gst_caps_unref (caps);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  for (j = 0; j < N_BUFFERS; j++) {
+    GstBuffer *buffer = create_constant_buffer (1000, j);
+
+    g_signal_emit_by_name (talking, "push-buffer", buffer, &ret);
+    gst_buffer_unref (buffer);
+  }
+
+  g_signal_emit_by_name (talking, "end-of-stream", &ret);
+
+  /* Finishes once the silent input gets the mix of the talking one */
+  g_main_loop_run (loop);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST
+#define CAPS_ROUNDS 50
+
+typedef struct _MixMinusCapsInput
+{
+  GstPad *pad;
+  GstCaps *caps;
+  gboolean accepted;
+} MixMinusCapsInput;
+
+static gpointer
+send_caps (MixMinusCapsInput * input)
+{
+  input->accepted = gst_pad_send_event (input->pad,
+      gst_event_new_caps (input->caps));
+
+  return NULL;
+}
+
+GST_START_TEST (concurrent_caps)
+{
+  MixMinusCapsInput inputs[2];
+  GThread *threads[2];
+  guint i, j;
+
+  inputs[0].caps = gst_caps_from_string (AUDIO_CAPS ",rate=8000");
+  inputs[1].caps = gst_caps_from_string (AUDIO_CAPS ",rate=16000");
+
+  for (i = 0; i < CAPS_ROUNDS; i++) {
+    GstElement *mixer = gst_element_factory_make ("mixminus", NULL);
+
+    gst_element_set_state (mixer, GST_STATE_PAUSED);
+
+    for (j = 0; j < 2; j++) {
+      inputs[j].pad = gst_element_get_request_pad (mixer, "sink_%u");
+      fail_unless (gst_pad_send_event (inputs[j].pad,
+              gst_event_new_stream_start ("test")));
+    }
+
+    for (j = 0; j < 2; j++) {
+      threads[j] = g_thread_new (NULL, (GThreadFunc) send_caps, &inputs[j]);
+    }
+
+    for (j = 0; j < 2; j++) {
+      g_thread_join (threads[j]);
+    }
+
+    /* The first one fixes the mix caps, the other differs from them */
+    fail_unless (inputs[0].accepted != inputs[1].accepted);
+
+    for (j = 0; j < 2; j++) {
+      gst_element_release_request_pad (mixer, inputs[j].pad);
+      g_object_unref (inputs[j].pad);
+    }
+
+    gst_element_set_state (mixer, GST_STATE_NULL);
+    gst_object_unref (mixer);
+  }
+
+  gst_caps_unref (inputs[0].caps);
+  gst_caps_unref (inputs[1].caps);
+}
+
+GST_END_TEST
+#ifdef ENABLE_EXPERIMENTAL_TESTS
+#define BENCHMARK_PERIOD 960    /* samples, 20 ms */
+#define BENCHMARK_PERIODS 500
+
+static gdouble
+rusage_to_us (const struct rusage *usage)
+{
+  return (usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * G_USEC_PER_SEC +
+      usage->ru_utime.tv_usec + usage->ru_stime.tv_usec;
+}
+
+/* Returns the CPU (us) used to run n participants for BENCHMARK_PERIODS */
+static gdouble
+run_mix_minus (guint n, gboolean with_mixer)
+{
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *mixer = NULL;
+  struct rusage start, end;
+  GstCaps *caps;
+  GstBus *bus;
+  GstMessage *msg;
+  guint i;
+
+  caps = gst_caps_from_string (AUDIO_CAPS ",rate=48000");
+
+  if (with_mixer) {
+    mixer = gst_element_factory_make ("mixminus", NULL);
+    gst_bin_add (GST_BIN (pipeline), mixer);
+  }
+
+  for (i = 0; i < n; i++) {
+    GstElement *src = gst_element_factory_make ("audiotestsrc", NULL);
+    GstElement *filter = gst_element_factory_make ("capsfilter", NULL);
+    GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+
+    g_object_set (src, "num-buffers", BENCHMARK_PERIODS, "samplesperbuffer",
+        BENCHMARK_PERIOD, "freq", 200.0 + 10 * i, NULL);
+    g_object_set (filter, "caps", caps, NULL);
+    g_object_set (sink, "async", FALSE, "sync", FALSE, NULL);
+    gst_bin_add_many (GST_BIN (pipeline), src, filter, sink, NULL);
+    fail_unless (gst_element_link (src, filter));
+
+    if (with_mixer) {
+      GstPad *sinkpad = gst_element_get_request_pad (mixer, "sink_%u");
+      GstPad *srcpad = gst_element_get_static_pad (filter, "src");
+      gchar *name;
+
+      fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK);
+      name = g_strdup_printf ("src_%s", GST_OBJECT_NAME (sinkpad) + 5);
+      fail_unless (gst_element_link_pads (mixer, name, sink, "sink"));
+      g_free (name);
+      g_object_unref (srcpad);
+      g_object_unref (sinkpad);
+    } else {
+      fail_unless (gst_element_link (filter, sink));
+    }
+  }
+
+  gst_caps_unref (caps);
+
+  getrusage (RUSAGE_SELF, &start);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  getrusage (RUSAGE_SELF, &end);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return rusage_to_us (&end) - rusage_to_us (&start);
+}
+
+GST_START_TEST (mix_minus_benchmark)
+{
+  guint participants[] = { 10, 50, 100 };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (participants); i++) {
+    guint n = participants[i];
+    gdouble base = run_mix_minus (n, FALSE);
+    gdouble mix = run_mix_minus (n, TRUE);
+
+    /* Generating the test signals is not accounted */
+    GST_INFO ("%u participants: %.1f us of CPU per 20 ms period, %.2f us per"
+        " participant", n, (mix - base) / BENCHMARK_PERIODS,
+        (mix - base) / BENCHMARK_PERIODS / n);
+  }
+}
+
+GST_END_TEST
+#endif
+/*
+ * End of test cases
+ */
+static Suite *
+mix_minus_suite (void)
+{
+  Suite *s = suite_create ("mixminus");
+  TCase *tc_chain = tcase_create ("element");
+
+  g_mutex_init (&mutex);
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, mix_minus);
+  tcase_add_test (tc_chain, random_input);
+  tcase_add_test (tc_chain, stalled_input);
+  tcase_add_test (tc_chain, concurrent_caps);
+#ifdef ENABLE_EXPERIMENTAL_TESTS
+  tcase_set_timeout (tc_chain, 600);
+  tcase_add_test (tc_chain, mix_minus_benchmark);
+#endif
+
+  return s;
+}
+
+GST_CHECK_MAIN (mix_minus);
@@ -0,0 +1,251 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+#include <sys/resource.h>
+
+#define WIDTH 64
+#define HEIGHT 48
+#define OVERLAY_SIZE 16
+
+/* I420 with a width multiple of 8 has no padding */
+#define LUMA(data, x, y) ((data)[(y) * WIDTH + (x)])
+#define CHROMA_V(data, x, y) \
+  ((data)[WIDTH * HEIGHT * 5 / 4 + (y) / 2 * WIDTH / 2 + (x) / 2])
+
+#define BLACK_Y 16
+#define WHITE_Y 235
+
+static void
+check_output_cb (GstElement * object, GstBuffer * buffer, GstPad * pad,
+    GMainLoop * loop)
+{
+  GstMapInfo info;
+
+  fail_unless (gst_buffer_map (buffer, &info, GST_MAP_READ));
+
+  /* Overlay frames arrive on their own thread, the first outputs may not */
+  /* have them yet */
+  if (LUMA (info.data, 0, 8) == WHITE_Y) {
+    /* Opaque overlay at (-4, 8), partially out of the frame */
+    fail_unless (LUMA (info.data, 11, 23) == WHITE_Y);
+    fail_unless (CHROMA_V (info.data, 0, 8) == 128);
+
+    /* Outside the overlay the master is untouched */
+    fail_unless (LUMA (info.data, 12, 8) == BLACK_Y);
+    fail_unless (LUMA (info.data, 0, 24) == BLACK_Y);
+    fail_unless (LUMA (info.data, 0, 7) == BLACK_Y);
+
+    /* Transparent overlay at (40, 30) */
+    fail_unless (LUMA (info.data, 44, 34) == BLACK_Y);
+
+    g_idle_add ((GSourceFunc) g_main_loop_quit, loop);
+  }
+
+  gst_buffer_unmap (buffer, &info);
+}
+
+static GstElement *
+add_source (GstElement * pipeline, GstElement * blender, const gchar * format,
+    gint width, gint height, gint pattern, gdouble alpha)
+{
+  GstElement *src = gst_element_factory_make ("videotestsrc", NULL);
+  GstElement *filter = gst_element_factory_make ("capsfilter", NULL);
+  GstCaps *caps;
+
+  caps = gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, format,
+      "width", G_TYPE_INT, width, "height", G_TYPE_INT, height,
+      "framerate", GST_TYPE_FRACTION, 30, 1, NULL);
+  g_object_set (src, "is-live", TRUE, "pattern", pattern, "alpha", alpha,
+      NULL);
+  g_object_set (filter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, filter, NULL);
+  fail_unless (gst_element_link (src, filter));
+  fail_unless (gst_element_link_pads (filter, NULL, blender, "sink_%u"));
+
+  return filter;
+}
+
+static GstPad *
+get_blender_pad (GstElement * filter)
+{
+  GstPad *srcpad = gst_element_get_static_pad (filter, "src");
+  GstPad *pad = gst_pad_get_peer (srcpad);
+
+  g_object_unref (srcpad);
+
+  return pad;
+}
+
+GST_START_TEST (blend_overlays)
+{
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *blender = gst_element_factory_make ("overlayblender", NULL);
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+  GstElement *master, *overlay, *transparent;
+  GstPad *pad;
+
+  g_object_set (sink, "async", FALSE, "sync", FALSE, "signal-handoffs", TRUE,
+      NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (check_output_cb), loop);
+
+  gst_bin_add_many (GST_BIN (pipeline), blender, sink, NULL);
+  fail_unless (gst_element_link (blender, sink));
+
+  /* Patterns: 2 black, 3 white */
+  master = add_source (pipeline, blender, "I420", WIDTH, HEIGHT, 2, 1.0);
+  overlay = add_source (pipeline, blender, "AYUV", OVERLAY_SIZE,
+      OVERLAY_SIZE, 3, 1.0);
+  transparent = add_source (pipeline, blender, "AYUV", OVERLAY_SIZE,
+      OVERLAY_SIZE, 3, 0.0);
+
+  pad = get_blender_pad (master);
+  g_object_set (pad, "master", TRUE, "zorder", 1, NULL);
+  g_object_unref (pad);
+
+  pad = get_blender_pad (overlay);
+  g_object_set (pad, "xpos", -4, "ypos", 8, "zorder", 2, NULL);
+  g_object_unref (pad);
+
+  pad = get_blender_pad (transparent);
+  g_object_set (pad, "xpos", 40, "ypos", 30, "zorder", 3, NULL);
+  g_object_unref (pad);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  g_main_loop_run (loop);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST
+#ifdef ENABLE_EXPERIMENTAL_TESTS
+#define BENCHMARK_FRAMES 300
+
+static gdouble
+rusage_to_us (const struct rusage *usage)
+{
+  return (usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * G_USEC_PER_SEC +
+      usage->ru_utime.tv_usec + usage->ru_stime.tv_usec;
+}
+
+/* Returns the CPU (us) used to blend a logo over BENCHMARK_FRAMES 720p */
+/* frames, either as AlphaBlending used to do or with overlayblender */
+static gdouble
+run_blend (gboolean with_blender)
+{
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *mixer, *master, *overlay, *convert, *sink;
+  struct rusage start, end;
+  GstBus *bus;
+  GstMessage *msg;
+  gchar *desc;
+
+  desc = g_strdup_printf ("videotestsrc num-buffers=%d ! "
+      "video/x-raw,format=I420,width=1280,height=720", BENCHMARK_FRAMES);
+  master = gst_parse_bin_from_description (desc, TRUE, NULL);
+  g_free (desc);
+
+  desc = g_strdup_printf ("videotestsrc num-buffers=%d pattern=ball alpha=0.5 "
+      "! video/x-raw,format=AYUV,width=160,height=90", BENCHMARK_FRAMES);
+  overlay = gst_parse_bin_from_description (desc, TRUE, NULL);
+  g_free (desc);
+
+  if (with_blender) {
+    mixer = gst_element_factory_make ("overlayblender", NULL);
+    convert = gst_element_factory_make ("identity", NULL);
+  } else {
+    mixer = gst_element_factory_make ("compositor", NULL);
+    convert = gst_parse_bin_from_description ("videoconvert ! "
+        "video/x-raw,format=AYUV", TRUE, NULL);
+  }
+
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (sink, "async", FALSE, "sync", FALSE, NULL);
+
+  gst_bin_add_many (GST_BIN (pipeline), master, convert, overlay, mixer, sink,
+      NULL);
+  fail_unless (gst_element_link (master, convert));
+  fail_unless (gst_element_link_pads (convert, NULL, mixer, "sink_0"));
+  fail_unless (gst_element_link_pads (overlay, NULL, mixer, "sink_1"));
+  fail_unless (gst_element_link (mixer, sink));
+
+  if (with_blender) {
+    GstPad *pad = gst_element_get_static_pad (mixer, "sink_0");
+
+    g_object_set (pad, "master", TRUE, NULL);
+    g_object_unref (pad);
+  }
+
+  getrusage (RUSAGE_SELF, &start);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  getrusage (RUSAGE_SELF, &end);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return rusage_to_us (&end) - rusage_to_us (&start);
+}
+
+GST_START_TEST (blend_benchmark)
+{
+  gdouble compositor = run_blend (FALSE);
+  gdouble blender = run_blend (TRUE);
+
+  /* Frames per second of CPU time, sources included */
+  GST_INFO ("compositor: %.1f fps per core", BENCHMARK_FRAMES *
+      G_USEC_PER_SEC / compositor);
+  GST_INFO ("overlayblender: %.1f fps per core", BENCHMARK_FRAMES *
+      G_USEC_PER_SEC / blender);
+}
+
+GST_END_TEST
+#endif
+/*
+ * End of test cases
+ */
+static Suite *
+overlay_blender_suite (void)
+{
+  Suite *s = suite_create ("overlayblender");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, blend_overlays);
+#ifdef ENABLE_EXPERIMENTAL_TESTS
+  tcase_set_timeout (tc_chain, 600);
+  tcase_add_test (tc_chain, blend_benchmark);
+#endif
+
+  return s;
+}
+
+GST_CHECK_MAIN (overlay_blender);
@@ -21,6 +21,7 @@
 #include <gst/check/gstcheck.h>
 #include <gst/gst.h>
 #include <commons/kmsuriendpointstate.h>
+#include <sys/resource.h>
 
 #include <kmstestutils.h>
 
@@ -32,6 +33,9 @@
 #define KMS_ELEMENT_PAD_TYPE_AUDIO 1
 #define KMS_ELEMENT_PAD_TYPE_VIDEO 2
 
+#define SEEK_MODE_ACCURATE 0
+#define SEEK_MODE_KEYFRAME 1
+
 #define KMS_VIDEO_PREFIX "video_src_"
 #define KMS_AUDIO_PREFIX "audio_src_"
 
@@ -487,8 +491,401 @@ GST_START_TEST (check_eos)
 
 GST_END_TEST
 
+static gint
+count_decoders (GstBin * bin)
+{
+  GstIterator *it = gst_bin_iterate_recurse (bin);
+  GValue item = G_VALUE_INIT;
+  gboolean done = FALSE;
+  gint count = 0;
+
+  while (!done) {
+    switch (gst_iterator_next (it, &item)) {
+      case GST_ITERATOR_OK:{
+        GstElementFactory *factory =
+            gst_element_get_factory (g_value_get_object (&item));
+
+        if (factory != NULL && gst_element_factory_list_is_type (factory,
+                GST_ELEMENT_FACTORY_TYPE_DECODER)) {
+          count++;
+        }
+        g_value_reset (&item);
+        break;
+      }
+      case GST_ITERATOR_RESYNC:
+        count = 0;
+        gst_iterator_resync (it);
+        break;
+      default:
+        done = TRUE;
+        break;
+    }
+  }
+
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  return count;
+}
+
+static void
+check_no_decoders_on_eos (GstElement * player, GMainLoop * loop)
+{
+  GstElement *internal;
+
+  g_object_get (player, "pipeline", &internal, NULL);
+  fail_unless (count_decoders (GST_BIN (internal)) == 0);
+  g_object_unref (internal);
+
+  player_eos (player, loop);
+}
+
+/* Plays the file to the end and returns the CPU (us) used */
+static gdouble
+run_player (const gchar * uri, gboolean passthrough)
+{
+  GstElement *player, *pipeline;
+  struct rusage start, end;
+  guint bus_watch_id;
+  GMainLoop *loop;
+  GstBus *bus;
+
+  loop = g_main_loop_new (NULL, FALSE);
+  pipeline = gst_pipeline_new (__FUNCTION__);
+  player = gst_element_factory_make ("playerendpoint", NULL);
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+
+  bus_watch_id = gst_bus_add_watch (bus, gst_bus_async_signal_func, NULL);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg_cb), pipeline);
+  g_object_unref (bus);
+
+  g_object_set (G_OBJECT (player), "uri", uri, "passthrough", passthrough,
+      NULL);
+
+  gst_bin_add (GST_BIN (pipeline), player);
+
+  if (passthrough) {
+    g_signal_connect (G_OBJECT (player), "eos",
+        G_CALLBACK (check_no_decoders_on_eos), loop);
+  } else {
+    g_signal_connect (G_OBJECT (player), "eos", G_CALLBACK (player_eos), loop);
+  }
+
+  getrusage (RUSAGE_SELF, &start);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  g_object_set (G_OBJECT (player), "state", KMS_URI_ENDPOINT_STATE_START, NULL);
+
+  g_main_loop_run (loop);
+  getrusage (RUSAGE_SELF, &end);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (GST_OBJECT (pipeline));
+  g_source_remove (bus_watch_id);
+  g_main_loop_unref (loop);
+
+  return (end.ru_utime.tv_sec - start.ru_utime.tv_sec +
+      end.ru_stime.tv_sec - start.ru_stime.tv_sec) * G_USEC_PER_SEC +
+      end.ru_utime.tv_usec - start.ru_utime.tv_usec +
+      end.ru_stime.tv_usec - start.ru_stime.tv_usec;
+}
+
+GST_START_TEST (check_passthrough)
+{
+  run_player (VIDEO_PATH3, TRUE);
+}
+
+GST_END_TEST
+
+static void
+shared_player_eos (GstElement * player, gint * pending)
+{
+  GST_DEBUG_OBJECT (player, "Eos received");
+
+  if (g_atomic_int_dec_and_test (pending)) {
+    g_idle_add (quit_main_loop_idle, loop);
+  }
+}
+
+GST_START_TEST (check_shared_source)
+{
+  GstElement *players[2];
+  guint bus_watch_id;
+  gint pending = G_N_ELEMENTS (players);
+  gboolean seeked;
+  GstBus *bus;
+  guint i;
+
+  loop = g_main_loop_new (NULL, FALSE);
+  pipeline = gst_pipeline_new (__FUNCTION__);
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+
+  bus_watch_id = gst_bus_add_watch (bus, gst_bus_async_signal_func, NULL);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg_cb), pipeline);
+  g_object_unref (bus);
+
+  for (i = 0; i < G_N_ELEMENTS (players); i++) {
+    players[i] = gst_element_factory_make ("playerendpoint", NULL);
+    g_object_set (G_OBJECT (players[i]), "uri", VIDEO_PATH3,
+        "shared-source", TRUE, NULL);
+    gst_bin_add (GST_BIN (pipeline), players[i]);
+    g_signal_connect (G_OBJECT (players[i]), "eos",
+        G_CALLBACK (shared_player_eos), &pending);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  /* Both players are fed, up to the end, by the same source */
+  for (i = 0; i < G_N_ELEMENTS (players); i++) {
+    g_object_set (G_OBJECT (players[i]), "state",
+        KMS_URI_ENDPOINT_STATE_START, NULL);
+  }
+
+  /* Shared sources cannot be seeked */
+  g_signal_emit_by_name (players[0], "set-position", (gint64) 0, &seeked);
+  fail_if (seeked);
+
+  g_main_loop_run (loop);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (GST_OBJECT (pipeline));
+  g_source_remove (bus_watch_id);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST
+
+static void
+check_read_ahead_on_eos (GstElement * player, GMainLoop * loop)
+{
+  gint level;
+
+  g_object_get (player, "read-ahead-level", &level, NULL);
+  fail_unless (level >= 0 && level <= 100);
+
+  player_eos (player, loop);
+}
+
+GST_START_TEST (check_read_ahead)
+{
+  guint bus_watch_id;
+  gint level;
+  GstBus *bus;
+
+  loop = g_main_loop_new (NULL, FALSE);
+  pipeline = gst_pipeline_new (__FUNCTION__);
+  player = gst_element_factory_make ("playerendpoint", NULL);
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+
+  bus_watch_id = gst_bus_add_watch (bus, gst_bus_async_signal_func, NULL);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg_cb), pipeline);
+  g_object_unref (bus);
+
+  g_object_set (G_OBJECT (player), "uri", VIDEO_PATH3, "read-ahead-bytes",
+      4 * 1024 * 1024, NULL);
+
+  g_object_get (player, "read-ahead-level", &level, NULL);
+  fail_unless (level == -1);
+
+  gst_bin_add (GST_BIN (pipeline), player);
+  g_signal_connect (G_OBJECT (player), "eos",
+      G_CALLBACK (check_read_ahead_on_eos), loop);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  g_object_set (G_OBJECT (player), "state", KMS_URI_ENDPOINT_STATE_START, NULL);
+
+  g_main_loop_run (loop);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (GST_OBJECT (pipeline));
+  g_source_remove (bus_watch_id);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST
+
+typedef struct _SeekLatency
+{
+  GMutex mutex;
+  GCond cond;
+  gboolean received;
+} SeekLatency;
+
+static void
+seek_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    SeekLatency * data)
+{
+  g_mutex_lock (&data->mutex);
+  data->received = TRUE;
+  g_cond_signal (&data->cond);
+  g_mutex_unlock (&data->mutex);
+}
+
+static gboolean
+wait_for_buffer (SeekLatency * data)
+{
+  gint64 end_time = g_get_monotonic_time () + 10 * G_TIME_SPAN_SECOND;
+  gboolean received;
+
+  g_mutex_lock (&data->mutex);
+  while (!data->received &&
+      g_cond_wait_until (&data->cond, &data->mutex, end_time));
+  received = data->received;
+  data->received = FALSE;
+  g_mutex_unlock (&data->mutex);
+
+  return received;
+}
+
+static void
+link_to_sink (GstElement * player, GstPad * pad, GstElement * sink)
+{
+  GstPad *sinkpad = gst_element_get_static_pad (sink, "sink");
+
+  fail_if (gst_pad_link (pad, sinkpad) != GST_PAD_LINK_OK);
+  g_object_unref (sinkpad);
+}
+
+/* Seeks n times over the file and returns the mean time (us) from each */
+/* seek to the next video buffer. Buffers already on their way may be */
+/* taken as the first one, so figures are approximate */
+static gint64
+run_seeks (const gchar * uri, gint seek_mode, guint n)
+{
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *player = gst_element_factory_make ("playerendpoint", NULL);
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+  GstStructure *video_data;
+  gint64 duration, total = 0;
+  SeekLatency data;
+  gchar *padname;
+  guint i;
+
+  g_mutex_init (&data.mutex);
+  g_cond_init (&data.cond);
+  data.received = FALSE;
+
+  g_object_set (player, "uri", uri, "seek-mode", seek_mode, NULL);
+  g_object_set (sink, "async", FALSE, "sync", FALSE, "signal-handoffs", TRUE,
+      NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (seek_handoff), &data);
+  g_signal_connect (player, "pad-added", G_CALLBACK (link_to_sink), sink);
+
+  gst_bin_add_many (GST_BIN (pipeline), player, sink, NULL);
+  g_signal_emit_by_name (player, "request-new-pad",
+      KMS_ELEMENT_PAD_TYPE_VIDEO, NULL, GST_PAD_SRC, &padname);
+  fail_if (padname == NULL);
+  g_free (padname);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  g_object_set (player, "state", KMS_URI_ENDPOINT_STATE_START, NULL);
+  fail_unless (wait_for_buffer (&data));
+
+  g_object_get (player, "video-data", &video_data, NULL);
+  fail_unless (gst_structure_get_int64 (video_data, "duration", &duration));
+  gst_structure_free (video_data);
+
+  for (i = 0; i < n; i++) {
+    gint64 start, position = duration / 2 * ((i * 37) % 100) / 100;
+    gboolean ret;
+
+    start = g_get_monotonic_time ();
+    g_signal_emit_by_name (player, "set-position", position, &ret);
+    fail_unless (ret);
+    fail_unless (wait_for_buffer (&data));
+    total += g_get_monotonic_time () - start;
+
+    /* Keyframes between seeks get indexed meanwhile */
+    g_usleep (100 * G_TIME_SPAN_MILLISECOND);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_cond_clear (&data.cond);
+  g_mutex_clear (&data.mutex);
+
+  return total / n;
+}
+
+GST_START_TEST (check_keyframe_seek)
+{
+  run_seeks (VIDEO_PATH3, SEEK_MODE_KEYFRAME, 4);
+}
+
+GST_END_TEST
+
+/* Plays the file and returns the time (us) it takes to reach EOS */
+static gint64
+run_at_rate (const gchar * uri, gdouble rate, gint seek_mode)
+{
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *player = gst_element_factory_make ("playerendpoint", NULL);
+  gdouble current;
+  gint64 start;
+
+  g_object_set (G_OBJECT (player), "uri", uri, "seek-mode", seek_mode,
+      "rate", rate, NULL);
+  g_object_get (G_OBJECT (player), "rate", &current, NULL);
+  fail_unless (current == rate);
+
+  gst_bin_add (GST_BIN (pipeline), player);
+  g_signal_connect (G_OBJECT (player), "eos", G_CALLBACK (player_eos), loop);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  start = g_get_monotonic_time ();
+  g_object_set (G_OBJECT (player), "state", KMS_URI_ENDPOINT_STATE_START, NULL);
+  g_main_loop_run (loop);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (GST_OBJECT (pipeline));
+  g_main_loop_unref (loop);
+
+  return g_get_monotonic_time () - start;
+}
+
+GST_START_TEST (check_rate)
+{
+  gint64 normal, fast;
+
+  normal = run_at_rate (VIDEO_PATH3, 1.0, SEEK_MODE_ACCURATE);
+  fast = run_at_rate (VIDEO_PATH3, 4.0, SEEK_MODE_KEYFRAME);
+
+  GST_INFO ("Rate 1.0: %" G_GINT64_FORMAT " us, rate 4.0: %" G_GINT64_FORMAT
+      " us", normal, fast);
+
+  fail_unless (fast < normal);
+}
+
+GST_END_TEST
+
 #ifdef ENABLE_EXPERIMENTAL_TESTS
 
+GST_START_TEST (seek_benchmark)
+{
+  gint64 accurate = run_seeks (VIDEO_PATH2, SEEK_MODE_ACCURATE, 50);
+  /* Runs after the accurate one, with the keyframes it indexed */
+  gint64 keyframe = run_seeks (VIDEO_PATH2, SEEK_MODE_KEYFRAME, 50);
+
+  GST_INFO ("accurate: %" G_GINT64_FORMAT " us per seek", accurate);
+  GST_INFO ("keyframe: %" G_GINT64_FORMAT " us per seek", keyframe);
+}
+
+GST_END_TEST
+
+/* CPU per stream playing the same file, decoding it or not. Use a 720p */
+/* file as VIDEO_PATH2 for figures comparable with a WebRTC setup */
+GST_START_TEST (passthrough_benchmark)
+{
+  gdouble decoded = run_player (VIDEO_PATH2, FALSE);
+  gdouble passthrough = run_player (VIDEO_PATH2, TRUE);
+
+  GST_INFO ("decoded: %.0f ms of CPU", decoded / 1000);
+  GST_INFO ("passthrough: %.0f ms of CPU", passthrough / 1000);
+}
+
+GST_END_TEST
+
 GST_START_TEST (check_set_encoded_media)
 {
   GstElement *player, *pipeline;
@@ -549,8 +946,16 @@ playerendpoint_suite (void)
   tcase_add_test (tc_chain, check_states);
   tcase_add_test (tc_chain, check_live_stream);
   tcase_add_test (tc_chain, check_eos);
+  tcase_add_test (tc_chain, check_passthrough);
+  tcase_add_test (tc_chain, check_shared_source);
+  tcase_add_test (tc_chain, check_read_ahead);
+  tcase_add_test (tc_chain, check_keyframe_seek);
+  tcase_add_test (tc_chain, check_rate);
 #ifdef ENABLE_EXPERIMENTAL_TESTS
+  tcase_set_timeout (tc_chain, 600);
   tcase_add_test (tc_chain, check_set_encoded_media);
+  tcase_add_test (tc_chain, passthrough_benchmark);
+  tcase_add_test (tc_chain, seek_benchmark);
 #endif
 
   return s;
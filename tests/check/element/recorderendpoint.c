@@ -17,7 +17,12 @@
 #include <gst/check/gstcheck.h>
 #include <gst/gst.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <valgrind/valgrind.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
 
 #include <commons/kmsrecordingprofile.h>
 #include <commons/kmsuriendpointstate.h>
@@ -545,6 +550,139 @@ GST_START_TEST (check_video_only)
 
 GST_END_TEST;
 
+static void
+segment_closed (GstElement * recorder, gchar * location, GPtrArray * segments)
+{
+  GST_DEBUG ("Segment closed: %s", location);
+  g_ptr_array_add (segments, g_strdup (location));
+}
+
+GST_START_TEST (check_segmented_recording)
+{
+  GstElement *pipeline, *videotestsrc, *vencoder;
+  GPtrArray *segments = g_ptr_array_new_with_free_func (g_free);
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+  GStatBuf st;
+  guint i;
+
+  expected_warnings = FALSE;
+
+  pipeline = gst_pipeline_new (__FUNCTION__);
+  videotestsrc = gst_element_factory_make ("videotestsrc", NULL);
+  vencoder = gst_element_factory_make ("vp8enc", NULL);
+  recorder = gst_element_factory_make ("recorderendpoint", NULL);
+
+  /* Segments are configured before the profile creates the muxer */
+  g_object_set (G_OBJECT (recorder), "uri",
+      "file:///tmp/check_segmented_recording.webm", "segment-duration",
+      GST_SECOND, "profile", KMS_RECORDING_PROFILE_WEBM_VIDEO_ONLY, NULL);
+  g_object_set (G_OBJECT (videotestsrc), "is-live", TRUE, "do-timestamp", TRUE,
+      NULL);
+  g_object_set (G_OBJECT (vencoder), "deadline", G_GINT64_CONSTANT (1),
+      "keyframe-max-dist", 10, NULL);
+
+  gst_bin_add_many (GST_BIN (pipeline), videotestsrc, vencoder, recorder,
+      NULL);
+  gst_element_link (videotestsrc, vencoder);
+  link_to_recorder (recorder, vencoder, pipeline, SINK_VIDEO_STREAM);
+
+  g_signal_connect (recorder, "segment-closed", G_CALLBACK (segment_closed),
+      segments);
+  g_signal_connect (recorder, "state-changed", G_CALLBACK (state_changed_cb3),
+      loop);
+
+  g_object_set (G_OBJECT (recorder), "state",
+      KMS_URI_ENDPOINT_STATE_START, NULL);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  g_main_loop_run (loop);
+
+  /* Three seconds of recording, the last segment is closed by the stop */
+  fail_unless (segments->len >= 3);
+
+  for (i = 0; i < segments->len; i++) {
+    const gchar *location = g_ptr_array_index (segments, i);
+
+    fail_unless (g_stat (location, &st) == 0);
+    fail_unless (st.st_size > 0);
+
+    if (i > 0) {
+      fail_if (g_strcmp0 (location, g_ptr_array_index (segments, i - 1)) == 0);
+    }
+
+    g_unlink (location);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_ptr_array_unref (segments);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST;
+
+#define FRAGMENTED_MP4_LOCATION "/tmp/check_fragmented_mp4.mp4"
+
+/* Fragments are written while recording, a stopped recording has several */
+GST_START_TEST (check_fragmented_mp4)
+{
+  GstElement *pipeline, *videotestsrc, *vencoder;
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+  gchar *contents, *moof;
+  gsize len, left;
+  guint fragments = 0;
+
+  expected_warnings = FALSE;
+
+  pipeline = gst_pipeline_new (__FUNCTION__);
+  videotestsrc = gst_element_factory_make ("videotestsrc", NULL);
+  vencoder = gst_element_factory_make ("x264enc", NULL);
+  fail_unless (vencoder != NULL);
+  recorder = gst_element_factory_make ("recorderendpoint", NULL);
+
+  g_object_set (G_OBJECT (recorder), "uri", "file://" FRAGMENTED_MP4_LOCATION,
+      "fragment-duration", 500, "profile",
+      KMS_RECORDING_PROFILE_MP4_VIDEO_ONLY, NULL);
+  g_object_set (G_OBJECT (videotestsrc), "is-live", TRUE, "do-timestamp", TRUE,
+      NULL);
+  g_object_set (G_OBJECT (vencoder), "tune", 0x4 /* zerolatency */ ,
+      "key-int-max", 10, NULL);
+
+  gst_bin_add_many (GST_BIN (pipeline), videotestsrc, vencoder, recorder,
+      NULL);
+  gst_element_link (videotestsrc, vencoder);
+  link_to_recorder (recorder, vencoder, pipeline, SINK_VIDEO_STREAM);
+
+  g_signal_connect (recorder, "state-changed", G_CALLBACK (state_changed_cb3),
+      loop);
+
+  g_object_set (G_OBJECT (recorder), "state",
+      KMS_URI_ENDPOINT_STATE_START, NULL);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  g_main_loop_run (loop);
+
+  fail_unless (g_file_get_contents (FRAGMENTED_MP4_LOCATION, &contents, &len,
+          NULL));
+
+  for (moof = contents, left = len; left >= 4; moof++, left--) {
+    if (memcmp (moof, "moof", 4) == 0) {
+      fragments++;
+    }
+  }
+
+  fail_unless (fragments > 1);
+
+  g_free (contents);
+  g_unlink (FRAGMENTED_MP4_LOCATION);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (check_audio_only)
 {
   GstElement *pipeline, *audiotestsrc, *encoder;
@@ -724,6 +862,534 @@ GST_START_TEST (check_ksm_sink_request)
 }
 
 GST_END_TEST
+
+/* The recording goes to a FIFO that nobody reads until the recorder */
+/* reports that it is too slow */
+typedef struct _SlowSinkData
+{
+  GMainLoop *loop;
+  gint fd;
+  gint buffers;
+  gint buffers_on_high_water;
+  gchar *media;
+  GThread *reader;
+} SlowSinkData;
+
+static GstPadProbeReturn
+count_buffers_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  SlowSinkData *data = user_data;
+
+  g_atomic_int_inc (&data->buffers);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gpointer
+drain_fifo (gpointer user_data)
+{
+  SlowSinkData *data = user_data;
+  gchar buf[4096];
+
+  fcntl (data->fd, F_SETFL, fcntl (data->fd, F_GETFL) & ~O_NONBLOCK);
+  while (read (data->fd, buf, sizeof (buf)) > 0);
+
+  return NULL;
+}
+
+static gboolean
+check_still_flowing (gpointer user_data)
+{
+  SlowSinkData *data = user_data;
+
+  /* Nothing was written meanwhile, but upstream was not blocked */
+  fail_unless (g_atomic_int_get (&data->buffers) >
+      data->buffers_on_high_water);
+
+  data->reader = g_thread_new ("drain", drain_fifo, data);
+  stop_recorder (NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+write_behind_high_water (GstElement * recorder, gchar * media,
+    SlowSinkData * data)
+{
+  GST_INFO ("High water reached on %s", media);
+
+  if (data->media != NULL) {
+    return;
+  }
+
+  data->media = g_strdup (media);
+  data->buffers_on_high_water = g_atomic_int_get (&data->buffers);
+  g_timeout_add_seconds (1, check_still_flowing, data);
+}
+
+static void
+slow_sink_state_changed (GstElement * recorder, KmsUriEndpointState newState,
+    SlowSinkData * data)
+{
+  if (newState == KMS_URI_ENDPOINT_STATE_STOP) {
+    g_idle_add (quit_main_loop_idle, data->loop);
+  }
+}
+
+GST_START_TEST (check_slow_sink)
+{
+  GstElement *pipeline, *videotestsrc, *vencoder;
+  gchar *path, *uri;
+  SlowSinkData data = { NULL, };
+  guint bus_watch_id;
+  GstBus *bus;
+  GstPad *pad;
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+
+  /* The muxer cannot seek back on a FIFO to complete the headers */
+  expected_warnings = TRUE;
+
+  path = g_build_filename (g_get_tmp_dir (), "check_slow_sink.webm", NULL);
+  unlink (path);
+  fail_unless (mkfifo (path, S_IRUSR | S_IWUSR) == 0);
+  data.fd = open (path, O_RDONLY | O_NONBLOCK);
+  fail_unless (data.fd >= 0);
+  uri = g_strdup_printf ("file://%s", path);
+
+  pipeline = gst_pipeline_new (__FUNCTION__);
+  videotestsrc = gst_element_factory_make ("videotestsrc", NULL);
+  vencoder = gst_element_factory_make ("vp8enc", NULL);
+  recorder = gst_element_factory_make ("recorderendpoint", NULL);
+
+  g_object_set (G_OBJECT (recorder), "uri", uri,
+      "profile", KMS_RECORDING_PROFILE_WEBM_VIDEO_ONLY,
+      "write-behind-bytes", 256 * 1024, NULL);
+  g_object_set (G_OBJECT (videotestsrc), "is-live", TRUE, "do-timestamp", TRUE,
+      "pattern", 18, NULL);
+  g_object_set (G_OBJECT (vencoder), "target-bitrate", 8000000, "deadline",
+      G_GINT64_CONSTANT (1), NULL);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  bus_watch_id = gst_bus_add_watch (bus, gst_bus_async_signal_func, NULL);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), pipeline);
+  g_object_unref (bus);
+
+  gst_bin_add_many (GST_BIN (pipeline), videotestsrc, vencoder, recorder,
+      NULL);
+  gst_element_link (videotestsrc, vencoder);
+
+  pad = gst_element_get_static_pad (vencoder, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, count_buffers_probe,
+      &data, NULL);
+  g_object_unref (pad);
+
+  link_to_recorder (recorder, vencoder, pipeline, SINK_VIDEO_STREAM);
+
+  g_signal_connect (recorder, "write-behind-high-water",
+      G_CALLBACK (write_behind_high_water), &data);
+  g_signal_connect (recorder, "state-changed",
+      G_CALLBACK (slow_sink_state_changed), &data);
+
+  g_object_set (G_OBJECT (recorder), "state",
+      KMS_URI_ENDPOINT_STATE_START, NULL);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  g_main_loop_run (data.loop);
+
+  fail_unless (g_strcmp0 (data.media, "video") == 0);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (GST_OBJECT (pipeline));
+
+  g_thread_join (data.reader);
+  close (data.fd);
+  unlink (path);
+
+  g_source_remove (bus_watch_id);
+  g_main_loop_unref (data.loop);
+  g_free (data.media);
+  g_free (path);
+  g_free (uri);
+}
+
+GST_END_TEST
+#ifdef ENABLE_EXPERIMENTAL_TESTS
+#define BENCHMARK_BUFFERS 20000
+#define BENCHMARK_FRAMES 30
+
+typedef struct _RecvBenchmark
+{
+  GMainLoop *loop;
+  GstElement *appsrc;
+  GPtrArray *frames;
+  GThread *pusher;
+  GThread *collector;
+  gint running;
+  gint64 start;
+  gint64 elapsed;
+} RecvBenchmark;
+
+/* Encodes once the frames that are pushed in loop to the recorder */
+static GPtrArray *
+encode_benchmark_frames (GstCaps ** caps)
+{
+  GPtrArray *frames = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) gst_buffer_unref);
+  GstElement *pipeline, *sink;
+  GstSample *sample = NULL;
+
+  pipeline = gst_parse_launch ("videotestsrc num-buffers="
+      G_STRINGIFY (BENCHMARK_FRAMES) " ! video/x-raw,width=640,height=480 "
+      "! vp8enc deadline=1 keyframe-max-dist=" G_STRINGIFY (BENCHMARK_FRAMES)
+      " ! appsink name=sink sync=false", NULL);
+  fail_unless (pipeline != NULL);
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  for (;;) {
+    g_signal_emit_by_name (sink, "pull-sample", &sample);
+    if (sample == NULL) {
+      break;
+    }
+
+    if (frames->len == 0) {
+      *caps = gst_caps_ref (gst_sample_get_caps (sample));
+    }
+
+    g_ptr_array_add (frames, gst_buffer_ref (gst_sample_get_buffer (sample)));
+    gst_sample_unref (sample);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  g_object_unref (sink);
+  gst_object_unref (pipeline);
+
+  fail_unless (frames->len == BENCHMARK_FRAMES);
+
+  return frames;
+}
+
+static gpointer
+collect_stats (gpointer user_data)
+{
+  RecvBenchmark *bench = user_data;
+  GstStructure *stats;
+
+  while (g_atomic_int_get (&bench->running)) {
+    stats = NULL;
+    g_signal_emit_by_name (recorder, "stats", NULL, &stats);
+    if (stats != NULL) {
+      gst_structure_free (stats);
+    }
+  }
+
+  return NULL;
+}
+
+static gpointer
+push_benchmark_buffers (gpointer user_data)
+{
+  RecvBenchmark *bench = user_data;
+  GstFlowReturn ret;
+  GstBuffer *buffer;
+  guint i;
+
+  for (i = 0; i < BENCHMARK_BUFFERS; i++) {
+    buffer = gst_buffer_copy (g_ptr_array_index (bench->frames,
+            i % bench->frames->len));
+    GST_BUFFER_PTS (buffer) = GST_BUFFER_DTS (buffer) =
+        i * GST_SECOND / BENCHMARK_FRAMES;
+
+    g_signal_emit_by_name (bench->appsrc, "push-buffer", buffer, &ret);
+    gst_buffer_unref (buffer);
+    fail_unless (ret == GST_FLOW_OK);
+  }
+
+  g_signal_emit_by_name (bench->appsrc, "end-of-stream", &ret);
+  g_idle_add (stop_recorder, NULL);
+
+  return NULL;
+}
+
+static void
+benchmark_state_changed (GstElement * recorder, KmsUriEndpointState newState,
+    RecvBenchmark * bench)
+{
+  if (newState == KMS_URI_ENDPOINT_STATE_START) {
+    g_atomic_int_set (&bench->running, TRUE);
+    bench->start = g_get_monotonic_time ();
+    bench->collector = g_thread_new ("stats", collect_stats, bench);
+    bench->pusher = g_thread_new ("push", push_benchmark_buffers, bench);
+  } else if (newState == KMS_URI_ENDPOINT_STATE_STOP) {
+    bench->elapsed = g_get_monotonic_time () - bench->start;
+    g_atomic_int_set (&bench->running, FALSE);
+    g_idle_add (quit_main_loop_idle, bench->loop);
+  }
+}
+
+/* Buffers per second through recv_sample, up to the muxer, while stats are */
+/* collected from another thread. Times include the stop, which waits for */
+/* the muxer, so figures are a lower bound. Nothing is dropped on the way, */
+/* so every buffer pushed is recorded */
+GST_START_TEST (recv_sample_benchmark)
+{
+  RecvBenchmark bench = { NULL, };
+  GstElement *pipeline;
+  GstCaps *caps = NULL;
+
+  expected_warnings = FALSE;
+  bench.loop = g_main_loop_new (NULL, FALSE);
+  bench.frames = encode_benchmark_frames (&caps);
+
+  pipeline = gst_pipeline_new (__FUNCTION__);
+  bench.appsrc = gst_element_factory_make ("appsrc", NULL);
+  recorder = gst_element_factory_make ("recorderendpoint", NULL);
+
+  g_object_set (bench.appsrc, "caps", caps, "format", GST_FORMAT_TIME,
+      "max-bytes", G_GUINT64_CONSTANT (0), NULL);
+  g_object_set (G_OBJECT (recorder), "uri",
+      "file:///tmp/recv_sample_benchmark.webm",
+      "profile", KMS_RECORDING_PROFILE_WEBM_VIDEO_ONLY, "media-stats", TRUE,
+      "write-behind-bytes", 0, NULL);
+  gst_caps_unref (caps);
+
+  gst_bin_add_many (GST_BIN (pipeline), bench.appsrc, recorder, NULL);
+  link_to_recorder (recorder, bench.appsrc, pipeline, SINK_VIDEO_STREAM);
+
+  g_signal_connect (recorder, "state-changed",
+      G_CALLBACK (benchmark_state_changed), &bench);
+
+  g_object_set (G_OBJECT (recorder), "state",
+      KMS_URI_ENDPOINT_STATE_START, NULL);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  g_main_loop_run (bench.loop);
+
+  g_thread_join (bench.pusher);
+  g_thread_join (bench.collector);
+
+  GST_INFO ("recv_sample: %.0f buffers/s with stats collection running",
+      BENCHMARK_BUFFERS * (gdouble) G_USEC_PER_SEC / bench.elapsed);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_ptr_array_unref (bench.frames);
+  g_main_loop_unref (bench.loop);
+}
+
+GST_END_TEST
+#define PARALLEL_BUFFERS 900
+#define PARALLEL_LOCATION "/tmp/parallel_recording_%u.webm"
+
+typedef struct _ParallelBenchmark
+{
+  GMainLoop *loop;
+  GPtrArray *recorders;
+  GPtrArray *appsrcs;
+  GPtrArray *frames;
+  GThread *pusher;
+  gint started;
+  gint recording;
+  gint64 start;
+  gint64 elapsed;
+} ParallelBenchmark;
+
+static gboolean
+stop_parallel_recorders (gpointer user_data)
+{
+  ParallelBenchmark *bench = user_data;
+  guint i;
+
+  for (i = 0; i < bench->recorders->len; i++) {
+    g_object_set (g_ptr_array_index (bench->recorders, i), "state",
+        KMS_URI_ENDPOINT_STATE_STOP, NULL);
+  }
+
+  return FALSE;
+}
+
+/* Interleaves buffers of every recording, as network threads would */
+static gpointer
+push_parallel_buffers (gpointer user_data)
+{
+  ParallelBenchmark *bench = user_data;
+  GstFlowReturn ret;
+  GstBuffer *buffer;
+  guint i, j;
+
+  for (i = 0; i < PARALLEL_BUFFERS; i++) {
+    for (j = 0; j < bench->appsrcs->len; j++) {
+      buffer = gst_buffer_copy (g_ptr_array_index (bench->frames,
+              i % bench->frames->len));
+      GST_BUFFER_PTS (buffer) = GST_BUFFER_DTS (buffer) =
+          i * GST_SECOND / BENCHMARK_FRAMES;
+
+      g_signal_emit_by_name (g_ptr_array_index (bench->appsrcs, j),
+          "push-buffer", buffer, &ret);
+      gst_buffer_unref (buffer);
+      fail_unless (ret == GST_FLOW_OK);
+    }
+  }
+
+  for (j = 0; j < bench->appsrcs->len; j++) {
+    g_signal_emit_by_name (g_ptr_array_index (bench->appsrcs, j),
+        "end-of-stream", &ret);
+  }
+
+  g_idle_add (stop_parallel_recorders, bench);
+
+  return NULL;
+}
+
+static void
+parallel_state_changed (GstElement * recorder, KmsUriEndpointState newState,
+    ParallelBenchmark * bench)
+{
+  if (newState == KMS_URI_ENDPOINT_STATE_START) {
+    if (g_atomic_int_add (&bench->started, 1) + 1 ==
+        (gint) bench->recorders->len) {
+      bench->start = g_get_monotonic_time ();
+      bench->pusher = g_thread_new ("push", push_parallel_buffers, bench);
+    }
+  } else if (newState == KMS_URI_ENDPOINT_STATE_STOP) {
+    if (g_atomic_int_dec_and_test (&bench->recording)) {
+      bench->elapsed = g_get_monotonic_time () - bench->start;
+      g_idle_add (quit_main_loop_idle, bench->loop);
+    }
+  }
+}
+
+static GType
+get_element_type (const gchar * name)
+{
+  GstElementFactory *factory = gst_element_factory_find (name);
+  GstPluginFeature *loaded;
+  GType type;
+
+  fail_unless (factory != NULL);
+  loaded = gst_plugin_feature_load (GST_PLUGIN_FEATURE (factory));
+  fail_unless (loaded != NULL);
+  type = gst_element_factory_get_element_type (GST_ELEMENT_FACTORY (loaded));
+
+  gst_object_unref (loaded);
+  gst_object_unref (factory);
+
+  return type;
+}
+
+/* Aggregated write throughput of n recordings to local files, from the */
+/* first buffer until every file is closed. Nothing is dropped, so every */
+/* buffer pushed is recorded. With stock_sink, files are written by */
+/* filesink instead of kmsfilesink, as a reference for the same run */
+static void
+run_parallel_recordings (guint n, gboolean stock_sink)
+{
+  ParallelBenchmark bench = { NULL, };
+  GstElement *pipeline, *appsrc, *recorder;
+  GstCaps *caps = NULL;
+  GType kms_type = G_TYPE_INVALID, file_type = G_TYPE_INVALID;
+  GStatBuf st;
+  guint64 bytes = 0;
+  gchar *uri, *location;
+  guint i;
+
+  expected_warnings = FALSE;
+
+  if (stock_sink) {
+    kms_type = get_element_type ("kmsfilesink");
+    file_type = get_element_type ("filesink");
+    /* Updates the factory the recorder makes its file sinks from */
+    fail_unless (gst_element_register (NULL, "kmsfilesink", GST_RANK_NONE,
+            file_type));
+  }
+
+  bench.loop = g_main_loop_new (NULL, FALSE);
+  bench.frames = encode_benchmark_frames (&caps);
+  bench.recorders = g_ptr_array_new ();
+  bench.appsrcs = g_ptr_array_new ();
+  bench.recording = n;
+
+  pipeline = gst_pipeline_new (__FUNCTION__);
+
+  for (i = 0; i < n; i++) {
+    appsrc = gst_element_factory_make ("appsrc", NULL);
+    recorder = gst_element_factory_make ("recorderendpoint", NULL);
+
+    location = g_strdup_printf (PARALLEL_LOCATION, i);
+    uri = g_strconcat ("file://", location, NULL);
+    g_object_set (appsrc, "caps", caps, "format", GST_FORMAT_TIME,
+        "max-bytes", G_GUINT64_CONSTANT (0), NULL);
+    g_object_set (G_OBJECT (recorder), "uri", uri, "sync-interval", 1000,
+        "profile", KMS_RECORDING_PROFILE_WEBM_VIDEO_ONLY,
+        "write-behind-bytes", 0, NULL);
+    g_free (location);
+    g_free (uri);
+
+    gst_bin_add_many (GST_BIN (pipeline), appsrc, recorder, NULL);
+    link_to_recorder (recorder, appsrc, pipeline, SINK_VIDEO_STREAM);
+
+    g_signal_connect (recorder, "state-changed",
+        G_CALLBACK (parallel_state_changed), &bench);
+
+    g_ptr_array_add (bench.recorders, recorder);
+    g_ptr_array_add (bench.appsrcs, appsrc);
+  }
+
+  gst_caps_unref (caps);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  for (i = 0; i < n; i++) {
+    g_object_set (g_ptr_array_index (bench.recorders, i), "state",
+        KMS_URI_ENDPOINT_STATE_START, NULL);
+  }
+
+  g_main_loop_run (bench.loop);
+  g_thread_join (bench.pusher);
+
+  for (i = 0; i < n; i++) {
+    location = g_strdup_printf (PARALLEL_LOCATION, i);
+    fail_unless (g_stat (location, &st) == 0);
+    fail_unless (st.st_size > 0);
+    bytes += st.st_size;
+    g_unlink (location);
+    g_free (location);
+  }
+
+  GST_INFO ("%u parallel recordings with %s: %.1f MB/s, %.0f buffers/s", n,
+      stock_sink ? "filesink" : "kmsfilesink", bytes / (gdouble) bench.elapsed,
+      n * PARALLEL_BUFFERS * (gdouble) G_USEC_PER_SEC / bench.elapsed);
+
+  if (stock_sink) {
+    fail_unless (gst_element_register (NULL, "kmsfilesink", GST_RANK_NONE,
+            kms_type));
+    fail_unless (gst_element_register (NULL, "filesink", GST_RANK_PRIMARY,
+            file_type));
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_ptr_array_unref (bench.recorders);
+  g_ptr_array_unref (bench.appsrcs);
+  g_ptr_array_unref (bench.frames);
+  g_main_loop_unref (bench.loop);
+}
+
+GST_START_TEST (parallel_recordings_100)
+{
+  run_parallel_recordings (100, FALSE);
+  run_parallel_recordings (100, TRUE);
+}
+
+GST_END_TEST
+GST_START_TEST (parallel_recordings_500)
+{
+  run_parallel_recordings (500, FALSE);
+  run_parallel_recordings (500, TRUE);
+}
+
+GST_END_TEST
+#endif
 /******************************/
 /* RecorderEndpoint test suit */
 /******************************/
@@ -740,6 +1406,15 @@ recorderendpoint_suite (void)
   tcase_add_test (tc_chain, check_audio_only);
   tcase_add_test (tc_chain, check_states_pipeline);
   tcase_add_test (tc_chain, warning_pipeline);
+  tcase_add_test (tc_chain, check_slow_sink);
+  tcase_add_test (tc_chain, check_segmented_recording);
+  tcase_add_test (tc_chain, check_fragmented_mp4);
+#ifdef ENABLE_EXPERIMENTAL_TESTS
+  tcase_set_timeout (tc_chain, 600);
+  tcase_add_test (tc_chain, recv_sample_benchmark);
+  tcase_add_test (tc_chain, parallel_recordings_100);
+  tcase_add_test (tc_chain, parallel_recordings_500);
+#endif
 
   if (check_support_for_ksr ()) {
     tcase_add_test (tc_chain, check_ksm_sink_request);
@@ -0,0 +1,345 @@
+/*
+ * (C) Copyright 2026 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+
+#define N_PANEL 3
+#define N_AUDIENCE 2
+#define N_PORTS (N_PANEL + N_AUDIENCE)
+
+static gboolean
+is_made_by (GstElement * element, const gchar * name)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+
+  return factory != NULL && g_strcmp0 (GST_OBJECT_NAME (factory), name) == 0;
+}
+
+static void
+count_factory (const GValue * item, gpointer * data)
+{
+  const gchar *name = data[0];
+  guint *count = data[1];
+
+  if (is_made_by (g_value_get_object (item), name)) {
+    (*count)++;
+  }
+}
+
+static gint
+find_factory (const GValue * item, const gchar * name)
+{
+  return is_made_by (g_value_get_object (item), name) ? 0 : 1;
+}
+
+/* First element of the mixer made by the factory */
+static GstElement *
+find_element (GstElement * mixer, const gchar * name)
+{
+  GstIterator *it = gst_bin_iterate_elements (GST_BIN (mixer));
+  GValue item = G_VALUE_INIT;
+  GstElement *element = NULL;
+
+  if (gst_iterator_find_custom (it, (GCompareFunc) find_factory, &item,
+          (gpointer) name)) {
+    element = g_value_dup_object (&item);
+    g_value_unset (&item);
+  }
+
+  gst_iterator_free (it);
+
+  return element;
+}
+
+/* Elements of the mixer itself made by the factory */
+static guint
+count_elements (GstElement * mixer, const gchar * name)
+{
+  GstIterator *it = gst_bin_iterate_elements (GST_BIN (mixer));
+  guint count = 0;
+  gpointer data[] = { (gpointer) name, &count };
+
+  while (gst_iterator_foreach (it, (GstIteratorForeachFunction) count_factory,
+          data) == GST_ITERATOR_RESYNC) {
+    gst_iterator_resync (it);
+    count = 0;
+  }
+
+  gst_iterator_free (it);
+
+  return count;
+}
+
+static void
+connect_audio (GstElement * mixer, gint source, gint sink)
+{
+  gboolean connected;
+
+  g_signal_emit_by_name (mixer, "connect-audio", source, sink, &connected);
+  fail_unless (connected);
+}
+
+static GstStructure *
+create_route (gint source, gint sink, const gchar * media)
+{
+  return gst_structure_new ("route", "source", G_TYPE_UINT, source, "sink",
+      G_TYPE_UINT, sink, "media", G_TYPE_STRING, media, NULL);
+}
+
+/* Element behind the ghost pad of the hub for the port */
+static GstElement *
+get_hub_element (GstElement * hub, const gchar * prefix, gint id)
+{
+  GstElement *element = NULL;
+  GstPad *pad, *target;
+  gchar *name;
+
+  name = g_strdup_printf ("%s%d", prefix, id);
+  pad = gst_element_get_static_pad (hub, name);
+  g_free (name);
+
+  if (pad == NULL) {
+    return NULL;
+  }
+
+  target = gst_ghost_pad_get_target (GST_GHOST_PAD (pad));
+
+  if (target != NULL) {
+    element = gst_pad_get_parent_element (target);
+    g_object_unref (target);
+  }
+
+  g_object_unref (pad);
+
+  return element;
+}
+
+/* Whether the video of the sink port comes from the source, any if -1 */
+static gboolean
+is_video_routed (GstElement * hub, gint source, gint sink)
+{
+  GstElement *from = get_hub_element (hub, "video_src_", sink);
+  GstElement *agnostic = NULL;
+  gboolean routed;
+
+  if (source >= 0) {
+    agnostic = get_hub_element (hub, "video_sink_", source);
+  }
+
+  routed = from == agnostic;
+
+  g_clear_object (&from);
+  g_clear_object (&agnostic);
+
+  return routed;
+}
+
+GST_START_TEST (panel_and_audience)
+{
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *mixer = gst_element_factory_make ("selectablemixer", NULL);
+  gint ids[N_PORTS];
+  guint i, j;
+
+  gst_bin_add (GST_BIN (pipeline), mixer);
+
+  for (i = 0; i < N_PORTS; i++) {
+    GstElement *port = gst_element_factory_make ("hubport", NULL);
+
+    gst_bin_add (GST_BIN (pipeline), port);
+    g_signal_emit_by_name (mixer, "handle-port", port, &ids[i]);
+    fail_if (ids[i] < 0);
+  }
+
+  /* The panel hears everyone in it but themselves */
+  for (i = 0; i < N_PANEL; i++) {
+    for (j = 0; j < N_PANEL; j++) {
+      if (i != j) {
+        connect_audio (mixer, ids[j], ids[i]);
+      }
+    }
+  }
+
+  fail_unless_equals_int (count_elements (mixer, "mixminus"), 1);
+  fail_unless_equals_int (count_elements (mixer, "audiomixerbin"), 0);
+
+  /* The audience hears the whole panel, from the same group */
+  for (i = N_PANEL; i < N_PORTS; i++) {
+    for (j = 0; j < N_PANEL; j++) {
+      connect_audio (mixer, ids[j], ids[i]);
+    }
+  }
+
+  fail_unless_equals_int (count_elements (mixer, "mixminus"), 1);
+  fail_unless_equals_int (count_elements (mixer, "audiomixerbin"), 0);
+
+  for (i = 0; i < N_PORTS; i++) {
+    g_signal_emit_by_name (mixer, "unhandle-port", ids[i]);
+  }
+
+  fail_unless_equals_int (count_elements (mixer, "mixminus"), 0);
+  fail_unless_equals_int (count_elements (mixer, "audiomixerbin"), 0);
+
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST
+/* A port hears two panel members through the group of the whole panel */
+GST_START_TEST (group_member_leaves)
+{
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *mixer = gst_element_factory_make ("selectablemixer", NULL);
+  GstElement *mixminus;
+  GstPad *pad;
+  gint ids[N_PANEL + 1];
+  gchar *name;
+  guint i, j;
+
+  gst_bin_add (GST_BIN (pipeline), mixer);
+
+  for (i = 0; i < N_PANEL + 1; i++) {
+    GstElement *port = gst_element_factory_make ("hubport", NULL);
+
+    gst_bin_add (GST_BIN (pipeline), port);
+    g_signal_emit_by_name (mixer, "handle-port", port, &ids[i]);
+    fail_if (ids[i] < 0);
+  }
+
+  for (i = 0; i < N_PANEL; i++) {
+    for (j = 0; j < N_PANEL; j++) {
+      if (i != j) {
+        connect_audio (mixer, ids[j], ids[i]);
+      }
+    }
+  }
+
+  /* Same set as the last panel member, so the same output of the group */
+  connect_audio (mixer, ids[0], ids[N_PANEL]);
+  connect_audio (mixer, ids[1], ids[N_PANEL]);
+
+  fail_unless_equals_int (count_elements (mixer, "mixminus"), 1);
+
+  g_signal_emit_by_name (mixer, "unhandle-port", ids[N_PANEL - 1]);
+
+  /* The listener moves to a group of its own set plus itself, and the */
+  /* others now hear a single source each */
+  fail_unless_equals_int (count_elements (mixer, "mixminus"), 1);
+  fail_unless_equals_int (count_elements (mixer, "audiomixerbin"), 2);
+
+  mixminus = find_element (mixer, "mixminus");
+  fail_if (mixminus == NULL);
+
+  name = g_strdup_printf ("sink_%d", ids[N_PANEL - 1]);
+  pad = gst_element_get_static_pad (mixminus, name);
+  fail_unless (pad == NULL, "Group still takes input from the removed port");
+  g_free (name);
+
+  name = g_strdup_printf ("sink_%d", ids[N_PANEL]);
+  pad = gst_element_get_static_pad (mixminus, name);
+  fail_if (pad == NULL);
+  g_object_unref (pad);
+  g_free (name);
+
+  g_object_unref (mixminus);
+
+  for (i = 0; i < N_PANEL + 1; i++) {
+    if (i != N_PANEL - 1) {
+      g_signal_emit_by_name (mixer, "unhandle-port", ids[i]);
+    }
+  }
+
+  fail_unless_equals_int (count_elements (mixer, "mixminus"), 0);
+  fail_unless_equals_int (count_elements (mixer, "audiomixerbin"), 0);
+
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST
+GST_START_TEST (apply_routing)
+{
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *mixer = gst_element_factory_make ("selectablemixer", NULL);
+  GPtrArray *routes;
+  gboolean applied;
+  gint ids[3];
+  guint i;
+
+  gst_bin_add (GST_BIN (pipeline), mixer);
+
+  for (i = 0; i < G_N_ELEMENTS (ids); i++) {
+    GstElement *port = gst_element_factory_make ("hubport", NULL);
+
+    gst_bin_add (GST_BIN (pipeline), port);
+    g_signal_emit_by_name (mixer, "handle-port", port, &ids[i]);
+    fail_if (ids[i] < 0);
+  }
+
+  routes = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_structure_free);
+  g_ptr_array_add (routes, create_route (ids[0], ids[2], "audio"));
+  g_ptr_array_add (routes, create_route (ids[1], ids[2], "audio"));
+  g_ptr_array_add (routes, create_route (ids[0], ids[1], "video"));
+  g_signal_emit_by_name (mixer, "apply-routing", routes, &applied);
+  fail_unless (applied);
+  g_ptr_array_unref (routes);
+
+  /* Both audio sources are mixed once, by the group they form with the sink */
+  fail_unless_equals_int (count_elements (mixer, "mixminus"), 1);
+  fail_unless_equals_int (count_elements (mixer, "audiomixerbin"), 0);
+  fail_unless (is_video_routed (mixer, ids[0], ids[1]));
+  fail_unless (is_video_routed (mixer, -1, ids[2]));
+
+  /* Rejected as a whole because of the unknown port */
+  routes = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_structure_free);
+  g_ptr_array_add (routes, create_route (ids[2], ids[0], "audio"));
+  g_ptr_array_add (routes, create_route (ids[2], ids[1], "video"));
+  g_ptr_array_add (routes, create_route (ids[0], G_MAXINT, "audio"));
+  g_signal_emit_by_name (mixer, "apply-routing", routes, &applied);
+  fail_if (applied);
+  g_ptr_array_unref (routes);
+
+  fail_unless_equals_int (count_elements (mixer, "mixminus"), 1);
+  fail_unless_equals_int (count_elements (mixer, "audiomixerbin"), 0);
+  fail_unless (is_video_routed (mixer, ids[0], ids[1]));
+
+  for (i = 0; i < G_N_ELEMENTS (ids); i++) {
+    g_signal_emit_by_name (mixer, "unhandle-port", ids[i]);
+  }
+
+  fail_unless_equals_int (count_elements (mixer, "mixminus"), 0);
+
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+selectable_mixer_suite (void)
+{
+  Suite *s = suite_create ("selectablemixer");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, panel_and_audience);
+  tcase_add_test (tc_chain, group_member_leaves);
+  tcase_add_test (tc_chain, apply_routing);
+
+  return s;
+}
+
+GST_CHECK_MAIN (selectable_mixer);
@@ -18,6 +18,8 @@
 #include <gst/check/gstcheck.h>
 #include <gst/sdp/gstsdpmessage.h>
 #include <webrtcendpoint/kmsicecandidate.h>
+#include <webrtcendpoint/kmsicebaseagent.h>
+#include <webrtcendpoint/kmswebrtclooppool.h>
 
 #include <commons/kmselementpadtype.h>
 #include <commons/kmsutils.h>
@@ -2575,6 +2577,257 @@ GST_START_TEST (set_external_ipv6_test)
 }
 GST_END_TEST
 
+GST_START_TEST (test_loop_pool)
+{
+  GstElement *webrtcendpoints[8];
+  GMainContext *ctx1, *ctx2, *ctx3;
+  guint i;
+
+  kms_webrtc_loop_pool_set_size (2);
+
+  ctx1 = kms_webrtc_loop_pool_acquire ();
+  ctx2 = kms_webrtc_loop_pool_acquire ();
+  ctx3 = kms_webrtc_loop_pool_acquire ();
+  fail_unless (ctx1 != ctx2);
+  fail_unless (ctx3 == ctx1 || ctx3 == ctx2);
+  fail_unless (kms_webrtc_loop_pool_get_n_loops () == 2);
+
+  kms_webrtc_loop_pool_release (ctx1);
+  kms_webrtc_loop_pool_release (ctx2);
+  kms_webrtc_loop_pool_release (ctx3);
+  fail_unless (kms_webrtc_loop_pool_get_n_loops () == 0);
+
+  for (i = 0; i < G_N_ELEMENTS (webrtcendpoints); i++) {
+    webrtcendpoints[i] = gst_element_factory_make ("webrtcendpoint", NULL);
+  }
+
+  fail_unless (kms_webrtc_loop_pool_get_n_loops () == 2);
+
+  for (i = 0; i < G_N_ELEMENTS (webrtcendpoints); i++) {
+    g_object_unref (webrtcendpoints[i]);
+  }
+
+  fail_unless (kms_webrtc_loop_pool_get_n_loops () == 0);
+
+  /* Dedicated loop for each endpoint */
+  kms_webrtc_loop_pool_set_size (KMS_WEBRTC_LOOP_POOL_DEDICATED);
+
+  for (i = 0; i < G_N_ELEMENTS (webrtcendpoints); i++) {
+    webrtcendpoints[i] = gst_element_factory_make ("webrtcendpoint", NULL);
+  }
+
+  fail_unless (kms_webrtc_loop_pool_get_n_loops () ==
+      G_N_ELEMENTS (webrtcendpoints));
+
+  for (i = 0; i < G_N_ELEMENTS (webrtcendpoints); i++) {
+    g_object_unref (webrtcendpoints[i]);
+  }
+
+  kms_webrtc_loop_pool_set_size (g_get_num_processors ());
+}
+GST_END_TEST
+
+#ifdef ENABLE_EXPERIMENTAL_TESTS
+
+// ----------------------------------------------------------------------------
+
+// loop_pool_benchmark
+// -------------------
+
+typedef struct _IceBenchData
+{
+  GMutex mutex;
+  GCond cond;
+  guint pending;
+} IceBenchData;
+
+typedef struct _IceBenchPair
+{
+  GstElement *offerer;
+  GstElement *answerer;
+  gchar *offerer_sess_id;
+  gchar *answerer_sess_id;
+  OnIceCandidateData offerer_cand_data;
+  OnIceCandidateData answerer_cand_data;
+  gint connected;               /* atomic */
+} IceBenchPair;
+
+static void
+ice_bench_on_state_changed (GstElement * self, gchar * sess_id,
+    gchar * stream_id, guint component_id, guint state, IceBenchData * data)
+{
+  IceBenchPair *pair = g_object_get_data (G_OBJECT (self), "bench-pair");
+
+  if (state != ICE_STATE_CONNECTED && state != ICE_STATE_READY) {
+    return;
+  }
+
+  if (g_object_get_data (G_OBJECT (self), "bench-connected") != NULL) {
+    return;
+  }
+
+  g_object_set_data (G_OBJECT (self), "bench-connected",
+      GINT_TO_POINTER (TRUE));
+
+  /* Both peers must be connected */
+  if (g_atomic_int_add (&pair->connected, 1) != 1) {
+    return;
+  }
+
+  g_mutex_lock (&data->mutex);
+  data->pending--;
+  g_cond_signal (&data->cond);
+  g_mutex_unlock (&data->mutex);
+}
+
+static guint64
+read_proc_status_value (const gchar * field)
+{
+  gchar *contents, *line;
+  guint64 value = 0;
+
+  if (!g_file_get_contents ("/proc/self/status", &contents, NULL, NULL)) {
+    return 0;
+  }
+
+  line = strstr (contents, field);
+  if (line != NULL) {
+    value = g_ascii_strtoull (line + strlen (field), NULL, 10);
+  }
+
+  g_free (contents);
+
+  return value;
+}
+
+static void
+ice_bench_pair_negotiate (IceBenchPair * pair, GArray * codecs_array,
+    IceBenchData * data)
+{
+  GstSDPMessage *offer, *answer;
+  gboolean ret;
+
+  pair->offerer = gst_element_factory_make ("webrtcendpoint", NULL);
+  pair->answerer = gst_element_factory_make ("webrtcendpoint", NULL);
+
+  g_object_set (pair->offerer, "num-audio-medias", 1, "audio-codecs",
+      g_array_ref (codecs_array), "niceagent-ice-tcp", FALSE, NULL);
+  g_object_set (pair->answerer, "num-audio-medias", 1, "audio-codecs",
+      g_array_ref (codecs_array), "niceagent-ice-tcp", FALSE, NULL);
+
+  g_signal_emit_by_name (pair->offerer, "create-session",
+      &pair->offerer_sess_id);
+  g_signal_emit_by_name (pair->answerer, "create-session",
+      &pair->answerer_sess_id);
+
+  pair->offerer_cand_data.peer = pair->answerer;
+  pair->offerer_cand_data.peer_sess_id = pair->answerer_sess_id;
+  g_signal_connect (pair->offerer, "on-ice-candidate",
+      G_CALLBACK (on_ice_candidate), &pair->offerer_cand_data);
+  pair->answerer_cand_data.peer = pair->offerer;
+  pair->answerer_cand_data.peer_sess_id = pair->offerer_sess_id;
+  g_signal_connect (pair->answerer, "on-ice-candidate",
+      G_CALLBACK (on_ice_candidate), &pair->answerer_cand_data);
+
+  g_object_set_data (G_OBJECT (pair->offerer), "bench-pair", pair);
+  g_object_set_data (G_OBJECT (pair->answerer), "bench-pair", pair);
+  g_signal_connect (pair->offerer, "on-ice-component-state-changed",
+      G_CALLBACK (ice_bench_on_state_changed), data);
+  g_signal_connect (pair->answerer, "on-ice-component-state-changed",
+      G_CALLBACK (ice_bench_on_state_changed), data);
+
+  g_signal_emit_by_name (pair->offerer, "generate-offer",
+      pair->offerer_sess_id, &offer);
+  fail_unless (offer != NULL);
+  g_signal_emit_by_name (pair->answerer, "process-offer",
+      pair->answerer_sess_id, offer, &answer);
+  fail_unless (answer != NULL);
+  g_signal_emit_by_name (pair->offerer, "process-answer",
+      pair->offerer_sess_id, answer, &ret);
+  fail_unless (ret);
+  gst_sdp_message_free (offer);
+  gst_sdp_message_free (answer);
+}
+
+static void
+loop_pool_benchmark (guint n_endpoints)
+{
+  gchar *codecs[] = { "PCMU/8000/1", NULL };
+  guint n_pairs = n_endpoints / 2;
+  IceBenchPair *pairs = g_new0 (IceBenchPair, n_pairs);
+  GArray *codecs_array = create_codecs_array (codecs);
+  gint64 start, end_time;
+  IceBenchData data;
+  gboolean ret;
+  guint i;
+
+  g_mutex_init (&data.mutex);
+  g_cond_init (&data.cond);
+  data.pending = n_pairs;
+
+  for (i = 0; i < n_pairs; i++) {
+    ice_bench_pair_negotiate (&pairs[i], codecs_array, &data);
+  }
+
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < n_pairs; i++) {
+    g_signal_emit_by_name (pairs[i].offerer, "gather-candidates",
+        pairs[i].offerer_sess_id, &ret);
+    fail_unless (ret);
+    g_signal_emit_by_name (pairs[i].answerer, "gather-candidates",
+        pairs[i].answerer_sess_id, &ret);
+    fail_unless (ret);
+  }
+
+  end_time = start + 120 * G_TIME_SPAN_SECOND;
+  g_mutex_lock (&data.mutex);
+  while (data.pending > 0) {
+    if (!g_cond_wait_until (&data.cond, &data.mutex, end_time)) {
+      break;
+    }
+  }
+  g_mutex_unlock (&data.mutex);
+
+  fail_unless (data.pending == 0, "%u pairs not connected", data.pending);
+
+  GST_INFO ("[LoopPoolBenchmark] endpoints: %u, pool size: %u"
+      ", loops: %u, threads: %" G_GUINT64_FORMAT ", VmRSS: %" G_GUINT64_FORMAT
+      " kB, ICE connect time: %" G_GINT64_FORMAT " ms",
+      n_endpoints, kms_webrtc_loop_pool_get_size (),
+      kms_webrtc_loop_pool_get_n_loops (), read_proc_status_value ("Threads:"),
+      read_proc_status_value ("VmRSS:"),
+      (g_get_monotonic_time () - start) / G_TIME_SPAN_MILLISECOND);
+
+  for (i = 0; i < n_pairs; i++) {
+    g_object_unref (pairs[i].offerer);
+    g_object_unref (pairs[i].answerer);
+    g_free (pairs[i].offerer_sess_id);
+    g_free (pairs[i].answerer_sess_id);
+  }
+
+  g_array_unref (codecs_array);
+  g_mutex_clear (&data.mutex);
+  g_cond_clear (&data.cond);
+  g_free (pairs);
+}
+
+GST_START_TEST (test_loop_pool_benchmark)
+{
+  guint sizes[] = { 100, 1000, 5000 };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++) {
+    kms_webrtc_loop_pool_set_size (KMS_WEBRTC_LOOP_POOL_DEDICATED);
+    loop_pool_benchmark (sizes[i]);
+    kms_webrtc_loop_pool_set_size (g_get_num_processors ());
+    loop_pool_benchmark (sizes[i]);
+  }
+}
+GST_END_TEST
+
+#endif // ENABLE_EXPERIMENTAL_TESTS
+
 /*
  * End of test cases
  */
@@ -2610,6 +2863,11 @@ webrtcendpoint_test_suite (void)
   tcase_add_test (tc_chain, set_external_ipv4_test);
   tcase_add_test (tc_chain, set_external_ipv6_test);
 
+  tcase_add_test (tc_chain, test_loop_pool);
+#ifdef ENABLE_EXPERIMENTAL_TESTS
+  tcase_add_test (tc_chain, test_loop_pool_benchmark);
+#endif
+
   return s;
 }
 